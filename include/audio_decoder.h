@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "audio_format.h"
+
+// 压缩音频解码器接口
+// 解码结果为 16bit Little Endian 单声道 PCM，直接接入 Session 的 PCM 流水线
+class IAudioDecoder {
+public:
+    virtual ~IAudioDecoder() = default;
+
+    // 解码一条消息的负载，结果追加到 pcm_out (字节流)
+    // 返回 false 表示数据损坏，本条消息被丢弃
+    virtual bool decode(const uint8_t* data, size_t len, std::vector<uint8_t>& pcm_out) = 0;
+
+    // 清空解码器内部状态，用于归还到池中复用
+    virtual void reset() = 0;
+};
+
+// 解码器对象池
+// 解码器状态 (尤其 Opus) 创建有一定开销，连接关闭后重置并留存，供后续连接复用
+class DecoderPool {
+public:
+    explicit DecoderPool(size_t max_idle_per_format = 64) : max_idle_(max_idle_per_format) {}
+
+    // 当前构建是否支持该编码
+    static bool supports(AudioCodec codec);
+
+    // 取出一个可用解码器；PCM 或不支持的编码返回 nullptr
+    std::unique_ptr<IAudioDecoder> acquire(const AudioFormat& format);
+
+    // 归还解码器 (线程安全，通常在 Session 析构时调用)
+    void release(const AudioFormat& format, std::unique_ptr<IAudioDecoder> decoder);
+
+private:
+    static std::unique_ptr<IAudioDecoder> create(const AudioFormat& format);
+
+    // 同一编码下输出率/帧长不同的解码器不能混用
+    typedef std::pair<int, int> Key; // (codec, engine rate or speex frame bytes)
+    static Key key_of(const AudioFormat& format);
+
+    size_t max_idle_;
+    std::mutex mutex_;
+    std::map<Key, std::vector<std::unique_ptr<IAudioDecoder>>> idle_;
+};
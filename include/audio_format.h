@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+
+// 传输编码
+enum class AudioCodec {
+    PCM,       // 原始 16bit Little Endian PCM
+    OPUS,      // 每条消息一个 Opus 包
+    SPEEX_WB   // 每条消息若干个定长 Speex 宽带帧 (与 Go 版 speex-wb 一致)
+};
+
+// 客户端输入音频格式 (每个连接在握手时协商一次)
+// 默认与旧协议一致: 16kHz、单声道、16bit Little Endian PCM
+struct AudioFormat {
+    int sample_rate = 16000;
+    int channels = 1;
+    AudioCodec codec = AudioCodec::PCM;
+    int speex_frame_bytes = 0; // SPEEX_WB: 每个编码帧的字节数
+
+    bool valid() const {
+        if (sample_rate < 8000 || sample_rate > 192000 || channels < 1 || channels > 8) return false;
+        switch (codec) {
+        case AudioCodec::PCM:
+            return true;
+        case AudioCodec::OPUS:
+            // Opus 只定义了这几种解码输出率
+            return (sample_rate == 8000 || sample_rate == 12000 || sample_rate == 16000 ||
+                    sample_rate == 24000 || sample_rate == 48000) && channels <= 2;
+        case AudioCodec::SPEEX_WB:
+            return sample_rate == 16000 && channels == 1 && speex_frame_bytes > 0;
+        }
+        return false;
+    }
+
+    // 解码后送入 PCM 流水线的格式
+    // Opus 直接解码到引擎采样率的单声道，省掉重采样与下混
+    AudioFormat decoded_format() const {
+        if (codec == AudioCodec::PCM) return *this;
+        AudioFormat pcm;
+        pcm.sample_rate = engine_sample_rate();
+        pcm.channels = 1;
+        return pcm;
+    }
+
+    // VAD 引擎实际运行的采样率: 原生 8k 直接使用 Silero 的 8k 模式，其余统一重采样到 16k
+    int engine_sample_rate() const {
+        return sample_rate == 8000 ? 8000 : 16000;
+    }
+
+    bool needs_resample() const { return sample_rate != engine_sample_rate(); }
+
+    // 每个交织帧 (所有声道各一个 int16) 的字节数
+    size_t frame_bytes() const { return static_cast<size_t>(channels) * 2; }
+
+    // 一条消息负载对应的音频时长 (微秒)，用于调度计费与限速
+    // PCM 按字节精确计算；压缩编码按 20ms 一帧估算 (Opus 每条消息一个包，Speex 为定长帧拼接)
+    uint64_t duration_us(size_t bytes) const {
+        switch (codec) {
+        case AudioCodec::PCM:
+            return static_cast<uint64_t>(bytes) * 1000000 / (static_cast<uint64_t>(sample_rate) * frame_bytes());
+        case AudioCodec::OPUS:
+            return 20000;
+        case AudioCodec::SPEEX_WB:
+            return speex_frame_bytes > 0 ? static_cast<uint64_t>(bytes / speex_frame_bytes) * 20000 : 0;
+        }
+        return 0;
+    }
+};
+
+// 从连接 URI 的查询串中取参数，例如 "/?sample_rate=48000&channels=2&codec=opus"
+// 未找到时返回空字符串
+inline std::string get_query_param(const std::string& resource, const std::string& key) {
+    size_t q = resource.find('?');
+    if (q == std::string::npos) return "";
+    size_t pos = q + 1;
+    while (pos < resource.size()) {
+        size_t amp = resource.find('&', pos);
+        if (amp == std::string::npos) amp = resource.size();
+        size_t eq = resource.find('=', pos);
+        if (eq != std::string::npos && eq < amp && resource.compare(pos, eq - pos, key) == 0 && eq - pos == key.size()) {
+            return resource.substr(eq + 1, amp - eq - 1);
+        }
+        pos = amp + 1;
+    }
+    return "";
+}
+
+inline bool parse_int_param(const std::string& text, int& value) {
+    if (text.empty()) return true;
+    char* end = nullptr;
+    long v = std::strtol(text.c_str(), &end, 10);
+    if (*end != '\0') return false;
+    value = static_cast<int>(v);
+    return true;
+}
+
+// 解析 URI 中的格式协商参数，缺省字段保持默认值
+// 返回 false 表示参数非法 (无法解析或超出支持范围)
+inline bool parse_audio_format(const std::string& resource, AudioFormat& fmt) {
+    std::string codec = get_query_param(resource, "codec");
+    if (codec.empty() || codec == "pcm" || codec == "raw") {
+        fmt.codec = AudioCodec::PCM;
+    } else if (codec == "opus") {
+        fmt.codec = AudioCodec::OPUS;
+    } else if (codec == "speex-wb") {
+        fmt.codec = AudioCodec::SPEEX_WB;
+    } else {
+        return false;
+    }
+    if (!parse_int_param(get_query_param(resource, "sample_rate"), fmt.sample_rate) ||
+        !parse_int_param(get_query_param(resource, "channels"), fmt.channels) ||
+        !parse_int_param(get_query_param(resource, "frame_bytes"), fmt.speex_frame_bytes)) {
+        return false;
+    }
+    return fmt.valid();
+}
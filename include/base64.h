@@ -3,6 +3,7 @@
 #include <vector>
 #include <algorithm>
 #include <stdexcept>
+#include <cstdint>
 
 namespace base64 {
 
@@ -56,6 +57,69 @@ inline std::vector<uint8_t> decode(std::string const& encoded_string) {
   return ret;
 }
 
+// 查表解码 [s, s + n)，结果追加到 out
+// 与 decode() 语义一致: 遇到 '=' 或第一个非 base64 字符即停止，末尾不完整的分组按剩余位输出
+inline void decode_append(const char* s, size_t n, std::vector<uint8_t>& out) {
+  static const struct Table {
+    int8_t v[256];
+    Table() {
+      for (int i = 0; i < 256; ++i) v[i] = -1;
+      for (int i = 0; i < 64; ++i) v[static_cast<unsigned char>(base64_chars[i])] = static_cast<int8_t>(i);
+    }
+  } table;
+
+  size_t end = 0;
+  while (end < n && table.v[static_cast<unsigned char>(s[end])] >= 0) ++end;
+
+  out.reserve(out.size() + end / 4 * 3 + 3);
+  size_t i = 0;
+  for (; i + 4 <= end; i += 4) {
+    uint32_t v = (uint32_t(table.v[static_cast<unsigned char>(s[i])]) << 18) |
+                 (uint32_t(table.v[static_cast<unsigned char>(s[i + 1])]) << 12) |
+                 (uint32_t(table.v[static_cast<unsigned char>(s[i + 2])]) << 6) |
+                 uint32_t(table.v[static_cast<unsigned char>(s[i + 3])]);
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+  }
+  size_t rest = end - i;
+  if (rest) {
+    uint32_t v = 0;
+    for (size_t k = 0; k < rest; ++k) {
+      v |= uint32_t(table.v[static_cast<unsigned char>(s[i + k])]) << (18 - 6 * k);
+    }
+    for (size_t k = 0; k + 1 < rest; ++k) {
+      out.push_back(static_cast<uint8_t>(v >> (16 - 8 * k)));
+    }
+  }
+}
+
+// 直接编码追加到 out 末尾 (一次性扩容，按 3 字节一组查表)
+inline void encode_append(std::string& out, unsigned char const* bytes, size_t in_len) {
+  static const char table[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t offset = out.size();
+  out.resize(offset + (in_len + 2) / 3 * 4);
+  char* dst = &out[offset];
+  size_t i = 0;
+  for (; i + 3 <= in_len; i += 3) {
+    uint32_t v = (uint32_t(bytes[i]) << 16) | (uint32_t(bytes[i + 1]) << 8) | bytes[i + 2];
+    *dst++ = table[(v >> 18) & 0x3F];
+    *dst++ = table[(v >> 12) & 0x3F];
+    *dst++ = table[(v >> 6) & 0x3F];
+    *dst++ = table[v & 0x3F];
+  }
+  size_t rest = in_len - i;
+  if (rest) {
+    uint32_t v = uint32_t(bytes[i]) << 16;
+    if (rest == 2) v |= uint32_t(bytes[i + 1]) << 8;
+    *dst++ = table[(v >> 18) & 0x3F];
+    *dst++ = table[(v >> 12) & 0x3F];
+    *dst++ = rest == 2 ? table[(v >> 6) & 0x3F] : '=';
+    *dst++ = '=';
+  }
+}
+
 inline std::string encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
   std::string ret;
   int i = 0;
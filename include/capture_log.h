@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "audio_format.h"
+
+// 会话抓包日志 (append-only 二进制格式，主机字节序 = 小端)
+//
+//   文件头: "VADCAP01" (仅新文件)
+//   记录:   CaptureRecordHeader + length 字节负载
+//     RUN_START     : u64 unix 时间 (微秒), u32 pid, u32 reserved；每次打开写入器时追加一条
+//     SESSION_OPEN  : u32 sample_rate, u16 channels, u8 codec, u8 reserved, u32 frame_bytes, 其后为 uid
+//     SESSION_META  : 三个 (u32 长度 + 字节) 字符串: uid, connect_session, current_session
+//     FRAME         : 连接收到的原始音频负载 (解码前)，在入队时记录，保留客户端的分块
+//     SESSION_CLOSE : 无负载
+//
+// 同一文件可以包含多次运行 (进程重启后继续追加)。session 为 (代数 << 32 | 槽位)，只在一次运行内唯一；
+// timestamp_us 为本次运行开始 (RUN_START) 后的单调时钟微秒数
+namespace capture {
+
+const char kMagic[8] = {'V', 'A', 'D', 'C', 'A', 'P', '0', '1'};
+
+enum RecordType : uint8_t {
+    SESSION_OPEN = 1,
+    SESSION_META = 2,
+    FRAME = 3,
+    SESSION_CLOSE = 4,
+    RUN_START = 5,
+};
+
+struct RecordHeader {
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t length;
+    uint64_t session;
+    uint64_t timestamp_us;
+};
+static_assert(sizeof(RecordHeader) == 24, "capture record header must be packed");
+
+const size_t kOpenFixedBytes = 12;
+const size_t kRunStartBytes = 16;
+
+// 抓包写入器
+// 调用方 (I/O 线程与工作线程) 只把记录拷进各自线程的内存缓冲区，由后台线程批量 fwrite，不在热路径上做文件 I/O，
+// 线程之间也不争同一把锁。后台线程按时间戳归并各线程的记录，保证同一会话的记录按发生顺序落盘。
+// 积压超过 max_pending_bytes 时丢弃新记录并计数，而不是阻塞工作线程。
+class Writer {
+public:
+    Writer(const std::string& path, size_t max_pending_bytes = 64 << 20);
+    ~Writer();
+
+    bool is_open() const { return file_ != nullptr; }
+
+    void session_open(uint64_t session, const std::string& uid, const AudioFormat& format);
+    void session_meta(uint64_t session, const std::string& uid, const std::string& connect_session,
+                      const std::string& current_session);
+    void frame(uint64_t session, const uint8_t* data, size_t len);
+    void session_close(uint64_t session);
+
+    uint64_t dropped_records() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    // 每个写入线程一个缓冲区；锁只在该线程与后台线程之间竞争
+    // 缓冲区内每条记录前多存一个 u64 纳秒时间戳，供归并排序使用，落盘时去掉
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<uint8_t> pending;
+        // 以下只由后台线程访问: 上一轮留下的、时间戳晚于截止点的记录
+        std::vector<uint8_t> carry;
+        size_t offset = 0;
+    };
+
+    ThreadBuffer* local_buffer();
+    // 组装一条记录: 头 + 最多两段负载
+    void append(RecordType type, uint64_t session, const void* a, size_t a_len, const void* b = nullptr,
+                size_t b_len = 0);
+    void writer_loop();
+    // 收集各线程缓冲区，按时间戳归并出早于 cutoff_ns 的记录并写入文件
+    void flush_round(uint64_t cutoff_ns, std::vector<uint8_t>& batch);
+    uint64_t now_ns() const;
+
+    std::FILE* file_ = nullptr;
+    size_t max_pending_bytes_;
+    std::chrono::steady_clock::time_point start_;
+    // 进程内唯一，线程局部缓存据此判断缓存的缓冲区是否属于本写入器
+    uint64_t id_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    bool stopping_ = false;
+    bool flush_requested_ = false;
+    std::atomic<size_t> pending_bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::thread thread_;
+};
+
+// 只读方式 mmap 整个抓包文件，按顺序遍历记录
+class Reader {
+public:
+    struct Record {
+        RecordHeader header;
+        const uint8_t* payload;
+    };
+
+    explicit Reader(const std::string& path);
+    ~Reader();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool is_open() const { return data_ != nullptr; }
+    // 读取下一条记录；文件结束或记录被截断时返回 false
+    bool next(Record& record);
+
+    // SESSION_OPEN 负载解析
+    static bool parse_open(const Record& record, AudioFormat& format, std::string& uid);
+    // RUN_START 负载解析
+    static bool parse_run_start(const Record& record, uint64_t& unix_us, uint32_t& pid);
+    // SESSION_META 负载解析
+    static bool parse_meta(const Record& record, std::string& uid, std::string& connect_session,
+                           std::string& current_session);
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+};
+
+} // namespace capture
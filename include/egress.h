@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ws_config.h"
+
+// 出站 (egress) 阶段
+// - 出站消息对象池化复用，payload 的 std::string 保留容量，工作线程直接序列化进去
+// - 消息在工作线程上预先封好 WebSocket 帧头 (prepared)，websocketpp 不再分配新消息、拷贝 payload
+// - 同一连接的多个待发事件合并为一次投递到 I/O 线程，由 websocketpp 在同一次写操作中发出
+class Egress {
+public:
+    Egress(server& srv, size_t pool_size);
+    ~Egress();
+
+    // 取一个空的出站消息 (线程安全)；最后一个持有者 (通常是 websocketpp 写完之后) 释放时自动回到池中
+    server::message_ptr acquire();
+
+    // 在消息上封装文本帧帧头；payload 写完后、send 之前调用
+    static void prepare_text_frame(const server::message_ptr& msg);
+
+    // 发送到指定连接 (线程安全，通常由工作线程调用)
+    // 连接已关闭时静默丢弃
+    void send(connection_hdl hdl, server::message_ptr msg);
+
+    // 统计: 实际投递到 I/O 线程的次数 / 发出的消息数
+    uint64_t flush_count() const { return flushes_.load(std::memory_order_relaxed); }
+    uint64_t message_count() const { return messages_.load(std::memory_order_relaxed); }
+
+private:
+    // 空闲消息列表；消息的删除器持有它的 shared_ptr，Egress 析构后仍在途的消息直接删除
+    struct FreeList {
+        std::mutex mutex;
+        std::vector<server::message_type*> messages;
+        size_t capacity = 0;
+    };
+    struct Recycler {
+        std::shared_ptr<FreeList> free;
+        void operator()(server::message_type* msg) const;
+    };
+
+    // 在连接的 strand 上运行，与该连接的 websocketpp 回调串行
+    void flush(server::connection_ptr con);
+
+    server& srv_;
+    std::shared_ptr<FreeList> free_;
+
+    std::atomic<uint64_t> flushes_{0};
+    std::atomic<uint64_t> messages_{0};
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// JSON 音频上行消息中我们关心的字段
+//  {
+//      "uid":"abc_123",
+//      "connect_session":"...",
+//      "current_session":"...",
+//      "data":{ "bussin":{}, "audio":"base64..." }
+//  }
+struct AudioMessageFields {
+    std::string uid;
+    std::string connect_session;
+    std::string current_session;
+    bool has_audio = false;
+};
+
+// 单遍选择性解析: 只提取 uid / connect_session / current_session / data.audio，
+// 其余值只做语法校验后跳过，不构建 DOM。
+// data.audio 的 base64 内容直接从负载内存解码追加到 audio_out，不产生中间字符串。
+// 返回 false 表示 JSON 非法或上述字段类型不是字符串 (与原先 nlohmann 解析抛异常的情形一致)
+bool parse_audio_message(const char* json, size_t len, AudioMessageFields& fields, std::vector<uint8_t>& audio_out);
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+namespace json_writer {
+
+// 按 nlohmann::json::dump() 的默认规则转义字符串内容 (不含两侧引号)，追加到 out
+// - 不做 ASCII 转义 (ensure_ascii = false)，UTF-8 字节原样输出
+// - '"' '\\' 与 \b \f \n \r \t 使用短转义，其余 0x00-0x1F 输出为 \u00xx (小写十六进制)
+inline void append_escaped(std::string& out, const char* s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    size_t run = 0; // 连续无需转义的字节从 s + run_start 开始批量追加
+    size_t run_start = 0;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            ++run;
+            continue;
+        }
+        out.append(s + run_start, run);
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            char buf[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            out.append(buf, 6);
+            break;
+        }
+        }
+        run = 0;
+        run_start = i + 1;
+    }
+    out.append(s + run_start, run);
+}
+
+inline void append_escaped(std::string& out, const std::string& s) {
+    append_escaped(out, s.data(), s.size());
+}
+
+// 追加 "key":"value"，value 需要转义
+inline void append_string_field(std::string& out, const char* key, const std::string& value) {
+    out += '"';
+    out += key;
+    out += "\":\"";
+    append_escaped(out, value);
+    out += '"';
+}
+
+} // namespace json_writer
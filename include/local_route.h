@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "audio_format.h"
+#include "session_slab.h"
+
+// websocketpp 以外的接入方式 (原生传输、共享内存环) 的出站目标
+//
+// 这类会话的 Session::get_hdl() 指向一个 LocalRoute (由 shared_ptr<LocalRoute> 转成 connection_hdl)，
+// Session::has_local_route() 为 true。路由对象随连接状态一起释放，工作线程 lock() 失败时丢弃响应。
+class LocalRoute {
+public:
+    virtual ~LocalRoute() = default;
+    // 工作线程调用: 发出一条 JSON 事件 (线程安全)
+    virtual void send_event(const std::string& payload) = 0;
+    // 线程安全: 以 code 关闭连接 (空闲回收)；不支持时返回 false
+    virtual bool close(uint16_t code) {
+        (void)code;
+        return false;
+    }
+};
+
+// 本地接入连接的会话与调度参数 (对应 websocketpp 路径的 connection_base)，只在所属接入线程上访问
+struct LocalStream {
+    SessionRef session_ref;
+    uint32_t shard = 0;
+    uint32_t latency_budget_ms = 0;
+    uint32_t pcm_bytes_per_sec = 0; // 压缩编码为 0 (不可切片)
+    uint16_t pcm_frame_bytes = 0;
+    AudioFormat format;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "local_route.h"
+#include "native_transport.h"
+#include "ws_protocol.h"
+
+class AudioServer;
+class NativeLoop;
+
+// 原生传输连接的出站目标: 封成文本帧后放进所属事件循环的发件箱
+class NativeRoute : public LocalRoute {
+public:
+    NativeRoute(NativeLoop& loop, uint64_t id) : loop_(loop), id_(id) {}
+    void send_event(const std::string& payload) override;
+    bool close(uint16_t code) override;
+
+private:
+    NativeLoop& loop_;
+    uint64_t id_;
+};
+
+// 一个原生传输事件循环 (--transport epoll|io_uring，每个 I/O 线程一个)
+//
+// 在后端的字节流上完成 HTTP 升级与 RFC 6455 分帧，之后与 websocketpp 路径走同一条会话流水线:
+// 经 AudioServer 的本地接入接口建立会话，帧解析成 AudioTask 交给所属工作线程的调度器，
+// 工作线程的响应经 NativeRoute 投递回本循环的发件箱。
+// 连接状态只在事件循环线程上访问，不加锁。
+// 与 websocketpp 路径相比不支持: 入站限速、协程流水线、/admin 管理接口 (排空与迁移)。
+class NativeLoop : public TransportHandler {
+public:
+    explicit NativeLoop(AudioServer& owner);
+
+    // 创建后端并开始监听 (SO_REUSEPORT，各循环共用端口)；io_uring 不可用时退回 epoll
+    bool open(const TransportOptions& options, bool use_uring);
+    const char* backend_name() const;
+
+    // 在调用线程上运行事件循环，直到 stop()
+    void run();
+    void stop();
+
+    // 线程安全: 工作线程投递已封好帧的响应
+    void send(uint64_t id, std::string&& bytes);
+    // 线程安全: 发出关闭帧后断开
+    void close(uint64_t id, uint16_t code);
+
+    void on_accept(uint64_t id) override;
+    void on_data(uint64_t id, uint8_t* data, size_t len) override;
+    void on_closed(uint64_t id) override;
+
+private:
+    struct Connection {
+        std::string in; // 未消费完的入站字节 (半个请求头或半帧)
+        bool upgraded = false;
+        bool closing = false;
+        ws::FrameParser parser;
+        std::shared_ptr<LocalRoute> route;
+        LocalStream stream;
+    };
+
+    // 解析字节流；返回已消费的字节数
+    size_t handle_http(uint64_t id, Connection& con, uint8_t* data, size_t len);
+    size_t handle_frames(uint64_t id, Connection& con, uint8_t* data, size_t len);
+    // 数据帧转成任务 (对应 AudioServer::on_message)
+    void on_message(Connection& con, ws::Opcode opcode, const uint8_t* payload, size_t size);
+    void fail(uint64_t id, Connection& con, uint16_t code);
+
+    AudioServer& owner_;
+    std::unique_ptr<TransportBackend> backend_;
+    std::unordered_map<uint64_t, Connection> connections_;
+};
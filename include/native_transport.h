@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 原生传输后端 (--transport epoll|io_uring)
+//
+// 后端只负责接受连接与收发字节，RFC 6455 协议与会话处理在 NativeServer 中。每个后端实例是一个
+// 单线程事件循环，各自以 SO_REUSEPORT 监听同一端口，由内核分配连接。
+// 连接以 64 位 id 标识 (代数 << 32 | fd)：fd 被复用后，旧 id 上的发送与关闭被忽略。
+// send/close/stop 可在任意线程调用 (放入发件箱，必要时用 eventfd 唤醒事件循环)。
+
+// 事件回调，全部在事件循环线程上执行
+class TransportHandler {
+public:
+    virtual ~TransportHandler() = default;
+    virtual void on_accept(uint64_t id) = 0;
+    // 收到的字节；缓冲区属于后端，只在回调期间有效 (可就地修改，例如去掩码)
+    virtual void on_data(uint64_t id, uint8_t* data, size_t len) = 0;
+    virtual void on_closed(uint64_t id) = 0;
+};
+
+struct TransportOptions {
+    uint16_t port = 9002;
+    // io_uring: 提交队列深度
+    unsigned ring_entries = 4096;
+    // io_uring: 多路接收使用的提供缓冲区 (个数需为 2 的幂)
+    unsigned recv_buffers = 4096;
+    size_t recv_buffer_size = 4096;
+    // io_uring: 注册的发送缓冲槽，放得下的响应以 WRITE_FIXED 发出
+    unsigned send_slots = 1024;
+    size_t send_slot_size = 1024;
+    // 每个连接尚未写出的字节上限；读得太慢的客户端超过后直接断开，不再为它无限缓存
+    size_t max_queued_bytes = 4 << 20;
+};
+
+class TransportBackend {
+public:
+    virtual ~TransportBackend() = default;
+
+    virtual const char* name() const = 0;
+    // 在调用线程上运行事件循环，直到 stop()
+    virtual void run() = 0;
+    virtual void stop() = 0;
+    // 追加到该连接的发送队列 (按调用顺序发出)
+    virtual void send(uint64_t id, std::string&& bytes) = 0;
+    // 发完已排队的数据后关闭 (对端半关闭时同样先发完，例如关闭帧的回应)
+    virtual void close(uint64_t id) = 0;
+};
+
+// SO_REUSEPORT 的非阻塞监听套接字，失败返回 -1
+int open_listen_socket(uint16_t port);
+
+std::unique_ptr<TransportBackend> make_epoll_transport(const TransportOptions& options, TransportHandler& handler);
+// io_uring 后端 (多路 accept/recv + 提供缓冲环 + 注册发送缓冲 + 批量提交)；
+// 内核不支持 (io_uring 被禁用或早于 5.19) 或以 VAD_NO_IO_URING 构建时返回 nullptr，调用方退回 epoll
+std::unique_ptr<TransportBackend> make_uring_transport(const TransportOptions& options, TransportHandler& handler);
@@ -0,0 +1,19 @@
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <functional>
+#include <memory>
+
+// 会话协程的驱动循环 (pipeline_coroutine.cpp，唯一按 C++20 编译的源文件)
+//
+// 这里不依赖任务类型与 websocketpp，协程之外的代码 (含 websocketpp 0.8 头文件) 保持 C++17。
+
+enum class PipelineStep {
+    RAN,  // 处理了一个任务: 让出一次后继续
+    WAIT, // 收件箱为空 (已登记等待): 挂起在 signal 上，直到被取消
+    DONE  // 流水线已关闭: 协程退出
+};
+
+// 在 context 上启动协程，反复调用 step()；keep_alive 在协程结束时释放
+void spawn_pipeline_coroutine(boost::asio::io_context& context, boost::asio::steady_timer& signal,
+                              std::function<PipelineStep()> step, std::shared_ptr<void> keep_alive);
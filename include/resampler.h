@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "session_snapshot.h"
+
+// 交织 PCM16 -> 单声道 float 的转码 + 下混 (一次遍历完成)
+// frames: 每声道的样本数; out 至少需要 frames 个元素
+void pcm16_to_mono_float(const uint8_t* pcm, size_t frames, int channels, float* out);
+
+// 流式多相 (polyphase) 重采样器
+// 输出率/输入率化简为 L/M，原型低通滤波器按 L 个相位拆分，
+// 每个输出样本只需计算一个相位的点积 (taps_per_phase 次乘加)。
+// 跨调用保留历史样本与相位，因此可以逐包喂入任意长度的数据。
+class PolyphaseResampler {
+public:
+    PolyphaseResampler(int in_rate, int out_rate);
+
+    // 处理一段输入，结果追加到 out
+    void process(const float* in, size_t n, std::vector<float>& out);
+
+    // 清空历史与相位 (用于会话复用)
+    void reset();
+
+    // 会话迁移: 导出/恢复历史样本与相位；采样率或滤波器长度不符时 load_state 返回 false
+    void save_state(snapshot::Writer& w) const;
+    bool load_state(snapshot::Reader& r);
+
+    // 内存统计 (按容量计)；trim: 收回大块输入撑大的工作缓冲区，只留历史样本
+    size_t memory_bytes() const { return sizeof(*this) + (coeffs_.capacity() + buf_.capacity()) * sizeof(float); }
+    void trim();
+
+    int in_rate() const { return in_rate_; }
+    int out_rate() const { return out_rate_; }
+
+private:
+    int in_rate_;
+    int out_rate_;
+    int up_;    // L
+    int down_;  // M
+    size_t taps_;  // 每个相位的抽头数 (已按 SIMD 宽度对齐)
+
+    // coeffs_[phase * taps_ + k]，k 按时间正序排列，便于与历史缓冲区做连续点积
+    std::vector<float> coeffs_;
+
+    // [taps_-1 个历史样本][本次新输入]
+    std::vector<float> buf_;
+
+    // 下一个输出样本在 "新输入" 坐标系中的位置，单位为 1/L 个输入样本
+    uint64_t pos_ = 0;
+};
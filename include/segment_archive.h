@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "segment_forwarder.h"
+
+struct ArchiveOptions {
+    // 输出目录 (需已存在)；文件名为 <prefix><uid>_<new_session>.wav
+    std::string directory;
+    // 文件名前缀 (多进程共用一个目录时区分进程)
+    std::string prefix;
+    // 排队上限: 超过任一上限时新段直接丢弃并计数，工作线程从不等待磁盘
+    size_t max_queue_segments = 1024;
+    size_t max_queue_bytes = 64u << 20;
+};
+
+// 语音段归档 (--archive-dir DIR)
+//
+// Session 在 VAD_END 时把整段 PCM 的缓冲区移交给 submit() (不拷贝)，归档线程每轮整批取走队列，
+// 为每段写一个 WAV: 44 字节头与 PCM 负载一次 writev 写入临时文件，写完再 rename，读者不会看到半个文件。
+// PCM 已是 int16 小端交织，"编码" 只是生成文件头。
+class SegmentArchive {
+public:
+    explicit SegmentArchive(const ArchiveOptions& options);
+    ~SegmentArchive();
+
+    // 检查目录并启动归档线程；失败时返回 false
+    bool start();
+    // 写完队列中剩余的段后停止
+    void stop();
+
+    // 工作线程调用: 接受时取走 pcm (留下空缓冲区) 并返回 true；队列已满时返回 false，pcm 不变
+    bool submit(const SpeechSegmentInfo& info, std::vector<uint8_t>& pcm);
+
+    // 统计
+    uint64_t written_segments() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t written_bytes() const { return written_bytes_.load(std::memory_order_relaxed); }
+    uint64_t dropped_segments() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t write_errors() const { return errors_.load(std::memory_order_relaxed); }
+    // 当前与历史最大的排队段数、排队字节数 (含正在写的一批)
+    size_t queue_segments() const { return queue_segments_.load(std::memory_order_relaxed); }
+    size_t queue_bytes() const { return queue_bytes_.load(std::memory_order_relaxed); }
+    size_t peak_queue_segments() const { return peak_segments_.load(std::memory_order_relaxed); }
+    size_t peak_queue_bytes() const { return peak_bytes_.load(std::memory_order_relaxed); }
+    // 归档线程花在写文件上的时间 (写出字节数 / 该时间 = 磁盘吞吐)
+    double busy_seconds() const { return busy_us_.load(std::memory_order_relaxed) / 1e6; }
+
+private:
+    struct Item {
+        SpeechSegmentInfo info;
+        std::vector<uint8_t> pcm;
+    };
+
+    void run();
+    // 返回写出的字节数 (文件头 + 按整帧截断的负载)，失败时返回 0
+    size_t write_segment(const Item& item);
+
+    ArchiveOptions options_;
+    std::thread thread_;
+    bool running_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopping_ = false;
+    std::vector<Item> queue_;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> written_bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<size_t> queue_segments_{0};
+    std::atomic<size_t> queue_bytes_{0};
+    std::atomic<size_t> peak_segments_{0};
+    std::atomic<size_t> peak_bytes_{0};
+    std::atomic<uint64_t> busy_us_{0};
+};
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 语音段开始时发给下游的元数据
+struct SpeechSegmentInfo {
+    std::string uid;
+    std::string connect_session;
+    std::string current_session;
+    std::string new_session;
+    int sample_rate = 16000;
+    int channels = 1;
+};
+
+// Session 把语音段音频 (解码后的 PCM，VAD_BEGIN 起) 交给的下游；工作线程调用，线程安全
+class SpeechSink {
+public:
+    virtual ~SpeechSink() = default;
+    // 开始一个语音段，返回段 id (非 0)
+    virtual uint64_t begin_segment(const SpeechSegmentInfo& info) = 0;
+    virtual void segment_audio(uint64_t id, const uint8_t* data, size_t len) = 0;
+    // aborted: 会话在语音段中途关闭 (连接断开、排空或迁移)
+    virtual void end_segment(uint64_t id, bool aborted) = 0;
+};
+
+struct ForwarderOptions {
+    // ws://host:port/path (每段一条 WebSocket 消息序列) 或 tcp://host:port (长度前缀分帧)
+    std::string url;
+    // 到下游的连接池上限；同时进行的语音段超过上限时排队等待空闲连接
+    size_t max_connections = 64;
+    // 每段尚未写出的字节上限 (下游跟不上或连接未就绪时累积)，超出后放弃该段
+    size_t max_backlog_bytes = 1u << 20;
+};
+
+// 语音段转发 (--asr-forward URL)
+//
+// 客户端原本要从 VAD_END 里取回 base64 的整段音频再转发给 ASR，多一次往返、带宽翻倍。
+// 开启转发后，Session 从 VAD_BEGIN 起把每一帧语音直接交给本对象，响应里只保留事件元数据:
+//   - 工作线程把帧封好 (WebSocket 客户端帧或 tcp 分帧) 后放进命令队列，多次追加只写一次 eventfd；
+//   - 一个 I/O 线程用 epoll 驱动连接池: 每个语音段独占一条连接，音频边说边发 (不等 VAD_END)，
+//     段结束且写完后连接回到空闲列表，供下一段复用 (省去建连与握手)；
+//   - 下游的回包 (ASR 结果) 读出后丢弃，不回传给客户端。
+//
+// 下游协议 (vad_asr_sink 是一个本地替身):
+//   ws:// : 每段一次 TEXT {"type":"start",...元数据}，若干 BINARY (PCM s16le)，一次 TEXT {"type":"end",...}
+//   tcp://: 同样的三类消息，每条为 [1 字节类型: 1 开始 / 2 音频 / 3 结束][4 字节大端长度][负载]
+class SegmentForwarder : public SpeechSink {
+public:
+    explicit SegmentForwarder(const ForwarderOptions& options);
+    ~SegmentForwarder() override;
+
+    // 解析 URL 与下游地址并启动 I/O 线程；失败时返回 false
+    bool start();
+    // 停止 I/O 线程并断开全部连接 (之后的调用直接丢弃)
+    void stop();
+
+    uint64_t begin_segment(const SpeechSegmentInfo& info) override;
+    void segment_audio(uint64_t id, const uint8_t* data, size_t len) override;
+    void end_segment(uint64_t id, bool aborted) override;
+
+    // 统计: 完整转发的段数、写出的音频字节数、放弃的段数 (积压超限或连接失败)、新建的连接数、建连失败次数
+    uint64_t forwarded_segments() const { return forwarded_.load(std::memory_order_relaxed); }
+    uint64_t forwarded_bytes() const { return audio_bytes_.load(std::memory_order_relaxed); }
+    uint64_t dropped_segments() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t connections_opened() const { return connections_opened_.load(std::memory_order_relaxed); }
+    uint64_t connect_failures() const { return connect_failures_.load(std::memory_order_relaxed); }
+
+private:
+    struct Command {
+        enum Type : uint8_t { BEGIN, AUDIO, END } type;
+        uint64_t id;
+        size_t audio_bytes;
+        std::string bytes; // 已封好的帧
+    };
+    struct Upstream;
+    struct Segment;
+
+    void push(Command&& command);
+    // 按下游协议封一条消息
+    void frame(std::string& out, uint8_t type, const uint8_t* data, size_t len) const;
+
+    // 以下只在 I/O 线程上运行
+    void run();
+    void apply(Command& command);
+    // 为段找一条连接: 空闲连接、新建连接或排队
+    void bind(const std::shared_ptr<Segment>& segment);
+    void release(Upstream& upstream);
+    Upstream* connect_upstream();
+    void on_event(Upstream& upstream, uint32_t events);
+    void flush(Upstream& upstream);
+    void fail(Upstream& upstream);
+    void drop(Segment& segment);
+
+    ForwarderOptions options_;
+    bool websocket_ = false;
+    std::string host_header_;
+    std::string path_;
+    std::vector<uint8_t> address_; // sockaddr_in / sockaddr_in6
+    int epoll_fd_ = -1;
+    int event_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    std::atomic<uint64_t> next_id_{1};
+    std::mutex mutex_;
+    std::vector<Command> commands_;
+    std::atomic<bool> signaled_{false};
+
+    // I/O 线程的状态
+    std::mt19937 key_rng_{std::random_device{}()}; // 握手的 Sec-WebSocket-Key
+    std::vector<Command> pending_commands_;
+    std::unordered_map<int, std::unique_ptr<Upstream>> upstreams_;
+    std::vector<Upstream*> idle_;
+    std::unordered_map<uint64_t, std::shared_ptr<Segment>> segments_;
+    std::deque<std::shared_ptr<Segment>> waiting_;
+
+    std::atomic<uint64_t> forwarded_{0};
+    std::atomic<uint64_t> audio_bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> connections_opened_{0};
+    std::atomic<uint64_t> connect_failures_{0};
+};
@@ -1,56 +1,237 @@
 #pragma once
 
-#include <websocketpp/config/asio_no_tls.hpp>
-#include <websocketpp/server.hpp>
-#include <map>
 #include <memory>
 #include <thread>
 #include <string>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
+#include "ws_config.h"
+#include "egress.h"
 #include "session.h"
-#include "safe_queue.h"
-
-// 定义服务器类型
-typedef websocketpp::server<websocketpp::config::asio> server;
-using websocketpp::connection_hdl;
-
-// 任务包
-struct AudioTask {
-    connection_hdl hdl;
-    std::vector<uint8_t> data;
-    // Protocol metadata
-    std::string uid;
-    std::string connect_session;
-    std::string current_session;
+#include "session_pool.h"
+#include "session_slab.h"
+#include "task_scheduler.h"
+#include "capture_log.h"
+#include "vad_model.h"
+#include "local_route.h"
+#include "segment_forwarder.h"
+#include "segment_archive.h"
+#ifdef VAD_WITH_COROUTINES
+#include "session_pipeline.h"
+#endif
+
+class NativeLoop;
+class ShmIngress;
+
+// 服务配置 (由 main.cpp 从命令行解析)
+struct ServerConfig {
+    uint16_t port = 9002;
+    // 以 SO_REUSEPORT 监听，多个进程共用同一端口、由内核分配连接 (多进程模式与滚动重启)
+    bool reuse_port = false;
+    // 启动时预热 (已加载模型) 的会话数
+    size_t warm_sessions = 0;
+    // 会话池最多保留的空闲会话数
+    size_t max_idle_sessions = 64;
+    // 同时在线的连接数上限 (会话槽表容量)
+    size_t max_sessions = 4096;
+    // 出站消息池大小
+    size_t egress_pool_size = 1024;
+    // 运行同一个 io_service 的 I/O 线程数 (WebSocket 分帧、JSON 解析、base64 解码)
+    size_t io_threads = 1;
+    // VAD 工作线程数，会话按槽位分片到固定的工作线程，保证同一会话的任务顺序执行
+    size_t worker_threads = 1;
+    // 非空时把每个会话收到的帧、时间与元数据写入该抓包文件 (供 vad_replay 回放)
+    std::string capture_path;
+    // 模型路径与 ORT 格式缓存 (main.cpp 在创建服务前交给 VadModel::configure)
+    VadModelOptions model;
+    // 每个工作线程在开始接受连接前跑的合成推理次数 (每种采样率)
+    int warmup_iterations = 32;
+    // 默认的单帧延迟预算 (连接可用 ?latency_ms= 覆盖)，用于计算任务截止时间
+    uint32_t latency_budget_ms = 200;
+    // 超大 PCM 任务的切片时长
+    uint32_t slice_ms = 100;
+    // 会话间调度策略: EDF 按截止时间 (延迟优先)，DRR 按音频时长轮转 (隔离高速上传的客户端)
+    SchedulerConfig::Policy schedule = SchedulerConfig::Policy::EDF;
+    // DRR 每轮给每个会话的音频额度
+    uint32_t quantum_ms = 100;
+    // 每个连接的入站限速 (音频秒 / 墙钟秒)，0 表示不限速
+    double rate_limit = 0;
+    // 令牌桶容量 (音频秒)，允许短时突发
+    double rate_burst_sec = 2.0;
+    // 超速时丢弃超出的帧；为 false 时暂停读取该连接 (TCP 背压) 直到令牌补足
+    bool rate_limit_drop = false;
+    // 会话积压超过该音频时长时进入追赶模式 (合并处理，只回传状态跳变)，0 关闭
+    uint32_t catchup_ms = 1000;
+    // 会话快照目录: 排空时把每个会话冻结到这里，新进程凭 ?resume= 令牌恢复 (为空时排空只断开连接)
+    std::string snapshot_dir;
+    // 开启 /admin/drain、/admin/migrate 与 /admin/sessions 管理接口 (只应在内网端口上开启)
+    bool admin_http = false;
+    // 每个会话一个协程 (需以 -DVAD_COROUTINES=ON 构建)，代替调度器队列 + 工作线程轮询；
+    // 协程模式下会话固定在所属工作线程上，不支持 /admin/migrate
+    bool coroutine_pipeline = false;
+    // 网络传输: websocketpp (Boost.Asio)，或原生的 RFC 6455 实现跑在 epoll / io_uring 事件循环上
+    // (每个 I/O 线程一个循环，各自以 SO_REUSEPORT 监听)；原生传输不支持入站限速与 /admin 接口
+    enum class Transport { WEBSOCKETPP, EPOLL, IO_URING };
+    Transport transport = Transport::WEBSOCKETPP;
+    // 非空时另在该 Unix 套接字上开放共享内存接入 (同机网关经共享内存环写入 PCM，见 shm_ingress.h)
+    std::string shm_socket;
+    // 共享内存接入每个流的事件环大小 (KiB)，决定能整条送回的最长 VAD_END (1024 KiB 约 24 秒 16kHz 语音)
+    size_t shm_event_ring_kb = 1024;
+    // 非空时把语音段音频转发到下游 ASR (ws://host:port/path 或 tcp://host:port)，响应不再带 vad_audio
+    std::string asr_forward;
+    // 到下游 ASR 的连接池上限
+    size_t asr_connections = 64;
+    // 非空时把每个语音段写成该目录下的 WAV 文件 (归档线程异步写入，见 segment_archive.h)
+    std::string archive_dir;
+    // 空闲回收: 会话超过 idle_timeout_sec 秒没有收到音频时断开，超过 hibernate_after_sec 秒时休眠
+    // (释放缓冲区、暂存引擎状态，下一帧音频到来时恢复)；0 表示关闭。共享内存接入的流不会被断开，只会休眠
+    size_t idle_timeout_sec = 0;
+    size_t hibernate_after_sec = 0;
+    // 归档文件名前缀 (supervisor 按进程设置)
+    std::string archive_prefix;
+    // 等待写盘的语音段总量上限 (MiB)，超出后新段不再归档
+    size_t archive_queue_mb = 64;
 };
 
 class AudioServer {
+    // 本地接入 (原生传输的事件循环、共享内存接入) 使用会话管理与就绪门控
+    friend class NativeLoop;
+    friend class ShmIngress;
+
 public:
-    AudioServer();
+    explicit AudioServer(const ServerConfig& config = ServerConfig());
     ~AudioServer();
 
     void run(uint16_t port);
     void stop();
+    // 优雅退出: 配置了快照目录时先排空 (冻结全部会话并等连接断开)，再 stop()
+    void shutdown();
+
+    // 按 config 建立服务并运行，直到收到 SIGTERM/SIGINT 后优雅退出 (单进程模式与多进程的工作进程共用)。
+    // 信号在创建任何线程之前屏蔽，由一个等待线程 sigwait 接收，不在信号处理函数里做事；启动失败时抛出异常
+    static void run_until_signal(const ServerConfig& config);
 
 private:
     // WebSocket 回调
     void on_open(connection_hdl hdl);
     void on_close(connection_hdl hdl);
     void on_message(connection_hdl hdl, server::message_ptr msg);
+    // 普通 HTTP 请求: GET /ready 就绪检查、GET /metrics，以及可选的管理接口
+    void on_http(connection_hdl hdl);
+    // GET /metrics: Prometheus 文本格式的会话数、会话内存与空闲回收统计 (websocketpp 与原生传输共用)
+    std::string metrics_text() const;
+    // GET /admin/sessions: 每个会话一行 (槽位、内存、空闲时长、是否休眠)
+    std::string sessions_text() const;
+
+    // 会话迁移
+    // 把会话移到另一个工作线程: 目标调度器先暂扣新任务，原线程处理完已入队的任务后放行
+    bool migrate_session(SessionRef ref, size_t shard);
+    // 排空: 停止就绪，把所有会话冻结成快照 (在各自的工作线程上、处理完已入队的音频之后) 并断开，
+    // 关闭原因中带上恢复令牌；返回排空的会话数
+    size_t drain();
+    // on_open 时按 ?resume= 令牌加载快照
+    bool resume_session(const std::string& token, Session& session);
+    // 工作线程上处理控制任务 (迁移屏障、冻结、休眠)
+    void handle_control(const AudioTask& task);
+    // 把控制任务排到会话所在的调度器 (或协程)，排在已入队的音频之后；连接已关闭或正在排空时返回 false
+    bool push_control(SessionRef ref, const Session& session, AudioTask&& task);
+
+    // 空闲回收 (配置了 idle_timeout_sec 或 hibernate_after_sec 时)，回收线程每秒扫描一次会话表
+    void start_reaper();
+    void reap_idle();
+    // 断开空闲会话的连接；传输不支持时返回 false
+    bool close_idle(const Session& session);
+
+    // 入站限速: 扣除音频时长对应的令牌，返回 false 表示丢弃该帧
+    bool admit(const server::connection_ptr& con, connection_hdl hdl, uint64_t audio_us);
 
     // 工作线程逻辑
-    void worker_loop();
+    void worker_loop(size_t shard);
+    // 在本线程上预热模型，并计入就绪门控；失败时记下异常交给 run() 重新抛出，返回 false
+    bool warm_up_worker(size_t shard);
+    // 在工作线程上处理一个任务 (队列模式与协程模式共用)
+    void process_task(const AudioTask& task, std::vector<std::string>& catchup_events);
+    // 把工作线程产生的响应发往会话所在的连接 (websocketpp 出站阶段或原生传输的事件循环)
+    void deliver(const Session& session, server::message_ptr out);
+    // 在入队时记录帧，保留连接收到的原始分块 (调度器切片、追赶合并之前)
+    void capture_task(const AudioTask& task);
+    // 在入队时更新会话的活跃时刻 (开启空闲回收时)，见 Session::touch
+    void touch_session(SessionRef ref);
+    // 原生传输: 每个 I/O 线程创建一个事件循环并监听
+    bool open_native_transport(uint16_t port);
+    // 开放共享内存接入 (配置了 shm_socket 时)，在独立线程上运行
+    void start_shm_ingress();
+
+    // 本地接入的会话管理 (对应 on_open / on_message / on_close)，在所属接入线程上调用
+    // 按 resource 的查询参数协商格式并建立会话，hdl 指向 route；失败时返回 WebSocket 关闭码，成功返回 0
+    uint16_t open_local_session(const std::shared_ptr<LocalRoute>& route, const std::string& resource,
+                                LocalStream& stream);
+    // 补全调度信息后交给会话所属工作线程
+    void push_local_task(const LocalStream& stream, AudioTask&& task);
+    void close_local_session(LocalStream& stream);
+
+    // 抓包中的会话标识: 代数 << 32 | 槽位
+    static uint64_t capture_key(SessionRef ref) {
+        return (static_cast<uint64_t>(ref.generation) << 32) | ref.slot;
+    }
 
 private:
+    ServerConfig config_;
     server srv_;
-    std::thread worker_thread_;
-    bool running_;
+    std::vector<std::thread> io_threads_;
+    std::vector<std::thread> worker_threads_;
+    std::atomic<bool> running_;
+    std::atomic<int> id_counter_{0};
+
+    // 就绪门控: 所有工作线程预热完成后才开始监听；排空或停止后 /ready 返回 503
+    std::mutex warmup_mutex_;
+    std::condition_variable warmup_cond_;
+    size_t warmed_workers_ = 0;
+    std::exception_ptr warmup_error_;
+    std::atomic<bool> ready_{false};
+
+    // 每个工作线程一个调度器 (会话内 FIFO，会话间按截止时间或公平轮转)
+    std::vector<std::unique_ptr<TaskScheduler>> task_queues_;
+
+    // 语音段转发 (未开启时为空)；会话析构时可能结束进行中的段，需晚于 sessions_ 析构
+    std::unique_ptr<SegmentForwarder> forwarder_;
+    // 语音段归档 (未开启时为空)；同样需晚于 sessions_ 析构
+    std::unique_ptr<SegmentArchive> archive_;
+
+    // 压缩音频解码器池与会话池 (需先于 sessions_ 构造、晚于其析构)
+    DecoderPool decoder_pool_;
+    SessionPool session_pool_;
+
+    // 会话管理: 按槽位下标 O(1) 查找，工作线程无锁
+    SessionSlab sessions_;
+
+    // 出站阶段 (池化消息 + 按连接合并投递)
+    Egress egress_;
+
+    // 可选的会话抓包 (未开启时为空)
+    std::unique_ptr<capture::Writer> capture_;
+
+    // 原生传输的事件循环 (websocketpp 传输时为空)
+    std::vector<std::unique_ptr<NativeLoop>> native_loops_;
+
+    // 共享内存接入 (未开启时为空)，在独立线程上运行
+    std::unique_ptr<ShmIngress> shm_ingress_;
+    std::thread shm_thread_;
 
-    // 线程安全队列
-    SafeQueue<AudioTask> task_queue_;
+    // 空闲回收线程 (未开启时不启动)
+    std::thread reaper_thread_;
+    std::mutex reaper_mutex_;
+    std::condition_variable reaper_cond_;
+    bool reaper_stop_ = false;
+    std::atomic<uint64_t> hibernated_sessions_{0};
+    std::atomic<uint64_t> idle_closed_sessions_{0};
 
-    // 会话管理
-    typedef std::map<connection_hdl, std::shared_ptr<Session>, std::owner_less<connection_hdl>> SessionMap;
-    SessionMap sessions_;
-    std::mutex session_mutex_;
+#ifdef VAD_WITH_COROUTINES
+    // 协程模式: 每个工作线程运行一个 io_context，会话协程按槽位分布其上 (队列模式下为空)
+    std::unique_ptr<PipelineExecutors> pipelines_;
+#endif
 };
@@ -2,30 +2,133 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <cstdint>
 #include "vad_engine.h"
 #include <websocketpp/common/connection_hdl.hpp>
 #include "sherpa_vad_detector.h"
+#include "audio_format.h"
+#include "resampler.h"
+#include "audio_decoder.h"
+#include "segment_forwarder.h"
+
+class SegmentArchive;
 
 class Session {
 public:
-    Session(std::string id, websocketpp::connection_hdl hdl);
+    // 空闲会话 (由 SessionPool 预热/复用)，需调用 open() 绑定连接
+    Session();
+    // decoder_pool: 压缩编码 (Opus/Speex) 连接从池中借用解码器，close() 时归还
+    Session(std::string id, websocketpp::connection_hdl hdl, const AudioFormat& format = AudioFormat(),
+            DecoderPool* decoder_pool = nullptr);
     ~Session();
 
-    // 处理原始字节流 (通常是 PCM 16bit Little Endian)
-    // 返回 JSON 格式的通知消息，如果无状态变化则返回空字符串
-    std::string process_audio(const std::vector<uint8_t>& raw_data);
+    // 绑定到一个新连接；不创建 VAD 引擎，引擎在收到第一帧音频时才挂载
+    void open(std::string id, websocketpp::connection_hdl hdl, const AudioFormat& format,
+              DecoderPool* decoder_pool);
+    // 解绑连接并重置全部状态 (引擎通过 IVadEngine::reset 复位而非销毁)，以便放回池中复用
+    void close();
+
+    // 挂载指定采样率的引擎；已有同采样率引擎时直接复用
+    void attach_engine(int sample_rate);
+    bool has_engine() const { return vad_engine_ != nullptr; }
+    int engine_sample_rate() const { return engine_sample_rate_; }
+
+    // 处理一条消息的音频负载: 按协商格式先解码 (如有)，再走 PCM 流水线
+    // data 可以直接指向 websocketpp 消息内存，处理期间调用方需保证其有效
+    // JSON 格式的通知消息写入 out (先清空，保留容量)；没有消息时返回 false
+    bool process_audio(const uint8_t* data, size_t len, std::string& out);
+    std::string process_audio(const std::vector<uint8_t>& raw_data) {
+        std::string out;
+        process_audio(raw_data.data(), raw_data.size(), out);
+        return out;
+    }
+
+    // 追赶模式: 一次处理积压的大段音频，只产生状态跳变 (VAD_BEGIN / VAD_END)，
+    // 不再为每一段回传 SPEAKING/SILENCE。事件依次写入 events[0..n) (复用已有元素的容量)，返回事件数 n
+    size_t catch_up(const uint8_t* data, size_t len, std::vector<std::string>& events);
+
+    // 会话迁移 (格式见 session_snapshot.h)
+    // freeze: 把会话全部状态写入 out；引擎不支持导出时返回 false
+    bool freeze(std::string& out) const;
+    // thaw: 在已 open() 的会话上恢复快照，传输格式必须与 open() 时一致；
+    // 失败时返回 false，会话回到刚 open() 的状态
+    bool thaw(const uint8_t* data, size_t len);
 
     std::string get_id() const { return id_; }
-    void set_id(const std::string& id) { id_ = id; }
-    void set_connect_session(const std::string& s) { connect_session_ = s; }
-    void set_current_session(const std::string& s) { current_session_ = s; }
+    // 元数据变化时作废对应的响应前缀/后缀缓存
+    void set_id(const std::string& id) {
+        if (id != id_) { id_ = id; suffix_dirty_ = true; }
+    }
+    void set_connect_session(const std::string& s) {
+        if (s != connect_session_) { connect_session_ = s; prefix_dirty_ = true; }
+    }
+    void set_current_session(const std::string& s) {
+        if (s != current_session_) { current_session_ = s; prefix_dirty_ = true; }
+    }
     websocketpp::connection_hdl get_hdl() const { return hdl_; }
+    // hdl 指向 LocalRoute (原生传输 / 共享内存接入) 而不是 websocketpp 连接；close() 时清除
+    void set_local_route(bool local) { local_route_ = local; }
+    bool has_local_route() const { return local_route_; }
+    const AudioFormat& get_format() const { return format_; }
+    // 语音段转发: 设置后 VAD_BEGIN 起的音频交给 sink，响应的 vad_audio 留空、不再缓存整段音频 (归档除外)；close() 时清除
+    void set_speech_sink(SpeechSink* sink) { speech_sink_ = sink; }
+    // 语音段归档: 设置后 VAD_END 时把整段 PCM 移交给 archive (与转发可同时开启)；close() 时清除
+    void set_segment_archive(SegmentArchive* archive) { segment_archive_ = archive; }
+
+    // 空闲回收与内存统计: 以下只读接口与 request_* 可在任意线程调用，其余成员只在工作线程上访问
+    // 最近一次收到音频 (或 open) 的时刻，steady_clock 毫秒
+    int64_t last_active_ms() const { return last_active_ms_.load(std::memory_order_relaxed); }
+    // 最近一次处理后统计的内存占用 (按容量计，见 measure_memory)
+    size_t memory_bytes() const { return memory_bytes_.load(std::memory_order_relaxed); }
+    bool hibernated() const { return hibernated_.load(std::memory_order_relaxed); }
+    // 每个空闲期只有第一次调用返回 true (下一帧音频到来后重新计)，避免重复投递控制任务
+    bool request_hibernate() { return !hibernate_requested_.exchange(true, std::memory_order_relaxed); }
+    bool request_close() { return !close_requested_.exchange(true, std::memory_order_relaxed); }
+    // 收到一帧 (接入线程入队时): 空闲按帧到达计，不等工作线程处理；同时作废已发出的休眠/断开请求，
+    // 每个空闲期各自判断
+    void touch() {
+        last_active_ms_.store(steady_ms(), std::memory_order_relaxed);
+        hibernate_requested_.store(false, std::memory_order_relaxed);
+        close_requested_.store(false, std::memory_order_relaxed);
+    }
+    // 休眠 (工作线程): 引擎状态存入 parked_engine_ 后销毁引擎，释放各缓冲区的容量；
+    // 下一帧音频到来时重新挂载引擎并恢复状态，判决结果不受影响。
+    // 已在休眠中、或请求之后又收到了音频 (请求已作废) 时返回 false
+    bool hibernate();
+    static int64_t steady_ms();
 
 private:
+    // PCM 16bit Little Endian，按 pcm_format_ 的采样率/声道交织
+    // transitions_only: 只为 VAD_BEGIN / VAD_END 生成响应 (追赶模式)
+    bool process_pcm(const uint8_t* data, size_t len, std::string& out, bool transitions_only = false);
+    // 按协商格式解码；PCM 直接返回原始数据
+    bool decode(const uint8_t*& data, size_t& len);
+
     std::string get_current_timestamp_us();
-    std::string build_vad_response(const std::string& vad_state, const std::string& audio_b64, const std::string& new_session);
-    std::string build_begin_response(const std::string& audio_b64);
-    std::string build_end_response(const std::string& audio_b64);
+    // 响应直接写入 out: 缓存的前缀 + base64 音频 + 状态 + 缓存的后缀
+    void refresh_response_cache();
+    void build_vad_response(std::string& out, const char* vad_state, const uint8_t* audio, size_t audio_len,
+                            bool with_new_session);
+    void build_begin_response(std::string& out, const uint8_t* audio, size_t audio_len);
+    void build_end_response(std::string& out, const uint8_t* audio, size_t audio_len);
+    void build_speaking_response(std::string& out, const uint8_t* audio, size_t audio_len);
+    void build_silence_response(std::string& out);
+    // 转发时语音段的元数据
+    SpeechSegmentInfo segment_info() const;
+    // 是否需要在 audio_buffer_ 中缓存整段音频 (vad_audio 或归档要用)
+    bool buffers_segment() const { return !speech_sink_ || segment_archive_; }
+
+    // 收到音频: 更新活跃时刻，允许再次休眠
+    void mark_active();
+    // 处理完一条消息: 语音段刚结束时收回超额容量，并发布内存统计
+    void finish_processing();
+    // 各缓冲区的容量超过 kRetainedBufferBytes 时收回 (长语音段、超大包之后)
+    void trim_buffers();
+    // 会话持有的内存: 对象本身、各缓冲区容量、引擎、重采样器与休眠中的引擎状态 (解码器库的内部状态不计)
+    size_t measure_memory() const;
+
+    static const size_t kRetainedBufferBytes = 512 * 1024;
 
 private:
     std::string id_;
@@ -33,8 +136,27 @@ private:
     std::string current_session_;
     std::string new_session_; // Generated at START_SPEAKING
 
+    // 预先转义好的响应片段，元数据变化时才重建
+    std::string response_prefix_; // {"connect_session":..,"current_session":..,"data":{"vad_audio":"
+    std::string response_suffix_; // "uid":..}
+    bool prefix_dirty_ = true;
+    bool suffix_dirty_ = true;
+
     websocketpp::connection_hdl hdl_;
+    bool local_route_ = false;
+    AudioFormat format_;      // 协商的传输格式
+    AudioFormat pcm_format_;  // 解码后的 PCM 格式
     std::unique_ptr<IVadEngine> vad_engine_;
+    int engine_sample_rate_ = 0;
+
+    DecoderPool* decoder_pool_ = nullptr;
+    std::unique_ptr<IAudioDecoder> decoder_;
+    std::vector<uint8_t> decoded_audio_;
+
+    // 输入采样率与引擎不一致时才创建
+    std::unique_ptr<PolyphaseResampler> resampler_;
+    // 重采样前的转码缓冲区 (复用，避免每帧分配)；无需重采样时直接转码进引擎缓冲区
+    std::vector<float> float_audio_;
     
     // 上一次的状态，用于检测状态跳变
     VadState last_state_;
@@ -42,4 +164,20 @@ private:
     // In-memory buffer for VAD segments
     std::vector<uint8_t> audio_buffer_;
 
+    // 语音段转发 (未开启时为空)；segment_id_ 为进行中的段，0 表示没有
+    SpeechSink* speech_sink_ = nullptr;
+    uint64_t segment_id_ = 0;
+    // 语音段归档 (未开启时为空)
+    SegmentArchive* segment_archive_ = nullptr;
+
+    // 休眠时暂存的引擎状态 (未休眠或引擎不支持导出时为空)
+    std::unique_ptr<VadEngineState> parked_engine_;
+    // 本条消息中有语音段结束，处理完后收回容量
+    bool trim_pending_ = false;
+    std::atomic<int64_t> last_active_ms_{0};
+    std::atomic<size_t> memory_bytes_{0};
+    std::atomic<bool> hibernated_{false};
+    std::atomic<bool> hibernate_requested_{false};
+    std::atomic<bool> close_requested_{false};
+
 };
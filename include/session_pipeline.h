@@ -0,0 +1,72 @@
+#pragma once
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "task_scheduler.h"
+
+// 协程流水线 (cmake -DVAD_COROUTINES=ON 时编译)
+//
+// 队列模式下一帧要经过: on_message -> 全局调度器 (加锁入队) -> 工作线程 pop -> 按槽位查找会话。
+// 协程模式下每个会话是一个常驻在工作线程 io_context 上的 C++20 协程:
+//   等待帧 -> 解码/重采样/推理 -> 交给出站阶段 -> 继续等待
+// on_message 直接把帧放进该会话的收件箱并唤醒协程，没有共享队列与会话查找；
+// 同一个工作线程上的多个会话协程在各自挂起时交替运行，I/O 线程上的解析与出站也与推理并行。
+//
+// 收件箱与执行器 (session_pipeline.cpp) 按 C++17 编译；协程体在 pipeline_coroutine.cpp 中，只有它按 C++20 编译。
+
+// 每个工作线程一个 io_context (单线程运行，无需 strand)
+class PipelineExecutors {
+public:
+    explicit PipelineExecutors(size_t count);
+
+    size_t size() const { return contexts_.size(); }
+    boost::asio::io_context& context(size_t index) { return *contexts_[index]; }
+
+    // 在调用线程上运行第 index 个 io_context，直到 stop()
+    void run(size_t index);
+    void stop();
+
+private:
+    typedef boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard;
+    std::vector<std::unique_ptr<boost::asio::io_context>> contexts_;
+    std::vector<work_guard> guards_;
+};
+
+class SessionPipeline : public std::enable_shared_from_this<SessionPipeline> {
+public:
+    // 在协程所在的工作线程上处理一个任务 (音频或控制任务)
+    typedef std::function<void(AudioTask&)> Processor;
+
+    // catchup_us: 收件箱积压超过该音频时长时，取出的 PCM 任务标记为追赶模式 (0 关闭)
+    SessionPipeline(boost::asio::io_context& context, uint64_t catchup_us);
+
+    // 在 context 上启动协程；协程持有本对象的引用，close() 后退出
+    void start(Processor processor);
+
+    // 线程安全；流水线已关闭时返回 false
+    bool push(AudioTask&& task);
+    // 丢弃未处理的任务并结束协程
+    void close();
+
+private:
+    // 协程侧: 取出下一个任务；收件箱为空时返回 false 并登记等待
+    bool pop_or_wait(AudioTask& task, bool& closed);
+
+    boost::asio::io_context& context_;
+    // 唤醒信号: 协程在一个永不到期的定时器上等待，push 在 context 上取消它
+    boost::asio::steady_timer signal_;
+    uint64_t catchup_us_;
+
+    std::mutex mutex_;
+    std::deque<AudioTask> inbox_;
+    uint64_t pending_us_ = 0;
+    bool waiting_ = false;
+    bool closed_ = false;
+};
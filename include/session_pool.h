@@ -0,0 +1,33 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include "session.h"
+
+// Session 对象池
+// 连接建立时从池中取出一个已分配好缓冲区 (预热的还带有已加载模型的引擎) 的 Session，
+// 连接关闭且最后一个引用释放后自动 close() 并放回池中，避免连接抖动带来的分配与模型初始化尖峰。
+class SessionPool {
+public:
+    // warm_size: 启动时预先创建并挂载 16k 引擎的会话数
+    // max_idle:  池中最多保留的空闲会话数，超出部分直接销毁
+    SessionPool(size_t warm_size, size_t max_idle);
+    ~SessionPool();
+
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    // 取出并绑定到新连接；返回的 shared_ptr 在最后一个引用释放时把对象归还给池
+    std::shared_ptr<Session> acquire(std::string id, websocketpp::connection_hdl hdl,
+                                     const AudioFormat& format, DecoderPool* decoder_pool);
+
+    size_t idle_size();
+
+private:
+    void recycle(Session* session);
+
+    size_t max_idle_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Session>> idle_;
+};
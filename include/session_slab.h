@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+class Session;
+
+// 会话句柄: 槽位下标 + 代数 (generation)
+// 槽位被释放后代数递增，旧句柄随之失效，因此任务队列里残留的旧任务不会落到复用该槽位的新连接上
+struct SessionRef {
+    uint32_t slot = 0;
+    uint32_t generation = 0; // 0 表示无效句柄
+};
+
+// 定长会话槽表 (slab)
+// - 查找: 工作线程凭 SessionRef 直接下标访问并校验代数，O(1)，不加任何全局锁
+// - 分配/释放: 仅在连接建立/关闭时发生 (I/O 线程)，由空闲链表的小锁保护，工作线程从不触碰
+class SessionSlab {
+public:
+    explicit SessionSlab(size_t capacity) : slots_(capacity) {
+        free_list_.reserve(capacity);
+        for (size_t i = capacity; i-- > 0;) {
+            free_list_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // 放入会话，槽位已满时返回无效句柄
+    SessionRef insert(std::shared_ptr<Session> session) {
+        uint32_t index;
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            if (free_list_.empty()) return SessionRef();
+            index = free_list_.back();
+            free_list_.pop_back();
+        }
+        Slot& slot = slots_[index];
+        std::atomic_store(&slot.session, std::move(session));
+        SessionRef ref;
+        ref.slot = index;
+        ref.generation = slot.generation.load(std::memory_order_acquire);
+        return ref;
+    }
+
+    // 查找会话；句柄过期 (连接已关闭、槽位已复用) 时返回 nullptr
+    std::shared_ptr<Session> get(SessionRef ref) const {
+        if (ref.generation == 0 || ref.slot >= slots_.size()) return nullptr;
+        const Slot& slot = slots_[ref.slot];
+        std::shared_ptr<Session> session = std::atomic_load(&slot.session);
+        if (slot.generation.load(std::memory_order_acquire) != ref.generation) return nullptr;
+        return session;
+    }
+
+    // 释放槽位: 先递增代数使旧句柄失效，再放下引用
+    // 会话对象在最后一个持有者 (可能是正在处理的工作线程) 释放后才回到 SessionPool
+    void erase(SessionRef ref) {
+        if (ref.generation == 0 || ref.slot >= slots_.size()) return;
+        Slot& slot = slots_[ref.slot];
+        uint32_t expected = ref.generation;
+        uint32_t next = expected + 1 == 0 ? 1 : expected + 1;
+        if (!slot.generation.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) return;
+        std::atomic_store(&slot.session, std::shared_ptr<Session>());
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_list_.push_back(ref.slot);
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+    // 槽位上当前会话的句柄；空槽返回无效句柄
+    SessionRef ref_at(uint32_t index) const {
+        SessionRef ref;
+        if (index >= slots_.size() || !std::atomic_load(&slots_[index].session)) return ref;
+        ref.slot = index;
+        ref.generation = slots_[index].generation.load(std::memory_order_acquire);
+        return ref;
+    }
+
+    // 遍历所有在用的槽位 (排空、迁移等管理操作，不在热路径上)
+    template <class F>
+    void for_each(F fn) const {
+        for (uint32_t i = 0; i < slots_.size(); ++i) {
+            SessionRef ref = ref_at(i);
+            std::shared_ptr<Session> session = get(ref);
+            if (session) fn(ref, session);
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> generation{1};
+        std::shared_ptr<Session> session;
+    };
+
+    std::vector<Slot> slots_;
+    std::mutex free_mutex_;
+    std::vector<uint32_t> free_list_;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 会话状态快照 (二进制、带版本号，主机字节序 = 小端)
+//
+//   "VSNP" + u16 版本 + u16 保留
+//   AudioFormat, 元数据 (uid / connect_session / current_session / new_session), 上一次的 VAD 状态,
+//   当前语音段已缓存的音频, 重采样器状态 (可选), 引擎状态 (可选)
+//
+// 快照只在同一版本的服务之间迁移 (同进程换工作线程、滚动重启时交给新进程)，版本不符直接拒绝。
+// 压缩编码的解码器状态不在快照中，恢复后从新解码器开始 (最多影响一个包)。
+namespace snapshot {
+
+const char kMagic[4] = {'V', 'S', 'N', 'P'};
+const uint16_t kVersion = 1;
+
+class Writer {
+public:
+    explicit Writer(std::string& out) : out_(out) {}
+
+    template <class T>
+    void put(T v) {
+        out_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    void put_bytes(const void* data, size_t len) {
+        put<uint32_t>(static_cast<uint32_t>(len));
+        out_.append(static_cast<const char*>(data), len);
+    }
+    void put_string(const std::string& s) { put_bytes(s.data(), s.size()); }
+    void put_floats(const float* data, size_t n) {
+        put<uint32_t>(static_cast<uint32_t>(n));
+        out_.append(reinterpret_cast<const char*>(data), n * sizeof(float));
+    }
+
+private:
+    std::string& out_;
+};
+
+// 越界或格式错误后 ok() 变为 false，之后的读取全部失败
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t len) : p_(data), end_(data + len) {}
+
+    bool ok() const { return ok_; }
+    bool at_end() const { return p_ == end_; }
+
+    template <class T>
+    bool get(T& v) {
+        if (!take(sizeof(v))) return false;
+        std::memcpy(&v, p_ - sizeof(v), sizeof(v));
+        return true;
+    }
+    bool get_string(std::string& s) {
+        uint32_t len = 0;
+        if (!get(len) || !take(len)) return false;
+        s.assign(reinterpret_cast<const char*>(p_ - len), len);
+        return true;
+    }
+    bool get_bytes(std::vector<uint8_t>& out) {
+        uint32_t len = 0;
+        if (!get(len) || !take(len)) return false;
+        out.assign(p_ - len, p_);
+        return true;
+    }
+    bool get_floats(std::vector<float>& out) {
+        uint32_t n = 0;
+        if (!get(n) || !take(static_cast<size_t>(n) * sizeof(float))) return false;
+        out.resize(n);
+        std::memcpy(out.data(), p_ - static_cast<size_t>(n) * sizeof(float), static_cast<size_t>(n) * sizeof(float));
+        return true;
+    }
+
+private:
+    bool take(size_t n) {
+        if (!ok_ || static_cast<size_t>(end_ - p_) < n) {
+            ok_ = false;
+            return false;
+        }
+        p_ += n;
+        return true;
+    }
+
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+};
+
+// 写/校验快照头
+void write_header(Writer& w);
+bool read_header(Reader& r);
+
+} // namespace snapshot
+
+// Silero 系引擎的可迁移状态
+// SileroVadEngine (VadIterator) 与 StaticVadEngine 使用同一布局，两者之间可以互相恢复
+struct VadEngineState {
+    int32_t sample_rate = 0;
+    std::vector<float> context;  // 上一个窗口的尾部 (16k: 64, 8k: 32)
+    std::vector<float> rnn_state; // 2x1x128
+    float last_prob = 0.0f;
+    // 迟滞判决
+    bool triggered = false;
+    uint32_t temp_end = 0;
+    uint32_t current_sample = 0;
+    int32_t prev_end = 0;
+    int32_t next_start = 0;
+    int32_t speech_start = -1; // 当前语音段
+    int32_t speech_end = -1;
+    int32_t last_start = -1;   // 最近一个完成的语音段 (用于 VadResult::timestamp)
+    int32_t last_end = -1;
+    // 不足一个窗口、尚未处理的样本
+    std::vector<float> pending;
+
+    void write(snapshot::Writer& w) const;
+    bool read(snapshot::Reader& r);
+};
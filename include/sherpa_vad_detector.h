@@ -22,7 +22,8 @@ public:
     ~SherpaVadDetector() override = default;
 
     // IVadEngine 接口实现
-    VadResult process_frame(const std::vector<float>& audio_frame) override;
+    std::vector<float>& input_buffer() override { return margin_buffer_; }
+    VadResult process_buffered() override;
     void reset() override;
 
 private:
@@ -30,7 +31,8 @@ private:
     // source_frame: 原始音频数据 (在此实现中我们假设 audio_frame 已经是 float 格式的 PCM)
     // 返回是否触发了关键事件 (Begin/End/Silent)
     // 为了适配 IVadEngine 的单次返回接口，我们需要将内部产生的事件转换为 VadResult
-    VadResult process_internal(const std::vector<float>& frame);
+    // frame 指向 frame_size_samples_ 个连续样本
+    VadResult process_internal(const float* frame);
 
     // 状态设置
     void set_state(GoState state);
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "local_route.h"
+
+class AudioServer;
+
+struct ShmIngressOptions {
+    // Unix 套接字 (SOCK_SEQPACKET) 路径，生产者在此打开流
+    std::string socket_path;
+    // 每个流的音频环 / 事件环容量 (向上取 2 的幂)；256 KiB 约为 16kHz 单声道 8 秒。
+    // VAD_END 带整段语音的 base64 (16kHz 单声道约 43 KB/s)，1 MiB 的事件环容得下约 24 秒的语音段，
+    // 更长的段放不下时丢弃并计入 dropped_events
+    size_t pcm_ring_bytes = 256 * 1024;
+    size_t event_ring_bytes = 1024 * 1024;
+};
+
+// 共享内存接入 (--shm-ingress PATH)
+//
+// 同机的媒体网关不再经回环 WebSocket 发送 PCM (分帧、掩码、两次套接字拷贝)，而是:
+//   1. 连接 Unix 套接字，发送查询串 (与 WebSocket 的 resource 相同，如 "/?sample_rate=8000")；
+//   2. 收到应答与三个 fd: 流的共享内存段、音频环 eventfd、事件环 eventfd (格式见 shm_ring.h)；
+//   3. 把 PCM 帧写进音频环，从事件环读回 VAD 事件 JSON；关闭套接字即结束会话。
+// 服务端一个线程用 epoll 等待所有流，读出的记录直接作为 AudioTask 的负载 (租约引用环内存，
+// 工作线程处理完才归还空间)，与其他接入方式走同一条会话流水线；响应由工作线程写入事件环。
+class ShmIngress {
+public:
+    ShmIngress(AudioServer& owner, const ShmIngressOptions& options);
+    ~ShmIngress();
+
+    // 创建并监听 Unix 套接字 (已存在的同名套接字文件会被替换)
+    bool open();
+    // 在调用线程上运行，直到 stop()
+    void run();
+    void stop();
+
+    // 统计: 打开过的流数、读出的记录数、事件环满时丢弃的事件数
+    uint64_t stream_count() const { return streams_opened_.load(std::memory_order_relaxed); }
+    uint64_t record_count() const { return records_.load(std::memory_order_relaxed); }
+    uint64_t dropped_events() const { return dropped_events_.load(std::memory_order_relaxed); }
+
+private:
+    class Stream;
+
+    void accept_all();
+    // 读取生产者的打开请求并建立流
+    void open_stream(int fd);
+    // 读出音频环中的全部记录，交给会话流水线
+    void drain(const std::shared_ptr<Stream>& stream);
+    void close_stream(int fd);
+
+    AudioServer& owner_;
+    ShmIngressOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    std::atomic<bool> running_{true};
+
+    // 按套接字 fd 与音频环 eventfd 两个键索引同一个流 (只在接入线程上访问)
+    std::unordered_map<int, std::shared_ptr<Stream>> streams_;
+
+    std::atomic<uint64_t> streams_opened_{0};
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> dropped_events_{0};
+};
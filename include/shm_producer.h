@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "shm_ring.h"
+
+// 共享内存接入的生产者一侧 (同机的媒体网关链接本文件，见 shm_ingress.h)
+//
+// 用法:
+//   ShmProducer producer;
+//   producer.open("/run/vad.sock", "/?sample_rate=8000");
+//   uint8_t* dst = producer.reserve(320);  // 直接在环内填 PCM，环满时为 nullptr
+//   ...; producer.commit();
+//   // event_fd() 可读 (或定时轮询) 时:
+//   std::string event;
+//   do { while (producer.read_event(event)) handle(event); } while (!producer.prepare_wait());
+// 一个 ShmProducer 只能由一个线程写入、一个线程读事件 (可以是同一个线程)。
+class ShmProducer {
+public:
+    ShmProducer() = default;
+    ~ShmProducer();
+    ShmProducer(const ShmProducer&) = delete;
+    ShmProducer& operator=(const ShmProducer&) = delete;
+
+    // 连接服务端并打开一个流；resource 为查询串，参数与 WebSocket 连接相同
+    // 失败时返回 false，status() 为服务端给出的关闭码 (连接失败或应答无效时为 0)
+    bool open(const std::string& socket_path, const std::string& resource);
+    // 结束会话 (关闭套接字并解除映射)
+    void close();
+    bool is_open() const { return base_ != nullptr; }
+    uint16_t status() const { return status_; }
+
+    // 在音频环中预留 size 字节 (一帧)，填好后 commit()；环满 (服务端跟不上) 时返回 nullptr
+    uint8_t* reserve(size_t size);
+    void commit();
+    // 拷贝一帧并发布；环满时返回 false
+    bool write(const void* data, size_t size);
+
+    // 事件环的 eventfd 与控制套接字 (可加入调用方的 epoll；套接字挂断表示服务端关闭了会话)
+    int event_fd() const { return event_fd_; }
+    int socket_fd() const { return sock_fd_; }
+    // 取下一条 VAD 事件 JSON；没有时返回 false
+    bool read_event(std::string& out);
+    // 睡眠前调用: 返回 false 表示又有事件到达，应继续 read_event
+    bool prepare_wait();
+
+private:
+    int sock_fd_ = -1;
+    int pcm_fd_ = -1;
+    int event_fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    uint16_t status_ = 0;
+    shm::RingWriter pcm_;
+    shm::RingReader events_;
+};
@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+// 共享内存接入的段布局与单生产者单消费者 (SPSC) 记录环
+//
+// 每个流一个共享内存段 (memfd)，由服务端创建后经 Unix 套接字 (SCM_RIGHTS) 交给生产者:
+//   SegmentHeader | 音频环数据区 (pcm_capacity) | 事件环数据区 (event_capacity)
+// 音频环: 生产者 (网关) 写 PCM，服务端读；事件环: 服务端工作线程写 VAD 事件 JSON，生产者读。
+// 两个进程只通过段内的原子变量同步，音频不经过内核拷贝。
+//
+// 记录: 8 字节头 {size, flags} + 负载，按 8 字节对齐，不跨越环尾 (放不下时先写一条填充记录再回到开头)，
+// 因此消费者总能拿到一段连续内存直接交给处理流程。单条记录最多占半个环；更长的消息 (事件环里带整段音频的
+// VAD_END) 拆成若干条带 kRecordMore 的记录，一次发布，读者按顺序拼接。
+// 唤醒: 消费者准备睡眠前置 waiting 并重新检查；生产者发布后看到 waiting 才写 eventfd，
+// 消费者忙碌时不产生任何系统调用。
+namespace shm {
+
+const uint32_t kMagic = 0x53444156; // "VADS"
+const uint32_t kVersion = 1;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory rings need lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory rings need lock-free 32-bit atomics");
+
+// 环的控制块: 生产者与消费者各自修改的字段放在不同缓存行
+struct RingControl {
+    alignas(64) std::atomic<uint64_t> head; // 已发布的写入位置 (单调递增的字节数)
+    alignas(64) std::atomic<uint64_t> tail; // 消费者已归还的位置
+    alignas(64) std::atomic<uint32_t> waiting; // 消费者已睡眠或准备睡眠，需要 eventfd 唤醒
+};
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t pcm_capacity;   // 2 的幂
+    uint64_t event_capacity; // 2 的幂
+    uint64_t segment_size;
+    RingControl pcm;
+    RingControl events;
+};
+
+// 数据区按页对齐
+inline size_t header_size() {
+    return (sizeof(SegmentHeader) + 4095) & ~static_cast<size_t>(4095);
+}
+inline size_t segment_size(size_t pcm_capacity, size_t event_capacity) {
+    return header_size() + pcm_capacity + event_capacity;
+}
+
+const uint32_t kRecordPad = 1;  // 填充记录: 跳到环的开头
+const uint32_t kRecordMore = 2; // 消息未完，下一条记录是它的后续
+const size_t kRecordHeader = 8;
+
+inline size_t record_span(size_t size) {
+    return kRecordHeader + ((size + 7) & ~static_cast<size_t>(7));
+}
+
+// 生产者一侧
+class RingWriter {
+public:
+    RingWriter() = default;
+    RingWriter(RingControl* control, uint8_t* data, uint64_t capacity)
+        : control_(control), data_(data), capacity_(capacity) {
+        head_ = control_->head.load(std::memory_order_relaxed);
+        cached_tail_ = control_->tail.load(std::memory_order_acquire);
+    }
+
+    // 预留一条 size 字节的记录，返回负载地址；空间不足时返回 nullptr (调用方丢弃或稍后重试)
+    uint8_t* reserve(size_t size) {
+        pending_ = head_;
+        return append(size, 0);
+    }
+
+    // 发布 reserve() 的记录；返回 true 表示消费者在等待，调用方应写它的 eventfd
+    bool commit() {
+        head_ = pending_;
+        control_->head.store(head_, std::memory_order_seq_cst);
+        return control_->waiting.load(std::memory_order_seq_cst) != 0 &&
+               control_->waiting.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+    // 便捷接口: 拷贝一条记录并发布
+    bool write(const void* payload, size_t size, bool& notify) {
+        uint8_t* dst = reserve(size);
+        if (!dst) return false;
+        std::memcpy(dst, payload, size);
+        notify = commit();
+        return true;
+    }
+
+    // 拷贝一条任意长度的消息: 超过单条记录上限时拆成多条 (除最后一条外带 kRecordMore)，全部写入后一次发布；
+    // 剩余空间放不下整条消息时什么也不写，返回 false
+    bool write_message(const void* payload, size_t size, bool& notify) {
+        const uint8_t* src = static_cast<const uint8_t*>(payload);
+        size_t max_chunk = capacity_ / 2 - kRecordHeader;
+        pending_ = head_;
+        do {
+            size_t chunk = size < max_chunk ? size : max_chunk;
+            uint8_t* dst = append(chunk, size > chunk ? kRecordMore : 0);
+            if (!dst) return false;
+            std::memcpy(dst, src, chunk);
+            src += chunk;
+            size -= chunk;
+        } while (size > 0);
+        notify = commit();
+        return true;
+    }
+
+private:
+    // 在 pending_ 处追加一条未发布的记录
+    uint8_t* append(size_t size, uint32_t flags) {
+        size_t span = record_span(size);
+        if (span > capacity_ / 2) return nullptr;
+        uint64_t offset = pending_ & (capacity_ - 1);
+        uint64_t to_end = capacity_ - offset;
+        uint64_t need = span <= to_end ? span : to_end + span;
+        if (pending_ + need - cached_tail_ > capacity_) {
+            cached_tail_ = control_->tail.load(std::memory_order_acquire);
+            if (pending_ + need - cached_tail_ > capacity_) return nullptr;
+        }
+        if (span > to_end) {
+            write_header(offset, static_cast<uint32_t>(to_end - kRecordHeader), kRecordPad);
+            pending_ += to_end;
+            offset = 0;
+        }
+        write_header(offset, static_cast<uint32_t>(size), flags);
+        pending_ += span;
+        return data_ + offset + kRecordHeader;
+    }
+
+    void write_header(uint64_t offset, uint32_t size, uint32_t flags) {
+        std::memcpy(data_ + offset, &size, 4);
+        std::memcpy(data_ + offset + 4, &flags, 4);
+    }
+
+    RingControl* control_ = nullptr;
+    uint8_t* data_ = nullptr;
+    uint64_t capacity_ = 0;
+    uint64_t head_ = 0;
+    uint64_t pending_ = 0;
+    uint64_t cached_tail_ = 0;
+};
+
+// 消费者一侧: 读取位置 (cursor) 与归还位置 (tail) 分开，记录可以在处理完之后再归还
+class RingReader {
+public:
+    RingReader() = default;
+    RingReader(RingControl* control, uint8_t* data, uint64_t capacity)
+        : control_(control), data_(data), capacity_(capacity) {
+        cursor_ = control_->tail.load(std::memory_order_relaxed);
+    }
+
+    // 取下一条记录；end 为该记录之后的位置 (传给 release)
+    bool next(const uint8_t*& payload, uint32_t& size, uint64_t& end) {
+        for (;;) {
+            uint64_t head = control_->head.load(std::memory_order_acquire);
+            if (cursor_ == head) return false;
+            uint64_t offset = cursor_ & (capacity_ - 1);
+            uint32_t flags;
+            std::memcpy(&size, data_ + offset, 4);
+            std::memcpy(&flags, data_ + offset + 4, 4);
+            if (flags & kRecordPad) {
+                cursor_ += kRecordHeader + size;
+                continue;
+            }
+            more_ = (flags & kRecordMore) != 0;
+            // 生产者可能写坏控制字段: 越界的记录视为协议错误
+            if (record_span(size) > capacity_ - offset || cursor_ + record_span(size) > head) {
+                corrupted_ = true;
+                cursor_ = head;
+                return false;
+            }
+            payload = data_ + offset + kRecordHeader;
+            cursor_ += record_span(size);
+            end = cursor_;
+            return true;
+        }
+    }
+
+    // 归还到 end 为止的空间 (可在任意线程调用；只前进不后退)。
+    // 记录乱序处理完时不能直接调用，先经 ReleaseOrder 换算成已连续处理完的位置
+    void release(uint64_t end) {
+        uint64_t current = control_->tail.load(std::memory_order_relaxed);
+        while (current < end &&
+               !control_->tail.compare_exchange_weak(current, end, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {
+        }
+    }
+
+    // 立即归还已读取的全部记录 (记录已拷出时使用)
+    void release_all() { release(cursor_); }
+
+    // 准备睡眠: 置 waiting 后重新检查；返回 false 表示又有数据 (不应睡眠)
+    bool prepare_wait() {
+        control_->waiting.store(1, std::memory_order_seq_cst);
+        if (control_->head.load(std::memory_order_seq_cst) != cursor_) {
+            control_->waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    bool corrupted() const { return corrupted_; }
+    // 上一条 next() 取出的记录之后还有同一消息的后续记录
+    bool more() const { return more_; }
+
+private:
+    RingControl* control_ = nullptr;
+    uint8_t* data_ = nullptr;
+    uint64_t capacity_ = 0;
+    uint64_t cursor_ = 0;
+    bool corrupted_ = false;
+    bool more_ = false;
+};
+
+// 消费者一侧的按序归还: 记录的租约可能以任意顺序释放 (不同线程、合并或切片后的任务)，
+// 只有此前的记录全部处理完，tail 才能越过一条记录，否则生产者会覆盖仍在使用的负载
+class ReleaseOrder {
+public:
+    // 读取线程: 按 next() 的顺序登记每条记录 (包括不交给处理流程、立即完成的空记录)
+    void track(uint64_t end) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        records_.push_back(Record{end, false});
+    }
+
+    // 任意线程: end 处的记录已处理完；返回现在可以 release 到的位置，还不能归还时返回 0
+    uint64_t complete(uint64_t end) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::lower_bound(records_.begin(), records_.end(), end,
+                                   [](const Record& r, uint64_t e) { return r.end < e; });
+        if (it == records_.end() || it->end != end) return 0;
+        it->done = true;
+        uint64_t released = 0;
+        while (!records_.empty() && records_.front().done) {
+            released = records_.front().end;
+            records_.pop_front();
+        }
+        return released;
+    }
+
+private:
+    struct Record {
+        uint64_t end;
+        bool done;
+    };
+    std::mutex mutex_;
+    std::deque<Record> records_; // 已登记、尚未归还的记录，end 递增
+};
+
+// 建立连接时服务端的应答 (随 SCM_RIGHTS 传递 memfd、音频环 eventfd、事件环 eventfd)
+struct OpenReply {
+    uint32_t magic;
+    uint16_t status; // 0 成功，否则为 WebSocket 关闭码 (1008 格式不支持，1013 服务繁忙)
+    uint16_t reserved;
+    uint64_t segment_size;
+};
+
+} // namespace shm
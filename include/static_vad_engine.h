@@ -0,0 +1,293 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "onnxruntime_cxx_api.h"
+#include "vad_engine.h"
+#include "vad_iterator.h"
+#include "vad_model.h"
+
+// 编译期特化的 Silero 引擎
+//
+// VadIterator 在运行时计算窗口大小，并把上下文、状态、输入放在 std::vector 中；
+// 这里把采样率与窗口时长作为模板参数，窗口几何全部是 constexpr，
+// 状态/输入都是定长 std::array，张量在构造时一次性绑定到这些数组上，
+// 每个窗口只剩: 拷贝窗口 -> Run -> 拷贝状态 -> 迟滞判决，没有虚调用，也没有尺寸簿记。
+// 对外仍实现 IVadEngine，Session 只在每条消息上做一次虚调用。
+// 所有实例共用 VadModel 的 Ort::Session，挂载引擎不再触发模型解析与图优化。
+
+// 窗口几何 (Silero v5: 16k 使用 64 个上下文样本，8k 使用 32 个)
+template <int SampleRate, int WindowMs>
+struct VadGeometry {
+    static_assert(SampleRate == 8000 || SampleRate == 16000, "Silero VAD only supports 8k and 16k");
+    static_assert(WindowMs > 0, "window must be positive");
+
+    static constexpr int sample_rate = SampleRate;
+    static constexpr int sr_per_ms = SampleRate / 1000;
+    static constexpr size_t window_samples = static_cast<size_t>(WindowMs) * sr_per_ms;
+    static constexpr size_t context_samples = SampleRate == 16000 ? 64 : 32;
+    static constexpr size_t effective_window = window_samples + context_samples;
+    static constexpr size_t state_size = 2 * 1 * 128;
+};
+
+// 与 VadIterator 相同的迟滞判决 (默认参数: 最短静音 100ms、最短语音 250ms、不限最长语音)
+template <class Geometry>
+class SileroHysteresis {
+public:
+    explicit SileroHysteresis(float threshold) : threshold_(threshold) {}
+
+    // 输入一个窗口的语音概率，更新触发状态
+    void update(float prob) {
+        current_sample_ += static_cast<unsigned int>(Geometry::window_samples);
+        if (prob >= threshold_) {
+            if (temp_end_ != 0) {
+                temp_end_ = 0;
+                if (next_start_ < prev_end_) next_start_ = static_cast<int>(current_sample_ - Geometry::window_samples);
+            }
+            if (!triggered_) {
+                triggered_ = true;
+                current_speech_.start = static_cast<int>(current_sample_ - Geometry::window_samples);
+            }
+            return;
+        }
+        // 与 VadIterator 一致，在 double 下比较
+        if (prob >= threshold_ - 0.15) return;
+
+        if (triggered_) {
+            if (temp_end_ == 0) temp_end_ = current_sample_;
+            if (current_sample_ - temp_end_ > kMinSilenceSamplesAtMaxSpeech) prev_end_ = static_cast<int>(temp_end_);
+            if (current_sample_ - temp_end_ >= kMinSilenceSamples) {
+                current_speech_.end = static_cast<int>(temp_end_);
+                if (current_speech_.end - current_speech_.start > kMinSpeechSamples) {
+                    speeches_.push_back(current_speech_);
+                    current_speech_ = timestamp_t();
+                    prev_end_ = 0;
+                    next_start_ = 0;
+                    temp_end_ = 0;
+                    triggered_ = false;
+                }
+            }
+        }
+    }
+
+    bool triggered() const { return triggered_; }
+    const std::vector<timestamp_t>& speeches() const { return speeches_; }
+
+    void save_state(VadEngineState& state) const {
+        state.triggered = triggered_;
+        state.temp_end = temp_end_;
+        state.current_sample = current_sample_;
+        state.prev_end = prev_end_;
+        state.next_start = next_start_;
+        state.speech_start = current_speech_.start;
+        state.speech_end = current_speech_.end;
+        state.last_start = speeches_.empty() ? -1 : speeches_.back().start;
+        state.last_end = speeches_.empty() ? -1 : speeches_.back().end;
+    }
+
+    void load_state(const VadEngineState& state) {
+        triggered_ = state.triggered;
+        temp_end_ = state.temp_end;
+        current_sample_ = state.current_sample;
+        prev_end_ = state.prev_end;
+        next_start_ = state.next_start;
+        current_speech_ = timestamp_t(state.speech_start, state.speech_end);
+        speeches_.clear();
+        if (state.last_start >= 0) speeches_.push_back(timestamp_t(state.last_start, state.last_end));
+    }
+
+    void reset() {
+        triggered_ = false;
+        temp_end_ = 0;
+        current_sample_ = 0;
+        prev_end_ = next_start_ = 0;
+        speeches_.clear();
+        current_speech_ = timestamp_t();
+    }
+
+    size_t memory_bytes() const { return speeches_.capacity() * sizeof(timestamp_t); }
+
+    // 历史语音段只保留最近一个 (判决与 VadResult::timestamp 只用到它)
+    void trim() {
+        if (speeches_.size() <= 1 && speeches_.capacity() <= 1) return;
+        std::vector<timestamp_t> last;
+        if (!speeches_.empty()) last.push_back(speeches_.back());
+        speeches_.swap(last);
+    }
+
+private:
+    static constexpr unsigned int kMinSilenceSamples = Geometry::sr_per_ms * 100;
+    static constexpr unsigned int kMinSilenceSamplesAtMaxSpeech = Geometry::sr_per_ms * 98;
+    static constexpr int kMinSpeechSamples = Geometry::sr_per_ms * 250;
+
+    float threshold_;
+    bool triggered_ = false;
+    unsigned int temp_end_ = 0;
+    unsigned int current_sample_ = 0;
+    int prev_end_ = 0;
+    int next_start_ = 0;
+    std::vector<timestamp_t> speeches_;
+    timestamp_t current_speech_;
+};
+
+template <int SampleRate, int WindowMs, template <class> class Policy = SileroHysteresis>
+class StaticVadEngine final : public IVadEngine {
+public:
+    using Geometry = VadGeometry<SampleRate, WindowMs>;
+
+    explicit StaticVadEngine(std::shared_ptr<VadModel> model, float threshold = 0.5f)
+        : model_(std::move(model)), policy_(threshold) {
+        // 张量直接引用成员数组，对象生命周期内地址不变，只需创建一次
+        sr_[0] = SampleRate;
+        inputs_[0] = Ort::Value::CreateTensor<float>(memory_info_, input_.data(), input_.size(), kInputDims, 2);
+        inputs_[1] = Ort::Value::CreateTensor<float>(memory_info_, state_.data(), state_.size(), kStateDims, 3);
+        inputs_[2] = Ort::Value::CreateTensor<int64_t>(memory_info_, sr_.data(), sr_.size(), kSrDims, 1);
+        outputs_[0] = Ort::Value::CreateTensor<float>(memory_info_, prob_.data(), prob_.size(), kProbDims, 2);
+        outputs_[1] = Ort::Value::CreateTensor<float>(memory_info_, state_out_.data(), state_out_.size(), kStateDims, 3);
+
+        buffer_.reserve(Geometry::window_samples);
+        reset_states();
+    }
+
+    // 张量持有成员数组的地址，禁止拷贝/移动
+    StaticVadEngine(const StaticVadEngine&) = delete;
+    StaticVadEngine& operator=(const StaticVadEngine&) = delete;
+
+    std::vector<float>& input_buffer() override { return buffer_; }
+
+    VadResult process_buffered() override {
+        VadResult result;
+        result.state = VadState::SILENCE;
+        result.probability = last_prob_;
+
+        bool was_triggered = policy_.triggered();
+        bool is_triggered = was_triggered;
+
+        size_t offset = 0;
+        while (buffer_.size() - offset >= Geometry::window_samples) {
+            process_window(buffer_.data() + offset);
+            offset += Geometry::window_samples;
+            result.probability = last_prob_;
+
+            is_triggered = policy_.triggered();
+            if (!was_triggered && is_triggered) {
+                result.state = VadState::START_SPEAKING;
+            } else if (was_triggered && !is_triggered) {
+                result.state = VadState::END_SPEAKING;
+            } else if (is_triggered) {
+                result.state = VadState::SPEAKING;
+            }
+            was_triggered = is_triggered;
+        }
+        if (offset > 0) {
+            buffer_.erase(buffer_.begin(), buffer_.begin() + offset);
+        }
+
+        if (result.state == VadState::SILENCE && is_triggered) {
+            result.state = VadState::SPEAKING;
+        }
+
+        const auto& stamps = policy_.speeches();
+        if (!stamps.empty()) {
+            result.timestamp = stamps.back().c_str();
+        }
+        return result;
+    }
+
+    void reset() override {
+        reset_states();
+        buffer_.clear();
+    }
+
+    size_t memory_bytes() const override {
+        return sizeof(*this) + buffer_.capacity() * sizeof(float) + policy_.memory_bytes();
+    }
+
+    void trim() override {
+        // 处理后缓冲区里只剩不足一个窗口的尾部；常规大小的包 (256ms 以内) 撑出的容量保留
+        if (buffer_.capacity() > 8 * Geometry::window_samples) {
+            std::vector<float> pending;
+            pending.reserve(Geometry::window_samples);
+            pending.assign(buffer_.begin(), buffer_.end());
+            buffer_.swap(pending);
+        }
+        policy_.trim();
+    }
+
+    bool save_state(VadEngineState& state) const override {
+        state.sample_rate = SampleRate;
+        state.context.assign(input_.begin(), input_.begin() + Geometry::context_samples);
+        state.rnn_state.assign(state_.begin(), state_.end());
+        state.last_prob = last_prob_;
+        policy_.save_state(state);
+        state.pending = buffer_;
+        return true;
+    }
+
+    bool load_state(const VadEngineState& state) override {
+        if (state.sample_rate != SampleRate || state.context.size() != Geometry::context_samples ||
+            state.rnn_state.size() != Geometry::state_size) {
+            return false;
+        }
+        std::copy(state.context.begin(), state.context.end(), input_.begin());
+        std::copy(state.rnn_state.begin(), state.rnn_state.end(), state_.begin());
+        last_prob_ = state.last_prob;
+        policy_.load_state(state);
+        buffer_ = state.pending;
+        return true;
+    }
+
+private:
+    // 每个窗口的热路径: 尺寸全部为编译期常量
+    void process_window(const float* window) {
+        std::copy(window, window + Geometry::window_samples, input_.begin() + Geometry::context_samples);
+        model_->session().Run(Ort::RunOptions{nullptr}, kInputNames, inputs_.data(), inputs_.size(),
+                      kOutputNames, outputs_.data(), outputs_.size());
+        last_prob_ = prob_[0];
+        state_ = state_out_;
+        policy_.update(last_prob_);
+        // 本窗口的尾部作为下一个窗口的上下文
+        std::copy(input_.end() - Geometry::context_samples, input_.end(), input_.begin());
+    }
+
+    void reset_states() {
+        input_.fill(0.0f);
+        state_.fill(0.0f);
+        last_prob_ = 0.0f;
+        policy_.reset();
+    }
+
+    static constexpr int64_t kInputDims[2] = {1, static_cast<int64_t>(Geometry::effective_window)};
+    static constexpr int64_t kStateDims[3] = {2, 1, 128};
+    static constexpr int64_t kSrDims[1] = {1};
+    static constexpr int64_t kProbDims[2] = {1, 1};
+    static constexpr const char* kInputNames[3] = {"input", "state", "sr"};
+    static constexpr const char* kOutputNames[2] = {"output", "stateN"};
+
+    std::shared_ptr<VadModel> model_;
+    Ort::MemoryInfo memory_info_ = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+
+    // [context | window]，上下文就地保存在输入的前部
+    std::array<float, Geometry::effective_window> input_;
+    std::array<float, Geometry::state_size> state_;
+    std::array<float, Geometry::state_size> state_out_;
+    std::array<int64_t, 1> sr_;
+    std::array<float, 1> prob_;
+    std::array<Ort::Value, 3> inputs_{{Ort::Value(nullptr), Ort::Value(nullptr), Ort::Value(nullptr)}};
+    std::array<Ort::Value, 2> outputs_{{Ort::Value(nullptr), Ort::Value(nullptr)}};
+
+    float last_prob_ = 0.0f;
+    Policy<Geometry> policy_;
+    std::vector<float> buffer_;
+};
+
+// 服务端实际使用的配置 (32ms 窗口)，在 static_vad_engine.cpp 中显式实例化
+extern template class StaticVadEngine<16000, 32>;
+extern template class StaticVadEngine<8000, 32>;
+
+// 按采样率选择编译期特化的引擎；不支持的采样率返回 nullptr，由调用方退回 SileroVadEngine
+std::unique_ptr<IVadEngine> make_static_vad_engine(std::shared_ptr<VadModel> model, int sample_rate,
+                                                   float threshold = 0.5f);
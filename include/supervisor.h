@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "server.h"
+
+// 多进程模式
+//
+// supervisor 进程本身不加载模型、不处理连接，只负责:
+//   1. 在一个临时子进程里加载一次模型，生成 ORT 格式缓存
+//   2. fork N 个工作进程，各自绑定到一组 CPU，以 SO_REUSEPORT 监听同一端口，由内核分配连接
+//   3. 工作进程异常退出时重新拉起 (其他进程上的连接不受影响)，收到 SIGTERM/SIGINT 时转发并等待全部退出
+//      (工作进程收到 SIGTERM 后排空或停止服务、写完排队中的归档并打印统计再退出)
+// 各进程以只读方式 mmap 同一个模型缓存文件，模型字节在页缓存中只有一份。
+struct SupervisorConfig {
+    // 工作进程数，0 表示不启用多进程模式
+    size_t processes = 0;
+    // 每个进程绑定的 CPU (进程 i 使用第 i % size 组)；为空时把可用 CPU 平均切分给各进程
+    std::vector<std::vector<int>> cpu_sets;
+};
+
+// 解析 "0-3;4-7,12" 形式的 CPU 集合列表 (分号分隔各组，组内逗号分隔编号或区间)
+bool parse_cpu_sets(const std::string& text, std::vector<std::vector<int>>& sets);
+
+// 运行 supervisor，直到收到退出信号；返回进程退出码
+int run_supervisor(const ServerConfig& server_config, const SupervisorConfig& config);
@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ws_config.h"
+#include "session_slab.h"
+
+// 任务包
+struct AudioTask {
+    SessionRef session_ref;
+    // 二进制帧: 直接持有 websocketpp 的引用计数消息，工作线程从消息内存中读取 PCM，不做拷贝
+    server::message_ptr msg;
+    // JSON 帧: base64 解码后的音频 (共享所有权，切片之间不拷贝)
+    std::shared_ptr<std::vector<uint8_t>> data;
+    // 共享内存接入: 直接指向环中的记录 (租约，最后一个引用释放时把空间归还给生产者)，不做拷贝
+    std::shared_ptr<const uint8_t> external;
+    size_t external_size = 0;
+    // 切片: 本任务只覆盖负载中的 [offset, offset + length)
+    size_t offset = 0;
+    size_t length = SIZE_MAX;
+    // Protocol metadata
+    std::string uid;
+    std::string connect_session;
+    std::string current_session;
+
+    // 调度信息 (on_message 中填写)
+    std::chrono::steady_clock::time_point deadline; // 到达时间 + 该连接的延迟预算
+    uint32_t bytes_per_sec = 0; // PCM 负载的字节速率；0 表示不可切片 (压缩包)
+    uint16_t frame_bytes = 0;   // PCM 交织帧字节数，切片按此对齐
+    uint64_t audio_us = 0;      // 整条负载的音频时长 (压缩包为估算值)，公平队列按此计费
+    bool catch_up = false;      // 会话积压: 只回传状态跳变 (由调度器设置)
+
+    // 控制任务 (无负载)，按会话 FIFO 排在已入队的音频之后: 工作线程处理到它时，该会话之前的任务都已完成
+    enum class Control : uint8_t {
+        NONE,
+        MIGRATE, // 迁往 target_shard: 放行目标调度器中暂扣的任务
+        FREEZE,  // 冻结会话并写出快照 (滚动重启前排空)
+        HIBERNATE // 空闲会话休眠 (释放缓冲区、暂存引擎状态)
+    };
+    Control control = Control::NONE;
+    uint32_t target_shard = 0;
+
+    const uint8_t* payload_base() const {
+        if (msg) return reinterpret_cast<const uint8_t*>(msg->get_payload().data());
+        if (external) return external.get();
+        return data ? data->data() : nullptr;
+    }
+    size_t payload_total() const {
+        if (msg) return msg->get_payload().size();
+        if (external) return external_size;
+        return data ? data->size() : 0;
+    }
+    const uint8_t* payload() const { return payload_base() + offset; }
+    size_t payload_size() const {
+        size_t total = payload_total();
+        if (offset >= total) return 0;
+        return std::min(length, total - offset);
+    }
+};
+
+struct SchedulerConfig {
+    enum class Policy {
+        EDF, // 截止时间最早的会话优先 (延迟优先)
+        DRR  // 按音频时长的赤字轮转 (各会话平分处理能力)
+    };
+    Policy policy = Policy::EDF;
+    // 大于两个切片的 PCM 任务按该时长切开，其他会话的实时帧可以插到切片之间
+    uint32_t slice_ms = 100;
+    // DRR 每轮给每个会话的额度 (音频毫秒)
+    uint32_t quantum_ms = 100;
+    // 会话排队的音频超过该时长 (且不止一个任务) 时进入追赶模式，0 关闭
+    uint32_t catchup_ms = 1000;
+    // 追赶模式下一次最多合并的音频时长
+    uint32_t catchup_max_ms = 10000;
+};
+
+// 单个工作线程的任务调度器
+//
+// 每个会话一条 FIFO (保证同一会话内的顺序)，会话之间按队首任务的截止时间 (EDF) 调度。
+// 超大的 PCM 任务被切成 slice_ms 的片段，第 k 片的截止时间为 deadline + k * slice 时长，
+// 即上传大块音频的会话按实时速度排队，实时流 20ms 帧的截止时间更早，会优先处理；
+// 没有竞争时大块音频仍然连续处理，不会空等。
+//
+// DRR 策略下会话按轮转顺序排队，每轮获得 quantum_ms 的音频额度，按任务的音频时长扣减，
+// 发得再快的客户端每轮也只能占用一个额度，不会挤占其他连接。
+//
+// 追赶模式: 网络卡顿或客户端冲刷缓冲后，一个会话可能积压大量已过时的任务。此时把积压的
+// PCM 任务合并成一段连续缓冲区整体交给工作线程 (AudioTask::catch_up)，只回传状态跳变与语音段，
+// 会话尽快回到实时；压缩编码无法拼接，逐个任务标记 catch_up。DRR 下只合并当前额度付得起的
+// 原始任务，按实际合并的音频扣减。合并时锁内只取走任务，拼接在 pop() 释放锁之后进行。
+//
+// push() 由 I/O 线程调用，pop() 只由所属的一个工作线程调用。
+class TaskScheduler {
+public:
+    explicit TaskScheduler(const SchedulerConfig& config = SchedulerConfig()) : config_(config) {
+        config_.quantum_ms = std::max<uint32_t>(1, config_.quantum_ms);
+    }
+
+    void push(AudioTask task);
+    // 阻塞直到有任务或 stop()；stop() 之后继续派发已入队的任务 (音频与控制任务)，全部派发完才返回 false
+    bool pop(AudioTask& out);
+    void stop();
+    // 停止时仍暂扣 (hold) 而无法派发、被丢弃的任务数
+    size_t dropped_on_stop();
+
+    size_t pending_sessions();
+
+    // 会话迁移: 暂扣该会话的任务 (照常入队但不派发)，直到 release()
+    void hold(SessionRef ref);
+    void release(SessionRef ref);
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    struct SessionQueue {
+        std::deque<AudioTask> tasks;
+        size_t head_offset = 0; // 队首任务已派发的字节数
+        uint64_t pending_us = 0; // 排队中的音频时长
+        bool ready = false;     // 是否已在 ready_ 堆 (EDF) / active_ 轮转队列 (DRR) 中
+        // DRR
+        uint64_t deficit_us = 0;
+        bool in_round = false;  // 本轮是否已领取额度
+        // 追赶合并范围的缓存: 从队首起可合并的任务数及其音频时长；队首变化时失效，push 时增量延长
+        size_t span_count = 0;
+        uint64_t span_us = 0;
+        bool span_valid = false;
+        bool span_closed = false; // 已遇到不可合并的任务或达到上限，之后入队的任务不再并入
+    };
+
+    struct ReadyEntry {
+        time_point deadline;
+        uint64_t seq; // 截止时间相同时按入堆顺序
+        uint64_t key;
+        bool operator>(const ReadyEntry& o) const {
+            return deadline != o.deadline ? deadline > o.deadline : seq > o.seq;
+        }
+    };
+
+    static uint64_t key_of(SessionRef ref) { return (static_cast<uint64_t>(ref.generation) << 32) | ref.slot; }
+    time_point head_deadline(const SessionQueue& q) const;
+    size_t slice_bytes(const AudioTask& task) const;
+    void make_ready(uint64_t key, SessionQueue& q);
+    bool catching_up(const SessionQueue& q) const;
+    // 队列中第 index 个任务尚未派发部分的音频时长 (仅 PCM)
+    uint64_t queued_us(const SessionQueue& q, size_t index) const;
+    // 从缓存的合并范围末尾继续向后扫描
+    void extend_span(SessionQueue& q) const;
+    // 追赶模式下从队首起可合并的任务数 (至少 1，队首为压缩包时为 0) 及其音频时长
+    size_t catchup_span(SessionQueue& q, uint64_t& audio_us) const;
+    // 队首下一次派发的字节数 (一个切片或剩余全部) 及其音频时长
+    size_t next_bytes(const SessionQueue& q) const;
+    uint64_t next_cost_us(const SessionQueue& q) const;
+    // 把 count 个任务移入 merge_parts_，合并任务的其余字段写入 out
+    void take_merged(SessionQueue& q, size_t count, uint64_t audio_us, AudioTask& out);
+    // 在锁外把 merge_parts_ 拼接成 out 的负载
+    void finish_merged(AudioTask& out);
+    // 派发队首的下一段到 out，追赶合并最多用掉 budget_us 的音频额度；返回会话队列是否已空
+    bool take_next(SessionQueue& q, uint64_t budget_us, AudioTask& out);
+    uint64_t pick_edf();
+    uint64_t pick_drr();
+
+    SchedulerConfig config_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopped_ = false;
+    size_t dropped_on_stop_ = 0;
+    uint64_t seq_ = 0;
+    std::unordered_map<uint64_t, SessionQueue> sessions_;
+    std::priority_queue<ReadyEntry, std::vector<ReadyEntry>, std::greater<ReadyEntry>> ready_;
+    std::deque<uint64_t> active_;
+    std::unordered_set<uint64_t> held_;
+    // 待拼接的追赶任务，只由调用 pop() 的工作线程访问
+    std::vector<AudioTask> merge_parts_;
+};
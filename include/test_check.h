@@ -0,0 +1,15 @@
+#pragma once
+#include <iostream>
+
+// 单元测试 (src/test_*.cpp) 共用的断言: 失败时打印位置并计数，不中止，main 按计数返回
+namespace test {
+inline int failures = 0;
+} // namespace test
+
+#define CHECK(cond)                                                                               \
+    do {                                                                                          \
+        if (!(cond)) {                                                                            \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl;    \
+            ++test::failures;                                                                     \
+        }                                                                                         \
+    } while (0)
@@ -4,6 +4,7 @@
 #include <memory>
 #include <iostream>
 #include "vad_iterator.h"
+#include "session_snapshot.h"
 
 // VAD 状态枚举
 enum class VadState {
@@ -26,17 +27,45 @@ public:
 
     // 输入 PCM 音频数据 (float 格式)
     // 返回本次处理的 VAD 状态结果
-    virtual VadResult process_frame(const std::vector<float>& audio_frame) = 0;
+    virtual VadResult process_frame(const std::vector<float>& audio_frame) {
+        std::vector<float>& in = input_buffer();
+        in.insert(in.end(), audio_frame.begin(), audio_frame.end());
+        return process_buffered();
+    }
+
+    // 引擎内部的待处理样本缓冲区
+    // 调用方可以把转码结果直接追加到这里，再调用 process_buffered()，省掉一次中间拷贝
+    virtual std::vector<float>& input_buffer() = 0;
+
+    // 处理缓冲区中所有完整的窗口，不足一个窗口的尾部留待下次
+    virtual VadResult process_buffered() = 0;
     
     // 重置状态
     virtual void reset() = 0;
+
+    // 会话迁移: 导出/恢复引擎的全部状态 (含未处理的样本)；不支持的引擎返回 false
+    virtual bool save_state(VadEngineState& state) const {
+        (void)state;
+        return false;
+    }
+    virtual bool load_state(const VadEngineState& state) {
+        (void)state;
+        return false;
+    }
+
+    // 内存统计: 引擎对象及其缓冲区按容量计的字节数 (共享模型与 ORT 内部的分配不计)
+    virtual size_t memory_bytes() const { return 0; }
+
+    // 收回超出常规用量的容量 (大包撑大的输入缓冲区、累积的历史语音段)，不影响之后的判决
+    virtual void trim() {}
 };
 
 // Silero VAD 引擎实现 (适配 VadIterator)
 class SileroVadEngine : public IVadEngine {
 public:
-    explicit SileroVadEngine(const std::string& model_path, int sample_rate = 16000, int window_frame_ms = 32) 
-        : vad_iterator_(model_path, sample_rate, window_frame_ms) {
+    explicit SileroVadEngine(const std::string& model_path, int sample_rate = 16000, int window_frame_ms = 32,
+                             float threshold = 0.5f)
+        : vad_iterator_(model_path, sample_rate, window_frame_ms, threshold) {
         
         // 计算需要的窗口大小 (samples)
         // VadIterator 内部: window_size_samples = windows_frame_size * (sample_rate / 1000)
@@ -45,28 +74,24 @@ public:
         buffer_.reserve(window_size_samples_);
     }
 
-    VadResult process_frame(const std::vector<float>& audio_frame) override {
+    std::vector<float>& input_buffer() override { return buffer_; }
+
+    VadResult process_buffered() override {
         VadResult result;
         result.state = VadState::SILENCE;
         result.probability = vad_iterator_.get_last_probability();
 
-        // 1. 将新数据添加到缓冲区
-        buffer_.insert(buffer_.end(), audio_frame.begin(), audio_frame.end());
-
-        // 2. 如果缓冲区数据足够一个窗口，进行处理
+        // 如果缓冲区数据足够一个窗口，进行处理
         
         bool was_triggered = vad_iterator_.is_triggered();
         bool is_triggered = was_triggered;
         
-        while (buffer_.size() >= window_size_samples_) {
-            // 提取一个窗口的数据
-            std::vector<float> chunk(buffer_.begin(), buffer_.begin() + window_size_samples_);
-            
-            // 从缓冲区移除
-            buffer_.erase(buffer_.begin(), buffer_.begin() + window_size_samples_);
-            
-            // 调用 VadIterator 处理
-            vad_iterator_.predict(chunk);
+        // 按偏移量逐窗口读取，处理完后一次性移除已消费的前缀
+        size_t offset = 0;
+        while (buffer_.size() - offset >= window_size_samples_) {
+            // 调用 VadIterator 处理 (直接读取缓冲区，无需拷贝出窗口)
+            vad_iterator_.predict(buffer_.data() + offset);
+            offset += window_size_samples_;
             result.probability = vad_iterator_.get_last_probability();
             
             // 更新触发状态
@@ -83,6 +108,9 @@ public:
             
             was_triggered = is_triggered;
         }
+        if (offset > 0) {
+            buffer_.erase(buffer_.begin(), buffer_.begin() + offset);
+        }
 
         // 如果没有状态跳变，根据当前状态返回
         if (result.state == VadState::SILENCE && is_triggered) {
@@ -93,7 +121,7 @@ public:
         // if (result.probability > 0.01) std::cout << "DEBUG VAD Prob: " << result.probability << " Trig: " << is_triggered << std::endl;
 
         // 尝试获取 timestamps 更新 (如果有)
-        auto stamps = vad_iterator_.get_speech_timestamps();
+        const auto& stamps = vad_iterator_.get_speech_timestamps();
         if (!stamps.empty()) {
             result.timestamp = stamps.back().c_str();
         }
@@ -106,6 +134,33 @@ public:
         buffer_.clear();
     }
 
+    size_t memory_bytes() const override {
+        return sizeof(*this) + buffer_.capacity() * sizeof(float) + vad_iterator_.memory_bytes();
+    }
+
+    void trim() override {
+        // 处理后缓冲区里只剩不足一个窗口的尾部；常规大小的包 (256ms 以内) 撑出的容量保留
+        if (buffer_.capacity() > 8 * window_size_samples_) {
+            std::vector<float> pending;
+            pending.reserve(window_size_samples_);
+            pending.assign(buffer_.begin(), buffer_.end());
+            buffer_.swap(pending);
+        }
+        vad_iterator_.trim();
+    }
+
+    bool save_state(VadEngineState& state) const override {
+        vad_iterator_.save_state(state);
+        state.pending = buffer_;
+        return true;
+    }
+
+    bool load_state(const VadEngineState& state) override {
+        if (!vad_iterator_.load_state(state)) return false;
+        buffer_ = state.pending;
+        return true;
+    }
+
 private:
     VadIterator vad_iterator_;
     std::vector<float> buffer_;
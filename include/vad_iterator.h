@@ -9,6 +9,8 @@
 #include <cstdio>
 #include "onnxruntime_cxx_api.h"
 
+struct VadEngineState;
+
 class timestamp_t {
 public:
     int start;
@@ -31,7 +33,8 @@ private:
     Ort::AllocatorWithDefaultOptions allocator;
     Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
 
-    const int context_samples = 64;
+    // Silero v5: 16k 使用 64 个上下文样本，8k 使用 32 个
+    int context_samples;
     std::vector<float> _context;
     int window_size_samples;
     int effective_window_size;
@@ -74,6 +77,8 @@ private:
     
 public:
     void predict(const std::vector<float>& data_chunk);
+    // data 指向 window_size_samples 个连续样本
+    void predict(const float* data);
     bool is_triggered() const { return triggered; }
 
     VadIterator(const std::string ModelPath,
@@ -83,9 +88,17 @@ public:
         float max_speech_duration_s = std::numeric_limits<float>::infinity());
 
     void process(const std::vector<float>& input_wav);
-    const std::vector<timestamp_t> get_speech_timestamps() const;
+    const std::vector<timestamp_t>& get_speech_timestamps() const;
     float get_last_probability() const { return last_prob; }
     void reset();
+
+    // 会话迁移: 导出/恢复 RNN 状态、上下文与迟滞计数 (不含 pending)；采样率不符时 load_state 返回 false
+    void save_state(VadEngineState& state) const;
+    bool load_state(const VadEngineState& state);
+
+    // 内存统计 (不含 ORT 会话)；trim: 历史语音段只保留最近一个 (与 save_state 导出的一致)
+    size_t memory_bytes() const;
+    void trim();
 };
 
 #endif // VAD_ITERATOR_H
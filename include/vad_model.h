@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "onnxruntime_cxx_api.h"
+
+// 模型加载参数
+struct VadModelOptions {
+    std::string model_path = "../model/silero_vad.onnx";
+    // 缓存优化后的 ORT 格式模型，之后启动直接加载，跳过图优化
+    bool use_ort_cache = true;
+    // 缓存路径，为空时使用 model_path + ".ort"
+    std::string ort_cache_path;
+};
+
+// 进程内共享的 Silero 模型
+//
+// 模型文件以只读 mmap 方式映射后从内存创建 ORT 会话；所有引擎共用同一个 Ort::Session
+// (Silero 的 RNN 状态作为输入/输出传递，会话本身无状态，Run 可并发调用)，
+// 新连接挂载引擎时不再重复解析模型与做图优化。
+// 首次启动把优化后的模型按 ORT 格式写入缓存，之后直接使用映射的缓存字节 (不再拷贝)。
+class VadModel {
+public:
+    // 在第一次 get() 之前调用；之后调用无效
+    static void configure(const VadModelOptions& options);
+    static const VadModelOptions& options();
+    // 按当前配置加载 (仅第一次调用时)，线程安全；加载失败抛出 Ort::Exception
+    static std::shared_ptr<VadModel> get();
+    // ORT 缓存路径，以及缓存是否存在且不比原始模型旧 (只查看文件，不创建 ORT 环境)
+    static std::string cache_path(const VadModelOptions& options);
+    static bool cache_fresh(const VadModelOptions& options);
+
+    ~VadModel();
+    VadModel(const VadModel&) = delete;
+    VadModel& operator=(const VadModel&) = delete;
+
+    Ort::Session& session() { return *session_; }
+    // 实际加载的文件 (原始模型或 ORT 缓存)
+    const std::string& loaded_from() const { return loaded_from_; }
+
+    // 在调用线程上用合成音频跑若干次 16k/8k 推理，预热内核、内存分配与 CPU 缓存
+    void warmup(int iterations);
+
+private:
+    explicit VadModel(const VadModelOptions& options);
+
+    // 只读映射整个文件，失败时返回 false
+    bool map_file(const std::string& path);
+    void unmap_file();
+    void load_from_cache(const std::string& cache_path);
+    void load_from_model(const VadModelOptions& options, const std::string& cache_path);
+    static void base_session_options(Ort::SessionOptions& options);
+
+    Ort::Env env_;
+    std::unique_ptr<Ort::Session> session_;
+    std::string loaded_from_;
+
+    const void* mapped_ = nullptr;
+    size_t mapped_size_ = 0;
+};
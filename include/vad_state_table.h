@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "onnxruntime_cxx_api.h"
+#include "static_vad_engine.h"
+#include "vad_engine.h"
+#include "vad_model.h"
+
+// 会话状态表 (structure of arrays)
+//
+// 每个会话占一行，同一种状态在所有会话之间连续存放: RNN 状态、上下文样本、迟滞计数器、样本时钟
+// 各自是一个数组，按行号下标。一步推理只触碰本批会话的几条连续缓存行，而不是
+// Session -> IVadEngine -> VadIterator -> 十几个 std::vector 的指针链。
+//
+// - update(): 整批会话的迟滞判决。先把各行的计数器收集进连续的批数组，用无分支的掩码运算
+//   一次算完整批 (编译器可向量化)，再写回各行；判决结果与 SileroHysteresis / VadIterator 一致。
+// - step(): 批量推理。每行一个窗口，拼成 [n, window] 输入与 [2, n, 128] 状态，一次 Run 处理整批
+//   (Silero v5 的 batch 维)，随后调用 update()。
+//
+// 行的分配/释放只在挂载/卸载引擎时发生，由小锁保护；不同线程可以同时 step 不相交的行。
+//
+// 目前只是基准原型: 只有 vad_bench 的 table / batch 引擎与一致性测试使用它。服务端的工作线程
+// 仍逐任务处理，每个会话用自己的 StaticVadEngine / SileroHysteresis 逐窗口判决，没有跨会话的批量 step；
+// 要在服务路径上得到批量收益，需要工作线程先收集多个会话凑满的窗口再统一 step。
+template <class Geometry>
+class VadStateTable {
+public:
+    static const uint32_t kNoRow = UINT32_MAX;
+
+    // 状态跳变
+    enum Transition : uint8_t {
+        NONE = 0,
+        START = 1,
+        END = 2,
+    };
+
+    VadStateTable(std::shared_ptr<VadModel> model, size_t capacity, float threshold = 0.5f);
+
+    size_t capacity() const { return triggered_.size(); }
+
+    // 分配一行 (状态清零)；表满时返回 kNoRow
+    uint32_t acquire();
+    void release(uint32_t row);
+    void reset_row(uint32_t row);
+
+    bool triggered(uint32_t row) const { return triggered_[row] != 0; }
+    float last_prob(uint32_t row) const { return last_prob_[row]; }
+    // 最近一个完成的语音段 (样本)，没有时 start < 0
+    int32_t last_start(uint32_t row) const { return last_start_[row]; }
+    int32_t last_end(uint32_t row) const { return last_end_[row]; }
+
+    // probs[i] 为 rows[i] 本窗口的语音概率；transitions[i] 输出该行的状态跳变
+    void update(const uint32_t* rows, const float* probs, size_t n, uint8_t* transitions);
+
+    // windows[i] 指向 rows[i] 的 Geometry::window_samples 个样本；rows 中不能有重复
+    // 调用方负责同一行不被两个线程同时 step
+    void step(const uint32_t* rows, const float* const* windows, size_t n, uint8_t* transitions);
+
+    // 会话迁移 (与 StaticVadEngine 使用同一布局，不含 pending)
+    void save_state(uint32_t row, VadEngineState& state) const;
+    bool load_state(uint32_t row, const VadEngineState& state);
+
+private:
+    static const size_t kStride = Geometry::state_size; // 每行 [2][128]
+
+    std::shared_ptr<VadModel> model_;
+    float threshold_;
+    float low_threshold_; // threshold - 0.15，取与 double 比较等价的最小 float
+
+    // SoA 状态
+    std::vector<float> rnn_state_;   // capacity * 256
+    std::vector<float> context_;     // capacity * context_samples
+    std::vector<float> last_prob_;
+    std::vector<uint8_t> triggered_;
+    std::vector<uint32_t> temp_end_;
+    std::vector<uint32_t> current_sample_;
+    std::vector<int32_t> prev_end_;
+    std::vector<int32_t> next_start_;
+    std::vector<int32_t> speech_start_;
+    std::vector<int32_t> speech_end_;
+    std::vector<int32_t> last_start_;
+    std::vector<int32_t> last_end_;
+
+    std::mutex free_mutex_;
+    std::vector<uint32_t> free_list_;
+
+    Ort::MemoryInfo memory_info_ = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+};
+
+extern template class VadStateTable<VadGeometry<16000, 32>>;
+extern template class VadStateTable<VadGeometry<8000, 32>>;
+
+// 以状态表中的一行为状态的引擎 (每次 step 一个窗口)，用于逐会话的流式处理和对比基准
+template <class Geometry>
+class TableVadEngine final : public IVadEngine {
+public:
+    // table 满时构造失败，valid() 返回 false
+    explicit TableVadEngine(std::shared_ptr<VadStateTable<Geometry>> table);
+    ~TableVadEngine() override;
+
+    bool valid() const { return row_ != VadStateTable<Geometry>::kNoRow; }
+
+    std::vector<float>& input_buffer() override { return buffer_; }
+    VadResult process_buffered() override;
+    void reset() override;
+
+    bool save_state(VadEngineState& state) const override;
+    bool load_state(const VadEngineState& state) override;
+
+private:
+    std::shared_ptr<VadStateTable<Geometry>> table_;
+    uint32_t row_;
+    std::vector<float> buffer_;
+};
+
+extern template class TableVadEngine<VadGeometry<16000, 32>>;
+extern template class TableVadEngine<VadGeometry<8000, 32>>;
@@ -169,6 +169,24 @@ class WavReader {
   float* data_;
 };
 
+// Canonical 44-byte PCM header ("riff" "WAVE" "fmt " "data").
+inline void FillHeader(WavHeader* header, int num_channel, int sample_rate,
+                       int bits_per_sample, uint32_t data_size) {
+  memcpy(header->riff, "RIFF", 4);
+  memcpy(header->wav, "WAVE", 4);
+  memcpy(header->fmt, "fmt ", 4);
+  memcpy(header->data, "data", 4);
+  header->fmt_size = 16;
+  header->format = 1;
+  header->channels = num_channel;
+  header->bit = bits_per_sample;
+  header->sample_rate = sample_rate;
+  header->data_size = data_size;
+  header->size = sizeof(WavHeader) - 8 + data_size;
+  header->bytes_per_second = sample_rate * num_channel * (bits_per_sample / 8);
+  header->block_size = num_channel * (bits_per_sample / 8);
+}
+
 class WavWriter {
  public:
   WavWriter(const float* data, int num_samples, int num_channel,
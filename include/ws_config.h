@@ -0,0 +1,52 @@
+#pragma once
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "audio_format.h"
+#include "session_slab.h"
+
+class SessionPipeline;
+
+// 在 websocketpp 连接对象上直接挂载每个连接的状态，I/O 回调与出站路径无需再查表
+struct vad_server_config : public websocketpp::config::asio {
+    typedef vad_server_config type;
+    typedef websocketpp::config::asio base;
+
+    struct connection_base {
+        SessionRef session_ref;
+        uint32_t shard = 0; // 负责该会话的工作线程下标 (迁移时在 route_mutex 下修改)
+
+        // 任务路由: on_message 读取 shard 并入队的过程与迁移/排空互斥
+        std::mutex route_mutex;
+        bool draining = false; // 已排入冻结任务，之后收到的音频丢弃
+        // 协程模式: 该会话的流水线 (帧直接进入其收件箱，不经过调度器)
+        std::shared_ptr<SessionPipeline> pipeline;
+
+        // 调度参数 (on_open 时确定)
+        uint32_t latency_budget_ms = 0;
+        uint32_t pcm_bytes_per_sec = 0; // 压缩编码为 0 (不可切片)
+        uint16_t pcm_frame_bytes = 0;
+        AudioFormat format;
+
+        // 入站限速: 令牌桶 (单位为音频微秒)，只在该连接的 strand 上修改
+        double rate_tokens_us = 0;
+        std::chrono::steady_clock::time_point rate_refill;
+        uint64_t rate_dropped = 0;
+        std::atomic<bool> rate_paused{false}; // 定时器回调 (任意 I/O 线程) 清除
+
+        // 出站队列: 工作线程追加，I/O 线程批量取走
+        std::mutex egress_mutex;
+        std::vector<base::message_type::ptr> egress_pending;
+        bool egress_scheduled = false;
+    };
+};
+
+// 定义服务器类型
+typedef websocketpp::server<vad_server_config> server;
+using websocketpp::connection_hdl;
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 精简的 RFC 6455 服务端协议 (原生传输使用，websocketpp 路径不经过这里)
+// - HTTP 升级握手: 只接受 GET + Upgrade: websocket + Sec-WebSocket-Version: 13，不协商扩展与子协议
+// - 帧解析: 客户端帧必须带掩码，负载就地去掩码；分片消息拼接到内部缓冲；ping/pong/close 控制帧单独返回；
+//   TEXT 消息与关闭原因必须是合法 UTF-8
+// - 服务端帧不加掩码；客户端一侧 (vad_loadgen、ASR 转发) 只需要发出带掩码的帧
+namespace ws {
+
+enum Opcode : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xA,
+};
+
+// 关闭码
+enum CloseCode : uint16_t {
+    NORMAL = 1000,
+    GOING_AWAY = 1001,
+    PROTOCOL_ERROR = 1002,
+    INVALID_PAYLOAD = 1007,
+    POLICY_VIOLATION = 1008,
+    MESSAGE_TOO_BIG = 1009,
+    TRY_AGAIN_LATER = 1013,
+};
+
+struct HttpRequest {
+    std::string method;
+    std::string resource;
+    std::string upgrade;    // Upgrade 头 (已转小写)
+    std::string connection; // Connection 头 (已转小写)
+    std::string key;        // Sec-WebSocket-Key
+    std::string version;    // Sec-WebSocket-Version
+
+    bool is_websocket() const;
+};
+
+// 解析请求头: 返回 0 表示还不完整，-1 表示格式错误或超过 max_size，否则为请求头的字节数
+long parse_http_request(const char* data, size_t len, HttpRequest& request, size_t max_size = 8192);
+
+// SHA-1 摘要 (握手用，输入很短)
+void sha1(const uint8_t* data, size_t len, uint8_t digest[20]);
+// 严格 UTF-8 校验: 拒绝过长编码、代理区 (U+D800..U+DFFF) 与超过 U+10FFFF 的码点
+bool valid_utf8(const uint8_t* data, size_t len);
+
+// Sec-WebSocket-Accept = base64(SHA1(key + RFC 6455 GUID))
+std::string accept_key(const std::string& key);
+// 101 Switching Protocols 响应
+std::string handshake_response(const std::string& key);
+// 普通 HTTP 响应 (Connection: close)
+std::string http_response(int status, const char* reason, const std::string& body);
+
+// 追加服务端帧头 (FIN=1，无掩码)
+void append_frame_header(std::string& out, Opcode opcode, size_t payload_len);
+// 追加完整的关闭帧
+void append_close_frame(std::string& out, uint16_t code);
+// 追加完整的客户端帧 (FIN=1，负载按 mask_key 加掩码)
+void append_client_frame(std::string& out, Opcode opcode, const uint8_t* payload, size_t len, uint32_t mask_key);
+
+// 增量帧解析器 (每个连接一个)
+class FrameParser {
+public:
+    enum Result {
+        NEED_MORE, // 数据不足一个完整帧 (已消耗的分片仍计入 consumed)
+        MESSAGE,   // 完整的数据消息 (TEXT/BINARY)
+        CONTROL,   // 控制帧 (CLOSE/PING/PONG)
+        FAILED     // 协议错误或消息超过上限，应以 close_code() 关闭连接
+    };
+
+    explicit FrameParser(size_t max_message = 16u << 20);
+
+    // 从 data 开头解析，直到得到一个消息/控制帧或数据不足；consumed 为本次消耗的字节数。
+    // 去掩码就地进行；未分片消息的 payload() 直接指向 data 内部，在调用方移动/释放缓冲区前有效
+    Result next(uint8_t* data, size_t len, size_t& consumed);
+
+    Opcode opcode() const { return opcode_; }
+    const uint8_t* payload() const { return payload_; }
+    size_t payload_size() const { return payload_size_; }
+    // FAILED 时建议的关闭码；CONTROL(CLOSE) 时为对端给出的关闭码 (没有时为 NORMAL)
+    uint16_t close_code() const { return close_code_; }
+
+private:
+    Result checked_message();
+
+    size_t max_message_;
+    bool fragmented_ = false;
+    Opcode fragment_opcode_ = TEXT;
+    std::vector<uint8_t> fragments_;
+
+    Opcode opcode_ = TEXT;
+    const uint8_t* payload_ = nullptr;
+    size_t payload_size_ = 0;
+    uint16_t close_code_ = NORMAL;
+};
+
+} // namespace ws
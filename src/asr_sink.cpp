@@ -0,0 +1,302 @@
+// 下游 ASR 的本地替身: 接收 vad_server --asr-forward 转发的语音段，统计并回一条假的识别结果
+//
+// 同一端口同时接受 ws:// (首包为 HTTP 升级请求) 与 tcp:// (长度前缀分帧) 两种协议，格式见 segment_forwarder.h。
+// 每段结束时回复 {"type":"result","bytes":N}；Ctrl-C 时打印汇总 (段数、中途放弃的段、音频时长、
+// 首帧音频相对 start 消息的到达间隔)。
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ws_protocol.h"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+struct Stats {
+    uint64_t connections = 0;
+    uint64_t segments = 0;
+    uint64_t aborted = 0;
+    uint64_t audio_bytes = 0;
+    uint64_t protocol_errors = 0;
+};
+
+struct Connection {
+    enum class Protocol { UNKNOWN, WEBSOCKET, TCP } protocol = Protocol::UNKNOWN;
+    std::string in;
+    ws::FrameParser parser;
+    bool in_segment = false;
+    uint64_t segment_bytes = 0;
+    int sample_rate = 16000;
+    int channels = 1;
+    clock_type::time_point segment_start;
+    bool first_audio_pending = false;
+};
+
+class Sink {
+public:
+    Sink(uint16_t port, bool verbose) : port_(port), verbose_(verbose) {}
+
+    bool open() {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+            std::cerr << "Cannot listen on port " << port_ << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+        return true;
+    }
+
+    void run() {
+        std::cout << "ASR sink listening on port " << port_ << " (ws:// and tcp://)" << std::endl;
+        epoll_event events[128];
+        std::vector<uint8_t> buf(64 * 1024);
+        while (!g_stop) {
+            int n = epoll_wait(epoll_fd_, events, 128, 200);
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd_) {
+                    accept_all();
+                    continue;
+                }
+                for (;;) {
+                    ssize_t r = ::recv(fd, buf.data(), buf.size(), 0);
+                    if (r > 0) {
+                        if (!on_data(fd, buf.data(), static_cast<size_t>(r))) {
+                            close_connection(fd);
+                            break;
+                        }
+                        continue;
+                    }
+                    if (r < 0 && errno == EINTR) continue;
+                    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    close_connection(fd);
+                    break;
+                }
+            }
+        }
+        double audio_sec = 0;
+        for (double s : segment_audio_sec_) audio_sec += s;
+        std::cout << "connections: " << stats_.connections << ", segments: " << stats_.segments << " ("
+                  << stats_.aborted << " aborted), audio: " << audio_sec << " s (" << stats_.audio_bytes
+                  << " bytes), protocol errors: " << stats_.protocol_errors << "\n"
+                  << "start -> first audio ms: p50 " << percentile(first_audio_ms_, 0.5) << ", p99 "
+                  << percentile(first_audio_ms_, 0.99) << std::endl;
+    }
+
+private:
+    static double percentile(std::vector<double> v, double p) {
+        if (v.empty()) return 0;
+        std::sort(v.begin(), v.end());
+        return v[static_cast<size_t>(p * (v.size() - 1) + 0.5)];
+    }
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            connections_[fd];
+            ++stats_.connections;
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void close_connection(int fd) {
+        auto it = connections_.find(fd);
+        if (it != connections_.end() && it->second.in_segment) ++stats_.aborted;
+        connections_.erase(fd);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+    }
+
+    bool on_data(int fd, const uint8_t* data, size_t len) {
+        Connection& con = connections_[fd];
+        con.in.append(reinterpret_cast<const char*>(data), len);
+        if (con.protocol == Connection::Protocol::UNKNOWN) {
+            if (con.in.size() < 4) return true;
+            if (con.in.compare(0, 4, "GET ") != 0) {
+                con.protocol = Connection::Protocol::TCP;
+            } else {
+                ws::HttpRequest request;
+                long header = ws::parse_http_request(con.in.data(), con.in.size(), request);
+                if (header == 0) return true;
+                if (header < 0 || !request.is_websocket()) return false;
+                send_all(fd, ws::handshake_response(request.key));
+                con.in.erase(0, static_cast<size_t>(header));
+                con.protocol = Connection::Protocol::WEBSOCKET;
+            }
+        }
+
+        size_t pos = 0;
+        uint8_t* base = reinterpret_cast<uint8_t*>(&con.in[0]);
+        while (pos < con.in.size()) {
+            uint8_t type = 0;
+            const uint8_t* payload = nullptr;
+            size_t size = 0;
+            if (con.protocol == Connection::Protocol::TCP) {
+                if (con.in.size() - pos < 5) break;
+                const uint8_t* p = base + pos;
+                size = (size_t(p[1]) << 24) | (size_t(p[2]) << 16) | (size_t(p[3]) << 8) | p[4];
+                if (con.in.size() - pos - 5 < size) break;
+                type = p[0];
+                payload = p + 5;
+                pos += 5 + size;
+            } else {
+                size_t consumed = 0;
+                ws::FrameParser::Result result = con.parser.next(base + pos, con.in.size() - pos, consumed);
+                pos += consumed;
+                if (result == ws::FrameParser::NEED_MORE) {
+                    if (consumed == 0) break;
+                    continue;
+                }
+                if (result == ws::FrameParser::FAILED) {
+                    ++stats_.protocol_errors;
+                    return false;
+                }
+                if (result == ws::FrameParser::CONTROL) {
+                    if (con.parser.opcode() == ws::CLOSE) return false;
+                    continue;
+                }
+                type = con.parser.opcode() == ws::BINARY ? 2 : 0;
+                payload = con.parser.payload();
+                size = con.parser.payload_size();
+                if (type == 0) {
+                    // TEXT: 按 type 字段区分 start / end
+                    std::string text(reinterpret_cast<const char*>(payload), size);
+                    type = text.find("\"type\":\"start\"") != std::string::npos ? 1 : 3;
+                }
+            }
+            if (!on_message(fd, con, type, payload, size)) return false;
+        }
+        con.in.erase(0, pos);
+        return true;
+    }
+
+    bool on_message(int fd, Connection& con, uint8_t type, const uint8_t* payload, size_t size) {
+        std::string text = type == 2 ? std::string() : std::string(reinterpret_cast<const char*>(payload), size);
+        if (type == 1) {
+            if (con.in_segment) ++stats_.aborted;
+            con.in_segment = true;
+            con.segment_bytes = 0;
+            con.sample_rate = int_field(text, "sample_rate", 16000);
+            con.channels = int_field(text, "channels", 1);
+            con.segment_start = clock_type::now();
+            con.first_audio_pending = true;
+            if (verbose_) std::cout << "[" << fd << "] start " << text << std::endl;
+        } else if (type == 2) {
+            if (!con.in_segment) {
+                ++stats_.protocol_errors;
+                return false;
+            }
+            if (con.first_audio_pending) {
+                first_audio_ms_.push_back(
+                    std::chrono::duration<double, std::milli>(clock_type::now() - con.segment_start).count());
+                con.first_audio_pending = false;
+            }
+            con.segment_bytes += size;
+            stats_.audio_bytes += size;
+        } else if (type == 3) {
+            if (!con.in_segment) {
+                ++stats_.protocol_errors;
+                return false;
+            }
+            con.in_segment = false;
+            ++stats_.segments;
+            if (text.find("\"aborted\":true") != std::string::npos) ++stats_.aborted;
+            double sec = static_cast<double>(con.segment_bytes) / (2.0 * con.channels * con.sample_rate);
+            segment_audio_sec_.push_back(sec);
+            if (verbose_) std::cout << "[" << fd << "] end " << text << ", " << sec << " s" << std::endl;
+
+            std::string result = "{\"type\":\"result\",\"bytes\":" + std::to_string(con.segment_bytes) + "}";
+            std::string out;
+            if (con.protocol == Connection::Protocol::WEBSOCKET) {
+                ws::append_frame_header(out, ws::TEXT, result.size());
+            }
+            out += result;
+            send_all(fd, out);
+        } else {
+            ++stats_.protocol_errors;
+            return false;
+        }
+        return true;
+    }
+
+    static int int_field(const std::string& json, const char* key, int fallback) {
+        std::string pattern = std::string("\"") + key + "\":";
+        size_t pos = json.find(pattern);
+        return pos == std::string::npos ? fallback : std::atoi(json.c_str() + pos + pattern.size());
+    }
+
+    // 回包很小，写不下时直接丢弃 (替身不做流控)
+    static void send_all(int fd, const std::string& bytes) {
+        ssize_t n = ::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+        (void)n;
+    }
+
+    uint16_t port_;
+    bool verbose_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    std::unordered_map<int, Connection> connections_;
+    Stats stats_;
+    std::vector<double> segment_audio_sec_;
+    std::vector<double> first_audio_ms_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint16_t port = 9100;
+    bool verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " [--port N] [--verbose]\n"
+                      << "  --port N    listen port (default 9100)\n"
+                      << "  --verbose   print every segment's start/end message\n";
+            return 0;
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    Sink sink(port, verbose);
+    if (!sink.open()) return 1;
+    sink.run();
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "audio_decoder.h"
+#include <stdexcept>
+#include <string>
+
+#ifdef VAD_WITH_OPUS
+#include <opus/opus.h>
+#endif
+
+#ifdef VAD_WITH_SPEEX
+#include <speex/speex.h>
+#endif
+
+namespace {
+
+#ifdef VAD_WITH_OPUS
+// Opus 解码器: 每条消息一个 Opus 包，直接解码为引擎采样率的单声道
+class OpusAudioDecoder : public IAudioDecoder {
+public:
+    explicit OpusAudioDecoder(int sample_rate) : sample_rate_(sample_rate) {
+        int err = OPUS_OK;
+        dec_ = opus_decoder_create(sample_rate_, 1, &err);
+        if (err != OPUS_OK) {
+            throw std::runtime_error(std::string("opus_decoder_create failed: ") + opus_strerror(err));
+        }
+    }
+
+    ~OpusAudioDecoder() override {
+        opus_decoder_destroy(dec_);
+    }
+
+    bool decode(const uint8_t* data, size_t len, std::vector<uint8_t>& pcm_out) override {
+        // 单包最长 120ms
+        const int max_samples = sample_rate_ / 1000 * 120;
+        size_t offset = pcm_out.size();
+        pcm_out.resize(offset + max_samples * sizeof(int16_t));
+        // 空包视为丢包，交给 PLC 补偿
+        int n = opus_decode(dec_, len ? data : nullptr, static_cast<opus_int32>(len),
+                            reinterpret_cast<opus_int16*>(pcm_out.data() + offset), max_samples, 0);
+        if (n < 0) {
+            pcm_out.resize(offset);
+            return false;
+        }
+        pcm_out.resize(offset + n * sizeof(int16_t));
+        return true;
+    }
+
+    void reset() override {
+        opus_decoder_ctl(dec_, OPUS_RESET_STATE);
+    }
+
+private:
+    int sample_rate_;
+    OpusDecoder* dec_ = nullptr;
+};
+#endif
+
+#ifdef VAD_WITH_SPEEX
+// Speex 宽带解码器: 消息由若干个定长编码帧拼接而成，每帧解码出 20ms (320 个样本)
+class SpeexWbDecoder : public IAudioDecoder {
+public:
+    explicit SpeexWbDecoder(int frame_bytes) : frame_bytes_(frame_bytes) {
+        state_ = speex_decoder_init(speex_lib_get_mode(SPEEX_MODEID_WB));
+        speex_decoder_ctl(state_, SPEEX_GET_FRAME_SIZE, &frame_size_);
+        int enh = 1;
+        speex_decoder_ctl(state_, SPEEX_SET_ENH, &enh);
+        speex_bits_init(&bits_);
+    }
+
+    ~SpeexWbDecoder() override {
+        speex_bits_destroy(&bits_);
+        speex_decoder_destroy(state_);
+    }
+
+    bool decode(const uint8_t* data, size_t len, std::vector<uint8_t>& pcm_out) override {
+        size_t frames = len / frame_bytes_;
+        size_t offset = pcm_out.size();
+        pcm_out.resize(offset + frames * frame_size_ * sizeof(int16_t));
+        auto* out = reinterpret_cast<spx_int16_t*>(pcm_out.data() + offset);
+        for (size_t i = 0; i < frames; ++i) {
+            speex_bits_read_from(&bits_, reinterpret_cast<const char*>(data + i * frame_bytes_), frame_bytes_);
+            if (speex_decode_int(state_, &bits_, out + i * frame_size_) != 0) {
+                pcm_out.resize(offset + i * frame_size_ * sizeof(int16_t));
+                return false;
+            }
+        }
+        return len % frame_bytes_ == 0;
+    }
+
+    void reset() override {
+        speex_decoder_ctl(state_, SPEEX_RESET_STATE, nullptr);
+        speex_bits_reset(&bits_);
+    }
+
+private:
+    int frame_bytes_;
+    int frame_size_ = 320;
+    void* state_ = nullptr;
+    SpeexBits bits_;
+};
+#endif
+
+} // namespace
+
+bool DecoderPool::supports(AudioCodec codec) {
+    switch (codec) {
+    case AudioCodec::PCM:
+        return true;
+    case AudioCodec::OPUS:
+#ifdef VAD_WITH_OPUS
+        return true;
+#else
+        return false;
+#endif
+    case AudioCodec::SPEEX_WB:
+#ifdef VAD_WITH_SPEEX
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+DecoderPool::Key DecoderPool::key_of(const AudioFormat& format) {
+    int param = format.codec == AudioCodec::SPEEX_WB ? format.speex_frame_bytes : format.engine_sample_rate();
+    return Key(static_cast<int>(format.codec), param);
+}
+
+std::unique_ptr<IAudioDecoder> DecoderPool::create(const AudioFormat& format) {
+    switch (format.codec) {
+#ifdef VAD_WITH_OPUS
+    case AudioCodec::OPUS:
+        return std::make_unique<OpusAudioDecoder>(format.engine_sample_rate());
+#endif
+#ifdef VAD_WITH_SPEEX
+    case AudioCodec::SPEEX_WB:
+        return std::make_unique<SpeexWbDecoder>(format.speex_frame_bytes);
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+std::unique_ptr<IAudioDecoder> DecoderPool::acquire(const AudioFormat& format) {
+    if (format.codec == AudioCodec::PCM) return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = idle_.find(key_of(format));
+        if (it != idle_.end() && !it->second.empty()) {
+            std::unique_ptr<IAudioDecoder> dec = std::move(it->second.back());
+            it->second.pop_back();
+            return dec;
+        }
+    }
+    return create(format);
+}
+
+void DecoderPool::release(const AudioFormat& format, std::unique_ptr<IAudioDecoder> decoder) {
+    if (!decoder) return;
+    decoder->reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& idle = idle_[key_of(format)];
+    if (idle.size() < max_idle_) {
+        idle.push_back(std::move(decoder));
+    }
+}
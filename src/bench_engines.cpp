@@ -0,0 +1,461 @@
+// 引擎对比基准: 在带标注的语料上分别运行 SileroVadEngine 与 SherpaVadDetector，
+// 统计每秒音频的 CPU 耗时，以及 START_SPEAKING / END_SPEAKING 相对人工标注的检测延迟
+// "batch" 把语料中同采样率的所有文件当作并发会话，放进同一个 VadStateTable 逐块齐步推进，
+// 每一步把凑满窗口的会话合成一批推理，对比逐会话 (static/table) 的 CPU 开销
+//
+// 语料清单每行一个样本: "<wav 路径> [标注路径]"，标注缺省为把 .wav 换成 .lab
+// 标注文件每行一个语音段: "<开始秒> <结束秒>"，'#' 开头为注释
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "audio_format.h"
+#include "resampler.h"
+#include "sherpa_vad_detector.h"
+#include "static_vad_engine.h"
+#include "vad_engine.h"
+#include "vad_state_table.h"
+#include "wav.h"
+
+namespace {
+
+struct Segment {
+    double start;
+    double end;
+};
+
+struct CorpusItem {
+    std::string wav_path;
+    std::vector<Segment> labels;
+};
+
+struct BenchOptions {
+    std::string model_path = "../model/silero_vad.onnx";
+    std::string corpus_path;
+    std::vector<std::string> engines = {"silero", "sherpa"};
+    int chunk_ms = 20;        // 每次送入引擎的音频长度，对应客户端的发包粒度
+    float threshold = 0.5f;
+    int silero_window_ms = 32;
+    double match_tolerance = 0.5; // 允许 START 早于标注开始的最大秒数
+    bool verbose = false;
+};
+
+struct EngineStats {
+    double audio_sec = 0;
+    double cpu_sec = 0;
+    double wall_sec = 0;
+    size_t segments = 0;
+    size_t missed_begins = 0;
+    size_t missed_ends = 0;
+    size_t false_begins = 0;
+    std::vector<double> begin_lag_ms;
+    std::vector<double> end_lag_ms;
+};
+
+void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " --corpus LIST [options]\n"
+              << "  --corpus LIST        lines of \"<wav> [labels]\" (labels default to <wav stem>.lab)\n"
+              << "  --model PATH         silero model (default ../model/silero_vad.onnx)\n"
+              << "  --engines a,b        engines to run: silero, static, table, batch, sherpa (default silero,sherpa)\n"
+              << "  --chunk-ms N         audio fed per call (default 20)\n"
+              << "  --threshold F        speech probability threshold (default 0.5)\n"
+              << "  --silero-window-ms N SileroVadEngine window (default 32)\n"
+              << "  --tolerance S        max seconds a BEGIN may precede the label (default 0.5)\n"
+              << "  --verbose            print per-file results\n";
+}
+
+bool parse_args(int argc, char** argv, BenchOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") return false;
+        if (arg == "--verbose") {
+            opt.verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--corpus") {
+            opt.corpus_path = value;
+        } else if (arg == "--model") {
+            opt.model_path = value;
+        } else if (arg == "--engines") {
+            opt.engines.clear();
+            std::stringstream ss(value);
+            std::string name;
+            while (std::getline(ss, name, ',')) {
+                if (!name.empty()) opt.engines.push_back(name);
+            }
+        } else if (arg == "--chunk-ms") {
+            opt.chunk_ms = std::max(1, std::atoi(value));
+        } else if (arg == "--threshold") {
+            opt.threshold = static_cast<float>(std::atof(value));
+        } else if (arg == "--silero-window-ms") {
+            opt.silero_window_ms = std::atoi(value);
+        } else if (arg == "--tolerance") {
+            opt.match_tolerance = std::atof(value);
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return !opt.corpus_path.empty();
+}
+
+bool load_labels(const std::string& path, std::vector<Segment>& labels) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        Segment seg;
+        if (ls >> seg.start >> seg.end && seg.end > seg.start) labels.push_back(seg);
+    }
+    std::sort(labels.begin(), labels.end(), [](const Segment& a, const Segment& b) { return a.start < b.start; });
+    return true;
+}
+
+bool load_corpus(const std::string& path, std::vector<CorpusItem>& corpus) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        CorpusItem item;
+        std::string label_path;
+        ls >> item.wav_path >> label_path;
+        if (label_path.empty()) {
+            size_t dot = item.wav_path.rfind('.');
+            label_path = item.wav_path.substr(0, dot) + ".lab";
+        }
+        if (!load_labels(label_path, item.labels)) {
+            std::cerr << "Missing labels " << label_path << " for " << item.wav_path << std::endl;
+            continue;
+        }
+        corpus.push_back(std::move(item));
+    }
+    return true;
+}
+
+// 读取 WAV 并转换为引擎可用的单声道 (8k 原样保留，其余重采样到 16k，与 Session 的处理一致)
+bool load_audio(const std::string& path, std::vector<float>& mono, int& sample_rate) {
+    wav::WavReader reader;
+    if (!reader.Open(path) || reader.num_samples() <= 0) return false;
+    int channels = std::max(1, reader.num_channel());
+    const float* data = reader.data();
+    std::vector<float> downmix(reader.num_samples());
+    for (int i = 0; i < reader.num_samples(); ++i) {
+        float sum = 0;
+        for (int c = 0; c < channels; ++c) sum += data[i * channels + c];
+        downmix[i] = sum / channels;
+    }
+    AudioFormat format;
+    format.sample_rate = reader.sample_rate();
+    sample_rate = format.engine_sample_rate();
+    mono.clear();
+    if (format.needs_resample()) {
+        PolyphaseResampler resampler(format.sample_rate, sample_rate);
+        resampler.process(downmix.data(), downmix.size(), mono);
+    } else {
+        mono.swap(downmix);
+    }
+    return true;
+}
+
+double process_cpu_seconds() {
+    // 进程 CPU 时间，包含 ONNX Runtime 可能使用的内部线程
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::unique_ptr<IVadEngine> make_engine(const std::string& name, const BenchOptions& opt, int sample_rate) {
+    if (name == "silero") {
+        return std::unique_ptr<IVadEngine>(
+            new SileroVadEngine(opt.model_path, sample_rate, opt.silero_window_ms, opt.threshold));
+    }
+    if (name == "static") {
+        // 编译期特化版本只提供 32ms 窗口
+        return make_static_vad_engine(VadModel::get(), sample_rate, opt.threshold);
+    }
+    if (name == "table") {
+        // 容量为 1 的状态表，逐窗口 step，与 static 对比 SoA 布局本身的开销
+        if (sample_rate == 16000) {
+            using Geometry = VadGeometry<16000, 32>;
+            auto table = std::make_shared<VadStateTable<Geometry>>(VadModel::get(), 1, opt.threshold);
+            return std::unique_ptr<IVadEngine>(new TableVadEngine<Geometry>(table));
+        }
+        if (sample_rate == 8000) {
+            using Geometry = VadGeometry<8000, 32>;
+            auto table = std::make_shared<VadStateTable<Geometry>>(VadModel::get(), 1, opt.threshold);
+            return std::unique_ptr<IVadEngine>(new TableVadEngine<Geometry>(table));
+        }
+        return nullptr;
+    }
+    if (name == "sherpa") {
+        return std::unique_ptr<IVadEngine>(new SherpaVadDetector(opt.model_path, opt.threshold, sample_rate));
+    }
+    return nullptr;
+}
+
+// 把检测到的事件与标注段按时间顺序配对
+// 每个标注段取 [start - tolerance, end] 内的第一个 BEGIN，其后的第一个 END 作为该段的结束
+void score(const std::vector<Segment>& labels, const std::vector<double>& begins, const std::vector<double>& ends,
+           double tolerance, EngineStats& stats) {
+    size_t bi = 0;
+    size_t ei = 0;
+    size_t matched_begins = 0;
+    for (const Segment& seg : labels) {
+        ++stats.segments;
+        while (bi < begins.size() && begins[bi] < seg.start - tolerance) ++bi;
+        if (bi >= begins.size() || begins[bi] > seg.end) {
+            ++stats.missed_begins;
+            continue;
+        }
+        double begin = begins[bi++];
+        ++matched_begins;
+        stats.begin_lag_ms.push_back((begin - seg.start) * 1000.0);
+        // 同一段内多余的 BEGIN (语音段被切开) 不参与配对，计入误触发
+        while (bi < begins.size() && begins[bi] <= seg.end) ++bi;
+        while (ei < ends.size() && ends[ei] <= begin) ++ei;
+        if (ei >= ends.size()) {
+            ++stats.missed_ends;
+            continue;
+        }
+        stats.end_lag_ms.push_back((ends[ei++] - seg.end) * 1000.0);
+    }
+    stats.false_begins += begins.size() > matched_begins ? begins.size() - matched_begins : 0;
+}
+
+bool run_file(IVadEngine& engine, const std::vector<float>& audio, int sample_rate, const BenchOptions& opt,
+              std::vector<double>& begins, std::vector<double>& ends) {
+    engine.reset();
+    size_t chunk = static_cast<size_t>(sample_rate) * opt.chunk_ms / 1000;
+    if (chunk == 0) return false;
+    for (size_t pos = 0; pos < audio.size(); pos += chunk) {
+        size_t n = std::min(chunk, audio.size() - pos);
+        std::vector<float>& in = engine.input_buffer();
+        in.insert(in.end(), audio.begin() + pos, audio.begin() + pos + n);
+        VadResult r = engine.process_buffered();
+        // 事件时间取本块音频的末尾，即服务端最早能发出该事件的时刻
+        double t = static_cast<double>(pos + n) / sample_rate;
+        if (r.state == VadState::START_SPEAKING) begins.push_back(t);
+        if (r.state == VadState::END_SPEAKING) ends.push_back(t);
+    }
+    return true;
+}
+
+struct BatchItem {
+    const CorpusItem* item;
+    int sample_rate;
+    std::vector<float> audio;
+};
+
+// 所有文件作为并发会话齐步推进: 每轮每个会话送入 chunk_ms 音频，随后把凑满一个窗口的会话
+// 合成一批 step，直到本轮没有完整窗口；事件的判定与时间取法与 run_file + TableVadEngine 相同
+template <class Geometry>
+void run_batch(const std::vector<const BatchItem*>& items, const BenchOptions& opt, EngineStats& stats) {
+    const size_t n = items.size();
+    if (n == 0) return;
+    using Table = VadStateTable<Geometry>;
+    auto table = std::make_shared<Table>(VadModel::get(), n, opt.threshold);
+    std::vector<uint32_t> rows(n);
+    for (size_t i = 0; i < n; ++i) rows[i] = table->acquire();
+
+    const size_t chunk = static_cast<size_t>(Geometry::sample_rate) * opt.chunk_ms / 1000;
+    std::vector<std::vector<float>> pending(n);
+    std::vector<size_t> pos(n, 0), offset(n, 0);
+    std::vector<uint8_t> fed(n), state(n);
+    std::vector<std::vector<double>> begins(n), ends(n);
+    std::vector<uint32_t> batch_rows;
+    std::vector<const float*> windows;
+    std::vector<size_t> batch_index;
+    std::vector<uint8_t> transitions;
+
+    double cpu0 = process_cpu_seconds();
+    auto wall0 = std::chrono::steady_clock::now();
+    for (;;) {
+        bool active = false;
+        for (size_t i = 0; i < n; ++i) {
+            const std::vector<float>& audio = items[i]->audio;
+            fed[i] = pos[i] < audio.size();
+            if (!fed[i]) continue;
+            active = true;
+            size_t m = std::min(chunk, audio.size() - pos[i]);
+            pending[i].insert(pending[i].end(), audio.begin() + pos[i], audio.begin() + pos[i] + m);
+            pos[i] += m;
+            state[i] = Table::NONE;
+        }
+        if (!active) break;
+
+        for (;;) {
+            batch_rows.clear();
+            windows.clear();
+            batch_index.clear();
+            for (size_t i = 0; i < n; ++i) {
+                if (pending[i].size() - offset[i] < Geometry::window_samples) continue;
+                batch_rows.push_back(rows[i]);
+                windows.push_back(pending[i].data() + offset[i]);
+                batch_index.push_back(i);
+            }
+            if (batch_rows.empty()) break;
+            transitions.resize(batch_rows.size());
+            table->step(batch_rows.data(), windows.data(), batch_rows.size(), transitions.data());
+            for (size_t k = 0; k < batch_index.size(); ++k) {
+                size_t i = batch_index[k];
+                offset[i] += Geometry::window_samples;
+                if (transitions[k] != Table::NONE) {
+                    state[i] = transitions[k];
+                } else if (table->triggered(rows[i])) {
+                    state[i] = Table::NONE; // 与 process_buffered 一致: 后续的 SPEAKING 覆盖本块较早的跳变
+                }
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (!fed[i]) continue;
+            pending[i].erase(pending[i].begin(), pending[i].begin() + offset[i]);
+            offset[i] = 0;
+            double t = static_cast<double>(pos[i]) / Geometry::sample_rate;
+            if (state[i] == Table::START) begins[i].push_back(t);
+            if (state[i] == Table::END) ends[i].push_back(t);
+        }
+    }
+    stats.cpu_sec += process_cpu_seconds() - cpu0;
+    stats.wall_sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+
+    for (size_t i = 0; i < n; ++i) {
+        stats.audio_sec += static_cast<double>(items[i]->audio.size()) / Geometry::sample_rate;
+        score(items[i]->item->labels, begins[i], ends[i], opt.match_tolerance, stats);
+        if (opt.verbose) {
+            std::cout << items[i]->item->wav_path << " [batch] begins " << begins[i].size() << ", ends "
+                      << ends[i].size() << ", labels " << items[i]->item->labels.size() << std::endl;
+        }
+    }
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+double mean(const std::vector<double>& v) {
+    if (v.empty()) return 0;
+    double sum = 0;
+    for (double x : v) sum += x;
+    return sum / v.size();
+}
+
+void print_stats(const std::string& name, const EngineStats& s) {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "== " << name << "\n"
+              << "  audio " << s.audio_sec << " s, cpu " << s.cpu_sec << " s, wall " << s.wall_sec << " s\n"
+              << "  cpu per audio-second: " << (s.audio_sec > 0 ? s.cpu_sec * 1000.0 / s.audio_sec : 0) << " ms"
+              << " (" << (s.wall_sec > 0 ? s.audio_sec / s.wall_sec : 0) << "x realtime)\n"
+              << "  segments " << s.segments << ", missed begins " << s.missed_begins << ", missed ends "
+              << s.missed_ends << ", false begins " << s.false_begins << "\n"
+              << "  BEGIN lag ms: mean " << mean(s.begin_lag_ms) << ", p50 " << percentile(s.begin_lag_ms, 0.5)
+              << ", p90 " << percentile(s.begin_lag_ms, 0.9) << "\n"
+              << "  END lag ms:   mean " << mean(s.end_lag_ms) << ", p50 " << percentile(s.end_lag_ms, 0.5)
+              << ", p90 " << percentile(s.end_lag_ms, 0.9) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parse_args(argc, argv, opt)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    VadModelOptions model_options;
+    model_options.model_path = opt.model_path;
+    VadModel::configure(model_options);
+
+    std::vector<CorpusItem> corpus;
+    if (!load_corpus(opt.corpus_path, corpus) || corpus.empty()) {
+        std::cerr << "Empty or unreadable corpus " << opt.corpus_path << std::endl;
+        return 1;
+    }
+
+    std::vector<EngineStats> stats(opt.engines.size());
+    std::vector<float> audio;
+    bool batch = std::find(opt.engines.begin(), opt.engines.end(), "batch") != opt.engines.end();
+    std::vector<BatchItem> batch_items;
+    for (const CorpusItem& item : corpus) {
+        int sample_rate = 16000;
+        if (!load_audio(item.wav_path, audio, sample_rate)) {
+            std::cerr << "Cannot read " << item.wav_path << std::endl;
+            continue;
+        }
+        double audio_sec = static_cast<double>(audio.size()) / sample_rate;
+        if (batch) batch_items.push_back(BatchItem{&item, sample_rate, audio});
+
+        for (size_t e = 0; e < opt.engines.size(); ++e) {
+            if (opt.engines[e] == "batch") continue;
+            // 模型加载不计入耗时
+            std::unique_ptr<IVadEngine> engine = make_engine(opt.engines[e], opt, sample_rate);
+            if (!engine) {
+                std::cerr << "Unknown engine " << opt.engines[e] << std::endl;
+                return 1;
+            }
+            std::vector<double> begins, ends;
+            double cpu0 = process_cpu_seconds();
+            auto wall0 = std::chrono::steady_clock::now();
+            run_file(*engine, audio, sample_rate, opt, begins, ends);
+            double cpu = process_cpu_seconds() - cpu0;
+            double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+
+            EngineStats file_stats;
+            score(item.labels, begins, ends, opt.match_tolerance, file_stats);
+            EngineStats& s = stats[e];
+            s.audio_sec += audio_sec;
+            s.cpu_sec += cpu;
+            s.wall_sec += wall;
+            s.segments += file_stats.segments;
+            s.missed_begins += file_stats.missed_begins;
+            s.missed_ends += file_stats.missed_ends;
+            s.false_begins += file_stats.false_begins;
+            s.begin_lag_ms.insert(s.begin_lag_ms.end(), file_stats.begin_lag_ms.begin(), file_stats.begin_lag_ms.end());
+            s.end_lag_ms.insert(s.end_lag_ms.end(), file_stats.end_lag_ms.begin(), file_stats.end_lag_ms.end());
+
+            if (opt.verbose) {
+                std::cout << item.wav_path << " [" << opt.engines[e] << "] begins " << begins.size() << ", ends "
+                          << ends.size() << ", labels " << item.labels.size() << ", cpu " << cpu << " s"
+                          << std::endl;
+            }
+        }
+    }
+
+    // 批量模式在全部文件读完后按采样率分组运行
+    for (size_t e = 0; e < opt.engines.size(); ++e) {
+        if (opt.engines[e] != "batch") continue;
+        std::vector<const BatchItem*> items16k, items8k;
+        for (const BatchItem& b : batch_items) {
+            (b.sample_rate == 8000 ? items8k : items16k).push_back(&b);
+        }
+        run_batch<VadGeometry<16000, 32>>(items16k, opt, stats[e]);
+        run_batch<VadGeometry<8000, 32>>(items8k, opt, stats[e]);
+    }
+
+    std::cout << "chunk " << opt.chunk_ms << " ms, threshold " << opt.threshold << ", silero window "
+              << opt.silero_window_ms << " ms" << std::endl;
+    for (size_t e = 0; e < opt.engines.size(); ++e) {
+        print_stats(opt.engines[e], stats[e]);
+    }
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include "capture_log.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace capture {
+
+namespace {
+
+// 后台线程每隔 kFlushInterval 落盘一次；某个线程的积压达到 kThreadBufferBytes 时提前唤醒
+const size_t kFlushBytes = 1 << 20;
+const size_t kThreadBufferBytes = 256 << 10;
+const auto kFlushInterval = std::chrono::milliseconds(100);
+
+uint64_t next_writer_id() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+void put_u32(std::string& out, uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+bool get_string(const uint8_t*& p, const uint8_t* end, std::string& out) {
+    uint32_t len;
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(len))) return false;
+    std::memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (static_cast<size_t>(end - p) < len) return false;
+    out.assign(reinterpret_cast<const char*>(p), len);
+    p += len;
+    return true;
+}
+
+} // namespace
+
+Writer::Writer(const std::string& path, size_t max_pending_bytes)
+    : max_pending_bytes_(max_pending_bytes), start_(std::chrono::steady_clock::now()), id_(next_writer_id()) {
+    file_ = std::fopen(path.c_str(), "ab");
+    if (!file_) {
+        std::cerr << "Failed to open capture log " << path << std::endl;
+        return;
+    }
+    // 新文件写入文件头；追加到已有文件时沿用原文件头
+    std::fseek(file_, 0, SEEK_END);
+    if (std::ftell(file_) == 0) {
+        std::fwrite(kMagic, 1, sizeof(kMagic), file_);
+    }
+    // 每次运行以 RUN_START 开头，回放据此区分不同运行的会话键与时间基准
+    uint8_t run[kRunStartBytes] = {};
+    uint64_t unix_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    uint32_t pid = static_cast<uint32_t>(::getpid());
+    std::memcpy(run, &unix_us, 8);
+    std::memcpy(run + 8, &pid, 4);
+    RecordHeader header = {};
+    header.type = RUN_START;
+    header.length = sizeof(run);
+    std::fwrite(&header, 1, sizeof(header), file_);
+    std::fwrite(run, 1, sizeof(run), file_);
+    std::fflush(file_);
+    thread_ = std::thread(&Writer::writer_loop, this);
+}
+
+Writer::~Writer() {
+    if (!file_) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+    std::fclose(file_);
+    if (dropped_ > 0) {
+        std::cerr << "Capture log dropped " << dropped_ << " records (writer backlog)" << std::endl;
+    }
+}
+
+uint64_t Writer::now_ns() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+}
+
+Writer::ThreadBuffer* Writer::local_buffer() {
+    // 一个进程通常只有一个写入器，线程局部只缓存最近使用的那个
+    thread_local uint64_t cached_id = 0;
+    thread_local ThreadBuffer* cached = nullptr;
+    if (cached_id == id_) return cached;
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+    buffer->pending.reserve(kThreadBufferBytes);
+    cached = buffer.get();
+    cached_id = id_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(std::move(buffer));
+    return cached;
+}
+
+void Writer::session_open(uint64_t session, const std::string& uid, const AudioFormat& format) {
+    uint8_t fixed[kOpenFixedBytes] = {};
+    uint32_t rate = static_cast<uint32_t>(format.sample_rate);
+    uint16_t channels = static_cast<uint16_t>(format.channels);
+    uint32_t frame_bytes = static_cast<uint32_t>(format.speex_frame_bytes);
+    std::memcpy(fixed, &rate, 4);
+    std::memcpy(fixed + 4, &channels, 2);
+    fixed[6] = static_cast<uint8_t>(format.codec);
+    std::memcpy(fixed + 8, &frame_bytes, 4);
+    append(SESSION_OPEN, session, fixed, sizeof(fixed), uid.data(), uid.size());
+}
+
+void Writer::session_meta(uint64_t session, const std::string& uid, const std::string& connect_session,
+                          const std::string& current_session) {
+    std::string payload;
+    payload.reserve(12 + uid.size() + connect_session.size() + current_session.size());
+    for (const std::string* s : {&uid, &connect_session, &current_session}) {
+        put_u32(payload, static_cast<uint32_t>(s->size()));
+        payload += *s;
+    }
+    append(SESSION_META, session, payload.data(), payload.size());
+}
+
+void Writer::frame(uint64_t session, const uint8_t* data, size_t len) {
+    append(FRAME, session, data, len);
+}
+
+void Writer::session_close(uint64_t session) {
+    append(SESSION_CLOSE, session, nullptr, 0);
+}
+
+void Writer::append(RecordType type, uint64_t session, const void* a, size_t a_len, const void* b,
+                    size_t b_len) {
+    if (!file_) return;
+    size_t total = sizeof(uint64_t) + sizeof(RecordHeader) + a_len + b_len;
+    if (pending_bytes_.fetch_add(total, std::memory_order_relaxed) + total > max_pending_bytes_) {
+        pending_bytes_.fetch_sub(total, std::memory_order_relaxed);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ThreadBuffer* buffer = local_buffer();
+    RecordHeader header = {};
+    header.type = type;
+    header.length = static_cast<uint32_t>(a_len + b_len);
+    header.session = session;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        // 时间戳在锁内取: 同一缓冲区内单调，且后台线程取走缓冲区时不会漏掉早于截止点的记录
+        uint64_t ns = now_ns();
+        header.timestamp_us = ns / 1000;
+        std::vector<uint8_t>& out = buffer->pending;
+        const uint8_t* k = reinterpret_cast<const uint8_t*>(&ns);
+        const uint8_t* h = reinterpret_cast<const uint8_t*>(&header);
+        out.insert(out.end(), k, k + sizeof(ns));
+        out.insert(out.end(), h, h + sizeof(header));
+        if (a_len) out.insert(out.end(), static_cast<const uint8_t*>(a), static_cast<const uint8_t*>(a) + a_len);
+        if (b_len) out.insert(out.end(), static_cast<const uint8_t*>(b), static_cast<const uint8_t*>(b) + b_len);
+        wake = out.size() >= kThreadBufferBytes;
+    }
+    if (wake) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flush_requested_ = true;
+        }
+        cond_.notify_one();
+    }
+}
+
+void Writer::flush_round(uint64_t cutoff_ns, std::vector<uint8_t>& batch) {
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers.reserve(buffers_.size());
+        for (const auto& buffer : buffers_) buffers.push_back(buffer.get());
+    }
+    // 取走各线程的积压，接在上一轮剩下的记录后面
+    for (ThreadBuffer* buffer : buffers) {
+        if (buffer->offset > 0) {
+            buffer->carry.erase(buffer->carry.begin(), buffer->carry.begin() + buffer->offset);
+            buffer->offset = 0;
+        }
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->carry.empty()) {
+            buffer->carry.swap(buffer->pending);
+        } else {
+            buffer->carry.insert(buffer->carry.end(), buffer->pending.begin(), buffer->pending.end());
+            buffer->pending.clear();
+        }
+    }
+    // 多路归并: 每次取时间戳最小的记录；只输出早于截止点的，晚于截止点的记录可能还有因果上更早的
+    // 记录没被取到 (对应线程在截止点之后才写入)，留到下一轮
+    size_t released = 0;
+    for (;;) {
+        ThreadBuffer* best = nullptr;
+        uint64_t best_ns = cutoff_ns;
+        for (ThreadBuffer* buffer : buffers) {
+            if (buffer->offset >= buffer->carry.size()) continue;
+            uint64_t ns;
+            std::memcpy(&ns, buffer->carry.data() + buffer->offset, sizeof(ns));
+            if (ns < best_ns) {
+                best_ns = ns;
+                best = buffer;
+            }
+        }
+        if (!best) break;
+        const uint8_t* p = best->carry.data() + best->offset;
+        RecordHeader header;
+        std::memcpy(&header, p + sizeof(uint64_t), sizeof(header));
+        size_t record = sizeof(header) + header.length;
+        batch.insert(batch.end(), p + sizeof(uint64_t), p + sizeof(uint64_t) + record);
+        best->offset += sizeof(uint64_t) + record;
+        released += sizeof(uint64_t) + record;
+    }
+    if (!batch.empty()) {
+        std::fwrite(batch.data(), 1, batch.size(), file_);
+        std::fflush(file_);
+        batch.clear();
+    }
+    pending_bytes_.fetch_sub(released, std::memory_order_relaxed);
+}
+
+void Writer::writer_loop() {
+    std::vector<uint8_t> batch;
+    batch.reserve(kFlushBytes);
+    for (;;) {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, kFlushInterval, [this] { return stopping_ || flush_requested_; });
+            flush_requested_ = false;
+            stop = stopping_;
+        }
+        // 截止点在取缓冲区之前确定；停止时所有写入方都已退出，全部输出
+        uint64_t cutoff = stop ? UINT64_MAX : now_ns();
+        flush_round(cutoff, batch);
+        if (stop) return;
+    }
+}
+
+Reader::Reader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(kMagic))) {
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            if (std::memcmp(p, kMagic, sizeof(kMagic)) == 0) {
+                data_ = static_cast<const uint8_t*>(p);
+                size_ = static_cast<size_t>(st.st_size);
+                offset_ = sizeof(kMagic);
+                // 回放按顺序扫描整个文件
+                ::madvise(p, size_, MADV_SEQUENTIAL);
+            } else {
+                ::munmap(p, static_cast<size_t>(st.st_size));
+            }
+        }
+    }
+    ::close(fd);
+}
+
+Reader::~Reader() {
+    if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+bool Reader::next(Record& record) {
+    if (!data_ || size_ - offset_ < sizeof(RecordHeader)) return false;
+    std::memcpy(&record.header, data_ + offset_, sizeof(RecordHeader));
+    size_t payload_offset = offset_ + sizeof(RecordHeader);
+    if (size_ - payload_offset < record.header.length) return false;
+    record.payload = data_ + payload_offset;
+    offset_ = payload_offset + record.header.length;
+    return true;
+}
+
+bool Reader::parse_open(const Record& record, AudioFormat& format, std::string& uid) {
+    if (record.header.type != SESSION_OPEN || record.header.length < kOpenFixedBytes) return false;
+    const uint8_t* p = record.payload;
+    uint32_t rate;
+    uint16_t channels;
+    uint32_t frame_bytes;
+    std::memcpy(&rate, p, 4);
+    std::memcpy(&channels, p + 4, 2);
+    std::memcpy(&frame_bytes, p + 8, 4);
+    format = AudioFormat();
+    format.sample_rate = static_cast<int>(rate);
+    format.channels = channels;
+    format.codec = static_cast<AudioCodec>(p[6]);
+    format.speex_frame_bytes = static_cast<int>(frame_bytes);
+    uid.assign(reinterpret_cast<const char*>(p + kOpenFixedBytes), record.header.length - kOpenFixedBytes);
+    return true;
+}
+
+bool Reader::parse_run_start(const Record& record, uint64_t& unix_us, uint32_t& pid) {
+    if (record.header.type != RUN_START || record.header.length < kRunStartBytes) return false;
+    std::memcpy(&unix_us, record.payload, 8);
+    std::memcpy(&pid, record.payload + 8, 4);
+    return true;
+}
+
+bool Reader::parse_meta(const Record& record, std::string& uid, std::string& connect_session,
+                        std::string& current_session) {
+    if (record.header.type != SESSION_META) return false;
+    const uint8_t* p = record.payload;
+    const uint8_t* end = p + record.header.length;
+    return get_string(p, end, uid) && get_string(p, end, connect_session) && get_string(p, end, current_session);
+}
+
+} // namespace capture
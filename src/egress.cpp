@@ -0,0 +1,134 @@
+#include "egress.h"
+#include <iostream>
+#include <algorithm>
+
+namespace {
+
+// 初始 payload 容量，覆盖大多数 SPEAKING/SILENCE 消息
+const size_t kInitialPayloadCapacity = 4096;
+
+} // namespace
+
+void Egress::Recycler::operator()(server::message_type* msg) const {
+    // shared_ptr 的引用计数保证此时没有其他持有者: 所有权在这里明确交还给池
+    {
+        std::lock_guard<std::mutex> lock(free->mutex);
+        if (free->messages.size() < free->capacity) {
+            free->messages.push_back(msg);
+            return;
+        }
+    }
+    delete msg;
+}
+
+Egress::Egress(server& srv, size_t pool_size) : srv_(srv), free_(std::make_shared<FreeList>()) {
+    free_->capacity = pool_size;
+    free_->messages.reserve(pool_size);
+}
+
+Egress::~Egress() {
+    std::vector<server::message_type*> messages;
+    {
+        std::lock_guard<std::mutex> lock(free_->mutex);
+        free_->capacity = 0;
+        messages.swap(free_->messages);
+    }
+    for (server::message_type* msg : messages) delete msg;
+}
+
+server::message_ptr Egress::acquire() {
+    server::message_type* msg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(free_->mutex);
+        if (!free_->messages.empty()) {
+            msg = free_->messages.back();
+            free_->messages.pop_back();
+        }
+    }
+    if (msg) {
+        msg->get_raw_payload().clear();
+        msg->set_header("");
+        msg->set_prepared(false);
+        msg->set_opcode(websocketpp::frame::opcode::text);
+    } else {
+        msg = new server::message_type(server::message_type::con_msg_man_ptr(), websocketpp::frame::opcode::text,
+                                       kInitialPayloadCapacity);
+    }
+    return server::message_ptr(msg, Recycler{free_});
+}
+
+void Egress::prepare_text_frame(const server::message_ptr& msg) {
+    // RFC 6455 服务端帧: FIN + opcode，不加掩码
+    const std::string& payload = msg->get_payload();
+    uint64_t len = payload.size();
+    char header[10];
+    size_t header_len = 2;
+    header[0] = static_cast<char>(0x80 | websocketpp::frame::opcode::text);
+    if (len < 126) {
+        header[1] = static_cast<char>(len);
+    } else if (len <= 0xFFFF) {
+        header[1] = 126;
+        header[2] = static_cast<char>((len >> 8) & 0xFF);
+        header[3] = static_cast<char>(len & 0xFF);
+        header_len = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; ++i) {
+            header[2 + i] = static_cast<char>((len >> (56 - 8 * i)) & 0xFF);
+        }
+        header_len = 10;
+    }
+    msg->set_header(std::string(header, header_len));
+    msg->set_prepared(true);
+}
+
+void Egress::send(connection_hdl hdl, server::message_ptr msg) {
+    server::connection_ptr con;
+    try {
+        con = srv_.get_con_from_hdl(hdl);
+    } catch (websocketpp::exception const &) {
+        return; // 连接已关闭
+    }
+    if (!msg->get_prepared()) {
+        prepare_text_frame(msg);
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(con->egress_mutex);
+        con->egress_pending.push_back(std::move(msg));
+        if (!con->egress_scheduled) {
+            con->egress_scheduled = true;
+            schedule = true;
+        }
+    }
+    // 已有一次投递在途时只追加，不重复投递；在途的 flush 会把新消息一起带走
+    if (schedule) {
+        // 经连接的 strand 投递，flush 不会与该连接的 open/message/close 回调并发
+        server::connection_type::strand_ptr strand = con->get_strand();
+        if (strand) {
+            strand->post([this, con] { flush(con); });
+        } else {
+            srv_.get_io_service().post([this, con] { flush(con); });
+        }
+    }
+}
+
+void Egress::flush(server::connection_ptr con) {
+    std::vector<server::message_ptr> batch;
+    {
+        std::lock_guard<std::mutex> lock(con->egress_mutex);
+        batch.swap(con->egress_pending);
+        con->egress_scheduled = false;
+    }
+    flushes_.fetch_add(1, std::memory_order_relaxed);
+    messages_.fetch_add(batch.size(), std::memory_order_relaxed);
+    // 连续 send 的消息进入 websocketpp 的发送队列，由同一次 async_write 聚合写出
+    for (auto& msg : batch) {
+        websocketpp::lib::error_code ec = con->send(msg);
+        if (ec) {
+            std::cout << "Send failed: " << ec.message() << std::endl;
+            break;
+        }
+    }
+}
@@ -0,0 +1,359 @@
+#include "json_audio_parser.h"
+#include <cstring>
+#include "base64.h"
+
+namespace {
+
+// 与 nlohmann 默认的最大嵌套深度相当，防止恶意深层嵌套耗尽栈
+const int kMaxDepth = 512;
+
+class Scanner {
+public:
+    Scanner(const char* p, size_t n) : p_(p), end_(p + n) {}
+
+    bool parse(AudioMessageFields& fields, std::vector<uint8_t>& audio_out) {
+        skip_ws();
+        if (!consume('{')) {
+            // 合法但不是对象: 没有可提取的字段
+            if (!skip_value(1)) return false;
+            skip_ws();
+            return p_ == end_;
+        }
+        skip_ws();
+        if (!consume('}')) {
+            for (;;) {
+                const char* key;
+                size_t key_len;
+                bool key_escaped;
+                if (!scan_string(key, key_len, key_escaped)) return false;
+                skip_ws();
+                if (!consume(':')) return false;
+                skip_ws();
+
+                if (key_is(key, key_len, key_escaped, "uid")) {
+                    if (!read_string(fields.uid)) return false;
+                } else if (key_is(key, key_len, key_escaped, "connect_session")) {
+                    if (!read_string(fields.connect_session)) return false;
+                } else if (key_is(key, key_len, key_escaped, "current_session")) {
+                    if (!read_string(fields.current_session)) return false;
+                } else if (key_is(key, key_len, key_escaped, "data") && peek() == '{') {
+                    if (!parse_data(fields, audio_out)) return false;
+                } else {
+                    if (!skip_value(1)) return false;
+                }
+
+                skip_ws();
+                if (consume(',')) {
+                    skip_ws();
+                    continue;
+                }
+                if (consume('}')) break;
+                return false;
+            }
+        }
+        skip_ws();
+        return p_ == end_;
+    }
+
+private:
+    // data 对象: 只取 audio，其余跳过
+    bool parse_data(AudioMessageFields& fields, std::vector<uint8_t>& audio_out) {
+        consume('{');
+        skip_ws();
+        if (consume('}')) return true;
+        for (;;) {
+            const char* key;
+            size_t key_len;
+            bool key_escaped;
+            if (!scan_string(key, key_len, key_escaped)) return false;
+            skip_ws();
+            if (!consume(':')) return false;
+            skip_ws();
+
+            if (key_is(key, key_len, key_escaped, "audio")) {
+                const char* val;
+                size_t val_len;
+                bool escaped;
+                if (!scan_string(val, val_len, escaped)) return false;
+                // 重复键以最后一个为准 (与 DOM 解析一致)
+                audio_out.clear();
+                if (!escaped) {
+                    // 常见情形: base64 不含转义，直接从负载内存解码
+                    base64::decode_append(val, val_len, audio_out);
+                } else {
+                    std::string unescaped;
+                    if (!unescape(val, val_len, unescaped)) return false;
+                    base64::decode_append(unescaped.data(), unescaped.size(), audio_out);
+                }
+                fields.has_audio = true;
+            } else {
+                if (!skip_value(2)) return false;
+            }
+
+            skip_ws();
+            if (consume(',')) {
+                skip_ws();
+                continue;
+            }
+            if (consume('}')) return true;
+            return false;
+        }
+    }
+
+    char peek() const { return p_ < end_ ? *p_ : '\0'; }
+
+    bool consume(char c) {
+        if (p_ < end_ && *p_ == c) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    void skip_ws() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) ++p_;
+    }
+
+    static bool key_is(const char* key, size_t len, bool escaped, const char* name) {
+        if (escaped) {
+            std::string k;
+            return unescape(key, len, k) && k == name;
+        }
+        return len == std::strlen(name) && std::memcmp(key, name, len) == 0;
+    }
+
+    // 定位字符串内容 [out, out + len)，不做反转义；escaped 表示其中含有 '\'
+    bool scan_string(const char*& out, size_t& len, bool& escaped) {
+        if (!consume('"')) return false;
+        const char* start = p_;
+        escaped = false;
+        while (p_ < end_) {
+            unsigned char c = static_cast<unsigned char>(*p_);
+            if (c == '"') {
+                out = start;
+                len = static_cast<size_t>(p_ - start);
+                ++p_;
+                return true;
+            }
+            if (c < 0x20) return false;
+            if (c >= 0x80) {
+                if (!skip_utf8()) return false;
+                continue;
+            }
+            if (c == '\\') {
+                escaped = true;
+                if (++p_ >= end_) return false;
+                char e = *p_;
+                if (e == 'u') {
+                    if (end_ - p_ < 5) return false;
+                    for (int i = 1; i <= 4; ++i) {
+                        if (!is_hex(p_[i])) return false;
+                    }
+                    p_ += 4;
+                } else if (!std::strchr("\"\\/bfnrt", e) || e == '\0') {
+                    return false;
+                }
+            }
+            ++p_;
+        }
+        return false;
+    }
+
+    // 校验一个多字节 UTF-8 序列 (RFC 3629: 拒绝超长编码与代理区)，成功时越过该序列
+    bool skip_utf8() {
+        unsigned char c = static_cast<unsigned char>(*p_);
+        int n;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            n = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 2;
+            if (c == 0xE0) lo = 0xA0;
+            if (c == 0xED) hi = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 3;
+            if (c == 0xF0) lo = 0x90;
+            if (c == 0xF4) hi = 0x8F;
+        } else {
+            return false;
+        }
+        if (end_ - p_ <= n) return false;
+        for (int i = 1; i <= n; ++i) {
+            unsigned char b = static_cast<unsigned char>(p_[i]);
+            if (b < lo || b > hi) return false;
+            lo = 0x80;
+            hi = 0xBF;
+        }
+        p_ += n + 1;
+        return true;
+    }
+
+    bool read_string(std::string& out) {
+        const char* s;
+        size_t len;
+        bool escaped;
+        if (!scan_string(s, len, escaped)) return false;
+        if (!escaped) {
+            out.assign(s, len);
+            return true;
+        }
+        out.clear();
+        return unescape(s, len, out);
+    }
+
+    static bool is_hex(char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    static unsigned hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return c - 'A' + 10;
+    }
+
+    static void append_utf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // 内容已由 scan_string 校验过转义格式
+    static bool unescape(const char* s, size_t len, std::string& out) {
+        out.reserve(out.size() + len);
+        for (size_t i = 0; i < len; ++i) {
+            if (s[i] != '\\') {
+                out += s[i];
+                continue;
+            }
+            char e = s[++i];
+            switch (e) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp = 0;
+                for (int k = 1; k <= 4; ++k) cp = (cp << 4) | hex_value(s[i + k]);
+                i += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // 代理对: 必须紧跟低位代理
+                    if (i + 6 >= len || s[i + 1] != '\\' || s[i + 2] != 'u') return false;
+                    uint32_t lo = 0;
+                    for (int k = 3; k <= 6; ++k) lo = (lo << 4) | hex_value(s[i + k]);
+                    if (lo < 0xDC00 || lo > 0xDFFF) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 6;
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return false;
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default: out += e; break; // '"' '\\' '/'
+            }
+        }
+        return true;
+    }
+
+    bool skip_value(int depth) {
+        if (depth > kMaxDepth) return false;
+        char c = peek();
+        if (c == '"') {
+            const char* s;
+            size_t len;
+            bool escaped;
+            return scan_string(s, len, escaped);
+        }
+        if (c == '{') {
+            ++p_;
+            skip_ws();
+            if (consume('}')) return true;
+            for (;;) {
+                const char* s;
+                size_t len;
+                bool escaped;
+                if (!scan_string(s, len, escaped)) return false;
+                skip_ws();
+                if (!consume(':')) return false;
+                skip_ws();
+                if (!skip_value(depth + 1)) return false;
+                skip_ws();
+                if (consume(',')) {
+                    skip_ws();
+                    continue;
+                }
+                return consume('}');
+            }
+        }
+        if (c == '[') {
+            ++p_;
+            skip_ws();
+            if (consume(']')) return true;
+            for (;;) {
+                if (!skip_value(depth + 1)) return false;
+                skip_ws();
+                if (consume(',')) {
+                    skip_ws();
+                    continue;
+                }
+                return consume(']');
+            }
+        }
+        if (c == 't') return skip_literal("true");
+        if (c == 'f') return skip_literal("false");
+        if (c == 'n') return skip_literal("null");
+        return skip_number();
+    }
+
+    bool skip_literal(const char* lit) {
+        size_t n = std::strlen(lit);
+        if (static_cast<size_t>(end_ - p_) < n || std::memcmp(p_, lit, n) != 0) return false;
+        p_ += n;
+        return true;
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool skip_number() {
+        consume('-');
+        if (consume('0')) {
+        } else if (peek() >= '1' && peek() <= '9') {
+            while (peek() >= '0' && peek() <= '9') ++p_;
+        } else {
+            return false;
+        }
+        if (consume('.')) {
+            if (!(peek() >= '0' && peek() <= '9')) return false;
+            while (peek() >= '0' && peek() <= '9') ++p_;
+        }
+        if (peek() == 'e' || peek() == 'E') {
+            ++p_;
+            if (peek() == '+' || peek() == '-') ++p_;
+            if (!(peek() >= '0' && peek() <= '9')) return false;
+            while (peek() >= '0' && peek() <= '9') ++p_;
+        }
+        return true;
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+} // namespace
+
+bool parse_audio_message(const char* json, size_t len, AudioMessageFields& fields, std::vector<uint8_t>& audio_out) {
+    Scanner scanner(json, len);
+    return scanner.parse(fields, audio_out);
+}
@@ -0,0 +1,515 @@
+// 负载生成器: 模拟大量实时音频流，对比不同传输后端 (--transport) 的连接与响应开销
+//
+// 每个连接完成 WebSocket 握手后按实时速度发送二进制 PCM 帧 (默认 16kHz 单声道 20ms)，
+// 各连接的发送相位在一个帧间隔内均匀错开。每个线程用一个 epoll 循环驱动自己的连接。
+// 统计: 握手延迟、发送滞后 (实际发送时刻相对计划时刻)、收到的 VAD 事件数与
+// 响应延迟 (事件到达时刻减去该连接最近一帧的发送时刻)。
+// --shm PATH 改用共享内存接入: 每个流经 ShmProducer 打开，帧直接写进音频环，事件从事件环读回
+// (握手延迟即打开流的耗时，写满的帧计入 blocked writes 并丢弃)。
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shm_producer.h"
+#include "ws_protocol.h"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 9002;
+    size_t connections = 100;
+    size_t threads = 1;
+    double duration_sec = 30;
+    int sample_rate = 16000;
+    int frame_ms = 20;
+    // 建立全部连接所用的时间 (均匀分布)，避免同一时刻涌入
+    double ramp_sec = 1;
+    std::string pcm_path; // 16 位单声道 PCM，循环发送；为空时合成 (语音段与静音交替)
+    std::string shm_path; // 非空时经共享内存接入的 Unix 套接字发送，而不是 WebSocket
+};
+
+struct Stats {
+    uint64_t connected = 0;
+    uint64_t failed = 0;
+    uint64_t closed_by_server = 0;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t blocked_writes = 0; // 套接字写满 (服务端读取跟不上)
+    uint64_t responses = 0;
+    std::vector<double> handshake_ms;
+    std::vector<double> send_lag_ms;
+    std::vector<double> response_ms;
+};
+
+struct Client {
+    int fd = -1;
+    enum class State { CONNECTING, HANDSHAKE, STREAMING, DONE } state = State::CONNECTING;
+    clock_type::time_point connect_start;
+    clock_type::time_point next_frame;
+    clock_type::time_point last_frame_sent;
+    size_t pcm_offset = 0;
+    std::string out;
+    std::string in;
+    std::unique_ptr<ShmProducer> shm;
+};
+
+// 共享内存模式下控制套接字的 epoll 标记 (事件环 eventfd 只用连接序号)
+const uint64_t kShmSocketTag = 1ull << 63;
+
+void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]\n"
+              << "  --host ADDR        server IPv4 address (default 127.0.0.1)\n"
+              << "  --port N           server port (default 9002)\n"
+              << "  --connections N    concurrent streams (default 100)\n"
+              << "  --threads N        client threads, each runs an epoll loop (default 1)\n"
+              << "  --duration SEC     streaming time after the ramp (default 30)\n"
+              << "  --ramp SEC         spread connection setup over SEC seconds (default 1)\n"
+              << "  --sample-rate N    PCM sample rate announced to the server (default 16000)\n"
+              << "  --frame-ms N       audio per frame (default 20)\n"
+              << "  --pcm FILE         16-bit mono PCM to loop (default: synthetic speech/silence)\n"
+              << "  --shm PATH         stream over the server's shared-memory ingress socket instead of WebSocket\n";
+}
+
+// 合成音频: 1 秒带谐波的"语音"与 1 秒静音交替，让 VAD 持续产生状态跳变
+std::vector<int16_t> synth_pcm(int sample_rate) {
+    std::vector<int16_t> pcm(static_cast<size_t>(sample_rate) * 2, 0);
+    const double kPi = 3.14159265358979323846;
+    for (int i = 0; i < sample_rate; ++i) {
+        double t = static_cast<double>(i) / sample_rate;
+        double v = 0.4 * std::sin(2 * kPi * 180 * t) + 0.25 * std::sin(2 * kPi * 360 * t) +
+                   0.15 * std::sin(2 * kPi * 720 * t);
+        v *= 0.5 + 0.5 * std::sin(2 * kPi * 4 * t);
+        pcm[i] = static_cast<int16_t>(v * 12000);
+    }
+    return pcm;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+double ms_between(clock_type::time_point from, clock_type::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+class Worker {
+public:
+    Worker(const Options& options, const std::vector<int16_t>& pcm, size_t first, size_t count, size_t total)
+        : opt_(options), pcm_(pcm), first_(first), count_(count), total_(total), clients_(count) {}
+
+    void run(clock_type::time_point start, clock_type::time_point stop) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        frame_samples_ = static_cast<size_t>(opt_.sample_rate) * opt_.frame_ms / 1000;
+        auto frame_interval = std::chrono::microseconds(opt_.frame_ms * 1000);
+        auto ramp = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(opt_.ramp_sec));
+        std::mt19937 rng(static_cast<uint32_t>(first_ + 1));
+
+        size_t next_connect = 0;
+        epoll_event events[256];
+        for (;;) {
+            auto now = clock_type::now();
+            if (now >= stop) break;
+
+            // 按 ramp 均匀发起连接
+            while (next_connect < count_) {
+                if (connect_due(start, ramp, next_connect) > now) break;
+                connect_client(next_connect, now);
+                ++next_connect;
+            }
+
+            // 到期的连接发送下一帧
+            auto wake = stop;
+            if (next_connect < count_) {
+                wake = std::min(wake, connect_due(start, ramp, next_connect));
+            }
+            for (size_t i = 0; i < next_connect; ++i) {
+                Client& c = clients_[i];
+                if (c.state != Client::State::STREAMING) continue;
+                while (c.next_frame <= now) {
+                    // 发送滞后每 8 帧采样一次，上万连接长时间运行时样本也不会太多
+                    if ((stats_.frames & 7) == 0) stats_.send_lag_ms.push_back(ms_between(c.next_frame, now));
+                    send_frame(c, rng());
+                    c.last_frame_sent = now;
+                    c.next_frame += frame_interval;
+                }
+                flush(c);
+                wake = std::min(wake, c.next_frame);
+            }
+
+            int timeout_ms = static_cast<int>(std::ceil(ms_between(clock_type::now(), wake)));
+            int n = epoll_wait(epoll_fd_, events, 256, std::max(0, timeout_ms));
+            for (int i = 0; i < n; ++i) {
+                Client& c = clients_[events[i].data.u64 & ~kShmSocketTag];
+                if (c.state == Client::State::DONE) continue; // 同一批里更早的事件已关闭该连接
+                if (c.shm) {
+                    if (events[i].data.u64 & kShmSocketTag) {
+                        ++stats_.closed_by_server;
+                        close_client(c);
+                    } else {
+                        read_shm_events(c);
+                    }
+                } else if (c.state == Client::State::CONNECTING) {
+                    on_connected(c, events[i].events);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    read_client(c);
+                }
+            }
+        }
+        for (Client& c : clients_) {
+            if (c.fd >= 0) ::close(c.fd);
+        }
+        ::close(epoll_fd_);
+    }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // 第 index 个连接 (全局序号 first_ + index) 的发起时刻
+    clock_type::time_point connect_due(clock_type::time_point start, clock_type::duration ramp, size_t index) const {
+        auto offset = ramp * static_cast<int64_t>(first_ + index) / static_cast<int64_t>(std::max<size_t>(1, total_));
+        return start + offset;
+    }
+
+    void connect_client(size_t index, clock_type::time_point now) {
+        Client& c = clients_[index];
+        if (!opt_.shm_path.empty()) {
+            connect_shm(c, index, now);
+            return;
+        }
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(opt_.port);
+        inet_pton(AF_INET, opt_.host.c_str(), &addr.sin_addr);
+        c.connect_start = now;
+        if (connect(c.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            fail(c);
+            return;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLOUT | EPOLLIN;
+        ev.data.u64 = index;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+
+    void connect_shm(Client& c, size_t index, clock_type::time_point now) {
+        c.shm.reset(new ShmProducer());
+        if (!c.shm->open(opt_.shm_path, "/?sample_rate=" + std::to_string(opt_.sample_rate) + "&channels=1")) {
+            fail(c);
+            return;
+        }
+        auto opened = clock_type::now();
+        stats_.handshake_ms.push_back(ms_between(now, opened));
+        ++stats_.connected;
+        c.state = Client::State::STREAMING;
+        start_streaming(c, opened);
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = index;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, c.shm->event_fd(), &ev);
+        ev.events = EPOLLRDHUP;
+        ev.data.u64 = index | kShmSocketTag;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, c.shm->socket_fd(), &ev);
+    }
+
+    // 发送相位在帧间隔内按连接序号错开
+    void start_streaming(Client& c, clock_type::time_point now) {
+        auto phase = std::chrono::microseconds(opt_.frame_ms * 1000) * ((&c - clients_.data()) % 64) / 64;
+        c.next_frame = now + phase;
+        c.last_frame_sent = now;
+    }
+
+    void on_connected(Client& c, uint32_t events) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (events & EPOLLERR)) {
+            fail(c);
+            return;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = static_cast<uint64_t>(&c - clients_.data());
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+        c.state = Client::State::HANDSHAKE;
+        c.out = "GET /?sample_rate=" + std::to_string(opt_.sample_rate) +
+                "&channels=1 HTTP/1.1\r\n"
+                "Host: " + opt_.host + "\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: Upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                "Sec-WebSocket-Version: 13\r\n\r\n";
+        flush(c);
+    }
+
+    void send_frame(Client& c, uint32_t mask) {
+        size_t samples = frame_samples_;
+        uint8_t* frame = nullptr;
+        if (c.shm) {
+            // 直接填进音频环
+            frame = c.shm->reserve(samples * 2);
+            if (!frame) {
+                ++stats_.blocked_writes;
+                return;
+            }
+        } else {
+            frame_buf_.resize(samples * 2);
+            frame = frame_buf_.data();
+        }
+        // 帧跨越 PCM 末尾时分两段拷贝
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(pcm_.data());
+        for (size_t done = 0; done < samples;) {
+            size_t take = std::min(samples - done, pcm_.size() - c.pcm_offset);
+            std::memcpy(frame + done * 2, base + c.pcm_offset * 2, take * 2);
+            done += take;
+            c.pcm_offset = (c.pcm_offset + take) % pcm_.size();
+        }
+        if (c.shm) {
+            c.shm->commit();
+        } else {
+            ws::append_client_frame(c.out, ws::BINARY, frame, samples * 2, mask);
+        }
+        ++stats_.frames;
+        stats_.bytes += samples * 2;
+    }
+
+    void read_shm_events(Client& c) {
+        auto now = clock_type::now();
+        std::string event;
+        do {
+            while (c.shm->read_event(event)) {
+                ++stats_.responses;
+                stats_.response_ms.push_back(ms_between(c.last_frame_sent, now));
+            }
+        } while (!c.shm->prepare_wait());
+    }
+
+    void flush(Client& c) {
+        while (!c.out.empty()) {
+            ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                c.out.erase(0, static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                ++stats_.blocked_writes;
+                return;
+            }
+            fail(c);
+            return;
+        }
+    }
+
+    void read_client(Client& c) {
+        char buf[16384];
+        for (;;) {
+            ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                c.in.append(buf, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(buf)) break;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (c.state == Client::State::STREAMING) ++stats_.closed_by_server;
+            else fail(c);
+            close_client(c);
+            return;
+        }
+
+        auto now = clock_type::now();
+        if (c.state == Client::State::HANDSHAKE) {
+            size_t end = c.in.find("\r\n\r\n");
+            if (end == std::string::npos) return;
+            if (c.in.compare(0, 12, "HTTP/1.1 101") != 0) {
+                fail(c);
+                close_client(c);
+                return;
+            }
+            stats_.handshake_ms.push_back(ms_between(c.connect_start, now));
+            ++stats_.connected;
+            c.in.erase(0, end + 4);
+            c.state = Client::State::STREAMING;
+            start_streaming(c, now);
+        }
+
+        // 服务端帧不带掩码
+        size_t pos = 0;
+        while (c.in.size() - pos >= 2) {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(c.in.data()) + pos;
+            size_t avail = c.in.size() - pos;
+            uint64_t len = p[1] & 0x7F;
+            size_t header = 2;
+            if (len == 126) {
+                if (avail < 4) break;
+                len = (uint64_t(p[2]) << 8) | p[3];
+                header = 4;
+            } else if (len == 127) {
+                if (avail < 10) break;
+                len = 0;
+                for (int i = 0; i < 8; ++i) len = (len << 8) | p[2 + i];
+                header = 10;
+            }
+            if (avail < header + len) break;
+            uint8_t opcode = p[0] & 0x0F;
+            if (opcode == ws::TEXT) {
+                ++stats_.responses;
+                stats_.response_ms.push_back(ms_between(c.last_frame_sent, now));
+            } else if (opcode == ws::CLOSE) {
+                ++stats_.closed_by_server;
+                close_client(c);
+                return;
+            }
+            pos += header + static_cast<size_t>(len);
+        }
+        c.in.erase(0, pos);
+    }
+
+    void fail(Client& c) {
+        ++stats_.failed;
+        close_client(c);
+    }
+
+    void close_client(Client& c) {
+        if (c.fd >= 0) ::close(c.fd);
+        c.fd = -1;
+        c.shm.reset();
+        c.state = Client::State::DONE;
+    }
+
+    const Options& opt_;
+    const std::vector<int16_t>& pcm_;
+    size_t first_;
+    size_t count_;
+    size_t total_;
+    std::vector<Client> clients_;
+    int epoll_fd_ = -1;
+    size_t frame_samples_ = 0;
+    std::vector<uint8_t> frame_buf_;
+    Stats stats_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--host") {
+            opt.host = value;
+        } else if (arg == "--port") {
+            opt.port = static_cast<uint16_t>(std::atoi(value));
+        } else if (arg == "--connections") {
+            opt.connections = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--threads") {
+            opt.threads = std::max<size_t>(1, std::strtoul(value, nullptr, 10));
+        } else if (arg == "--duration") {
+            opt.duration_sec = std::strtod(value, nullptr);
+        } else if (arg == "--ramp") {
+            opt.ramp_sec = std::strtod(value, nullptr);
+        } else if (arg == "--sample-rate") {
+            opt.sample_rate = std::atoi(value);
+        } else if (arg == "--frame-ms") {
+            opt.frame_ms = std::max(1, std::atoi(value));
+        } else if (arg == "--pcm") {
+            opt.pcm_path = value;
+        } else if (arg == "--shm") {
+            opt.shm_path = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<int16_t> pcm;
+    if (!opt.pcm_path.empty()) {
+        std::ifstream file(opt.pcm_path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        pcm.resize(bytes.size() / 2);
+        std::memcpy(pcm.data(), bytes.data(), pcm.size() * 2);
+        if (pcm.empty()) {
+            std::cerr << "Cannot read PCM from " << opt.pcm_path << std::endl;
+            return 1;
+        }
+    } else {
+        pcm = synth_pcm(opt.sample_rate);
+    }
+
+    auto start = clock_type::now();
+    auto stop = start + std::chrono::duration_cast<clock_type::duration>(
+                            std::chrono::duration<double>(opt.ramp_sec + opt.duration_sec));
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < opt.threads; ++t) {
+        size_t first = opt.connections * t / opt.threads;
+        size_t last = opt.connections * (t + 1) / opt.threads;
+        workers.emplace_back(new Worker(opt, pcm, first, last - first, opt.connections));
+    }
+    for (auto& worker : workers) {
+        Worker* w = worker.get();
+        threads.emplace_back([w, start, stop] { w->run(start, stop); });
+    }
+    for (auto& t : threads) t.join();
+
+    Stats total;
+    for (auto& worker : workers) {
+        const Stats& s = worker->stats();
+        total.connected += s.connected;
+        total.failed += s.failed;
+        total.closed_by_server += s.closed_by_server;
+        total.frames += s.frames;
+        total.bytes += s.bytes;
+        total.blocked_writes += s.blocked_writes;
+        total.responses += s.responses;
+        total.handshake_ms.insert(total.handshake_ms.end(), s.handshake_ms.begin(), s.handshake_ms.end());
+        total.send_lag_ms.insert(total.send_lag_ms.end(), s.send_lag_ms.begin(), s.send_lag_ms.end());
+        total.response_ms.insert(total.response_ms.end(), s.response_ms.begin(), s.response_ms.end());
+    }
+    double wall = ms_between(start, clock_type::now()) / 1000.0;
+    std::cout << "connections: " << total.connected << " ok, " << total.failed << " failed, "
+              << total.closed_by_server << " closed by server\n"
+              << "frames: " << total.frames << " (" << total.frames / wall << "/s, "
+              << total.bytes / wall / 1e6 << " MB/s), blocked writes " << total.blocked_writes << "\n"
+              << "handshake ms: p50 " << percentile(total.handshake_ms, 0.5) << ", p99 "
+              << percentile(total.handshake_ms, 0.99) << "\n"
+              << "send lag ms:  p50 " << percentile(total.send_lag_ms, 0.5) << ", p99 "
+              << percentile(total.send_lag_ms, 0.99) << ", max " << percentile(total.send_lag_ms, 1.0) << "\n"
+              << "responses: " << total.responses << ", latency ms p50 " << percentile(total.response_ms, 0.5)
+              << ", p99 " << percentile(total.response_ms, 0.99) << std::endl;
+    return total.failed == 0 ? 0 : 2;
+}
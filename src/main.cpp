@@ -1,10 +1,201 @@
 #include "server.h"
+#include "supervisor.h"
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
-int main() {
+static void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]\n"
+              << "  --port N               listen port (default 9002)\n"
+              << "  --warm-sessions N      sessions pre-created with a loaded model (default 0)\n"
+              << "  --max-idle-sessions N  idle sessions kept for reuse (default 64)\n"
+              << "  --max-sessions N       concurrent connection limit (default 4096)\n"
+              << "  --egress-pool-size N   pooled outgoing messages (default 1024)\n"
+              << "  --io-threads N         threads running the websocket io_service (default 1)\n"
+              << "  --worker-threads N     VAD worker threads, sessions are sharded across them (default 1)\n"
+              << "  --capture FILE         append every session's frames to a capture log for vad_replay\n"
+              << "  --model PATH           silero model (default ../model/silero_vad.onnx)\n"
+              << "  --ort-cache PATH       optimized ORT-format model cache (default <model>.ort, 'off' disables)\n"
+              << "  --warmup N             synthetic inferences per worker before accepting (default 32)\n"
+              << "  --latency-budget-ms N  default per-frame latency budget used as deadline (default 200)\n"
+              << "  --slice-ms N           split PCM tasks longer than two slices into N ms pieces (default 100, 0 = off)\n"
+              << "  --schedule edf|drr     order sessions by deadline or by fair audio-time share (default edf)\n"
+              << "  --pipeline queue|coroutine  per-worker task queue or one coroutine per session (default queue,\n"
+              << "                         coroutine needs a -DVAD_COROUTINES=ON build)\n"
+              << "  --transport T          websocketpp, epoll or io_uring (native RFC 6455 loops, one per io thread;\n"
+              << "                         io_uring falls back to epoll when the kernel lacks support; default websocketpp)\n"
+              << "  --shm-ingress PATH     also accept same-host producers over shared-memory rings on this Unix socket\n"
+              << "  --shm-event-ring-kb N  per-stream event ring size; bounds the longest VAD_END returned over shared\n"
+              << "                         memory (default 1024, about 24 s of 16 kHz speech)\n"
+              << "  --asr-forward URL      stream speech audio to ws://host:port/path or tcp://host:port; responses\n"
+              << "                         then carry only event metadata (empty vad_audio)\n"
+              << "  --asr-connections N    pooled connections to the ASR sink (default 64)\n"
+              << "  --archive-dir DIR      write every speech segment to DIR as a WAV file (asynchronously)\n"
+              << "  --archive-queue-mb N   segment bytes waiting for the archive writer before new ones are dropped\n"
+              << "                         (default 64)\n"
+              << "  --idle-timeout-sec N   close sessions that sent no audio for N seconds (default 0 = off)\n"
+              << "  --hibernate-after-sec N  release buffers and park engine state of sessions idle for N seconds\n"
+              << "                         (default 0 = off)\n"
+              << "  --quantum-ms N         audio credited to each session per DRR round (default 100)\n"
+              << "  --rate-limit X         per-connection ingress limit in audio seconds per second (default 0 = off)\n"
+              << "  --rate-burst SEC       audio a connection may send ahead of the limit (default 2)\n"
+              << "  --rate-limit-action A  delay (pause reading) or drop frames over the limit (default delay)\n"
+              << "  --catchup-ms N         merge a session's backlog once it exceeds N ms of audio (default 1000, 0 = off)\n"
+              << "  --snapshot-dir DIR     freeze sessions here on drain so another process can resume them\n"
+              << "  --admin                enable /admin/drain, /admin/migrate and /admin/sessions HTTP endpoints\n"
+              << "  --reuse-port           listen with SO_REUSEPORT so several processes can share the port\n"
+              << "  --processes N          supervisor mode: fork N pinned worker processes sharing the port\n"
+              << "  --cpu-sets LIST        CPUs per process, e.g. \"0-3;4-7\" (default: split available CPUs)\n";
+}
+
+static bool parse_args(int argc, char** argv, ServerConfig& config, SupervisorConfig& supervisor) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        }
+        if (arg == "--admin") {
+            config.admin_http = true;
+            continue;
+        }
+        if (arg == "--reuse-port") {
+            config.reuse_port = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--port") {
+            config.port = static_cast<uint16_t>(std::atoi(value));
+        } else if (arg == "--warm-sessions") {
+            config.warm_sessions = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--max-idle-sessions") {
+            config.max_idle_sessions = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--max-sessions") {
+            config.max_sessions = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--egress-pool-size") {
+            config.egress_pool_size = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--io-threads") {
+            config.io_threads = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--worker-threads") {
+            config.worker_threads = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--capture") {
+            config.capture_path = value;
+        } else if (arg == "--model") {
+            config.model.model_path = value;
+        } else if (arg == "--ort-cache") {
+            if (std::string(value) == "off") {
+                config.model.use_ort_cache = false;
+            } else {
+                config.model.ort_cache_path = value;
+            }
+        } else if (arg == "--warmup") {
+            config.warmup_iterations = std::atoi(value);
+        } else if (arg == "--latency-budget-ms") {
+            config.latency_budget_ms = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--slice-ms") {
+            config.slice_ms = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--schedule") {
+            std::string policy = value;
+            if (policy == "edf") {
+                config.schedule = SchedulerConfig::Policy::EDF;
+            } else if (policy == "drr") {
+                config.schedule = SchedulerConfig::Policy::DRR;
+            } else {
+                std::cerr << "Unknown schedule " << policy << std::endl;
+                return false;
+            }
+        } else if (arg == "--pipeline") {
+            std::string pipeline = value;
+            if (pipeline == "queue") {
+                config.coroutine_pipeline = false;
+            } else if (pipeline == "coroutine") {
+#ifdef VAD_WITH_COROUTINES
+                config.coroutine_pipeline = true;
+#else
+                std::cerr << "Coroutine pipeline not built (configure with -DVAD_COROUTINES=ON)" << std::endl;
+                return false;
+#endif
+            } else {
+                std::cerr << "Unknown pipeline " << pipeline << std::endl;
+                return false;
+            }
+        } else if (arg == "--transport") {
+            std::string transport = value;
+            if (transport == "websocketpp") {
+                config.transport = ServerConfig::Transport::WEBSOCKETPP;
+            } else if (transport == "epoll") {
+                config.transport = ServerConfig::Transport::EPOLL;
+            } else if (transport == "io_uring") {
+                config.transport = ServerConfig::Transport::IO_URING;
+            } else {
+                std::cerr << "Unknown transport " << transport << std::endl;
+                return false;
+            }
+        } else if (arg == "--shm-ingress") {
+            config.shm_socket = value;
+        } else if (arg == "--shm-event-ring-kb") {
+            config.shm_event_ring_kb = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--asr-forward") {
+            config.asr_forward = value;
+        } else if (arg == "--asr-connections") {
+            config.asr_connections = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--archive-dir") {
+            config.archive_dir = value;
+        } else if (arg == "--archive-queue-mb") {
+            config.archive_queue_mb = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--idle-timeout-sec") {
+            config.idle_timeout_sec = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--hibernate-after-sec") {
+            config.hibernate_after_sec = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--quantum-ms") {
+            config.quantum_ms = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--rate-limit") {
+            config.rate_limit = std::strtod(value, nullptr);
+        } else if (arg == "--rate-burst") {
+            config.rate_burst_sec = std::strtod(value, nullptr);
+        } else if (arg == "--processes") {
+            supervisor.processes = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--cpu-sets") {
+            if (!parse_cpu_sets(value, supervisor.cpu_sets)) {
+                std::cerr << "Invalid CPU sets " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--snapshot-dir") {
+            config.snapshot_dir = value;
+        } else if (arg == "--catchup-ms") {
+            config.catchup_ms = std::strtoul(value, nullptr, 10);
+        } else if (arg == "--rate-limit-action") {
+            std::string action = value;
+            if (action == "delay" || action == "drop") {
+                config.rate_limit_drop = action == "drop";
+            } else {
+                std::cerr << "Unknown rate limit action " << action << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ServerConfig config;
+    SupervisorConfig supervisor;
+    if (!parse_args(argc, argv, config, supervisor)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    VadModel::configure(config.model);
+    if (supervisor.processes > 0) {
+        return run_supervisor(config, supervisor);
+    }
     try {
-        AudioServer server;
-        server.run(9002);
+        AudioServer::run_until_signal(config);
     } catch (std::exception & e) {
         std::cerr << "Exception: " << e.what() << std::endl;
     }
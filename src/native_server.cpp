@@ -0,0 +1,184 @@
+#include "native_server.h"
+#include <iostream>
+#include "json_audio_parser.h"
+#include "server.h"
+
+void NativeRoute::send_event(const std::string& payload) {
+    std::string frame;
+    frame.reserve(payload.size() + 10);
+    ws::append_frame_header(frame, ws::TEXT, payload.size());
+    frame += payload;
+    loop_.send(id_, std::move(frame));
+}
+
+bool NativeRoute::close(uint16_t code) {
+    loop_.close(id_, code);
+    return true;
+}
+
+NativeLoop::NativeLoop(AudioServer& owner) : owner_(owner) {}
+
+bool NativeLoop::open(const TransportOptions& options, bool use_uring) {
+    if (use_uring) {
+        backend_ = make_uring_transport(options, *this);
+        if (!backend_) std::cerr << "io_uring transport unavailable, falling back to epoll" << std::endl;
+    }
+    if (!backend_) backend_ = make_epoll_transport(options, *this);
+    return backend_ != nullptr;
+}
+
+const char* NativeLoop::backend_name() const {
+    return backend_ ? backend_->name() : "none";
+}
+
+void NativeLoop::run() {
+    backend_->run();
+}
+
+void NativeLoop::stop() {
+    if (backend_) backend_->stop();
+}
+
+void NativeLoop::send(uint64_t id, std::string&& bytes) {
+    backend_->send(id, std::move(bytes));
+}
+
+void NativeLoop::close(uint64_t id, uint16_t code) {
+    std::string frame;
+    ws::append_close_frame(frame, code);
+    backend_->send(id, std::move(frame));
+    backend_->close(id);
+}
+
+void NativeLoop::on_accept(uint64_t id) {
+    connections_[id];
+}
+
+void NativeLoop::on_data(uint64_t id, uint8_t* data, size_t len) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) return;
+    Connection& con = it->second;
+    if (con.closing) return;
+
+    // 没有残留时直接在后端的接收缓冲区上解析 (就地去掩码)，只把不完整的尾部留存下来
+    bool buffered = !con.in.empty();
+    if (buffered) {
+        con.in.append(reinterpret_cast<const char*>(data), len);
+        data = reinterpret_cast<uint8_t*>(&con.in[0]);
+        len = con.in.size();
+    }
+    size_t pos = 0;
+    while (pos < len && !con.closing) {
+        size_t consumed = con.upgraded ? handle_frames(id, con, data + pos, len - pos)
+                                       : handle_http(id, con, data + pos, len - pos);
+        if (consumed == 0) break;
+        pos += consumed;
+    }
+    if (con.closing) {
+        con.in.clear();
+    } else if (buffered) {
+        con.in.erase(0, pos);
+    } else if (pos < len) {
+        con.in.assign(reinterpret_cast<const char*>(data + pos), len - pos);
+    }
+}
+
+size_t NativeLoop::handle_http(uint64_t id, Connection& con, uint8_t* data, size_t len) {
+    ws::HttpRequest request;
+    long header = ws::parse_http_request(reinterpret_cast<const char*>(data), len, request);
+    if (header == 0) return 0;
+    if (header < 0) {
+        backend_->send(id, ws::http_response(400, "Bad Request", ""));
+        backend_->close(id);
+        con.closing = true;
+        return len;
+    }
+
+    if (!request.is_websocket()) {
+        // 普通 HTTP: 就绪检查与指标
+        if (request.resource == "/ready") {
+            bool ready = owner_.ready_;
+            backend_->send(id, ready ? ws::http_response(200, "OK", "ready\n")
+                                     : ws::http_response(503, "Service Unavailable", "not ready\n"));
+        } else if (request.resource == "/metrics") {
+            backend_->send(id, ws::http_response(200, "OK", owner_.metrics_text()));
+        } else {
+            backend_->send(id, ws::http_response(404, "Not Found", ""));
+        }
+        backend_->close(id);
+        con.closing = true;
+        return len;
+    }
+
+    backend_->send(id, ws::handshake_response(request.key));
+    con.upgraded = true;
+    con.route = std::make_shared<NativeRoute>(*this, id);
+    uint16_t code = owner_.open_local_session(con.route, request.resource, con.stream);
+    if (code != 0) {
+        fail(id, con, code);
+        return len;
+    }
+    return static_cast<size_t>(header);
+}
+
+size_t NativeLoop::handle_frames(uint64_t id, Connection& con, uint8_t* data, size_t len) {
+    size_t consumed = 0;
+    ws::FrameParser::Result result = con.parser.next(data, len, consumed);
+    switch (result) {
+    case ws::FrameParser::NEED_MORE:
+        // 分片消息的中间帧已拼进解析器，同样计入消耗
+        return consumed;
+    case ws::FrameParser::FAILED:
+        fail(id, con, con.parser.close_code());
+        return len;
+    case ws::FrameParser::MESSAGE:
+        on_message(con, con.parser.opcode(), con.parser.payload(), con.parser.payload_size());
+        return consumed;
+    case ws::FrameParser::CONTROL:
+        break;
+    }
+
+    if (con.parser.opcode() == ws::PING) {
+        std::string pong;
+        ws::append_frame_header(pong, ws::PONG, con.parser.payload_size());
+        pong.append(reinterpret_cast<const char*>(con.parser.payload()), con.parser.payload_size());
+        backend_->send(id, std::move(pong));
+    } else if (con.parser.opcode() == ws::CLOSE) {
+        // 回应关闭帧后断开
+        fail(id, con, con.parser.close_code());
+    }
+    return consumed;
+}
+
+void NativeLoop::on_message(Connection& con, ws::Opcode opcode, const uint8_t* payload, size_t size) {
+    if (con.stream.session_ref.generation == 0) return;
+    AudioTask task;
+    task.data = std::make_shared<std::vector<uint8_t>>();
+    if (opcode == ws::TEXT) {
+        AudioMessageFields fields;
+        if (!parse_audio_message(reinterpret_cast<const char*>(payload), size, fields, *task.data)) {
+            std::cerr << "JSON parse error: malformed audio message (" << size << " bytes)" << std::endl;
+            return;
+        }
+        if (!fields.has_audio) return;
+        task.uid = std::move(fields.uid);
+        task.connect_session = std::move(fields.connect_session);
+        task.current_session = std::move(fields.current_session);
+    } else {
+        // 负载在接收缓冲区中，回调返回后即被复用，需要拷出
+        task.data->assign(payload, payload + size);
+    }
+    owner_.push_local_task(con.stream, std::move(task));
+}
+
+void NativeLoop::fail(uint64_t id, Connection& con, uint16_t code) {
+    close(id, code);
+    con.closing = true;
+}
+
+void NativeLoop::on_closed(uint64_t id) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) return;
+    owner_.close_local_session(it->second.stream);
+    connections_.erase(it);
+}
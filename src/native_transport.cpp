@@ -0,0 +1,867 @@
+#include "native_transport.h"
+#ifndef VAD_NO_IO_URING
+#include <linux/io_uring.h>
+#endif
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 连接 id: 代数 (24 位) << 32 | fd；io_uring 的 user_data 高 8 位留给操作类型
+inline uint64_t make_id(uint32_t generation, int fd) {
+    return (static_cast<uint64_t>(generation & 0xFFFFFF) << 32) | static_cast<uint32_t>(fd);
+}
+inline int id_fd(uint64_t id) {
+    return static_cast<int>(id & 0xFFFFFFFF);
+}
+
+void set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+struct OutboxEntry {
+    uint64_t id;
+    std::string bytes;
+    bool close;
+};
+
+// 跨线程发件箱: 工作线程追加，事件循环每轮整体取走；多次追加只写一次 eventfd
+class Outbox {
+public:
+    Outbox() : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    ~Outbox() {
+        if (event_fd_ >= 0) ::close(event_fd_);
+    }
+
+    int event_fd() const { return event_fd_; }
+    void set_loop_thread() { loop_thread_ = std::this_thread::get_id(); }
+
+    void push(OutboxEntry&& entry) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_.push_back(std::move(entry));
+        }
+        // 事件循环自己 (收包回调中) 追加时不必唤醒，本轮末尾就会取走
+        if (std::this_thread::get_id() != loop_thread_) wake();
+    }
+
+    void wake() {
+        if (!signaled_.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t n = ::write(event_fd_, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // 先清除唤醒标记再取，之后的追加会重新写 eventfd，不会丢失
+    void take(std::vector<OutboxEntry>& out) {
+        signaled_.store(false);
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(entries_);
+    }
+
+private:
+    int event_fd_;
+    std::thread::id loop_thread_;
+    std::atomic<bool> signaled_{false};
+    std::mutex mutex_;
+    std::vector<OutboxEntry> entries_;
+};
+
+// ==========================================
+// epoll 后端
+// ==========================================
+
+class EpollTransport final : public TransportBackend {
+public:
+    EpollTransport(const TransportOptions& options, TransportHandler& handler)
+        : handler_(handler), listen_fd_(open_listen_socket(options.port)), epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+          max_queued_bytes_(options.max_queued_bytes), read_buf_(64 * 1024) {
+        if (!ok()) return;
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+        ev.data.fd = outbox_.event_fd();
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, outbox_.event_fd(), &ev);
+    }
+
+    ~EpollTransport() override {
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    }
+
+    bool ok() const { return listen_fd_ >= 0 && epoll_fd_ >= 0 && outbox_.event_fd() >= 0; }
+    const char* name() const override { return "epoll"; }
+
+    void run() override {
+        outbox_.set_loop_thread();
+        epoll_event events[256];
+        while (running_) {
+            int n = epoll_wait(epoll_fd_, events, 256, -1);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd_) {
+                    accept_all();
+                } else if (fd == outbox_.event_fd()) {
+                    uint64_t value;
+                    ssize_t r = ::read(fd, &value, sizeof(value));
+                    (void)r;
+                } else {
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) read_all(fd);
+                    if ((events[i].events & EPOLLOUT) && conns_[fd].open) flush(fd);
+                }
+            }
+            apply_outbox();
+        }
+        for (size_t fd = 0; fd < conns_.size(); ++fd) {
+            if (conns_[fd].open) close_fd(static_cast<int>(fd));
+        }
+    }
+
+    void stop() override {
+        running_ = false;
+        outbox_.wake();
+    }
+
+    void send(uint64_t id, std::string&& bytes) override { outbox_.push(OutboxEntry{id, std::move(bytes), false}); }
+    void close(uint64_t id) override { outbox_.push(OutboxEntry{id, std::string(), true}); }
+
+private:
+    struct Conn {
+        uint32_t generation = 0;
+        bool open = false;
+        bool closing = false;    // 发完 out 后关闭
+        bool want_write = false; // 已注册 EPOLLOUT
+        bool dirty = false;      // 本轮有新数据待写
+        std::string out;
+        size_t out_offset = 0;
+    };
+
+    Conn* lookup(uint64_t id) {
+        int fd = id_fd(id);
+        if (fd < 0 || static_cast<size_t>(fd) >= conns_.size()) return nullptr;
+        Conn& c = conns_[fd];
+        return c.open && make_id(c.generation, fd) == id ? &c : nullptr;
+    }
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return; // EAGAIN，或 EMFILE 等 (下次可读时重试)
+            }
+            set_nodelay(fd);
+            if (static_cast<size_t>(fd) >= conns_.size()) conns_.resize(fd + 1024);
+            Conn& c = conns_[fd];
+            ++c.generation;
+            c.open = true;
+            c.closing = c.want_write = c.dirty = false;
+            c.out.clear();
+            c.out_offset = 0;
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            handler_.on_accept(make_id(c.generation, fd));
+        }
+    }
+
+    // 边沿触发: 一直读到 EAGAIN
+    void read_all(int fd) {
+        uint64_t id = make_id(conns_[fd].generation, fd);
+        for (;;) {
+            ssize_t n = ::recv(fd, read_buf_.data(), read_buf_.size(), 0);
+            if (n > 0) {
+                handler_.on_data(id, read_buf_.data(), static_cast<size_t>(n));
+                if (!lookup(id)) return;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n == 0) {
+                // 对端半关闭: 回调刚排队的数据 (例如关闭帧的回应) 还在发件箱里，
+                // 等本轮 apply_outbox 写出后再关闭
+                eof_.push_back(id);
+                return;
+            }
+            close_fd(fd);
+            return;
+        }
+    }
+
+    void flush(int fd) {
+        Conn& c = conns_[fd];
+        while (c.out_offset < c.out.size()) {
+            ssize_t n = ::send(fd, c.out.data() + c.out_offset, c.out.size() - c.out_offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                c.out_offset += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (!c.want_write) set_write_interest(fd, true);
+                return;
+            }
+            close_fd(fd);
+            return;
+        }
+        c.out.clear();
+        c.out_offset = 0;
+        if (c.want_write) set_write_interest(fd, false);
+        if (c.closing) close_fd(fd);
+    }
+
+    void set_write_interest(int fd, bool on) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (on ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+        conns_[fd].want_write = on;
+    }
+
+    void close_fd(int fd) {
+        Conn& c = conns_[fd];
+        if (!c.open) return;
+        uint64_t id = make_id(c.generation, fd);
+        c.open = false;
+        c.out.clear();
+        c.out_offset = 0;
+        ::close(fd); // 同时从 epoll 中移除
+        handler_.on_closed(id);
+    }
+
+    // 同一连接本轮的多条消息先拼接，再一次写出
+    void apply_outbox() {
+        outbox_.take(pending_);
+        dirty_.clear();
+        for (OutboxEntry& entry : pending_) {
+            Conn* c = lookup(entry.id);
+            if (!c || c->closing) continue;
+            if (entry.close) {
+                c->closing = true;
+            } else if (c->out.empty()) {
+                c->out.swap(entry.bytes);
+            } else {
+                c->out += entry.bytes;
+            }
+            if (c->out.size() - c->out_offset > max_queued_bytes_) {
+                // 客户端读得太慢，积压超过上限: 断开，不再为它缓存
+                close_fd(id_fd(entry.id));
+                continue;
+            }
+            if (!c->dirty) {
+                c->dirty = true;
+                dirty_.push_back(id_fd(entry.id));
+            }
+        }
+        for (int fd : dirty_) {
+            Conn& c = conns_[fd];
+            c.dirty = false;
+            // 已在等 EPOLLOUT 的连接由可写事件继续发送
+            if (c.open && !c.want_write) flush(fd);
+        }
+        // 读到 EOF 的连接: 排队的数据写完后关闭 (flush 在 out 为空时立即关闭)
+        for (uint64_t id : eof_) {
+            Conn* c = lookup(id);
+            if (!c) continue;
+            c->closing = true;
+            if (!c->want_write) flush(id_fd(id));
+        }
+        eof_.clear();
+    }
+
+    TransportHandler& handler_;
+    int listen_fd_;
+    int epoll_fd_;
+    Outbox outbox_;
+    std::atomic<bool> running_{true};
+    size_t max_queued_bytes_;
+    std::vector<Conn> conns_;
+    std::vector<uint8_t> read_buf_;
+    std::vector<OutboxEntry> pending_;
+    std::vector<int> dirty_;
+    std::vector<uint64_t> eof_;
+};
+
+#ifndef VAD_NO_IO_URING
+// ==========================================
+// io_uring 后端
+// ==========================================
+
+int uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+int uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+class UringTransport final : public TransportBackend {
+public:
+    UringTransport(const TransportOptions& options, TransportHandler& handler)
+        : options_(options), handler_(handler) {}
+
+    ~UringTransport() override {
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (ring_ptr_) munmap(ring_ptr_, ring_size_);
+        if (buf_ring_) munmap(buf_ring_, buf_ring_size_);
+        if (recv_slab_) munmap(recv_slab_, recv_slab_size_);
+        if (send_slab_) munmap(send_slab_, send_slab_size_);
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+        // 停止时仍有操作在途、尚未释放的 fd
+        for (size_t fd = 0; fd < conns_.size(); ++fd) {
+            if (conns_[fd].held) ::close(static_cast<int>(fd));
+        }
+    }
+
+    bool init() {
+        unsigned recv_buffers = options_.recv_buffers;
+        if (recv_buffers == 0 || (recv_buffers & (recv_buffers - 1)) != 0 || recv_buffers > 32768) {
+            std::cerr << "io_uring: recv_buffers must be a power of two <= 32768" << std::endl;
+            return false;
+        }
+
+        io_uring_params params = {};
+        // 多路接收会产生大量 CQE: CQ 放大到 SQ 的 4 倍，溢出时由内核暂存 (FEAT_NODROP)
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+        params.cq_entries = options_.ring_entries * 4;
+        ring_fd_ = uring_setup(options_.ring_entries, &params);
+        if (ring_fd_ < 0 && errno == EINVAL) {
+            params = io_uring_params();
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = options_.ring_entries * 4;
+            ring_fd_ = uring_setup(options_.ring_entries, &params);
+        }
+        if (ring_fd_ < 0) return false;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) return false;
+
+        // SQ 与 CQ 环共用一次映射
+        size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring_size_ = std::max(sq_size, cq_size);
+        void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED) return false;
+        ring_ptr_ = ring;
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* base = static_cast<char*>(ring_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+        sq_local_tail_ = *sq_tail_;
+        cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+        // 提供缓冲环 (5.19+): 多路接收时由内核从这里挑选缓冲区
+        buf_ring_size_ = recv_buffers * sizeof(io_uring_buf);
+        void* br = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (br == MAP_FAILED) return false;
+        buf_ring_ = static_cast<io_uring_buf_ring*>(br);
+        recv_slab_size_ = recv_buffers * options_.recv_buffer_size;
+        void* slab = mmap(nullptr, recv_slab_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slab == MAP_FAILED) return false;
+        recv_slab_ = static_cast<uint8_t*>(slab);
+        io_uring_buf_reg reg = {};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+        reg.ring_entries = recv_buffers;
+        reg.bgid = kBufferGroup;
+        if (uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+        buf_mask_ = recv_buffers - 1;
+        for (unsigned bid = 0; bid < recv_buffers; ++bid) recycle_buffer(static_cast<uint16_t>(bid));
+        publish_buffers();
+
+        // 注册发送缓冲: 响应拷进其中一个槽，以 WRITE_FIXED 发出 (免去每次发送的页面固定)；
+        // 受 RLIMIT_MEMLOCK 限制注册失败时全部走普通 SEND
+        if (options_.send_slots > 0 && options_.send_slot_size > 0) {
+            send_slab_size_ = static_cast<size_t>(options_.send_slots) * options_.send_slot_size;
+            void* s = mmap(nullptr, send_slab_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (s != MAP_FAILED) {
+                send_slab_ = static_cast<uint8_t*>(s);
+                iovec iov = {send_slab_, send_slab_size_};
+                if (uring_register(ring_fd_, IORING_REGISTER_BUFFERS, &iov, 1) == 0) {
+                    for (unsigned i = options_.send_slots; i-- > 0;) free_slots_.push_back(i);
+                } else {
+                    std::cerr << "io_uring: cannot register send buffers, using plain sends" << std::endl;
+                }
+            }
+        }
+
+        listen_fd_ = open_listen_socket(options_.port);
+        return listen_fd_ >= 0 && outbox_.event_fd() >= 0;
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    void run() override {
+        outbox_.set_loop_thread();
+        arm_accept();
+        arm_wake();
+        while (running_) {
+            apply_outbox();
+            publish_buffers();
+            // 本轮积累的全部 SQE (重新挂接的接收、发送) 一次提交，并等待至少一个完成
+            if (submit(1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                std::cerr << "io_uring_enter failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            reap();
+        }
+        for (size_t fd = 0; fd < conns_.size(); ++fd) {
+            if (conns_[fd].open) close_conn(static_cast<int>(fd));
+        }
+    }
+
+    void stop() override {
+        running_ = false;
+        outbox_.wake();
+    }
+
+    void send(uint64_t id, std::string&& bytes) override { outbox_.push(OutboxEntry{id, std::move(bytes), false}); }
+    void close(uint64_t id) override { outbox_.push(OutboxEntry{id, std::string(), true}); }
+
+private:
+    enum Op : uint8_t {
+        OP_ACCEPT = 1,
+        OP_RECV = 2,
+        OP_SEND = 3,
+        OP_WAKE = 4,
+    };
+    static const uint16_t kBufferGroup = 0;
+
+    struct Conn {
+        uint32_t generation = 0;
+        bool open = false;
+        bool closing = false; // 发完后关闭
+        bool sending = false; // 每个连接同时只有一个发送在途，保证顺序
+        bool held = false;    // fd 尚未 close；连接关闭后要等在途操作全部完成才释放
+        unsigned inflight = 0; // 已提交、尚未收到最后一个 CQE 的接收与发送
+        std::string queued;   // 在途期间追加的数据，完成后合并为下一次发送
+    };
+
+    // 存放在 deque 中: 追加不移动已有元素，在途 SEND 引用的 heap 数据 (含短字符串的内联缓冲) 地址不变
+    struct SendOp {
+        uint64_t conn = 0;
+        int slot = -1;    // 注册缓冲槽；-1 表示数据在 heap 中
+        std::string heap;
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    static uint64_t user_data(Op op, uint64_t value) { return (static_cast<uint64_t>(op) << 56) | value; }
+
+    Conn* lookup(uint64_t id) {
+        int fd = id_fd(id);
+        if (fd < 0 || static_cast<size_t>(fd) >= conns_.size()) return nullptr;
+        Conn& c = conns_[fd];
+        return c.open && make_id(c.generation, fd) == id ? &c : nullptr;
+    }
+
+    io_uring_sqe* get_sqe() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sq_local_tail_ - head >= sq_entries_) {
+            // SQ 满: 先提交已有的 (不等待完成)
+            submit(0);
+            head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            if (sq_local_tail_ - head >= sq_entries_) return nullptr;
+        }
+        unsigned index = sq_local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++sq_local_tail_;
+        return sqe;
+    }
+
+    int submit(unsigned wait) {
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+        unsigned pending = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (pending == 0 && wait == 0) return 0;
+        return uring_enter(ring_fd_, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+    }
+
+    void recycle_buffer(uint16_t bid) {
+        // 不用 buf_ring_->bufs: 在 C++ 中 __DECLARE_FLEX_ARRAY 的空结构体占 1 字节，bufs 会偏移到第 8 字节，
+        // 与内核布局不一致；环本身就是 io_uring_buf 数组 (tail 与 bufs[0].resv 重叠)
+        io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(buf_ring_) + (buf_tail_ & buf_mask_);
+        buf->addr = reinterpret_cast<uint64_t>(recv_slab_ + static_cast<size_t>(bid) * options_.recv_buffer_size);
+        buf->len = static_cast<uint32_t>(options_.recv_buffer_size);
+        buf->bid = bid;
+        ++buf_tail_;
+    }
+
+    void publish_buffers() { __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE); }
+
+    void arm_accept() {
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listen_fd_;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = user_data(OP_ACCEPT, 0);
+    }
+
+    void arm_wake() {
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = outbox_.event_fd();
+        sqe->addr = reinterpret_cast<uint64_t>(&wake_value_);
+        sqe->len = sizeof(wake_value_);
+        sqe->user_data = user_data(OP_WAKE, 0);
+    }
+
+    void arm_recv(uint64_t id) {
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) {
+            close_conn(id_fd(id));
+            return;
+        }
+        ++conns_[id_fd(id)].inflight;
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = id_fd(id);
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        if (multishot_recv_) {
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+        } else {
+            sqe->len = static_cast<uint32_t>(options_.recv_buffer_size);
+        }
+        sqe->user_data = user_data(OP_RECV, id);
+    }
+
+    void start_send(uint64_t id, Conn& c, std::string&& bytes) {
+        uint32_t index;
+        if (!free_sends_.empty()) {
+            index = free_sends_.back();
+            free_sends_.pop_back();
+        } else {
+            index = static_cast<uint32_t>(sends_.size());
+            sends_.emplace_back();
+        }
+        SendOp& op = sends_[index];
+        op.conn = id;
+        op.offset = 0;
+        op.size = bytes.size();
+        op.slot = -1;
+        if (bytes.size() <= options_.send_slot_size && !free_slots_.empty()) {
+            op.slot = static_cast<int>(free_slots_.back());
+            free_slots_.pop_back();
+            std::memcpy(slot_data(op.slot), bytes.data(), bytes.size());
+        } else {
+            op.heap = std::move(bytes);
+        }
+        c.sending = true;
+        submit_send(index);
+    }
+
+    uint8_t* slot_data(int slot) { return send_slab_ + static_cast<size_t>(slot) * options_.send_slot_size; }
+
+    void submit_send(uint32_t index) {
+        SendOp& op = sends_[index];
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) {
+            finish_send(index, -EBUSY);
+            return;
+        }
+        ++conns_[id_fd(op.conn)].inflight;
+        sqe->fd = id_fd(op.conn);
+        sqe->len = static_cast<uint32_t>(op.size - op.offset);
+        sqe->user_data = user_data(OP_SEND, index);
+        if (op.slot >= 0) {
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->addr = reinterpret_cast<uint64_t>(slot_data(op.slot) + op.offset);
+            sqe->buf_index = 0;
+            sqe->off = static_cast<uint64_t>(-1);
+        } else {
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = reinterpret_cast<uint64_t>(op.heap.data() + op.offset);
+            sqe->msg_flags = MSG_NOSIGNAL;
+        }
+    }
+
+    void finish_send(uint32_t index, int res) {
+        SendOp& op = sends_[index];
+        uint64_t id = op.conn;
+        Conn* c = lookup(id);
+        if (res > 0 && c && op.offset + static_cast<size_t>(res) < op.size) {
+            // 部分写出: 从断点继续
+            op.offset += static_cast<size_t>(res);
+            submit_send(index);
+            return;
+        }
+        if (op.slot >= 0) free_slots_.push_back(static_cast<unsigned>(op.slot));
+        op.slot = -1;
+        op.heap.clear();
+        free_sends_.push_back(index);
+        if (!c) return;
+        c->sending = false;
+        if (res < 0) {
+            close_conn(id_fd(id));
+            return;
+        }
+        if (!c->queued.empty()) {
+            std::string next;
+            next.swap(c->queued);
+            start_send(id, *c, std::move(next));
+        } else if (c->closing) {
+            close_conn(id_fd(id));
+        }
+    }
+
+    void close_conn(int fd) {
+        Conn& c = conns_[fd];
+        if (!c.open) return;
+        uint64_t id = make_id(c.generation, fd);
+        c.open = false;
+        c.queued.clear();
+        // shutdown 让在途的接收以 0 结束、发送以错误结束 (其 CQE 因连接已关闭被忽略)。
+        // 仍有操作在途时不能 close: fd 号会被新连接复用，队列里的 SQE 就会作用到新连接上，
+        // 等最后一个 CQE 到达后由 op_done 释放
+        ::shutdown(fd, SHUT_RDWR);
+        if (c.inflight == 0) release_fd(fd);
+        handler_.on_closed(id);
+    }
+
+    void release_fd(int fd) {
+        conns_[fd].held = false;
+        ::close(fd);
+    }
+
+    // 一个操作的最后一个 CQE 已收到
+    void op_done(int fd) {
+        Conn& c = conns_[fd];
+        if (--c.inflight == 0 && !c.open && c.held) release_fd(fd);
+    }
+
+    void apply_outbox() {
+        outbox_.take(pending_);
+        for (OutboxEntry& entry : pending_) {
+            Conn* c = lookup(entry.id);
+            if (!c || c->closing) continue;
+            if (entry.close) {
+                c->closing = true;
+                if (!c->sending) close_conn(id_fd(entry.id));
+            } else if (c->sending) {
+                c->queued += entry.bytes;
+                if (c->queued.size() > options_.max_queued_bytes) {
+                    // 客户端读得太慢，积压超过上限: 断开，不再为它缓存
+                    close_conn(id_fd(entry.id));
+                }
+            } else {
+                start_send(entry.id, *c, std::move(entry.bytes));
+            }
+        }
+        // 读到 EOF 的连接: 排队的数据 (例如关闭帧的回应) 发完后关闭
+        for (uint64_t id : eof_) {
+            Conn* c = lookup(id);
+            if (!c) continue;
+            c->closing = true;
+            if (!c->sending) close_conn(id_fd(id));
+        }
+        eof_.clear();
+    }
+
+    void handle_accept(int res, uint32_t flags) {
+        if (res >= 0) {
+            int fd = res;
+            set_nodelay(fd);
+            if (static_cast<size_t>(fd) >= conns_.size()) conns_.resize(fd + 1024);
+            Conn& c = conns_[fd];
+            ++c.generation;
+            c.open = c.held = true;
+            c.closing = c.sending = false;
+            c.queued.clear();
+            uint64_t id = make_id(c.generation, fd);
+            handler_.on_accept(id);
+            if (lookup(id)) arm_recv(id);
+        }
+        if (!(flags & IORING_CQE_F_MORE) && running_) arm_accept();
+    }
+
+    void handle_recv(uint64_t id, int res, uint32_t flags) {
+        bool has_buffer = (flags & IORING_CQE_F_BUFFER) != 0;
+        uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0 && has_buffer && lookup(id)) {
+            handler_.on_data(id, recv_slab_ + static_cast<size_t>(bid) * options_.recv_buffer_size,
+                             static_cast<size_t>(res));
+        }
+        if (has_buffer) recycle_buffer(bid);
+
+        if (!lookup(id)) return;
+        if (res == -EINVAL && multishot_recv_) {
+            // 内核不支持多路接收 (6.0 之前): 退回每次重新提交的单次接收
+            multishot_recv_ = false;
+            arm_recv(id);
+            return;
+        }
+        if (res == 0) {
+            // 对端半关闭: 回调刚排队的数据还在发件箱里，等下一轮 apply_outbox 发出后再关闭
+            eof_.push_back(id);
+            return;
+        }
+        if (res < 0 && res != -ENOBUFS) {
+            close_conn(id_fd(id));
+            return;
+        }
+        if (!(flags & IORING_CQE_F_MORE)) arm_recv(id);
+    }
+
+    void reap() {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                uint64_t data = cqe.user_data;
+                int res = cqe.res;
+                uint32_t flags = cqe.flags;
+                uint64_t value = data & ((uint64_t(1) << 56) - 1);
+                switch (static_cast<Op>(data >> 56)) {
+                case OP_ACCEPT:
+                    handle_accept(res, flags);
+                    break;
+                case OP_RECV:
+                    handle_recv(value, res, flags);
+                    if (!(flags & IORING_CQE_F_MORE)) op_done(id_fd(value));
+                    break;
+                case OP_SEND:
+                    op_done(id_fd(sends_[value].conn));
+                    finish_send(static_cast<uint32_t>(value), res);
+                    break;
+                case OP_WAKE:
+                    if (running_) arm_wake();
+                    break;
+                }
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    TransportOptions options_;
+    TransportHandler& handler_;
+    Outbox outbox_;
+    std::atomic<bool> running_{true};
+    int listen_fd_ = -1;
+
+    int ring_fd_ = -1;
+    void* ring_ptr_ = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    io_uring_buf_ring* buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    uint8_t* recv_slab_ = nullptr;
+    size_t recv_slab_size_ = 0;
+    uint16_t buf_tail_ = 0;
+    unsigned buf_mask_ = 0;
+    bool multishot_recv_ = true;
+
+    uint8_t* send_slab_ = nullptr;
+    size_t send_slab_size_ = 0;
+    std::vector<unsigned> free_slots_;
+    std::deque<SendOp> sends_;
+    std::vector<uint32_t> free_sends_;
+
+    uint64_t wake_value_ = 0;
+    std::vector<Conn> conns_;
+    std::vector<OutboxEntry> pending_;
+    std::vector<uint64_t> eof_;
+};
+#endif // VAD_NO_IO_URING
+
+} // namespace
+
+int open_listen_socket(uint16_t port) {
+    int fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    bool v6 = fd >= 0;
+    if (!v6) fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    int rc;
+    if (v6) {
+        int zero = 0;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        sockaddr_in6 addr = {};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_any;
+        addr.sin6_port = htons(port);
+        rc = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    } else {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        rc = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+    if (rc < 0 || listen(fd, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on port " << port << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::unique_ptr<TransportBackend> make_epoll_transport(const TransportOptions& options, TransportHandler& handler) {
+    std::unique_ptr<EpollTransport> transport(new EpollTransport(options, handler));
+    if (!transport->ok()) return nullptr;
+    return transport;
+}
+
+std::unique_ptr<TransportBackend> make_uring_transport(const TransportOptions& options, TransportHandler& handler) {
+#ifdef VAD_NO_IO_URING
+    (void)options;
+    (void)handler;
+    return nullptr;
+#else
+    std::unique_ptr<UringTransport> transport(new UringTransport(options, handler));
+    if (!transport->init()) return nullptr;
+    return transport;
+#endif
+}
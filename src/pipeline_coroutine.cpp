@@ -0,0 +1,46 @@
+#include "pipeline_coroutine.h"
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <iostream>
+
+#if !defined(BOOST_ASIO_HAS_CO_AWAIT)
+#error "pipeline_coroutine.cpp requires C++20 coroutines (build with -DVAD_COROUTINES=ON)"
+#endif
+
+namespace {
+
+boost::asio::awaitable<void> run(boost::asio::io_context& context, boost::asio::steady_timer& signal,
+                                 std::function<PipelineStep()> step, std::shared_ptr<void> keep_alive) {
+    for (;;) {
+        PipelineStep next = step();
+        if (next == PipelineStep::DONE) break;
+        if (next == PipelineStep::RAN) {
+            // 每个任务后让出一次，同一工作线程上的其他会话协程按到达顺序轮转
+            co_await boost::asio::post(context, boost::asio::use_awaitable);
+            continue;
+        }
+        // 永不到期的定时器: push/close 在同一个 io_context 上取消它来唤醒协程
+        boost::system::error_code ec;
+        signal.expires_at(boost::asio::steady_timer::time_point::max());
+        co_await signal.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    }
+    keep_alive.reset();
+}
+
+} // namespace
+
+void spawn_pipeline_coroutine(boost::asio::io_context& context, boost::asio::steady_timer& signal,
+                              std::function<PipelineStep()> step, std::shared_ptr<void> keep_alive) {
+    boost::asio::co_spawn(context, run(context, signal, std::move(step), std::move(keep_alive)),
+                          [](std::exception_ptr error) {
+                              if (!error) return;
+                              try {
+                                  std::rethrow_exception(error);
+                              } catch (std::exception& e) {
+                                  std::cerr << "Session pipeline exception: " << e.what() << std::endl;
+                              }
+                          });
+}
@@ -0,0 +1,179 @@
+// 抓包回放: 按原始分块把抓包里的每一帧喂给 Session，以最快速度运行
+// 用于复现线上问题 (打印每个 VAD 事件对应的帧与抓包时间)，也可作为离线吞吐基准
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include "capture_log.h"
+#include "session.h"
+#include "vad_model.h"
+
+namespace {
+
+struct ReplaySession {
+    std::unique_ptr<Session> session;
+    AudioFormat format;
+    uint64_t frames = 0;
+    uint64_t events = 0;
+    bool closed = false;
+};
+
+void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " <capture.log> [options]\n"
+              << "  --session KEY   only replay sessions with this capture key (in every run)\n"
+              << "  --model PATH    silero model (default ../model/silero_vad.onnx)\n"
+              << "  --quiet         do not print individual VAD events\n";
+}
+
+// 从响应中取出 vad_state 字段 (响应由 Session 自己生成，格式固定)
+std::string extract_state(const std::string& response) {
+    static const char kKey[] = "\"vad_state\":\"";
+    size_t pos = response.find(kKey);
+    if (pos == std::string::npos) return "";
+    pos += sizeof(kKey) - 1;
+    size_t end = response.find('"', pos);
+    return response.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2 || std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    std::string path = argv[1];
+    bool quiet = false;
+    bool filter = false;
+    uint64_t only_session = 0;
+    VadModelOptions model_options;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--session" && i + 1 < argc) {
+            filter = true;
+            only_session = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--model" && i + 1 < argc) {
+            model_options.model_path = argv[++i];
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    capture::Reader reader(path);
+    if (!reader.is_open()) {
+        std::cerr << "Cannot open capture log " << path << std::endl;
+        return 1;
+    }
+
+    // 模型加载不计入回放耗时
+    VadModel::configure(model_options);
+    VadModel::get();
+
+    DecoderPool decoder_pool;
+    // 会话键只在一次运行内唯一，按 (运行序号, 会话键) 区分；旧文件没有 RUN_START，运行序号为 0
+    std::map<std::pair<uint32_t, uint64_t>, ReplaySession> sessions;
+    std::string out;
+    uint64_t total_frames = 0;
+    uint64_t total_events = 0;
+    double pcm_audio_sec = 0.0;
+    uint32_t run = 0;
+    // 各次运行的时间基准不同，抓包时长按运行分别累计
+    double captured_sec = 0.0;
+    uint64_t first_us = 0, last_us = 0;
+    bool have_time = false;
+
+    auto start = std::chrono::steady_clock::now();
+    capture::Reader::Record record;
+    while (reader.next(record)) {
+        const capture::RecordHeader& h = record.header;
+        if (h.type == capture::RUN_START) {
+            uint64_t unix_us = 0;
+            uint32_t pid = 0;
+            if (have_time) captured_sec += (last_us - first_us) / 1e6;
+            have_time = false;
+            ++run;
+            if (!quiet && capture::Reader::parse_run_start(record, unix_us, pid)) {
+                std::cout << "run=" << run << " pid=" << pid << " unix_us=" << unix_us << std::endl;
+            }
+            continue;
+        }
+        if (filter && h.session != only_session) continue;
+        if (!have_time) {
+            first_us = h.timestamp_us;
+            have_time = true;
+        }
+        last_us = h.timestamp_us;
+
+        switch (h.type) {
+        case capture::SESSION_OPEN: {
+            ReplaySession& rs = sessions[std::make_pair(run, h.session)];
+            std::string uid;
+            if (!capture::Reader::parse_open(record, rs.format, uid)) break;
+            rs.session.reset(new Session(uid, websocketpp::connection_hdl(), rs.format, &decoder_pool));
+            break;
+        }
+        case capture::SESSION_META: {
+            auto it = sessions.find(std::make_pair(run, h.session));
+            if (it == sessions.end() || !it->second.session) break;
+            std::string uid, connect_session, current_session;
+            if (!capture::Reader::parse_meta(record, uid, connect_session, current_session)) break;
+            // 与 AudioServer::worker_loop 相同: 空字段不覆盖
+            Session& s = *it->second.session;
+            if (!uid.empty()) s.set_id(uid);
+            if (!connect_session.empty()) s.set_connect_session(connect_session);
+            if (!current_session.empty()) s.set_current_session(current_session);
+            break;
+        }
+        case capture::FRAME: {
+            auto it = sessions.find(std::make_pair(run, h.session));
+            if (it == sessions.end() || !it->second.session) break;
+            ReplaySession& rs = it->second;
+            ++rs.frames;
+            ++total_frames;
+            if (rs.format.codec == AudioCodec::PCM) {
+                pcm_audio_sec += static_cast<double>(h.length) /
+                                 (rs.format.frame_bytes() * static_cast<double>(rs.format.sample_rate));
+            }
+            if (rs.session->process_audio(record.payload, h.length, out)) {
+                ++rs.events;
+                ++total_events;
+                if (!quiet) {
+                    std::cout << "run=" << run << " session=" << h.session << " frame=" << rs.frames
+                              << " t_us=" << h.timestamp_us << " state=" << extract_state(out) << std::endl;
+                }
+            }
+            break;
+        }
+        case capture::SESSION_CLOSE: {
+            // 连接关闭后工作线程可能还在处理已取出的帧，所以回放不立即销毁会话
+            auto it = sessions.find(std::make_pair(run, h.session));
+            if (it != sessions.end()) it->second.closed = true;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    double wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (have_time) captured_sec += (last_us - first_us) / 1e6;
+
+    std::cout << "Replayed " << sessions.size() << " sessions, " << total_frames << " frames, " << total_events
+              << " events in " << wall_sec << " s (captured span " << captured_sec << " s in " << run << " runs)"
+              << std::endl;
+    if (pcm_audio_sec > 0 && wall_sec > 0) {
+        std::cout << "PCM audio: " << pcm_audio_sec << " s, " << pcm_audio_sec / wall_sec << "x realtime"
+                  << std::endl;
+    }
+    for (const auto& kv : sessions) {
+        std::cout << "  run " << kv.first.first << " session " << kv.first.second << ": " << kv.second.frames
+                  << " frames, " << kv.second.events << " events" << (kv.second.closed ? "" : " (no close record)") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "resampler.h"
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// 单边过零点数量，决定过渡带宽度
+const int kZeroCrossings = 8;
+// Kaiser 窗 beta，约 60dB 阻带衰减，对 VAD 足够
+const double kKaiserBeta = 6.0;
+// 截止频率相对目标奈奎斯特频率的比例，留出过渡带
+const double kRolloff = 0.92;
+
+double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// taps 已按 4 对齐，系数尾部以 0 填充
+inline float dot(const float* a, const float* b, size_t taps) {
+#if defined(__SSE__)
+    __m128 acc = _mm_setzero_ps();
+    for (size_t k = 0; k < taps; k += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__ARM_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (size_t k = 0; k < taps; k += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + k), vld1q_f32(b + k));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (size_t k = 0; k < taps; k += 4) {
+        acc[0] += a[k] * b[k];
+        acc[1] += a[k + 1] * b[k + 1];
+        acc[2] += a[k + 2] * b[k + 2];
+        acc[3] += a[k + 3] * b[k + 3];
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+} // namespace
+
+void pcm16_to_mono_float(const uint8_t* pcm, size_t frames, int channels, float* out) {
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; ++i) {
+            int16_t s = static_cast<int16_t>(pcm[2 * i] | (pcm[2 * i + 1] << 8));
+            out[i] = s / 32768.0f;
+        }
+        return;
+    }
+    const float scale = 1.0f / (32768.0f * channels);
+    const size_t stride = static_cast<size_t>(channels) * 2;
+    for (size_t i = 0; i < frames; ++i) {
+        const uint8_t* p = pcm + i * stride;
+        int32_t sum = 0;
+        for (int c = 0; c < channels; ++c) {
+            sum += static_cast<int16_t>(p[2 * c] | (p[2 * c + 1] << 8));
+        }
+        out[i] = sum * scale;
+    }
+}
+
+PolyphaseResampler::PolyphaseResampler(int in_rate, int out_rate)
+    : in_rate_(in_rate), out_rate_(out_rate) {
+    int g = std::gcd(in_rate, out_rate);
+    up_ = out_rate / g;
+    down_ = in_rate / g;
+
+    // 降采样时滤波器要按 M/L 拉长，保证截止点处仍有 kZeroCrossings 个过零点
+    double ratio = std::max(1.0, static_cast<double>(down_) / up_);
+    size_t raw_taps = static_cast<size_t>(std::ceil(2 * kZeroCrossings * ratio));
+    taps_ = (raw_taps + 3) & ~static_cast<size_t>(3);
+
+    // 原型滤波器工作在 in_rate * L 的上采样率上，长度 taps_ * L
+    // 归一化截止频率 (cycles/sample)
+    double fc = 0.5 * kRolloff / std::max(up_, down_);
+    size_t proto_len = taps_ * up_;
+    double center = (raw_taps * up_ - 1) / 2.0;
+    double i0_beta = bessel_i0(kKaiserBeta);
+
+    coeffs_.assign(proto_len, 0.0f);
+    for (int phase = 0; phase < up_; ++phase) {
+        for (size_t j = 0; j < raw_taps; ++j) {
+            // 原型中第 phase + j*L 个系数作用于 x[base - j]
+            size_t idx = phase + j * up_;
+            double t = idx - center;
+            double x = 2.0 * fc * t;
+            double sinc = (std::fabs(x) < 1e-12) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+            double r = t / (center + 1.0);
+            double w = (std::fabs(r) >= 1.0) ? 0.0 : bessel_i0(kKaiserBeta * std::sqrt(1.0 - r * r)) / i0_beta;
+            // 增益 L 补偿插零带来的能量损失
+            double h = 2.0 * fc * sinc * w * up_;
+            // 倒序存放: coeffs 第 k 个作用于 buf 中 base+k (即 x[base-(taps-1)+k])
+            coeffs_[phase * taps_ + (taps_ - 1 - j)] = static_cast<float>(h);
+        }
+    }
+
+    reset();
+}
+
+void PolyphaseResampler::reset() {
+    buf_.assign(taps_ - 1, 0.0f);
+    pos_ = 0;
+}
+
+void PolyphaseResampler::trim() {
+    // 调用之间 buf_ 只保存 taps_-1 个历史样本；常规大小的包 (48k 下约 170ms 以内) 撑出的容量保留
+    if (buf_.capacity() <= taps_ + 8192) return;
+    std::vector<float> history(buf_.begin(), buf_.end());
+    buf_.swap(history);
+}
+
+void PolyphaseResampler::save_state(snapshot::Writer& w) const {
+    w.put<int32_t>(in_rate_);
+    w.put<int32_t>(out_rate_);
+    w.put(pos_);
+    w.put_floats(buf_.data(), buf_.size());
+}
+
+bool PolyphaseResampler::load_state(snapshot::Reader& r) {
+    int32_t in_rate = 0, out_rate = 0;
+    uint64_t pos = 0;
+    std::vector<float> history;
+    r.get(in_rate);
+    r.get(out_rate);
+    r.get(pos);
+    r.get_floats(history);
+    if (!r.ok() || in_rate != in_rate_ || out_rate != out_rate_ || history.size() != taps_ - 1) return false;
+    buf_ = std::move(history);
+    pos_ = pos;
+    return true;
+}
+
+void PolyphaseResampler::process(const float* in, size_t n, std::vector<float>& out) {
+    if (n == 0) return;
+    const size_t history = taps_ - 1;
+    buf_.resize(history + n);
+    std::copy(in, in + n, buf_.begin() + history);
+
+    const uint64_t limit = static_cast<uint64_t>(n) * up_;
+    out.reserve(out.size() + static_cast<size_t>((limit - std::min(limit, pos_)) / down_ + 1));
+    const float* base_ptr = buf_.data();
+    while (pos_ < limit) {
+        size_t base = static_cast<size_t>(pos_ / up_);
+        size_t phase = static_cast<size_t>(pos_ % up_);
+        // buf_[base .. base+taps_-1] 对应 x[base-(taps-1) .. base]
+        out.push_back(dot(coeffs_.data() + phase * taps_, base_ptr + base, taps_));
+        pos_ += down_;
+    }
+    pos_ -= limit;
+
+    // 保留最后 taps_-1 个样本作为下一次的历史
+    std::copy(buf_.end() - history, buf_.end(), buf_.begin());
+    buf_.resize(history);
+}
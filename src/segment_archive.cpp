@@ -0,0 +1,171 @@
+#include "segment_archive.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "wav.h"
+
+namespace {
+
+// uid 由客户端给出，只保留文件名安全的字符
+void append_safe(std::string& out, const std::string& s) {
+    for (char c : s) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '_';
+        out += ok ? c : '_';
+    }
+}
+
+void update_peak(std::atomic<size_t>& peak, size_t value) {
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+SegmentArchive::SegmentArchive(const ArchiveOptions& options) : options_(options) {
+    while (options_.directory.size() > 1 && options_.directory.back() == '/') options_.directory.pop_back();
+}
+
+SegmentArchive::~SegmentArchive() {
+    stop();
+}
+
+bool SegmentArchive::start() {
+    struct stat st;
+    if (stat(options_.directory.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+        access(options_.directory.c_str(), W_OK) != 0) {
+        std::cerr << "Archive directory " << options_.directory << " is not a writable directory" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    thread_ = std::thread(&SegmentArchive::run, this);
+    return true;
+}
+
+void SegmentArchive::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+        stopping_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable()) thread_.join();
+}
+
+bool SegmentArchive::submit(const SpeechSegmentInfo& info, std::vector<uint8_t>& pcm) {
+    size_t bytes = pcm.size();
+    size_t segments = 0;
+    size_t total = 0;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return false;
+        segments = queue_segments_.load(std::memory_order_relaxed) + 1;
+        total = queue_bytes_.load(std::memory_order_relaxed) + bytes;
+        if (segments > options_.max_queue_segments || total > options_.max_queue_bytes) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queue_segments_.store(segments, std::memory_order_relaxed);
+        queue_bytes_.store(total, std::memory_order_relaxed);
+        wake = queue_.empty();
+        queue_.push_back(Item{info, std::move(pcm)});
+    }
+    pcm = std::vector<uint8_t>();
+    if (wake) cond_.notify_one();
+    update_peak(peak_segments_, segments);
+    update_peak(peak_bytes_, total);
+    return true;
+}
+
+void SegmentArchive::run() {
+    std::vector<Item> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            // 停止时也先写完已排队的段
+            if (queue_.empty()) return;
+            batch.swap(queue_);
+        }
+        for (Item& item : batch) {
+            auto begin = std::chrono::steady_clock::now();
+            size_t bytes = write_segment(item);
+            if (bytes > 0) {
+                written_.fetch_add(1, std::memory_order_relaxed);
+                written_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            } else {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+            busy_us_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - begin).count(),
+                               std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_segments_.fetch_sub(1, std::memory_order_relaxed);
+                queue_bytes_.fetch_sub(item.pcm.size(), std::memory_order_relaxed);
+            }
+            // 段缓冲区在归档线程上释放
+            std::vector<uint8_t>().swap(item.pcm);
+        }
+        batch.clear();
+    }
+}
+
+size_t SegmentArchive::write_segment(const Item& item) {
+    std::string path = options_.directory + '/' + options_.prefix;
+    append_safe(path, item.info.uid.empty() ? std::string("session") : item.info.uid);
+    path += '_';
+    append_safe(path, item.info.new_session);
+    path += ".wav";
+    std::string tmp = path + ".tmp";
+
+    int channels = item.info.channels > 0 ? item.info.channels : 1;
+    size_t data_size = item.pcm.size() / (2 * channels) * (2 * channels);
+    wav::WavHeader header;
+    wav::FillHeader(&header, channels, item.info.sample_rate, 16, static_cast<uint32_t>(data_size));
+
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot create " << tmp << ": " << std::strerror(errno) << std::endl;
+        return 0;
+    }
+    // 头与负载一次写出 (短写时从断点继续)
+    iovec iov[2] = {{&header, sizeof(header)}, {const_cast<uint8_t*>(item.pcm.data()), data_size}};
+    int first = 0;
+    size_t remaining = sizeof(header) + data_size;
+    bool ok = true;
+    while (remaining > 0) {
+        ssize_t n = ::writev(fd, iov + first, 2 - first);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ok = false;
+            break;
+        }
+        remaining -= static_cast<size_t>(n);
+        size_t advance = static_cast<size_t>(n);
+        while (first < 2 && advance >= iov[first].iov_len) {
+            advance -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < 2) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + advance;
+            iov[first].iov_len -= advance;
+        }
+    }
+    if (::close(fd) != 0) ok = false;
+    if (ok && std::rename(tmp.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Cannot write " << path << ": " << std::strerror(errno) << std::endl;
+        ::unlink(tmp.c_str());
+    }
+    return ok ? sizeof(header) + data_size : 0;
+}
@@ -0,0 +1,513 @@
+#include "segment_forwarder.h"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "base64.h"
+#include "json_writer.h"
+#include "ws_protocol.h"
+
+namespace {
+
+enum MessageType : uint8_t {
+    MSG_START = 1,
+    MSG_AUDIO = 2,
+    MSG_END = 3,
+};
+
+// 下游回包只需检测断开，读出后丢弃
+const size_t kReadChunk = 16 * 1024;
+
+// 响应头 [0, end) 中名为 name (小写) 的字段值，去掉首尾空白；没有时返回空串
+std::string header_value(const std::string& response, size_t end, const char* name) {
+    size_t name_len = std::strlen(name);
+    size_t line = response.find("\r\n");
+    while (line != std::string::npos && line < end) {
+        line += 2;
+        size_t eol = response.find("\r\n", line);
+        if (eol == std::string::npos || eol > end) eol = end;
+        size_t colon = response.find(':', line);
+        if (colon != std::string::npos && colon < eol && colon - line == name_len) {
+            bool match = true;
+            for (size_t i = 0; i < name_len && match; ++i) {
+                match = std::tolower(static_cast<unsigned char>(response[line + i])) == name[i];
+            }
+            if (match) {
+                size_t begin = colon + 1;
+                while (begin < eol && (response[begin] == ' ' || response[begin] == '\t')) ++begin;
+                size_t stop = eol;
+                while (stop > begin && (response[stop - 1] == ' ' || response[stop - 1] == '\t')) --stop;
+                return response.substr(begin, stop - begin);
+            }
+        }
+        line = eol;
+    }
+    return std::string();
+}
+
+} // namespace
+
+struct SegmentForwarder::Segment {
+    uint64_t id = 0;
+    std::string pending; // 尚未绑定连接时累积的帧
+    Upstream* upstream = nullptr;
+    size_t audio_bytes = 0;
+    bool ended = false;
+};
+
+struct SegmentForwarder::Upstream {
+    enum class State { CONNECTING, HANDSHAKE, READY } state = State::CONNECTING;
+    int fd = -1;
+    std::string out;
+    size_t out_pos = 0;
+    std::string in;  // 握手响应
+    std::string key; // 本连接的 Sec-WebSocket-Key
+    bool writing = false; // 已注册 EPOLLOUT
+    bool idle = false;
+    std::shared_ptr<Segment> segment;
+};
+
+SegmentForwarder::SegmentForwarder(const ForwarderOptions& options) : options_(options) {
+    options_.max_connections = std::max<size_t>(1, options_.max_connections);
+}
+
+SegmentForwarder::~SegmentForwarder() {
+    stop();
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    if (event_fd_ >= 0) ::close(event_fd_);
+}
+
+bool SegmentForwarder::start() {
+    // ws://host:port/path 或 tcp://host:port
+    std::string rest;
+    if (options_.url.compare(0, 5, "ws://") == 0) {
+        websocket_ = true;
+        rest = options_.url.substr(5);
+    } else if (options_.url.compare(0, 6, "tcp://") == 0) {
+        rest = options_.url.substr(6);
+    } else {
+        std::cerr << "ASR forward URL must start with ws:// or tcp://: " << options_.url << std::endl;
+        return false;
+    }
+    size_t slash = rest.find('/');
+    path_ = slash == std::string::npos ? "/" : rest.substr(slash);
+    host_header_ = rest.substr(0, slash);
+    std::string host = host_header_;
+    std::string port = websocket_ ? "80" : "";
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos && host.find(']', colon) == std::string::npos) {
+        port = host.substr(colon + 1);
+        host = host.substr(0, colon);
+    }
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+    if (host.empty() || port.empty()) {
+        std::cerr << "ASR forward URL needs host:port: " << options_.url << std::endl;
+        return false;
+    }
+
+    // 启动时解析一次，之后建连不再查询 DNS
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0 || !result) {
+        std::cerr << "Cannot resolve ASR forward host " << host << ": " << gai_strerror(rc) << std::endl;
+        return false;
+    }
+    const uint8_t* addr = reinterpret_cast<const uint8_t*>(result->ai_addr);
+    address_.assign(addr, addr + result->ai_addrlen);
+    freeaddrinfo(result);
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || event_fd_ < 0) return false;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = event_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+
+    running_ = true;
+    thread_ = std::thread(&SegmentForwarder::run, this);
+    return true;
+}
+
+void SegmentForwarder::stop() {
+    if (running_.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t n = ::write(event_fd_, &one, sizeof(one));
+        (void)n;
+    }
+    if (thread_.joinable()) thread_.join();
+    for (auto& entry : upstreams_) ::close(entry.first);
+    upstreams_.clear();
+    idle_.clear();
+    segments_.clear();
+    waiting_.clear();
+    // epoll_fd_ 与 event_fd_ 留到析构时关闭: 工作线程的 push() 可能刚看过 running_ 还在写 eventfd，
+    // 此时关闭会让它写到被复用的 fd 上
+}
+
+void SegmentForwarder::frame(std::string& out, uint8_t type, const uint8_t* data, size_t len) const {
+    if (websocket_) {
+        thread_local std::mt19937 rng(std::random_device{}());
+        ws::append_client_frame(out, type == MSG_AUDIO ? ws::BINARY : ws::TEXT, data, len, rng());
+        return;
+    }
+    char header[5] = {static_cast<char>(type), static_cast<char>(len >> 24), static_cast<char>(len >> 16),
+                      static_cast<char>(len >> 8), static_cast<char>(len)};
+    out.append(header, sizeof(header));
+    out.append(reinterpret_cast<const char*>(data), len);
+}
+
+uint64_t SegmentForwarder::begin_segment(const SpeechSegmentInfo& info) {
+    uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    std::string meta = "{\"type\":\"start\",";
+    json_writer::append_string_field(meta, "uid", info.uid);
+    meta += ',';
+    json_writer::append_string_field(meta, "connect_session", info.connect_session);
+    meta += ',';
+    json_writer::append_string_field(meta, "current_session", info.current_session);
+    meta += ',';
+    json_writer::append_string_field(meta, "new_session", info.new_session);
+    meta += ",\"sample_rate\":" + std::to_string(info.sample_rate) + ",\"channels\":" +
+            std::to_string(info.channels) + ",\"codec\":\"pcm_s16le\"}";
+    Command command{Command::BEGIN, id, 0, std::string()};
+    frame(command.bytes, MSG_START, reinterpret_cast<const uint8_t*>(meta.data()), meta.size());
+    push(std::move(command));
+    return id;
+}
+
+void SegmentForwarder::segment_audio(uint64_t id, const uint8_t* data, size_t len) {
+    if (len == 0) return;
+    Command command{Command::AUDIO, id, len, std::string()};
+    command.bytes.reserve(len + 16);
+    frame(command.bytes, MSG_AUDIO, data, len);
+    push(std::move(command));
+}
+
+void SegmentForwarder::end_segment(uint64_t id, bool aborted) {
+    std::string meta = aborted ? "{\"type\":\"end\",\"aborted\":true}" : "{\"type\":\"end\",\"aborted\":false}";
+    Command command{Command::END, id, 0, std::string()};
+    frame(command.bytes, MSG_END, reinterpret_cast<const uint8_t*>(meta.data()), meta.size());
+    push(std::move(command));
+}
+
+void SegmentForwarder::push(Command&& command) {
+    if (!running_.load(std::memory_order_relaxed)) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        commands_.push_back(std::move(command));
+    }
+    // 同一轮内多次追加只唤醒一次 I/O 线程
+    if (!signaled_.exchange(true)) {
+        uint64_t one = 1;
+        ssize_t n = ::write(event_fd_, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+void SegmentForwarder::run() {
+    epoll_event events[128];
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, 128, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == event_fd_) {
+                uint64_t value;
+                ssize_t r = ::read(event_fd_, &value, sizeof(value));
+                (void)r;
+                // 先清除唤醒标记再取，之后的追加会重新写 eventfd
+                signaled_.store(false);
+                pending_commands_.clear();
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pending_commands_.swap(commands_);
+                }
+                for (Command& command : pending_commands_) apply(command);
+                continue;
+            }
+            auto it = upstreams_.find(fd);
+            if (it != upstreams_.end()) on_event(*it->second, events[i].events);
+        }
+    }
+}
+
+void SegmentForwarder::apply(Command& command) {
+    if (command.type == Command::BEGIN) {
+        auto segment = std::make_shared<Segment>();
+        segment->id = command.id;
+        segment->pending = std::move(command.bytes);
+        segments_[command.id] = segment;
+        bind(segment);
+        return;
+    }
+
+    // 已放弃 (积压超限、连接失败) 的段，后续帧直接丢弃
+    auto it = segments_.find(command.id);
+    if (it == segments_.end()) return;
+    std::shared_ptr<Segment> segment = it->second;
+    segment->audio_bytes += command.audio_bytes;
+    if (command.type == Command::END) segment->ended = true;
+    Upstream* upstream = segment->upstream;
+    if (!upstream) {
+        segment->pending += command.bytes;
+        if (segment->pending.size() > options_.max_backlog_bytes) drop(*segment);
+        return;
+    }
+    upstream->out += command.bytes;
+    if (upstream->out.size() - upstream->out_pos > options_.max_backlog_bytes) {
+        // 已写出半个消息流，只能断开连接
+        fail(*upstream);
+        return;
+    }
+    flush(*upstream);
+}
+
+void SegmentForwarder::bind(const std::shared_ptr<Segment>& segment) {
+    Upstream* upstream = nullptr;
+    if (!idle_.empty()) {
+        upstream = idle_.back();
+        idle_.pop_back();
+        upstream->idle = false;
+    } else if (upstreams_.size() < options_.max_connections) {
+        upstream = connect_upstream();
+        if (!upstream) {
+            drop(*segment);
+            return;
+        }
+    } else {
+        waiting_.push_back(segment);
+        return;
+    }
+    upstream->segment = segment;
+    segment->upstream = upstream;
+    upstream->out += segment->pending;
+    segment->pending.clear();
+    segment->pending.shrink_to_fit();
+    flush(*upstream);
+}
+
+void SegmentForwarder::release(Upstream& upstream) {
+    upstream.segment.reset();
+    // 优先交给排队的段，否则回到空闲列表
+    while (!waiting_.empty()) {
+        std::shared_ptr<Segment> segment = waiting_.front();
+        waiting_.pop_front();
+        if (segments_.count(segment->id) == 0) continue;
+        upstream.segment = segment;
+        segment->upstream = &upstream;
+        upstream.out += segment->pending;
+        segment->pending.clear();
+        segment->pending.shrink_to_fit();
+        flush(upstream);
+        return;
+    }
+    upstream.idle = true;
+    idle_.push_back(&upstream);
+}
+
+SegmentForwarder::Upstream* SegmentForwarder::connect_upstream() {
+    int fd = socket(reinterpret_cast<const sockaddr*>(address_.data())->sa_family,
+                    SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        connect_failures_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, reinterpret_cast<const sockaddr*>(address_.data()), static_cast<socklen_t>(address_.size())) < 0 &&
+        errno != EINPROGRESS) {
+        ::close(fd);
+        connect_failures_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    std::unique_ptr<Upstream> upstream(new Upstream());
+    upstream->fd = fd;
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    upstream->writing = true;
+    connections_opened_.fetch_add(1, std::memory_order_relaxed);
+    Upstream* raw = upstream.get();
+    upstreams_[fd] = std::move(upstream);
+    return raw;
+}
+
+void SegmentForwarder::on_event(Upstream& upstream, uint32_t events) {
+    if (upstream.state == Upstream::State::CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(upstream.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (events & EPOLLERR)) {
+            connect_failures_.fetch_add(1, std::memory_order_relaxed);
+            fail(upstream);
+            return;
+        }
+        if (!(events & EPOLLOUT)) return;
+        if (!websocket_) {
+            upstream.state = Upstream::State::READY;
+            flush(upstream);
+            return;
+        }
+        // 每个连接一个随机的 16 字节 key (RFC 6455 4.1)，应答里的 Sec-WebSocket-Accept 据此校验
+        uint8_t nonce[16];
+        for (size_t i = 0; i < sizeof(nonce); i += 4) {
+            uint32_t r = key_rng_();
+            std::memcpy(nonce + i, &r, 4);
+        }
+        upstream.key.clear();
+        base64::encode_append(upstream.key, nonce, sizeof(nonce));
+        // 握手请求很短，新连接的发送缓冲区一定放得下
+        std::string request = "GET " + path_ + " HTTP/1.1\r\n"
+                              "Host: " + host_header_ + "\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: " + upstream.key + "\r\n"
+                              "Sec-WebSocket-Version: 13\r\n\r\n";
+        if (::send(upstream.fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+            connect_failures_.fetch_add(1, std::memory_order_relaxed);
+            fail(upstream);
+            return;
+        }
+        upstream.state = Upstream::State::HANDSHAKE;
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = upstream.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, upstream.fd, &ev);
+        upstream.writing = false;
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char buf[kReadChunk];
+        for (;;) {
+            ssize_t n = ::recv(upstream.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                if (upstream.state == Upstream::State::HANDSHAKE) upstream.in.append(buf, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(buf)) break;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (upstream.state == Upstream::State::HANDSHAKE) connect_failures_.fetch_add(1, std::memory_order_relaxed);
+            fail(upstream);
+            return;
+        }
+        if (upstream.state == Upstream::State::HANDSHAKE) {
+            size_t end = upstream.in.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                if (upstream.in.size() > 8192) fail(upstream);
+                return;
+            }
+            if (upstream.in.compare(0, 12, "HTTP/1.1 101") != 0) {
+                std::cerr << "ASR sink refused the WebSocket upgrade: " << upstream.in.substr(0, upstream.in.find('\r'))
+                          << std::endl;
+                connect_failures_.fetch_add(1, std::memory_order_relaxed);
+                fail(upstream);
+                return;
+            }
+            if (header_value(upstream.in, end, "sec-websocket-accept") != ws::accept_key(upstream.key)) {
+                std::cerr << "ASR sink answered the WebSocket upgrade with a wrong Sec-WebSocket-Accept" << std::endl;
+                connect_failures_.fetch_add(1, std::memory_order_relaxed);
+                fail(upstream);
+                return;
+            }
+            upstream.in.clear();
+            upstream.in.shrink_to_fit();
+            upstream.state = Upstream::State::READY;
+            flush(upstream);
+            return;
+        }
+    }
+    if ((events & EPOLLOUT) && upstream.state == Upstream::State::READY) flush(upstream);
+}
+
+void SegmentForwarder::flush(Upstream& upstream) {
+    if (upstream.state != Upstream::State::READY) return;
+    while (upstream.out_pos < upstream.out.size()) {
+        ssize_t n = ::send(upstream.fd, upstream.out.data() + upstream.out_pos, upstream.out.size() - upstream.out_pos,
+                           MSG_NOSIGNAL);
+        if (n > 0) {
+            upstream.out_pos += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 下游读取跟不上: 等可写再继续，期间新帧累积在 out 中 (受 max_backlog_bytes 限制)
+            if (!upstream.writing) {
+                epoll_event ev = {};
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.fd = upstream.fd;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, upstream.fd, &ev);
+                upstream.writing = true;
+            }
+            return;
+        }
+        fail(upstream);
+        return;
+    }
+    upstream.out.clear();
+    upstream.out_pos = 0;
+    if (upstream.writing) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = upstream.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, upstream.fd, &ev);
+        upstream.writing = false;
+    }
+    // 段已结束且全部写出: 连接可以复用
+    std::shared_ptr<Segment> segment = upstream.segment;
+    if (segment && segment->ended) {
+        forwarded_.fetch_add(1, std::memory_order_relaxed);
+        audio_bytes_.fetch_add(segment->audio_bytes, std::memory_order_relaxed);
+        segments_.erase(segment->id);
+        release(upstream);
+    }
+}
+
+void SegmentForwarder::fail(Upstream& upstream) {
+    if (upstream.segment) {
+        upstream.segment->upstream = nullptr;
+        drop(*upstream.segment);
+    }
+    if (upstream.idle) {
+        for (size_t i = 0; i < idle_.size(); ++i) {
+            if (idle_[i] == &upstream) {
+                idle_[i] = idle_.back();
+                idle_.pop_back();
+                break;
+            }
+        }
+    }
+    int fd = upstream.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    upstreams_.erase(fd);
+
+    // 排队的段改用新连接
+    while (!waiting_.empty() && upstreams_.size() < options_.max_connections) {
+        std::shared_ptr<Segment> segment = waiting_.front();
+        waiting_.pop_front();
+        if (segments_.count(segment->id) == 0) continue;
+        bind(segment);
+        break;
+    }
+}
+
+void SegmentForwarder::drop(Segment& segment) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    segment.pending.clear();
+    segments_.erase(segment.id);
+}
@@ -1,12 +1,90 @@
 #include "server.h"
 #include <iostream>
 #include <functional>
-#include "json.hpp"
-#include "base64.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <pthread.h>
+#include <random>
+#include <stdexcept>
+#include "json_audio_parser.h"
+#include "native_server.h"
+#include "shm_ingress.h"
 
-using json = nlohmann::json;
+namespace {
+
+// 快照恢复令牌: 64 位随机数的十六进制
+std::string make_resume_token() {
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(rng()));
+    return buf;
+}
+
+} // namespace
+
+AudioServer::AudioServer(const ServerConfig& config)
+    : config_(config), running_(false),
+      session_pool_(config.warm_sessions, config.max_idle_sessions),
+      sessions_(config.max_sessions),
+      egress_(srv_, config.egress_pool_size) {
+    config_.io_threads = std::max<size_t>(1, config_.io_threads);
+    config_.worker_threads = std::max<size_t>(1, config_.worker_threads);
+    for (size_t i = 0; i < config_.worker_threads; ++i) {
+        SchedulerConfig scheduler_config;
+        scheduler_config.policy = config_.schedule;
+        scheduler_config.slice_ms = config_.slice_ms;
+        scheduler_config.quantum_ms = config_.quantum_ms;
+        scheduler_config.catchup_ms = config_.catchup_ms;
+        task_queues_.push_back(std::make_unique<TaskScheduler>(scheduler_config));
+    }
+#ifdef VAD_WITH_COROUTINES
+    if (config_.coroutine_pipeline) pipelines_.reset(new PipelineExecutors(config_.worker_threads));
+#else
+    if (config_.coroutine_pipeline) {
+        std::cerr << "Built without VAD_COROUTINES, using the task queue pipeline" << std::endl;
+        config_.coroutine_pipeline = false;
+    }
+#endif
+    if (config_.transport != ServerConfig::Transport::WEBSOCKETPP) {
+        if (config_.coroutine_pipeline) {
+            std::cerr << "Native transport uses the task queue pipeline" << std::endl;
+            config_.coroutine_pipeline = false;
+#ifdef VAD_WITH_COROUTINES
+            pipelines_.reset();
+#endif
+        }
+        if (config_.rate_limit > 0) std::cerr << "Rate limiting is not supported by the native transport" << std::endl;
+        if (config_.admin_http) std::cerr << "Admin endpoints are not served by the native transport" << std::endl;
+    }
+    if (!config_.shm_socket.empty() && config_.coroutine_pipeline) {
+        // 共享内存接入的任务走工作线程的调度器
+        std::cerr << "Shared-memory ingress uses the task queue pipeline" << std::endl;
+        config_.coroutine_pipeline = false;
+#ifdef VAD_WITH_COROUTINES
+        pipelines_.reset();
+#endif
+    }
+    if (!config_.asr_forward.empty()) {
+        ForwarderOptions options;
+        options.url = config_.asr_forward;
+        options.max_connections = config_.asr_connections;
+        forwarder_.reset(new SegmentForwarder(options));
+    }
+    if (!config_.archive_dir.empty()) {
+        ArchiveOptions options;
+        options.directory = config_.archive_dir;
+        options.prefix = config_.archive_prefix;
+        options.max_queue_bytes = config_.archive_queue_mb << 20;
+        archive_.reset(new SegmentArchive(options));
+    }
+    if (!config_.capture_path.empty()) {
+        capture_.reset(new capture::Writer(config_.capture_path));
+        if (!capture_->is_open()) capture_.reset();
+    }
 
-AudioServer::AudioServer() : running_(false) {
     // 1. 关闭多余日志
     srv_.clear_access_channels(websocketpp::log::alevel::all);
     srv_.set_error_channels(websocketpp::log::elevel::all);
@@ -18,6 +96,20 @@ AudioServer::AudioServer() : running_(false) {
     srv_.set_open_handler(std::bind(&AudioServer::on_open, this, std::placeholders::_1));
     srv_.set_close_handler(std::bind(&AudioServer::on_close, this, std::placeholders::_1));
     srv_.set_message_handler(std::bind(&AudioServer::on_message, this, std::placeholders::_1, std::placeholders::_2));
+    srv_.set_http_handler(std::bind(&AudioServer::on_http, this, std::placeholders::_1));
+    if (config_.reuse_port) {
+        srv_.set_tcp_pre_bind_handler([](server::acceptor_ptr acceptor) -> websocketpp::lib::error_code {
+            typedef websocketpp::lib::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+            boost::system::error_code asio_ec;
+            acceptor->set_option(reuse_port(true), asio_ec);
+            // 设置失败时中止 listen: 否则会静默地变成独占端口，其他进程绑定失败
+            if (asio_ec) {
+                std::cerr << "Cannot set SO_REUSEPORT: " << asio_ec.message() << std::endl;
+                return asio_ec;
+            }
+            return websocketpp::lib::error_code();
+        });
+    }
 }
 
 AudioServer::~AudioServer() {
@@ -25,121 +117,872 @@ AudioServer::~AudioServer() {
 }
 
 void AudioServer::run(uint16_t port) {
+    // 在主线程上加载模型 (失败时异常交给 main 处理)，工作线程随后各自预热
+    VadModel::get();
+    if (forwarder_ && !forwarder_->start()) throw std::runtime_error("cannot start ASR forwarding");
+    if (archive_ && !archive_->start()) throw std::runtime_error("cannot start segment archive");
+
     // 启动工作线程
     running_ = true;
-    worker_thread_ = std::thread(&AudioServer::worker_loop, this);
+    for (size_t i = 0; i < config_.worker_threads; ++i) {
+#ifdef VAD_WITH_COROUTINES
+        if (pipelines_) {
+            // 协程模式: 工作线程预热后运行自己的 io_context，会话协程在其上轮流执行
+            worker_threads_.emplace_back([this, i] {
+                if (warm_up_worker(i)) pipelines_->run(i);
+            });
+            continue;
+        }
+#endif
+        worker_threads_.emplace_back(&AudioServer::worker_loop, this, i);
+    }
+    {
+        std::unique_lock<std::mutex> lock(warmup_mutex_);
+        warmup_cond_.wait(lock, [this] { return warmed_workers_ == config_.worker_threads; });
+    }
+    if (warmup_error_) {
+        // 某个工作线程预热失败: 停掉其余线程，把异常交给 main 处理
+        stop();
+        std::rethrow_exception(warmup_error_);
+    }
 
-    // 启动监听
+    if (config_.transport != ServerConfig::Transport::WEBSOCKETPP) {
+        if (!open_native_transport(port)) throw std::runtime_error("cannot open native transport");
+        start_shm_ingress();
+        start_reaper();
+        ready_ = true;
+        std::cout << "Server listening on port " << port << " (" << native_loops_[0]->backend_name() << " loops: "
+                  << native_loops_.size() << ", workers: " << config_.worker_threads << "), ready" << std::endl;
+        for (size_t i = 1; i < native_loops_.size(); ++i) {
+            io_threads_.emplace_back([this, i] { native_loops_[i]->run(); });
+        }
+        native_loops_[0]->run();
+        for (auto& t : io_threads_) {
+            if (t.joinable()) t.join();
+        }
+        return;
+    }
+
+    // 预热完成后才开始监听，重启时第一批连接不会撞上冷启动
     srv_.listen(port);
     srv_.start_accept();
+    start_shm_ingress();
+    start_reaper();
+    ready_ = true;
+
+    std::cout << "Server listening on port " << port << " (io threads: " << config_.io_threads
+              << ", workers: " << config_.worker_threads << "), ready" << std::endl;
     
-    std::cout << "Server listening on port " << port << std::endl;
-    
+    // 多个线程共同运行同一个 io_service
+    // asio 配置开启了 enable_multithreading，websocketpp 为每个连接分配一个 strand，
+    // 同一连接的 open/message/close 回调串行执行，不同连接的解析则分摊到各个 I/O 线程
+    for (size_t i = 1; i < config_.io_threads; ++i) {
+        io_threads_.emplace_back([this] { srv_.run(); });
+    }
+
     // 阻塞运行
     srv_.run();
+
+    for (auto& t : io_threads_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+void AudioServer::shutdown() {
+    if (!config_.snapshot_dir.empty()) {
+        // 冻结任务排在各会话已入队的音频之后；等工作线程写完快照、连接断开后再停止
+        drain();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (;;) {
+            size_t remaining = 0;
+            sessions_.for_each([&remaining](SessionRef, const std::shared_ptr<Session>& session) {
+                if (!session->has_local_route()) ++remaining;
+            });
+            if (remaining == 0) break;
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::cerr << remaining << " sessions still open after drain, stopping anyway" << std::endl;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+    stop();
+}
+
+void AudioServer::run_until_signal(const ServerConfig& config) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    // 之后创建的线程 (包括构造函数里的抓包线程) 都继承屏蔽字，信号只会被等待线程取走
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    AudioServer server(config);
+    std::mutex mutex;
+    bool finished = false; // run() 已返回: 等待线程被唤醒时直接退出
+    std::thread waiter([&] {
+        int sig = 0;
+        sigwait(&signals, &sig);
+        // 启动完成之前 (监听尚未建立) 不能 stop()，等到就绪或 run() 失败返回
+        while (!server.ready_) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished) return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished) return;
+        }
+        std::cout << "Received signal " << sig << ", shutting down" << std::endl;
+        server.shutdown();
+    });
+    auto join_waiter = [&] {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        // 等待线程仍阻塞在 sigwait 上时用一个定向信号唤醒它；已在退出流程中则该信号留在线程上随之丢弃
+        pthread_kill(waiter.native_handle(), SIGTERM);
+        waiter.join();
+    };
+    try {
+        server.run(config.port);
+    } catch (...) {
+        join_waiter();
+        throw;
+    }
+    join_waiter();
 }
 
 void AudioServer::stop() {
-    if (running_) {
-        running_ = false;
+    if (running_.exchange(false)) {
+        ready_ = false;
+        if (reaper_thread_.joinable()) {
+            // 回收线程会往调度器投递任务，需在调度器停止之前结束
+            {
+                std::lock_guard<std::mutex> lock(reaper_mutex_);
+                reaper_stop_ = true;
+            }
+            reaper_cond_.notify_all();
+            reaper_thread_.join();
+        }
         srv_.stop();
-        if (worker_thread_.joinable()) {
-            worker_thread_.join();
+        for (auto& loop : native_loops_) {
+            loop->stop();
+        }
+        if (shm_ingress_) {
+            // 接入线程退出前关闭全部流的会话，需在工作线程之前结束
+            shm_ingress_->stop();
+            if (shm_thread_.joinable()) shm_thread_.join();
+            std::cout << "Shared-memory ingress: " << shm_ingress_->stream_count() << " streams, "
+                      << shm_ingress_->record_count() << " records, " << shm_ingress_->dropped_events()
+                      << " dropped events" << std::endl;
+        }
+        // 唤醒阻塞在 pop() 上的工作线程；已入队的任务处理完后工作线程才退出
+        for (auto& queue : task_queues_) {
+            queue->stop();
+        }
+#ifdef VAD_WITH_COROUTINES
+        if (pipelines_) pipelines_->stop();
+#endif
+        for (auto& t : worker_threads_) {
+            if (t.joinable()) t.join();
+        }
+        size_t dropped_tasks = 0;
+        for (auto& queue : task_queues_) dropped_tasks += queue->dropped_on_stop();
+        if (dropped_tasks > 0) {
+            std::cout << "Scheduler: " << dropped_tasks << " tasks of sessions held for migration dropped at shutdown"
+                      << std::endl;
+        }
+        if (forwarder_) {
+            forwarder_->stop();
+            std::cout << "ASR forwarding: " << forwarder_->forwarded_segments() << " segments ("
+                      << forwarder_->forwarded_bytes() << " audio bytes), " << forwarder_->dropped_segments()
+                      << " dropped, " << forwarder_->connections_opened() << " connections opened, "
+                      << forwarder_->connect_failures() << " connect failures" << std::endl;
+        }
+        if (archive_) {
+            // 写完排队的段再退出
+            archive_->stop();
+            double busy = archive_->busy_seconds();
+            std::cout << "Segment archive: " << archive_->written_segments() << " files ("
+                      << archive_->written_bytes() << " bytes, "
+                      << (busy > 0 ? archive_->written_bytes() / busy / (1 << 20) : 0) << " MiB/s while writing), "
+                      << archive_->dropped_segments() << " dropped, " << archive_->write_errors()
+                      << " write errors, peak queue " << archive_->peak_queue_segments() << " segments / "
+                      << archive_->peak_queue_bytes() << " bytes" << std::endl;
+        }
+    }
+}
+
+bool AudioServer::open_native_transport(uint16_t port) {
+    TransportOptions options;
+    options.port = port;
+    bool use_uring = config_.transport == ServerConfig::Transport::IO_URING;
+    for (size_t i = 0; i < config_.io_threads; ++i) {
+        std::unique_ptr<NativeLoop> loop(new NativeLoop(*this));
+        if (!loop->open(options, use_uring)) return false;
+        native_loops_.push_back(std::move(loop));
+    }
+    return true;
+}
+
+void AudioServer::start_shm_ingress() {
+    if (config_.shm_socket.empty()) return;
+    ShmIngressOptions options;
+    options.socket_path = config_.shm_socket;
+    options.event_ring_bytes = config_.shm_event_ring_kb * 1024;
+    std::unique_ptr<ShmIngress> ingress(new ShmIngress(*this, options));
+    if (!ingress->open()) throw std::runtime_error("cannot open shared-memory ingress");
+    shm_ingress_ = std::move(ingress);
+    shm_thread_ = std::thread([this] { shm_ingress_->run(); });
+    std::cout << "Shared-memory ingress on " << config_.shm_socket << std::endl;
+}
+
+void AudioServer::on_http(connection_hdl hdl) {
+    server::connection_ptr con = srv_.get_con_from_hdl(hdl);
+    if (con->get_resource() == "/ready") {
+        bool ready = ready_;
+        con->set_status(ready ? websocketpp::http::status_code::ok
+                              : websocketpp::http::status_code::service_unavailable);
+        // 预热完成前不监听，这里的 503 只出现在排空或停止之后
+        con->set_body(ready ? "ready\n" : "not ready\n");
+        return;
+    }
+    if (con->get_resource() == "/metrics") {
+        con->set_status(websocketpp::http::status_code::ok);
+        con->replace_header("Content-Type", "text/plain; version=0.0.4");
+        con->set_body(metrics_text());
+        return;
+    }
+    if (config_.admin_http) {
+        const std::string resource = con->get_resource();
+        if (resource == "/admin/sessions") {
+            con->set_status(websocketpp::http::status_code::ok);
+            con->set_body(sessions_text());
+            return;
+        }
+        if (resource == "/admin/drain") {
+            size_t count = drain();
+            con->set_status(websocketpp::http::status_code::ok);
+            con->set_body("draining " + std::to_string(count) + " sessions\n");
+            return;
+        }
+        if (resource.compare(0, 15, "/admin/migrate?") == 0) {
+            // /admin/migrate?slot=S&shard=W
+            int slot = -1, shard = -1;
+            bool ok = parse_int_param(get_query_param(resource, "slot"), slot) &&
+                      parse_int_param(get_query_param(resource, "shard"), shard) && slot >= 0 && shard >= 0 &&
+                      migrate_session(sessions_.ref_at(static_cast<uint32_t>(slot)), static_cast<size_t>(shard));
+            con->set_status(ok ? websocketpp::http::status_code::ok : websocketpp::http::status_code::bad_request);
+            con->set_body(ok ? "migrated\n" : "cannot migrate\n");
+            return;
         }
     }
+    con->set_status(websocketpp::http::status_code::not_found);
 }
 
 void AudioServer::on_open(connection_hdl hdl) {
-    std::lock_guard<std::mutex> lock(session_mutex_);
-    static int id_counter = 0;
-    std::string uid = "user_" + std::to_string(++id_counter);
-    sessions_[hdl] = std::make_shared<Session>(uid, hdl);
+    // 输入格式协商: ws://host:9002/?sample_rate=48000&channels=2&codec=opus
+    AudioFormat format;
+    server::connection_ptr con = srv_.get_con_from_hdl(hdl);
+    if (!parse_audio_format(con->get_resource(), format) || !DecoderPool::supports(format.codec)) {
+        std::cerr << "Unsupported audio format in " << con->get_resource() << std::endl;
+        con->close(websocketpp::close::status::policy_violation, "unsupported audio format");
+        return;
+    }
+
+    std::string uid = "user_" + std::to_string(++id_counter_);
+    std::shared_ptr<Session> session = session_pool_.acquire(uid, hdl, format, &decoder_pool_);
+    if (forwarder_) session->set_speech_sink(forwarder_.get());
+    if (archive_) session->set_segment_archive(archive_.get());
+    // 滚动重启: 客户端带着旧进程给出的令牌重连，接着原来的 VAD 状态继续
+    std::string resume = get_query_param(con->get_resource(), "resume");
+    if (!resume.empty()) {
+        if (resume_session(resume, *session)) {
+            uid = session->get_id();
+        } else {
+            std::cerr << "Cannot resume session from snapshot " << resume << ", starting fresh" << std::endl;
+        }
+    }
+    SessionRef ref = sessions_.insert(std::move(session));
+    if (ref.generation == 0) {
+        std::cerr << "Session table full (" << sessions_.capacity() << "), rejecting connection" << std::endl;
+        con->close(websocketpp::close::status::try_again_later, "server busy");
+        return;
+    }
+    {
+        // 插入后 drain / migrate_session 就能从会话表找到本连接，路由字段在 route_mutex 内写入
+        std::lock_guard<std::mutex> lock(con->route_mutex);
+        con->session_ref = ref;
+        con->shard = ref.slot % task_queues_.size();
+    }
+#ifdef VAD_WITH_COROUTINES
+    if (pipelines_) {
+        uint64_t catchup_us = static_cast<uint64_t>(config_.catchup_ms) * 1000;
+        auto pipeline = std::make_shared<SessionPipeline>(pipelines_->context(con->shard), catchup_us);
+        pipeline->start([this, events = std::vector<std::string>()](AudioTask& task) mutable {
+            process_task(task, events);
+        });
+        con->pipeline = std::move(pipeline);
+    }
+#endif
+
+    // 调度参数: 延迟预算可由连接覆盖 (?latency_ms=50)，PCM 记录字节速率以便切片
+    int budget = 0;
+    con->latency_budget_ms = parse_int_param(get_query_param(con->get_resource(), "latency_ms"), budget) && budget > 0
+                                 ? static_cast<uint32_t>(budget)
+                                 : config_.latency_budget_ms;
+    con->format = format;
+    if (format.codec == AudioCodec::PCM) {
+        con->pcm_frame_bytes = static_cast<uint16_t>(format.frame_bytes());
+        con->pcm_bytes_per_sec = static_cast<uint32_t>(format.sample_rate) * con->pcm_frame_bytes;
+    }
+    if (capture_) capture_->session_open(capture_key(con->session_ref), uid, format);
 }
 
 void AudioServer::on_close(connection_hdl hdl) {
-    std::lock_guard<std::mutex> lock(session_mutex_);
-    sessions_.erase(hdl);
+    server::connection_ptr con = srv_.get_con_from_hdl(hdl);
+    if (con->rate_dropped > 0) {
+        std::cout << "Connection dropped " << con->rate_dropped << " frames over the rate limit" << std::endl;
+    }
+    // session_ref 与 migrate_session / drain 共享，在 route_mutex 内取出并清空
+    SessionRef ref;
+    {
+        std::lock_guard<std::mutex> lock(con->route_mutex);
+#ifdef VAD_WITH_COROUTINES
+        if (con->pipeline) con->pipeline->close();
+        con->pipeline.reset();
+#endif
+        ref = con->session_ref;
+        con->session_ref = SessionRef();
+    }
+    if (capture_ && ref.generation != 0) capture_->session_close(capture_key(ref));
+    sessions_.erase(ref);
+}
+
+bool AudioServer::admit(const server::connection_ptr& con, connection_hdl hdl, uint64_t audio_us) {
+    if (config_.rate_limit <= 0) return true;
+
+    // 令牌按限速随墙钟时间补充，上限为突发容量；新连接从满桶开始
+    auto now = std::chrono::steady_clock::now();
+    double capacity_us = config_.rate_burst_sec * 1e6;
+    if (con->rate_refill == std::chrono::steady_clock::time_point()) {
+        con->rate_tokens_us = capacity_us;
+    } else {
+        double elapsed_us = std::chrono::duration<double, std::micro>(now - con->rate_refill).count();
+        con->rate_tokens_us = std::min(capacity_us, con->rate_tokens_us + elapsed_us * config_.rate_limit);
+    }
+    con->rate_refill = now;
+
+    if (config_.rate_limit_drop) {
+        if (con->rate_tokens_us < static_cast<double>(audio_us)) {
+            ++con->rate_dropped;
+            return false;
+        }
+        con->rate_tokens_us -= static_cast<double>(audio_us);
+        return true;
+    }
+
+    // 延迟模式: 帧照常入队，欠下的令牌换算成等待时间，期间暂停读取该连接，
+    // 客户端被 TCP 背压减速，其他连接的读取与处理不受影响
+    con->rate_tokens_us -= static_cast<double>(audio_us);
+    if (con->rate_tokens_us < 0 && !con->rate_paused.exchange(true)) {
+        long wait_ms = static_cast<long>(std::ceil(-con->rate_tokens_us / config_.rate_limit / 1000.0));
+        con->pause_reading();
+        srv_.set_timer(wait_ms, [this, hdl](const websocketpp::lib::error_code& ec) {
+            if (ec) return;
+            websocketpp::lib::error_code con_ec;
+            server::connection_ptr paused = srv_.get_con_from_hdl(hdl, con_ec);
+            if (con_ec || !paused) return;
+            paused->rate_paused = false;
+            paused->resume_reading();
+        });
+    }
+    return true;
 }
 
 void AudioServer::on_message(connection_hdl hdl, server::message_ptr msg) {
+    server::connection_ptr con = srv_.get_con_from_hdl(hdl);
+    AudioTask task;
     if (msg->get_opcode() == websocketpp::frame::opcode::text) {
-        try {
-            auto payload = msg->get_payload();
-            auto j = json::parse(payload);
-            
-            // Expected format:
-            // { 
-            //     "uid":"abc_123", 
-            //     "connect_session":"...", 
-            //     "current_session":"...", 
-            //     "data":{ "bussin":{}, "audio":"base64..." } 
-            // }
-
-            if (j.contains("data") && j["data"].contains("audio")) {
-                std::string audio_b64 = j["data"]["audio"];
-                std::vector<uint8_t> audio_data = base64::decode(audio_b64);
-                
-                AudioTask task;
-                task.hdl = hdl;
-                task.data = std::move(audio_data);
-                
-                if (j.contains("uid")) task.uid = j["uid"];
-                if (j.contains("connect_session")) task.connect_session = j["connect_session"];
-                if (j.contains("current_session")) task.current_session = j["current_session"];
-
-                task_queue_.push(std::move(task));
-            }
-        } catch (std::exception& e) {
-            std::cerr << "JSON parse error: " << e.what() << std::endl;
+        // 选择性解析: 只提取需要的字段，base64 音频直接解码进任务缓冲区
+        const std::string& payload = msg->get_payload();
+        AudioMessageFields fields;
+        task.data = std::make_shared<std::vector<uint8_t>>();
+        if (!parse_audio_message(payload.data(), payload.size(), fields, *task.data)) {
+            std::cerr << "JSON parse error: malformed audio message (" << payload.size() << " bytes)" << std::endl;
+            return;
         }
+        if (!fields.has_audio) return;
+        task.uid = std::move(fields.uid);
+        task.connect_session = std::move(fields.connect_session);
+        task.current_session = std::move(fields.current_session);
     }
     else if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
-        AudioTask task;
-        task.hdl = hdl;
-        const std::string& payload = msg->get_payload();
-        task.data = std::vector<uint8_t>(payload.begin(), payload.end());
-        task_queue_.push(std::move(task));
+        task.msg = std::move(msg);
+    }
+    else {
+        return;
     }
+
+    // 先确认连接没有在排空: 排空后丢弃的帧不扣限速令牌，也不暂停读取
+    std::lock_guard<std::mutex> lock(con->route_mutex);
+    if (con->draining) return;
+    task.audio_us = con->format.duration_us(task.payload_size());
+    if (!admit(con, hdl, task.audio_us)) return;
+
+    task.session_ref = con->session_ref;
+    task.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(con->latency_budget_ms);
+    task.bytes_per_sec = con->pcm_bytes_per_sec;
+    task.frame_bytes = con->pcm_frame_bytes;
+    capture_task(task);
+    touch_session(task.session_ref);
+#ifdef VAD_WITH_COROUTINES
+    if (con->pipeline) {
+        con->pipeline->push(std::move(task));
+        return;
+    }
+#endif
+    task_queues_[con->shard]->push(std::move(task));
 }
 
-void AudioServer::worker_loop() {
-    std::cout << "Worker thread started." << std::endl;
-    while (running_) {
-        // 从队列取任务
-        AudioTask task = task_queue_.pop(); 
-        
-        // 查找 Session
-        std::shared_ptr<Session> session;
-        {
-            std::lock_guard<std::mutex> lock(session_mutex_);
-            auto it = sessions_.find(task.hdl);
-            if (it == sessions_.end()) continue;
-            session = it->second;
+bool AudioServer::migrate_session(SessionRef ref, size_t shard) {
+    std::shared_ptr<Session> session = sessions_.get(ref);
+    if (!session || shard >= task_queues_.size()) return false;
+    websocketpp::lib::error_code ec;
+    server::connection_ptr con = srv_.get_con_from_hdl(session->get_hdl(), ec);
+    if (ec || !con) return false;
+
+    std::lock_guard<std::mutex> lock(con->route_mutex);
+    if (con->draining || con->session_ref.slot != ref.slot || con->session_ref.generation != ref.generation) {
+        return false;
+    }
+    if (con->shard == shard) return true;
+    // 协程固定在创建它的 io_context 上
+    if (con->pipeline) return false;
+    // 之后的任务进入目标调度器但暂不派发；屏障排在原调度器中该会话已入队的任务之后，
+    // 原线程处理到它时会话已经空闲，再放行目标调度器，两个线程不会同时处理同一个会话
+    AudioTask barrier;
+    barrier.session_ref = ref;
+    barrier.control = AudioTask::Control::MIGRATE;
+    barrier.target_shard = static_cast<uint32_t>(shard);
+    task_queues_[shard]->hold(ref);
+    task_queues_[con->shard]->push(std::move(barrier));
+    con->shard = static_cast<uint32_t>(shard);
+    return true;
+}
+
+size_t AudioServer::drain() {
+    ready_ = false;
+    websocketpp::lib::error_code ec;
+    srv_.stop_listening(ec);
+
+    size_t count = 0;
+    sessions_.for_each([this, &count](SessionRef ref, const std::shared_ptr<Session>& session) {
+        if (session->has_local_route()) return;
+        AudioTask freeze;
+        freeze.session_ref = ref;
+        freeze.control = AudioTask::Control::FREEZE;
+        if (push_control(ref, *session, std::move(freeze))) ++count;
+    });
+    std::cout << "Draining " << count << " sessions" << std::endl;
+    return count;
+}
+
+bool AudioServer::push_control(SessionRef ref, const Session& session, AudioTask&& task) {
+    if (session.has_local_route()) {
+        // 本地接入的会话不迁移，始终在 open_local_session 分配的工作线程上
+        task_queues_[ref.slot % task_queues_.size()]->push(std::move(task));
+        return true;
+    }
+    websocketpp::lib::error_code ec;
+    server::connection_ptr con = srv_.get_con_from_hdl(session.get_hdl(), ec);
+    if (ec || !con) return false;
+    std::lock_guard<std::mutex> lock(con->route_mutex);
+    if (con->draining || con->session_ref.slot != ref.slot || con->session_ref.generation != ref.generation) {
+        return false;
+    }
+    // 排空之后该连接不再接受任何任务
+    if (task.control == AudioTask::Control::FREEZE) con->draining = true;
+#ifdef VAD_WITH_COROUTINES
+    if (con->pipeline) {
+        con->pipeline->push(std::move(task));
+        return true;
+    }
+#endif
+    task_queues_[con->shard]->push(std::move(task));
+    return true;
+}
+
+void AudioServer::start_reaper() {
+    if (config_.idle_timeout_sec == 0 && config_.hibernate_after_sec == 0) return;
+    reaper_thread_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(reaper_mutex_);
+        while (!reaper_cond_.wait_for(lock, std::chrono::seconds(1), [this] { return reaper_stop_; })) {
+            lock.unlock();
+            reap_idle();
+            lock.lock();
         }
+    });
+    std::cout << "Idle reaping: close after " << config_.idle_timeout_sec << " s, hibernate after "
+              << config_.hibernate_after_sec << " s (0 = off)" << std::endl;
+}
 
-        // Update Metadata
-        if (!task.uid.empty() && session->get_id() != task.uid) {
-             std::cout << "[Session " << session->get_id() << "] Updating UID to " << task.uid << std::endl;
-             session->set_id(task.uid);
+void AudioServer::reap_idle() {
+    const int64_t now = Session::steady_ms();
+    const int64_t close_ms = static_cast<int64_t>(config_.idle_timeout_sec) * 1000;
+    const int64_t hibernate_ms = static_cast<int64_t>(config_.hibernate_after_sec) * 1000;
+    sessions_.for_each([&](SessionRef ref, const std::shared_ptr<Session>& session) {
+        int64_t idle = now - session->last_active_ms();
+        if (close_ms > 0 && idle >= close_ms && session->request_close()) {
+            if (close_idle(*session)) {
+                idle_closed_sessions_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
         }
-        if (!task.connect_session.empty()) {
-            session->set_connect_session(task.connect_session);
+        // 休眠在会话所在的工作线程上执行，排在已入队的音频之后
+        if (hibernate_ms > 0 && idle >= hibernate_ms && !session->hibernated() && session->request_hibernate()) {
+            AudioTask task;
+            task.session_ref = ref;
+            task.control = AudioTask::Control::HIBERNATE;
+            push_control(ref, *session, std::move(task));
         }
-        if (!task.current_session.empty()) {
-            session->set_current_session(task.current_session);
+    });
+}
+
+bool AudioServer::close_idle(const Session& session) {
+    if (session.has_local_route()) {
+        std::shared_ptr<void> target = session.get_hdl().lock();
+        return target && static_cast<LocalRoute*>(target.get())->close(ws::GOING_AWAY);
+    }
+    connection_hdl hdl = session.get_hdl();
+    // 连接已经断开 (会话还没从表中移除) 时不计入空闲断开
+    if (hdl.expired()) return false;
+    srv_.get_io_service().post([this, hdl] {
+        websocketpp::lib::error_code ec;
+        srv_.close(hdl, websocketpp::close::status::going_away, "idle timeout", ec);
+    });
+    return true;
+}
+
+std::string AudioServer::metrics_text() const {
+    // 会话内存的分布 (字节，上界)
+    static const size_t kBuckets[] = {16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20};
+    const size_t bucket_count = sizeof(kBuckets) / sizeof(kBuckets[0]);
+    uint64_t counts[bucket_count + 1] = {};
+    uint64_t sessions = 0, hibernated = 0, total = 0, largest = 0;
+    sessions_.for_each([&](SessionRef, const std::shared_ptr<Session>& session) {
+        size_t bytes = session->memory_bytes();
+        ++sessions;
+        if (session->hibernated()) ++hibernated;
+        total += bytes;
+        largest = std::max<uint64_t>(largest, bytes);
+        size_t b = 0;
+        while (b < bucket_count && bytes > kBuckets[b]) ++b;
+        ++counts[b];
+    });
+
+    std::string out;
+    auto metric_text = [&out](const char* name, const char* type, const char* help, const std::string& value) {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+        out += name;
+        out += ' ';
+        out += value;
+        out += '\n';
+    };
+    auto metric = [&metric_text](const char* name, const char* type, const char* help, uint64_t value) {
+        metric_text(name, type, help, std::to_string(value));
+    };
+    metric("vad_sessions", "gauge", "Open sessions.", sessions);
+    metric("vad_sessions_hibernated", "gauge", "Open sessions currently hibernated.", hibernated);
+    metric("vad_session_memory_bytes_total", "gauge", "Memory held by open sessions (buffer capacities).", total);
+    metric("vad_session_memory_bytes_max", "gauge", "Memory held by the largest open session.", largest);
+    out += "# HELP vad_session_memory_bytes Memory held per open session.\n"
+           "# TYPE vad_session_memory_bytes histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b <= bucket_count; ++b) {
+        cumulative += counts[b];
+        out += "vad_session_memory_bytes_bucket{le=\"";
+        out += b < bucket_count ? std::to_string(kBuckets[b]) : std::string("+Inf");
+        out += "\"} " + std::to_string(cumulative) + '\n';
+    }
+    out += "vad_session_memory_bytes_sum " + std::to_string(total) + '\n';
+    out += "vad_session_memory_bytes_count " + std::to_string(sessions) + '\n';
+    metric("vad_sessions_hibernations_total", "counter", "Sessions hibernated after being idle.",
+           hibernated_sessions_.load(std::memory_order_relaxed));
+    metric("vad_sessions_idle_closed_total", "counter", "Sessions closed after being idle.",
+           idle_closed_sessions_.load(std::memory_order_relaxed));
+    if (forwarder_) {
+        metric("vad_asr_forwarded_segments_total", "counter", "Speech segments fully forwarded to the ASR sink.",
+               forwarder_->forwarded_segments());
+        metric("vad_asr_forwarded_bytes_total", "counter", "PCM bytes written to the ASR sink.",
+               forwarder_->forwarded_bytes());
+        metric("vad_asr_dropped_segments_total", "counter",
+               "Speech segments abandoned (backlog over the limit or upstream failure).", forwarder_->dropped_segments());
+        metric("vad_asr_connections_opened_total", "counter", "Connections opened to the ASR sink.",
+               forwarder_->connections_opened());
+        metric("vad_asr_connect_failures_total", "counter", "Failed connection attempts to the ASR sink.",
+               forwarder_->connect_failures());
+    }
+    if (archive_) {
+        // 写盘吞吐 = vad_archive_written_bytes_total 的增量 / vad_archive_busy_seconds_total 的增量
+        metric("vad_archive_written_files_total", "counter", "Speech segments written as WAV files.",
+               archive_->written_segments());
+        metric("vad_archive_written_bytes_total", "counter", "Bytes written to WAV files (headers included).",
+               archive_->written_bytes());
+        char busy[32];
+        std::snprintf(busy, sizeof(busy), "%.6f", archive_->busy_seconds());
+        metric_text("vad_archive_busy_seconds_total", "counter", "Time the archive thread spent writing files.", busy);
+        metric("vad_archive_dropped_segments_total", "counter", "Speech segments dropped because the queue was full.",
+               archive_->dropped_segments());
+        metric("vad_archive_write_errors_total", "counter", "Speech segments that could not be written.",
+               archive_->write_errors());
+        metric("vad_archive_queue_segments", "gauge", "Segments waiting for or being written by the archive thread.",
+               archive_->queue_segments());
+        metric("vad_archive_queue_bytes", "gauge", "PCM bytes waiting for or being written by the archive thread.",
+               archive_->queue_bytes());
+        metric("vad_archive_queue_segments_peak", "gauge", "Largest number of queued segments so far.",
+               archive_->peak_queue_segments());
+        metric("vad_archive_queue_bytes_peak", "gauge", "Largest number of queued PCM bytes so far.",
+               archive_->peak_queue_bytes());
+    }
+    return out;
+}
+
+std::string AudioServer::sessions_text() const {
+    const int64_t now = Session::steady_ms();
+    std::string out = "slot\tmemory_bytes\tidle_ms\thibernated\n";
+    sessions_.for_each([&](SessionRef ref, const std::shared_ptr<Session>& session) {
+        out += std::to_string(ref.slot) + '\t' + std::to_string(session->memory_bytes()) + '\t' +
+               std::to_string(now - session->last_active_ms()) + '\t' + (session->hibernated() ? "1" : "0") + '\n';
+    });
+    return out;
+}
+
+bool AudioServer::resume_session(const std::string& token, Session& session) {
+    if (config_.snapshot_dir.empty()) return false;
+    // 令牌只能是十六进制，防止拼出快照目录以外的路径
+    if (token.size() > 32 || token.find_first_not_of("0123456789abcdef") != std::string::npos) return false;
+    std::string path = config_.snapshot_dir + "/" + token + ".snap";
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::vector<uint8_t> blob;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), file)) > 0) {
+        blob.insert(blob.end(), buf, buf + n);
+    }
+    std::fclose(file);
+
+    if (!session.thaw(blob.data(), blob.size())) return false;
+    // 快照只能使用一次；恢复失败时保留文件，便于排查或由另一个版本匹配的进程恢复
+    std::remove(path.c_str());
+    std::cout << "[Session " << session.get_id() << "] Resumed from snapshot " << token << std::endl;
+    return true;
+}
+
+void AudioServer::handle_control(const AudioTask& task) {
+    if (task.control == AudioTask::Control::MIGRATE) {
+        // 本线程已处理完该会话在屏障之前的全部任务
+        task_queues_[task.target_shard]->release(task.session_ref);
+        return;
+    }
+    if (task.control == AudioTask::Control::HIBERNATE) {
+        std::shared_ptr<Session> session = sessions_.get(task.session_ref);
+        if (session && session->hibernate()) hibernated_sessions_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // FREEZE: 已入队的音频都处理完了，写出快照后断开，关闭原因中带上恢复令牌
+    std::shared_ptr<Session> session = sessions_.get(task.session_ref);
+    if (!session) return;
+    std::string reason = "draining";
+    std::string blob;
+    if (!config_.snapshot_dir.empty() && session->freeze(blob)) {
+        std::string token = make_resume_token();
+        std::string path = config_.snapshot_dir + "/" + token + ".snap";
+        std::string tmp_path = path + ".tmp";
+        std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+        bool ok = file && std::fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+        if (file) ok = std::fclose(file) == 0 && ok;
+        if (ok && std::rename(tmp_path.c_str(), path.c_str()) == 0) {
+            reason = "resume=" + token;
+        } else {
+            std::cerr << "[Session " << session->get_id() << "] Failed to write snapshot " << path << std::endl;
+            std::remove(tmp_path.c_str());
         }
+    }
+    connection_hdl hdl = session->get_hdl();
+    srv_.get_io_service().post([this, hdl, reason] {
+        websocketpp::lib::error_code ec;
+        srv_.close(hdl, websocketpp::close::status::going_away, reason, ec);
+    });
+}
 
-        // 业务处理
-        std::string resp = session->process_audio(task.data);
+bool AudioServer::warm_up_worker(size_t shard) {
+    std::cout << "Worker thread " << shard << " started." << std::endl;
 
-        // 发送结果
-        if (!resp.empty()) {
-            try {
-                srv_.send(task.hdl, resp, websocketpp::frame::opcode::text);
-                std::cout << "-> Sent VAD Event: " << resp << std::endl;
-            } catch (websocketpp::exception const & e) {
-                std::cout << "Send failed: " << e.what() << std::endl;
-            }
+    // 在本线程上跑合成推理，预热 ORT 内核、分配器与本核缓存
+    // 异常不能逃出线程函数 (会直接 std::terminate)，记下后由 run() 在主线程上重新抛出
+    std::exception_ptr error;
+    if (config_.warmup_iterations > 0) {
+        try {
+            auto t0 = std::chrono::steady_clock::now();
+            VadModel::get()->warmup(config_.warmup_iterations);
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << "Worker thread " << shard << " warmed up in " << ms << " ms" << std::endl;
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(warmup_mutex_);
+        ++warmed_workers_;
+        if (error && !warmup_error_) warmup_error_ = error;
+    }
+    warmup_cond_.notify_all();
+    return !error;
+}
+
+void AudioServer::worker_loop(size_t shard) {
+    if (!warm_up_worker(shard)) return;
+    TaskScheduler& task_queue = *task_queues_[shard];
+
+    AudioTask task;
+    std::vector<std::string> catchup_events; // 追赶模式的事件 (复用容量)
+    // 按调度策略取下一个任务 (可能是大任务的一个切片)
+    while (task_queue.pop(task)) {
+        process_task(task, catchup_events);
+    }
+}
+
+void AudioServer::process_task(const AudioTask& task, std::vector<std::string>& catchup_events) {
+    if (task.control != AudioTask::Control::NONE) {
+        handle_control(task);
+        return;
+    }
+
+    // 查找 Session (槽位下标 + 代数校验，连接已关闭则丢弃)
+    std::shared_ptr<Session> session = sessions_.get(task.session_ref);
+    if (!session) return;
+
+    // Update Metadata
+    if (!task.uid.empty() && session->get_id() != task.uid) {
+         std::cout << "[Session " << session->get_id() << "] Updating UID to " << task.uid << std::endl;
+         session->set_id(task.uid);
+    }
+    if (!task.connect_session.empty()) {
+        session->set_connect_session(task.connect_session);
+    }
+    if (!task.current_session.empty()) {
+        session->set_current_session(task.current_session);
+    }
+
+    if (task.catch_up) {
+        // 积压的音频一次处理完，只回传其中的状态跳变
+        size_t n = session->catch_up(task.payload(), task.payload_size(), catchup_events);
+        for (size_t i = 0; i < n; ++i) {
+            server::message_ptr out = egress_.acquire();
+            out->get_raw_payload().swap(catchup_events[i]);
+            std::cout << "-> Sent VAD Event (catch-up): " << out->get_payload() << std::endl;
+            deliver(*session, std::move(out));
         }
+        return;
     }
+
+    // 业务处理: 响应直接序列化进池化的出站消息
+    server::message_ptr out = egress_.acquire();
+    if (session->process_audio(task.payload(), task.payload_size(), out->get_raw_payload())) {
+        std::cout << "-> Sent VAD Event: " << out->get_payload() << std::endl;
+        // 发送结果: 投递到 I/O 线程，不在工作线程上直接调用 send
+        deliver(*session, std::move(out));
+    }
+}
+
+void AudioServer::deliver(const Session& session, server::message_ptr out) {
+    if (!session.has_local_route()) {
+        egress_.send(session.get_hdl(), std::move(out));
+        return;
+    }
+    // 本地接入: hdl 指向连接的 LocalRoute，连接已关闭时 lock() 失败，丢弃
+    std::shared_ptr<void> target = session.get_hdl().lock();
+    if (!target) return;
+    static_cast<LocalRoute*>(target.get())->send_event(out->get_payload());
+}
+
+uint16_t AudioServer::open_local_session(const std::shared_ptr<LocalRoute>& route, const std::string& resource,
+                                         LocalStream& stream) {
+    // 输入格式协商与 on_open 相同: ?sample_rate=48000&channels=2&codec=opus&latency_ms=50
+    AudioFormat format;
+    if (!parse_audio_format(resource, format) || !DecoderPool::supports(format.codec)) {
+        std::cerr << "Unsupported audio format in " << resource << std::endl;
+        return ws::POLICY_VIOLATION;
+    }
+
+    std::string uid = "user_" + std::to_string(++id_counter_);
+    std::shared_ptr<Session> session = session_pool_.acquire(uid, route, format, &decoder_pool_);
+    if (forwarder_) session->set_speech_sink(forwarder_.get());
+    if (archive_) session->set_segment_archive(archive_.get());
+    session->set_local_route(true);
+    stream.session_ref = sessions_.insert(std::move(session));
+    if (stream.session_ref.generation == 0) {
+        std::cerr << "Session table full (" << sessions_.capacity() << "), rejecting connection" << std::endl;
+        return ws::TRY_AGAIN_LATER;
+    }
+    stream.shard = stream.session_ref.slot % task_queues_.size();
+
+    int budget = 0;
+    stream.latency_budget_ms = parse_int_param(get_query_param(resource, "latency_ms"), budget) && budget > 0
+                                   ? static_cast<uint32_t>(budget)
+                                   : config_.latency_budget_ms;
+    stream.format = format;
+    if (format.codec == AudioCodec::PCM) {
+        stream.pcm_frame_bytes = static_cast<uint16_t>(format.frame_bytes());
+        stream.pcm_bytes_per_sec = static_cast<uint32_t>(format.sample_rate) * stream.pcm_frame_bytes;
+    }
+    if (capture_) capture_->session_open(capture_key(stream.session_ref), uid, format);
+    return 0;
+}
+
+void AudioServer::push_local_task(const LocalStream& stream, AudioTask&& task) {
+    task.audio_us = stream.format.duration_us(task.payload_size());
+    task.session_ref = stream.session_ref;
+    task.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(stream.latency_budget_ms);
+    task.bytes_per_sec = stream.pcm_bytes_per_sec;
+    task.frame_bytes = stream.pcm_frame_bytes;
+    capture_task(task);
+    touch_session(task.session_ref);
+    task_queues_[stream.shard]->push(std::move(task));
+}
+
+void AudioServer::touch_session(SessionRef ref) {
+    if (config_.idle_timeout_sec == 0 && config_.hibernate_after_sec == 0) return;
+    if (std::shared_ptr<Session> session = sessions_.get(ref)) session->touch();
+}
+
+void AudioServer::capture_task(const AudioTask& task) {
+    if (!capture_) return;
+    uint64_t key = capture_key(task.session_ref);
+    if (!task.uid.empty() || !task.connect_session.empty() || !task.current_session.empty()) {
+        capture_->session_meta(key, task.uid, task.connect_session, task.current_session);
+    }
+    capture_->frame(key, task.payload(), task.payload_size());
+}
+
+void AudioServer::close_local_session(LocalStream& stream) {
+    if (stream.session_ref.generation == 0) return;
+    if (capture_) capture_->session_close(capture_key(stream.session_ref));
+    sessions_.erase(stream.session_ref);
+    stream.session_ref = SessionRef();
 }
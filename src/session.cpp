@@ -5,27 +5,203 @@
 #include <thread>
 #include <sstream>
 #include <iomanip>
-#include "json.hpp"
+#include <algorithm>
+#include "json_writer.h"
+#include "static_vad_engine.h"
 #include "base64.h"
+#include "segment_archive.h"
 
-using json = nlohmann::json;
+namespace {
+
+// 容量超过 max_bytes 时收缩到恰好容纳现有内容
+template <class T>
+void shrink_if_over(std::vector<T>& v, size_t max_bytes) {
+    if (v.capacity() * sizeof(T) > max_bytes) std::vector<T>(v.begin(), v.end()).swap(v);
+}
+
+} // namespace
 
 // ==========================================
 // Session 实现
 // ==========================================
 
-Session::Session(std::string id, websocketpp::connection_hdl hdl) 
-    : id_(id), hdl_(hdl), last_state_(VadState::SILENCE) {
-    // 确保 model 目录在运行时的相对路径正确 (通常是 build/../model)
-    std::string model_path = "../model/silero_vad.onnx";
+Session::Session() : last_state_(VadState::SILENCE) {
+}
 
-    // 使用 Silero VAD 引擎 (基于 ONNX Runtime)
-    vad_engine_ = std::make_unique<SileroVadEngine>(model_path);
-    std::cout << "[Session " << id_ << "] Created with Original VAD (SileroVadEngine)" << std::endl;
+Session::Session(std::string id, websocketpp::connection_hdl hdl, const AudioFormat& format,
+                 DecoderPool* decoder_pool)
+    : last_state_(VadState::SILENCE) {
+    open(std::move(id), hdl, format, decoder_pool);
 }
 
 Session::~Session() {
-    std::cout << "[Session " << id_ << "] Destroyed" << std::endl;
+    close();
+}
+
+void Session::open(std::string id, websocketpp::connection_hdl hdl, const AudioFormat& format,
+                   DecoderPool* decoder_pool) {
+    id_ = std::move(id);
+    prefix_dirty_ = suffix_dirty_ = true;
+    hdl_ = hdl;
+    format_ = format;
+    pcm_format_ = format.decoded_format();
+    decoder_pool_ = decoder_pool;
+    last_state_ = VadState::SILENCE;
+
+    // 8k 输入直接走 Silero 的 8k 模式，其余采样率重采样到 16k
+    int engine_rate = pcm_format_.engine_sample_rate();
+    if (pcm_format_.needs_resample()) {
+        if (resampler_ && resampler_->in_rate() == pcm_format_.sample_rate && resampler_->out_rate() == engine_rate) {
+            resampler_->reset();
+        } else {
+            resampler_ = std::make_unique<PolyphaseResampler>(pcm_format_.sample_rate, engine_rate);
+        }
+    } else {
+        resampler_.reset();
+    }
+    if (decoder_pool_) {
+        decoder_ = decoder_pool_->acquire(format_);
+    }
+    close_requested_.store(false, std::memory_order_relaxed);
+    mark_active();
+    memory_bytes_.store(measure_memory(), std::memory_order_relaxed);
+}
+
+void Session::close() {
+    if (!id_.empty()) {
+        std::cout << "[Session " << id_ << "] Closed" << std::endl;
+    }
+    if (decoder_pool_ && decoder_) {
+        decoder_pool_->release(format_, std::move(decoder_));
+    }
+    decoder_.reset();
+    decoder_pool_ = nullptr;
+    if (vad_engine_) {
+        vad_engine_->reset();
+    }
+    hdl_.reset();
+    local_route_ = false;
+    if (speech_sink_ && segment_id_ != 0) speech_sink_->end_segment(segment_id_, true);
+    speech_sink_ = nullptr;
+    segment_id_ = 0;
+    segment_archive_ = nullptr;
+    id_.clear();
+    connect_session_.clear();
+    current_session_.clear();
+    new_session_.clear();
+    prefix_dirty_ = suffix_dirty_ = true;
+    last_state_ = VadState::SILENCE;
+    audio_buffer_.clear();
+    // 放回池中的会话不保留休眠状态与历史峰值容量
+    parked_engine_.reset();
+    hibernated_.store(false, std::memory_order_relaxed);
+    trim_buffers();
+    trim_pending_ = false;
+    memory_bytes_.store(measure_memory(), std::memory_order_relaxed);
+}
+
+void Session::attach_engine(int sample_rate) {
+    if (vad_engine_ && engine_sample_rate_ == sample_rate) return;
+    // 优先使用按采样率编译期特化的 Silero 引擎，其他采样率退回运行时配置的 SileroVadEngine
+    vad_engine_ = make_static_vad_engine(VadModel::get(), sample_rate);
+    const char* engine_name = "StaticVadEngine";
+    if (!vad_engine_) {
+        vad_engine_ = std::make_unique<SileroVadEngine>(VadModel::options().model_path, sample_rate);
+        engine_name = "SileroVadEngine";
+    }
+    engine_sample_rate_ = sample_rate;
+    if (parked_engine_) {
+        // 从休眠中唤醒: 接着休眠前的状态继续
+        if (!vad_engine_->load_state(*parked_engine_)) {
+            std::cerr << "[Session " << id_ << "] Cannot restore engine state after hibernation" << std::endl;
+        }
+        parked_engine_.reset();
+        std::cout << "[Session " << id_ << "] Woke from hibernation (" << engine_name << ")" << std::endl;
+        return;
+    }
+    std::cout << "[Session " << id_ << "] Attached Silero VAD (" << engine_name << "), input "
+              << format_.sample_rate << "Hz x" << format_.channels << ", engine " << sample_rate << "Hz" << std::endl;
+}
+
+bool Session::freeze(std::string& out) const {
+    VadEngineState engine_state;
+    bool has_engine = vad_engine_ != nullptr || parked_engine_ != nullptr;
+    if (vad_engine_) {
+        if (!vad_engine_->save_state(engine_state)) return false;
+    } else if (parked_engine_) {
+        engine_state = *parked_engine_;
+    }
+
+    out.clear();
+    snapshot::Writer w(out);
+    snapshot::write_header(w);
+    w.put<int32_t>(format_.sample_rate);
+    w.put<int32_t>(format_.channels);
+    w.put<uint8_t>(static_cast<uint8_t>(format_.codec));
+    w.put<int32_t>(format_.speex_frame_bytes);
+    w.put_string(id_);
+    w.put_string(connect_session_);
+    w.put_string(current_session_);
+    w.put_string(new_session_);
+    w.put<uint8_t>(static_cast<uint8_t>(last_state_));
+    w.put_bytes(audio_buffer_.data(), audio_buffer_.size());
+    w.put<uint8_t>(has_engine ? 1 : 0);
+    if (has_engine) engine_state.write(w);
+    w.put<uint8_t>(resampler_ ? 1 : 0);
+    if (resampler_) resampler_->save_state(w);
+    return true;
+}
+
+bool Session::thaw(const uint8_t* data, size_t len) {
+    snapshot::Reader r(data, len);
+    if (!snapshot::read_header(r)) return false;
+
+    int32_t sample_rate = 0, channels = 0, speex_frame_bytes = 0;
+    uint8_t codec = 0, last_state = 0, has_engine = 0, has_resampler = 0;
+    std::string id, connect_session, current_session, new_session;
+    std::vector<uint8_t> audio_buffer;
+    VadEngineState engine_state;
+    r.get(sample_rate);
+    r.get(channels);
+    r.get(codec);
+    r.get(speex_frame_bytes);
+    if (!r.ok() || sample_rate != format_.sample_rate || channels != format_.channels ||
+        codec != static_cast<uint8_t>(format_.codec) || speex_frame_bytes != format_.speex_frame_bytes) {
+        return false;
+    }
+    r.get_string(id);
+    r.get_string(connect_session);
+    r.get_string(current_session);
+    r.get_string(new_session);
+    r.get(last_state);
+    r.get_bytes(audio_buffer);
+    r.get(has_engine);
+    if (has_engine && !engine_state.read(r)) return false;
+    r.get(has_resampler);
+    if (!r.ok() || last_state > static_cast<uint8_t>(VadState::END_SPEAKING) ||
+        (has_resampler != 0) != (resampler_ != nullptr)) {
+        return false;
+    }
+
+    // 重采样器与引擎的状态直接加载到现有对象上，失败时整体复位
+    bool ok = !resampler_ || (resampler_->load_state(r) && r.at_end());
+    if (ok && has_engine) {
+        attach_engine(pcm_format_.engine_sample_rate());
+        ok = vad_engine_->load_state(engine_state);
+    }
+    if (!ok) {
+        if (resampler_) resampler_->reset();
+        if (vad_engine_) vad_engine_->reset();
+        return false;
+    }
+
+    set_id(id);
+    set_connect_session(connect_session);
+    set_current_session(current_session);
+    new_session_ = std::move(new_session);
+    last_state_ = static_cast<VadState>(last_state);
+    audio_buffer_ = std::move(audio_buffer);
+    return true;
 }
 
 std::string Session::get_current_timestamp_us() {
@@ -35,56 +211,211 @@ std::string Session::get_current_timestamp_us() {
     return std::to_string(micros);
 }
 
-std::string Session::build_vad_response(const std::string& vad_state, const std::string& audio_b64, const std::string& new_session) {
-    json j = {
-        {"uid", id_},
-        {"connect_session", connect_session_},
-        {"current_session", current_session_},
-        {"data", {{"vad_state", vad_state}, {"vad_audio", audio_b64}}}
-    };
-    if (!new_session.empty()) {
-        j["new_session"] = new_session;
+void Session::refresh_response_cache() {
+    // 字段顺序与 nlohmann::json 默认 (按键名排序) 的 dump() 输出保持一致:
+    // {"connect_session":..,"current_session":..,"data":{"vad_audio":..,"vad_state":..},["new_session":..,]"uid":..}
+    if (prefix_dirty_) {
+        response_prefix_.clear();
+        response_prefix_ += '{';
+        json_writer::append_string_field(response_prefix_, "connect_session", connect_session_);
+        response_prefix_ += ',';
+        json_writer::append_string_field(response_prefix_, "current_session", current_session_);
+        response_prefix_ += ",\"data\":{\"vad_audio\":\"";
+        prefix_dirty_ = false;
+    }
+    if (suffix_dirty_) {
+        response_suffix_.clear();
+        json_writer::append_string_field(response_suffix_, "uid", id_);
+        response_suffix_ += '}';
+        suffix_dirty_ = false;
     }
-    return j.dump();
 }
 
-std::string Session::build_begin_response(const std::string& audio_b64) {
-    return build_vad_response("VAD_BEGIN", audio_b64, new_session_);
+void Session::build_vad_response(std::string& out, const char* vad_state, const uint8_t* audio, size_t audio_len,
+                                 bool with_new_session) {
+    refresh_response_cache();
+    out.reserve(response_prefix_.size() + (audio_len + 2) / 3 * 4 + response_suffix_.size() + new_session_.size() + 64);
+    out.append(response_prefix_);
+    base64::encode_append(out, audio, audio_len);
+    out += "\",\"vad_state\":\"";
+    out += vad_state;
+    out += "\"},";
+    if (with_new_session && !new_session_.empty()) {
+        json_writer::append_string_field(out, "new_session", new_session_);
+        out += ',';
+    }
+    out.append(response_suffix_);
 }
 
+SpeechSegmentInfo Session::segment_info() const {
+    SpeechSegmentInfo info;
+    info.uid = id_;
+    info.connect_session = connect_session_;
+    info.current_session = current_session_;
+    info.new_session = new_session_;
+    info.sample_rate = pcm_format_.sample_rate;
+    info.channels = pcm_format_.channels;
+    return info;
+}
 
-std::string Session::build_end_response(const std::string& audio_b64) {
-    return build_vad_response("VAD_END", audio_b64, "");
+void Session::build_begin_response(std::string& out, const uint8_t* audio, size_t audio_len) {
+    build_vad_response(out, "VAD_BEGIN", audio, audio_len, true);
 }
 
-std::string Session::build_speaking_response(const std::string& audio_b64) {
-    return build_vad_response("SPEAKING", audio_b64, "");
+
+void Session::build_end_response(std::string& out, const uint8_t* audio, size_t audio_len) {
+    build_vad_response(out, "VAD_END", audio, audio_len, false);
 }
 
-std::string Session::build_silence_response() {
-    return build_vad_response("SILENCE", "", "");
+void Session::build_speaking_response(std::string& out, const uint8_t* audio, size_t audio_len) {
+    build_vad_response(out, "SPEAKING", audio, audio_len, false);
 }
 
+void Session::build_silence_response(std::string& out) {
+    build_vad_response(out, "SILENCE", nullptr, 0, false);
+}
+
+
+
+bool Session::decode(const uint8_t*& data, size_t& len) {
+    if (format_.codec == AudioCodec::PCM) return true;
+    if (!decoder_) return false;
+    // 0. 解码 (在工作线程上执行)，之后的流程与原始 PCM 一致
+    //    回传给客户端的 vad_audio 为解码后的 PCM
+    decoded_audio_.clear();
+    if (!decoder_->decode(data, len, decoded_audio_)) {
+        std::cerr << "[Session " << id_ << "] Failed to decode audio packet (" << len << " bytes)" << std::endl;
+    }
+    data = decoded_audio_.data();
+    len = decoded_audio_.size();
+    return true;
+}
+
+bool Session::process_audio(const uint8_t* data, size_t len, std::string& out) {
+    mark_active();
+    // 懒加载: 只有真正发送音频的连接才挂载引擎 (健康检查/空连接不占用模型)
+    attach_engine(pcm_format_.engine_sample_rate());
+
+    if (!decode(data, len)) {
+        out.clear();
+        return false;
+    }
+    bool has_event = process_pcm(data, len, out);
+    finish_processing();
+    return has_event;
+}
+
+size_t Session::catch_up(const uint8_t* data, size_t len, std::vector<std::string>& events) {
+    mark_active();
+    attach_engine(pcm_format_.engine_sample_rate());
+    if (!decode(data, len)) return 0;
 
+    // 按一个 Silero 窗口 (32ms) 的输入时长分块送入引擎，块内最多一次状态跳变，
+    // 跳变位置精确到块；中间的 SPEAKING/SILENCE 不生成响应
+    size_t chunk = static_cast<size_t>(pcm_format_.sample_rate) * 32 / 1000 * pcm_format_.frame_bytes();
+    size_t count = 0;
+    for (size_t offset = 0; offset < len; offset += chunk) {
+        if (count == events.size()) events.emplace_back();
+        if (process_pcm(data + offset, std::min(chunk, len - offset), events[count], true)) {
+            ++count;
+        }
+    }
+    finish_processing();
+    return count;
+}
+
+void Session::mark_active() {
+    last_active_ms_.store(steady_ms(), std::memory_order_relaxed);
+    hibernate_requested_.store(false, std::memory_order_relaxed);
+    hibernated_.store(false, std::memory_order_relaxed);
+}
+
+void Session::finish_processing() {
+    if (trim_pending_) {
+        trim_buffers();
+        trim_pending_ = false;
+    }
+    memory_bytes_.store(measure_memory(), std::memory_order_relaxed);
+}
 
-std::string Session::process_audio(const std::vector<uint8_t>& raw_data) {
-    // 1. 转码: PCM 16bit -> Float
-    // raw_data 是字节流，每两个字节是一个 int16
-    std::vector<float> float_audio;
-    float_audio.reserve(raw_data.size() / 2);
+void Session::trim_buffers() {
+    shrink_if_over(audio_buffer_, kRetainedBufferBytes);
+    shrink_if_over(decoded_audio_, kRetainedBufferBytes);
+    shrink_if_over(float_audio_, kRetainedBufferBytes);
+    if (vad_engine_) vad_engine_->trim();
+    if (resampler_) resampler_->trim();
+}
 
-    for (size_t i = 0; i < raw_data.size(); i += 2) {
-        if (i + 1 < raw_data.size()) {
-            int16_t sample = static_cast<int16_t>(raw_data[i] | (raw_data[i+1] << 8));
-            float_audio.push_back(sample / 32768.0f);
+bool Session::hibernate() {
+    if (hibernated_.load(std::memory_order_relaxed)) return false;
+    // 控制任务排队期间来了新帧: 会话不再空闲
+    if (!hibernate_requested_.load(std::memory_order_relaxed)) return false;
+    if (vad_engine_) {
+        std::unique_ptr<VadEngineState> state(new VadEngineState());
+        if (vad_engine_->save_state(*state)) {
+            parked_engine_ = std::move(state);
+            vad_engine_.reset();
         }
     }
+    // 语音段中途休眠时保留已缓存的音频；解码器留在原处 (编解码库的状态无法导出)
+    shrink_if_over(audio_buffer_, 0);
+    std::vector<uint8_t>().swap(decoded_audio_);
+    std::vector<float>().swap(float_audio_);
+    if (vad_engine_) vad_engine_->trim();
+    if (resampler_) resampler_->trim();
+    // 响应缓存在下一次响应时重建
+    std::string().swap(response_prefix_);
+    std::string().swap(response_suffix_);
+    prefix_dirty_ = suffix_dirty_ = true;
+    hibernated_.store(true, std::memory_order_relaxed);
+    memory_bytes_.store(measure_memory(), std::memory_order_relaxed);
+    std::cout << "[Session " << id_ << "] Hibernated" << std::endl;
+    return true;
+}
+
+size_t Session::measure_memory() const {
+    size_t bytes = sizeof(Session);
+    bytes += response_prefix_.capacity() + response_suffix_.capacity();
+    bytes += audio_buffer_.capacity() + decoded_audio_.capacity() + float_audio_.capacity() * sizeof(float);
+    if (vad_engine_) bytes += vad_engine_->memory_bytes();
+    if (resampler_) bytes += resampler_->memory_bytes();
+    if (parked_engine_) {
+        bytes += sizeof(VadEngineState) + (parked_engine_->context.capacity() + parked_engine_->rnn_state.capacity() +
+                                           parked_engine_->pending.capacity()) * sizeof(float);
+    }
+    return bytes;
+}
+
+int64_t Session::steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Session::process_pcm(const uint8_t* data, size_t len, std::string& out, bool transitions_only) {
+    // 1. 转码 + 下混: 交织 PCM 16bit -> 单声道 Float
+    // 不足一个完整交织帧的尾部字节直接丢弃
+    size_t frames = len / pcm_format_.frame_bytes();
+    std::vector<float>& engine_input = vad_engine_->input_buffer();
+
+    if (!resampler_) {
+        // 8k/16k 原生输入: 直接转码写入引擎缓冲区
+        size_t offset = engine_input.size();
+        engine_input.resize(offset + frames);
+        pcm16_to_mono_float(data, frames, pcm_format_.channels, engine_input.data() + offset);
+    } else {
+        // 2. 重采样到引擎采样率，结果直接追加到引擎缓冲区
+        float_audio_.resize(frames);
+        pcm16_to_mono_float(data, frames, pcm_format_.channels, float_audio_.data());
+        resampler_->process(float_audio_.data(), float_audio_.size(), engine_input);
+    }
 
-    // 2. VAD 处理
-    VadResult res = vad_engine_->process_frame(float_audio);
+    // 3. VAD 处理
+    VadResult res = vad_engine_->process_buffered();
 
-    // 3. 状态变更检测与消息生成
-    std::string json_resp = "";
+    // 4. 状态变更检测与消息生成
+    // 写入调用方提供的 (池化) 缓冲区，保留其容量
+    std::string& json_resp = out;
+    json_resp.clear();
     bool state_changed = false;
     VadState current_state = res.state;
 
@@ -96,27 +427,36 @@ std::string Session::process_audio(const std::vector<uint8_t>& raw_data) {
     if (current_state == VadState::START_SPEAKING) {
         std::cout << "[Session " << id_ << "] VAD START_SPEAKING detected!" << std::endl;
         
-        // Start buffering logic
-        audio_buffer_.clear();
-        audio_buffer_.insert(audio_buffer_.end(), raw_data.begin(), raw_data.end());
-        
         // Generate new session timestamp
         new_session_ = get_current_timestamp_us();
 
-        {
-            std::string audio_b64 = base64::encode(raw_data.data(), raw_data.size());
-            json_resp = build_begin_response(audio_b64);
+        if (speech_sink_) {
+            // 转发: 音频边说边发给下游，响应只带事件元数据
+            if (segment_id_ != 0) speech_sink_->end_segment(segment_id_, false);
+            segment_id_ = speech_sink_->begin_segment(segment_info());
+            speech_sink_->segment_audio(segment_id_, data, len);
+        }
+        if (buffers_segment()) {
+            // Start buffering logic
+            audio_buffer_.clear();
+            audio_buffer_.insert(audio_buffer_.end(), data, data + len);
         }
+        if (speech_sink_) build_begin_response(json_resp, nullptr, 0);
+        else build_begin_response(json_resp, data, len);
         
         last_state_ = VadState::SPEAKING;
     }
     else if (current_state == VadState::SPEAKING) {
+        if (speech_sink_) {
+            // 从快照恢复到语音段中途时，在新进程里另开一段
+            if (segment_id_ == 0) segment_id_ = speech_sink_->begin_segment(segment_info());
+            speech_sink_->segment_audio(segment_id_, data, len);
+        }
         // Continue buffering
-        audio_buffer_.insert(audio_buffer_.end(), raw_data.begin(), raw_data.end());
-        
-        {
-            std::string audio_b64 = base64::encode(raw_data.data(), raw_data.size());
-            json_resp = build_speaking_response(audio_b64);
+        if (buffers_segment()) audio_buffer_.insert(audio_buffer_.end(), data, data + len);
+        if (!transitions_only) {
+            if (speech_sink_) build_speaking_response(json_resp, nullptr, 0);
+            else build_speaking_response(json_resp, data, len);
         }
 
         last_state_ = VadState::SPEAKING;
@@ -124,24 +464,35 @@ std::string Session::process_audio(const std::vector<uint8_t>& raw_data) {
     else if (current_state == VadState::END_SPEAKING) {
         std::cout << "[Session " << id_ << "] VAD END_SPEAKING detected!" << std::endl;
         
-        // Final buffer append
-        audio_buffer_.insert(audio_buffer_.end(), raw_data.begin(), raw_data.end());
+        if (speech_sink_) {
+            if (segment_id_ == 0) segment_id_ = speech_sink_->begin_segment(segment_info());
+            speech_sink_->segment_audio(segment_id_, data, len);
+            speech_sink_->end_segment(segment_id_, false);
+            segment_id_ = 0;
+        }
+        if (buffers_segment()) {
+            // Final buffer append
+            audio_buffer_.insert(audio_buffer_.end(), data, data + len);
+        }
+        if (speech_sink_) build_end_response(json_resp, nullptr, 0);
+        else build_end_response(json_resp, audio_buffer_.data(), audio_buffer_.size());
 
-        std::string audio_b64 = base64::encode(audio_buffer_.data(), audio_buffer_.size());
-        json_resp = build_end_response(audio_b64);
+        // 归档: 整段缓冲区移交给归档线程 (队列满时留在原地，下面照常清空)
+        if (segment_archive_ && !audio_buffer_.empty()) segment_archive_->submit(segment_info(), audio_buffer_);
 
         // Clear buffer
         audio_buffer_.clear();
+        trim_pending_ = true;
         
         last_state_ = VadState::SILENCE;
     }
     else { // SILENCE
         // Clear buffer if we were somehow buffering in silence (safety)
         if (!audio_buffer_.empty()) audio_buffer_.clear();
-        json_resp = build_silence_response();
+        if (!transitions_only) build_silence_response(json_resp);
         
         last_state_ = VadState::SILENCE;
     }
 
-    return json_resp;
+    return !json_resp.empty();
 }
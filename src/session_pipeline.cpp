@@ -0,0 +1,93 @@
+#include "session_pipeline.h"
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include "pipeline_coroutine.h"
+
+PipelineExecutors::PipelineExecutors(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        // 并发提示为 1: 每个 io_context 只由一个工作线程运行，内部可省去锁
+        contexts_.push_back(std::make_unique<boost::asio::io_context>(1));
+        guards_.push_back(boost::asio::make_work_guard(*contexts_.back()));
+    }
+}
+
+void PipelineExecutors::run(size_t index) {
+    contexts_[index]->run();
+}
+
+void PipelineExecutors::stop() {
+    for (auto& guard : guards_) guard.reset();
+    for (auto& context : contexts_) context->stop();
+}
+
+SessionPipeline::SessionPipeline(boost::asio::io_context& context, uint64_t catchup_us)
+    : context_(context), signal_(context), catchup_us_(catchup_us) {}
+
+bool SessionPipeline::push(AudioTask&& task) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return false;
+        pending_us_ += task.audio_us;
+        inbox_.push_back(std::move(task));
+        wake = waiting_;
+        waiting_ = false;
+    }
+    // 定时器只在所属 io_context 上操作；协程登记等待与发起 async_wait 在同一次执行中完成，
+    // 这里投递的 cancel 一定在 async_wait 之后运行，不会丢失唤醒
+    if (wake) {
+        auto self = shared_from_this();
+        boost::asio::post(context_, [self] { self->signal_.cancel(); });
+    }
+    return true;
+}
+
+void SessionPipeline::close() {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return;
+        closed_ = true;
+        inbox_.clear();
+        pending_us_ = 0;
+        wake = waiting_;
+        waiting_ = false;
+    }
+    if (wake) {
+        auto self = shared_from_this();
+        boost::asio::post(context_, [self] { self->signal_.cancel(); });
+    }
+}
+
+bool SessionPipeline::pop_or_wait(AudioTask& task, bool& closed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed = closed_;
+    if (closed_) return false;
+    if (inbox_.empty()) {
+        waiting_ = true;
+        return false;
+    }
+    // 与调度器的追赶判定一致: 积压超过阈值且不止一个任务，只处理不带元数据的 PCM 任务
+    bool catching_up = catchup_us_ > 0 && inbox_.size() > 1 && pending_us_ >= catchup_us_;
+    task = std::move(inbox_.front());
+    inbox_.pop_front();
+    pending_us_ -= std::min(pending_us_, task.audio_us);
+    task.catch_up = catching_up && task.control == AudioTask::Control::NONE && task.bytes_per_sec != 0 &&
+                    task.uid.empty() && task.connect_session.empty() && task.current_session.empty();
+    return true;
+}
+
+void SessionPipeline::start(Processor processor) {
+    auto self = shared_from_this();
+    // step 只持有裸指针: 协程帧通过 keep_alive 持有本对象，避免 step 与对象互相引用
+    spawn_pipeline_coroutine(
+        context_, signal_,
+        [this, processor = std::move(processor), task = AudioTask()]() mutable {
+            bool closed = false;
+            if (!pop_or_wait(task, closed)) return closed ? PipelineStep::DONE : PipelineStep::WAIT;
+            processor(task);
+            task = AudioTask();
+            return PipelineStep::RAN;
+        },
+        self);
+}
@@ -0,0 +1,62 @@
+#include "session_pool.h"
+#include <iostream>
+#include <algorithm>
+
+SessionPool::SessionPool(size_t warm_size, size_t max_idle)
+    : max_idle_(std::max(max_idle, warm_size)) {
+    idle_.reserve(max_idle_);
+    for (size_t i = 0; i < warm_size; ++i) {
+        auto session = std::make_unique<Session>();
+        session->attach_engine(16000);
+        idle_.push_back(std::move(session));
+    }
+    if (warm_size > 0) {
+        std::cout << "SessionPool warmed up with " << warm_size << " sessions" << std::endl;
+    }
+}
+
+SessionPool::~SessionPool() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.clear();
+}
+
+std::shared_ptr<Session> SessionPool::acquire(std::string id, websocketpp::connection_hdl hdl,
+                                              const AudioFormat& format, DecoderPool* decoder_pool) {
+    std::unique_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            // 优先复用已挂载同采样率引擎的会话
+            int rate = format.decoded_format().engine_sample_rate();
+            size_t pick = idle_.size() - 1;
+            for (size_t i = idle_.size(); i-- > 0;) {
+                if (idle_[i]->engine_sample_rate() == rate) {
+                    pick = i;
+                    break;
+                }
+            }
+            session = std::move(idle_[pick]);
+            idle_[pick] = std::move(idle_.back());
+            idle_.pop_back();
+        }
+    }
+    if (!session) {
+        session = std::make_unique<Session>();
+    }
+    session->open(std::move(id), hdl, format, decoder_pool);
+    return std::shared_ptr<Session>(session.release(), [this](Session* s) { recycle(s); });
+}
+
+size_t SessionPool::idle_size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+void SessionPool::recycle(Session* session) {
+    std::unique_ptr<Session> owned(session);
+    owned->close();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < max_idle_) {
+        idle_.push_back(std::move(owned));
+    }
+}
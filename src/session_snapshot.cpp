@@ -0,0 +1,58 @@
+#include "session_snapshot.h"
+
+namespace snapshot {
+
+void write_header(Writer& w) {
+    for (char c : kMagic) w.put(c);
+    w.put<uint16_t>(kVersion);
+    w.put<uint16_t>(0);
+}
+
+bool read_header(Reader& r) {
+    char magic[sizeof(kMagic)];
+    for (char& c : magic) {
+        if (!r.get(c)) return false;
+    }
+    uint16_t version = 0, reserved = 0;
+    if (!r.get(version) || !r.get(reserved)) return false;
+    return std::memcmp(magic, kMagic, sizeof(kMagic)) == 0 && version == kVersion;
+}
+
+} // namespace snapshot
+
+void VadEngineState::write(snapshot::Writer& w) const {
+    w.put(sample_rate);
+    w.put_floats(context.data(), context.size());
+    w.put_floats(rnn_state.data(), rnn_state.size());
+    w.put(last_prob);
+    w.put<uint8_t>(triggered ? 1 : 0);
+    w.put(temp_end);
+    w.put(current_sample);
+    w.put(prev_end);
+    w.put(next_start);
+    w.put(speech_start);
+    w.put(speech_end);
+    w.put(last_start);
+    w.put(last_end);
+    w.put_floats(pending.data(), pending.size());
+}
+
+bool VadEngineState::read(snapshot::Reader& r) {
+    uint8_t trig = 0;
+    r.get(sample_rate);
+    r.get_floats(context);
+    r.get_floats(rnn_state);
+    r.get(last_prob);
+    r.get(trig);
+    r.get(temp_end);
+    r.get(current_sample);
+    r.get(prev_end);
+    r.get(next_start);
+    r.get(speech_start);
+    r.get(speech_end);
+    r.get(last_start);
+    r.get(last_end);
+    r.get_floats(pending);
+    triggered = trig != 0;
+    return r.ok() && rnn_state.size() == 2 * 1 * 128;
+}
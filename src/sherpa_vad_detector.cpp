@@ -59,9 +59,8 @@ VadResult SherpaVadDetector::emit_voice_silent() {
     return {VadState::SILENCE, vad_.get_last_probability(), ""};
 }
 
-VadResult SherpaVadDetector::process_frame(const std::vector<float>& audio_frame) {
-    // 1. 将数据加入 margin_buffer (Go: d.marginBuff.Append)
-    margin_buffer_.insert(margin_buffer_.end(), audio_frame.begin(), audio_frame.end());
+VadResult SherpaVadDetector::process_buffered() {
+    // 1. 数据已由调用方追加到 margin_buffer (Go: d.marginBuff.Append)
 
     // 2. 检查是否有足够的数据 (Go: block := d.marginBuff.Len() / FrameDuration20SizeInBytes)
     // FrameDuration20SizeInBytes 对应 frame_size_samples_ (320 samples)
@@ -74,22 +73,10 @@ VadResult SherpaVadDetector::process_frame(const std::vector<float>& audio_frame
     VadResult last_result = {VadState::SILENCE, 0.0f, ""};
     bool triggered_any = false;
 
-    // 3. 循环处理块
+    // 3. 循环处理块 (按偏移量读取，最后一次性移除已处理数据)
     for (int i = 0; i < blocks; ++i) {
-        // 提取一帧
-        std::vector<float> frame(
-            margin_buffer_.begin(), 
-            margin_buffer_.begin() + frame_size_samples_
-        );
-        
-        // 移除已处理数据
-        margin_buffer_.erase(
-            margin_buffer_.begin(), 
-            margin_buffer_.begin() + frame_size_samples_
-        );
-
         // 调用内部处理逻辑
-        VadResult res = process_internal(frame);
+        VadResult res = process_internal(margin_buffer_.data() + static_cast<size_t>(i) * frame_size_samples_);
         
         // 如果有重要状态变化，记录下来
         // 注意：单次调用可能产生多次状态变化（理论上），
@@ -102,11 +89,12 @@ VadResult SherpaVadDetector::process_frame(const std::vector<float>& audio_frame
             last_result = res;
         }
     }
+    margin_buffer_.erase(margin_buffer_.begin(), margin_buffer_.begin() + static_cast<size_t>(blocks) * frame_size_samples_);
 
     return last_result;
 }
 
-VadResult SherpaVadDetector::process_internal(const std::vector<float>& frame) {
+VadResult SherpaVadDetector::process_internal(const float* frame) {
     // Go: d.vad.IsSpeech()
     // 我们使用 vad_.predict(frame)
     // 注意：VadIterator 内部有自己的 buffer 和 window 逻辑，
@@ -139,7 +127,7 @@ VadResult SherpaVadDetector::process_internal(const std::vector<float>& frame) {
     switch (state_) {
     case GoState::Inactivity:
         // d.fixed.Append(sourceBuff)
-        fixed_buffer_.insert(fixed_buffer_.end(), frame.begin(), frame.end());
+        fixed_buffer_.insert(fixed_buffer_.end(), frame, frame + frame_size_samples_);
         while (fixed_buffer_.size() > fixed_buffer_capacity_) {
             fixed_buffer_.pop_front();
         }
@@ -165,7 +153,7 @@ VadResult SherpaVadDetector::process_internal(const std::vector<float>& frame) {
 
     case GoState::InactivityTransition:
         // d.fixed.Append(sourceBuff)
-        fixed_buffer_.insert(fixed_buffer_.end(), frame.begin(), frame.end());
+        fixed_buffer_.insert(fixed_buffer_.end(), frame, frame + frame_size_samples_);
         while (fixed_buffer_.size() > fixed_buffer_capacity_) {
             fixed_buffer_.pop_front();
         }
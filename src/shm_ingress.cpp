@@ -0,0 +1,330 @@
+#include "shm_ingress.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include "server.h"
+#include "shm_ring.h"
+
+namespace {
+
+size_t round_up_pow2(size_t v) {
+    size_t p = 4096;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+// epoll 数据: 高 32 位为类型，低 32 位为 fd
+enum EventKind : uint64_t {
+    KIND_LISTEN = 1,
+    KIND_STOP = 2,
+    KIND_SOCKET = 3, // 生产者的控制套接字 (打开请求、挂断)
+    KIND_PCM = 4,    // 音频环 eventfd
+};
+
+uint64_t event_tag(EventKind kind, int fd) {
+    return (static_cast<uint64_t>(kind) << 32) | static_cast<uint32_t>(fd);
+}
+
+} // namespace
+
+// 一个流: 共享内存段 + 两个 eventfd + 会话调度参数
+// 工作线程经 LocalRoute 写事件环；音频记录的租约持有本对象，段在最后一个租约释放后才解除映射
+class ShmIngress::Stream : public LocalRoute {
+public:
+    Stream(int sock_fd, std::atomic<uint64_t>& dropped_events) : sock_fd(sock_fd), dropped_events_(dropped_events) {}
+
+    ~Stream() override {
+        if (base_) munmap(base_, size_);
+        if (memfd >= 0) ::close(memfd);
+        if (pcm_fd >= 0) ::close(pcm_fd);
+        if (event_fd >= 0) ::close(event_fd);
+        if (sock_fd >= 0) ::close(sock_fd);
+    }
+
+    bool create(size_t pcm_capacity, size_t event_capacity) {
+        size_ = shm::segment_size(pcm_capacity, event_capacity);
+        memfd = memfd_create("vad-shm-stream", MFD_CLOEXEC);
+        if (memfd < 0 || ftruncate(memfd, static_cast<off_t>(size_)) < 0) return false;
+        void* base = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (base == MAP_FAILED) return false;
+        base_ = static_cast<uint8_t*>(base);
+#ifdef MADV_POPULATE_WRITE
+        // 只预先分配头部与音频环 (每帧都写)；事件环较大，页面在事件写到时才分配
+        madvise(base_, shm::header_size() + pcm_capacity, MADV_POPULATE_WRITE);
+#endif
+
+        // memfd 初始全零，只需填写头部；两个环的消费者都从"等待中"开始，第一条记录就会唤醒
+        shm::SegmentHeader* header = reinterpret_cast<shm::SegmentHeader*>(base_);
+        header->magic = shm::kMagic;
+        header->version = shm::kVersion;
+        header->pcm_capacity = pcm_capacity;
+        header->event_capacity = event_capacity;
+        header->segment_size = size_;
+        header->pcm.waiting.store(1);
+        header->events.waiting.store(1);
+        uint8_t* pcm_data = base_ + shm::header_size();
+        pcm = shm::RingReader(&header->pcm, pcm_data, pcm_capacity);
+        events_ = shm::RingWriter(&header->events, pcm_data + pcm_capacity, event_capacity);
+
+        pcm_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        return pcm_fd >= 0 && event_fd >= 0;
+    }
+
+    size_t size() const { return size_; }
+
+    // 音频记录处理完 (租约释放或空记录)；按读出顺序归还环空间
+    void complete_record(uint64_t end) {
+        uint64_t released = pcm_order.complete(end);
+        if (released != 0) pcm.release(released);
+    }
+
+    // 工作线程调用: 同一会话固定在一个工作线程上，事件环只有这一个写者
+    void send_event(const std::string& payload) override {
+        if (closed.load(std::memory_order_acquire)) return;
+        bool notify = false;
+        if (!events_.write_message(payload.data(), payload.size(), notify)) {
+            dropped_events_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (notify) {
+            uint64_t one = 1;
+            ssize_t n = ::write(event_fd, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    int sock_fd;
+    int memfd = -1;
+    int pcm_fd = -1;   // 生产者 -> 服务端
+    int event_fd = -1; // 服务端 -> 生产者
+    shm::RingReader pcm;
+    shm::ReleaseOrder pcm_order;
+    LocalStream local;
+    std::atomic<bool> closed{false};
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    shm::RingWriter events_;
+    std::atomic<uint64_t>& dropped_events_;
+};
+
+namespace {
+
+// 音频记录的租约: 任务 (及其切片) 全部释放后标记该记录处理完，由 ReleaseOrder 按写入顺序归还环空间
+template <typename StreamPtr>
+struct RecordLease {
+    RecordLease(StreamPtr stream, uint64_t end) : stream(std::move(stream)), end(end) {}
+    ~RecordLease() { stream->complete_record(end); }
+    StreamPtr stream;
+    uint64_t end;
+};
+
+} // namespace
+
+ShmIngress::ShmIngress(AudioServer& owner, const ShmIngressOptions& options) : owner_(owner), options_(options) {
+    options_.pcm_ring_bytes = round_up_pow2(options_.pcm_ring_bytes);
+    options_.event_ring_bytes = round_up_pow2(options_.event_ring_bytes);
+}
+
+ShmIngress::~ShmIngress() {
+    streams_.clear();
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        unlink(options_.socket_path.c_str());
+    }
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    if (stop_fd_ >= 0) ::close(stop_fd_);
+}
+
+bool ShmIngress::open() {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (options_.socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Shared-memory ingress socket path too long: " << options_.socket_path << std::endl;
+        return false;
+    }
+    std::strcpy(addr.sun_path, options_.socket_path.c_str());
+    unlink(options_.socket_path.c_str());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on " << options_.socket_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || stop_fd_ < 0) return false;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = event_tag(KIND_LISTEN, listen_fd_);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    ev.data.u64 = event_tag(KIND_STOP, stop_fd_);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &ev);
+    return true;
+}
+
+void ShmIngress::run() {
+    epoll_event events[256];
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, 256, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n && running_; ++i) {
+            EventKind kind = static_cast<EventKind>(events[i].data.u64 >> 32);
+            int fd = static_cast<int>(events[i].data.u64 & 0xFFFFFFFF);
+            if (kind == KIND_LISTEN) {
+                accept_all();
+                continue;
+            }
+            if (kind == KIND_STOP) continue;
+            auto it = streams_.find(fd);
+            if (it == streams_.end()) continue;
+            std::shared_ptr<Stream> stream = it->second;
+            if (kind == KIND_PCM) {
+                uint64_t value;
+                ssize_t r = ::read(fd, &value, sizeof(value));
+                (void)r;
+                drain(stream);
+            } else if (stream->memfd < 0) {
+                open_stream(fd);
+            } else {
+                // 建立之后套接字上只剩挂断 (多余的消息忽略)
+                char buf[256];
+                ssize_t r = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR) || (events[i].events & (EPOLLHUP | EPOLLRDHUP))) {
+                    close_stream(fd);
+                }
+            }
+        }
+    }
+    while (!streams_.empty()) close_stream(streams_.begin()->second->sock_fd);
+}
+
+void ShmIngress::stop() {
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t n = ::write(stop_fd_, &one, sizeof(one));
+    (void)n;
+}
+
+void ShmIngress::accept_all() {
+    for (;;) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        streams_[fd] = std::make_shared<Stream>(fd, dropped_events_);
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = event_tag(KIND_SOCKET, fd);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void ShmIngress::open_stream(int fd) {
+    std::shared_ptr<Stream> stream = streams_[fd];
+    char request[2048];
+    ssize_t n = ::recv(fd, request, sizeof(request), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    if (n <= 0) {
+        close_stream(fd);
+        return;
+    }
+    std::string resource(request, static_cast<size_t>(n));
+
+    shm::OpenReply reply = {};
+    reply.magic = shm::kMagic;
+    if (!stream->create(options_.pcm_ring_bytes, options_.event_ring_bytes)) {
+        std::cerr << "Cannot create shared-memory stream: " << std::strerror(errno) << std::endl;
+        reply.status = 1011; // internal error
+    } else {
+        std::shared_ptr<LocalRoute> route = stream;
+        reply.status = owner_.open_local_session(route, resource, stream->local);
+    }
+    reply.segment_size = reply.status == 0 ? stream->size() : 0;
+
+    // 应答与三个 fd 一起发出: 段、音频环 eventfd、事件环 eventfd
+    iovec iov = {&reply, sizeof(reply)};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+    if (reply.status == 0) {
+        int fds[3] = {stream->memfd, stream->pcm_fd, stream->event_fd};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    }
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0 || reply.status != 0) {
+        close_stream(fd);
+        return;
+    }
+
+    streams_[stream->pcm_fd] = stream;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = event_tag(KIND_PCM, stream->pcm_fd);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stream->pcm_fd, &ev);
+    streams_opened_.fetch_add(1, std::memory_order_relaxed);
+    // 生产者可能在收到应答前就没有等待唤醒: 先读一遍
+    drain(stream);
+}
+
+void ShmIngress::drain(const std::shared_ptr<Stream>& stream) {
+    if (stream->closed.load(std::memory_order_relaxed)) return;
+    const uint8_t* payload;
+    uint32_t size;
+    uint64_t end;
+    uint64_t count = 0;
+    for (;;) {
+        while (stream->pcm.next(payload, size, end)) {
+            stream->pcm_order.track(end);
+            if (size == 0) {
+                // 空记录不进入流水线，但也要等之前的租约都释放后才归还
+                stream->complete_record(end);
+                continue;
+            }
+            // 负载直接引用环内存，租约 (aliasing shared_ptr) 释放时归还
+            auto lease = std::make_shared<RecordLease<std::shared_ptr<Stream>>>(stream, end);
+            AudioTask task;
+            task.external = std::shared_ptr<const uint8_t>(lease, payload);
+            task.external_size = size;
+            owner_.push_local_task(stream->local, std::move(task));
+            ++count;
+        }
+        if (stream->pcm.corrupted()) {
+            std::cerr << "Shared-memory stream " << stream->sock_fd << " sent a corrupted record, closing" << std::endl;
+            close_stream(stream->sock_fd);
+            break;
+        }
+        if (stream->pcm.prepare_wait()) break;
+    }
+    records_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void ShmIngress::close_stream(int fd) {
+    auto it = streams_.find(fd);
+    if (it == streams_.end()) return;
+    std::shared_ptr<Stream> stream = it->second;
+    stream->closed.store(true, std::memory_order_release);
+    owner_.close_local_session(stream->local);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, stream->sock_fd, nullptr);
+    streams_.erase(stream->sock_fd);
+    if (stream->pcm_fd >= 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, stream->pcm_fd, nullptr);
+        streams_.erase(stream->pcm_fd);
+    }
+    // 先关套接字让生产者立即看到挂断；段与 eventfd 等最后一个租约释放后随对象关闭
+    ::close(stream->sock_fd);
+    stream->sock_fd = -1;
+}
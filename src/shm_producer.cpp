@@ -0,0 +1,137 @@
+#include "shm_producer.h"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+
+ShmProducer::~ShmProducer() {
+    close();
+}
+
+bool ShmProducer::open(const std::string& socket_path, const std::string& resource) {
+    close();
+    status_ = 0;
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) return false;
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    sock_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock_fd_ < 0 || connect(sock_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        send(sock_fd_, resource.data(), resource.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(resource.size())) {
+        close();
+        return false;
+    }
+
+    // 应答: OpenReply + SCM_RIGHTS [memfd, 音频环 eventfd, 事件环 eventfd]
+    shm::OpenReply reply = {};
+    iovec iov = {&reply, sizeof(reply)};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(sock_fd_, &msg, MSG_CMSG_CLOEXEC);
+    int memfd = -1;
+    cmsghdr* cmsg = n == static_cast<ssize_t>(sizeof(reply)) ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(3 * sizeof(int))) {
+        int fds[3];
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        memfd = fds[0];
+        pcm_fd_ = fds[1];
+        event_fd_ = fds[2];
+    }
+    if (n == static_cast<ssize_t>(sizeof(reply)) && reply.magic == shm::kMagic) status_ = reply.status;
+    if (memfd < 0 || reply.magic != shm::kMagic || reply.status != 0) {
+        if (memfd >= 0) ::close(memfd);
+        close();
+        return false;
+    }
+
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(memfd, &st) == 0 && static_cast<uint64_t>(st.st_size) == reply.segment_size &&
+        reply.segment_size > shm::header_size()) {
+        base = mmap(nullptr, reply.segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    }
+    ::close(memfd);
+    if (base == MAP_FAILED) {
+        close();
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(base);
+    size_ = reply.segment_size;
+
+    const shm::SegmentHeader* header = reinterpret_cast<const shm::SegmentHeader*>(base_);
+    if (header->magic != shm::kMagic || header->version != shm::kVersion ||
+        shm::segment_size(header->pcm_capacity, header->event_capacity) != size_) {
+        close();
+        return false;
+    }
+    shm::SegmentHeader* mutable_header = reinterpret_cast<shm::SegmentHeader*>(base_);
+    uint8_t* pcm_data = base_ + shm::header_size();
+    pcm_ = shm::RingWriter(&mutable_header->pcm, pcm_data, header->pcm_capacity);
+    events_ = shm::RingReader(&mutable_header->events, pcm_data + header->pcm_capacity, header->event_capacity);
+    return true;
+}
+
+void ShmProducer::close() {
+    if (base_) munmap(base_, size_);
+    base_ = nullptr;
+    size_ = 0;
+    if (sock_fd_ >= 0) ::close(sock_fd_);
+    if (pcm_fd_ >= 0) ::close(pcm_fd_);
+    if (event_fd_ >= 0) ::close(event_fd_);
+    sock_fd_ = pcm_fd_ = event_fd_ = -1;
+}
+
+uint8_t* ShmProducer::reserve(size_t size) {
+    return base_ ? pcm_.reserve(size) : nullptr;
+}
+
+void ShmProducer::commit() {
+    if (pcm_.commit()) {
+        uint64_t one = 1;
+        ssize_t n = ::write(pcm_fd_, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+bool ShmProducer::write(const void* data, size_t size) {
+    uint8_t* dst = reserve(size);
+    if (!dst) return false;
+    std::memcpy(dst, data, size);
+    commit();
+    return true;
+}
+
+bool ShmProducer::read_event(std::string& out) {
+    if (!base_) return false;
+    const uint8_t* payload;
+    uint32_t size;
+    uint64_t end;
+    if (!events_.next(payload, size, end)) return false;
+    out.assign(reinterpret_cast<const char*>(payload), size);
+    // 长事件拆成了多条记录，服务端一次发布，后续记录此时都已可读
+    while (events_.more()) {
+        if (!events_.next(payload, size, end)) {
+            out.clear();
+            return false;
+        }
+        out.append(reinterpret_cast<const char*>(payload), size);
+    }
+    events_.release(end);
+    return true;
+}
+
+bool ShmProducer::prepare_wait() {
+    if (!base_) return true;
+    // 先清空 eventfd 计数，之后到达的唤醒留在 fd 上
+    uint64_t value;
+    ssize_t n = ::read(event_fd_, &value, sizeof(value));
+    (void)n;
+    return events_.prepare_wait();
+}
@@ -0,0 +1,15 @@
+#include "static_vad_engine.h"
+
+template class StaticVadEngine<16000, 32>;
+template class StaticVadEngine<8000, 32>;
+
+std::unique_ptr<IVadEngine> make_static_vad_engine(std::shared_ptr<VadModel> model, int sample_rate, float threshold) {
+    switch (sample_rate) {
+    case 16000:
+        return std::unique_ptr<IVadEngine>(new StaticVadEngine<16000, 32>(std::move(model), threshold));
+    case 8000:
+        return std::unique_ptr<IVadEngine>(new StaticVadEngine<8000, 32>(std::move(model), threshold));
+    default:
+        return nullptr;
+    }
+}
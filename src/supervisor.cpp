@@ -0,0 +1,202 @@
+#include "supervisor.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+volatile sig_atomic_t g_stop_signal = 0;
+
+void on_stop_signal(int sig) {
+    g_stop_signal = sig;
+}
+
+std::vector<int> available_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// 工作进程: 绑核后运行一个完整的 AudioServer；收到 supervisor 转发的 SIGTERM 时优雅退出
+// (写完归档队列、排空或停止会话、打印统计)，见 AudioServer::run_until_signal
+int run_child(ServerConfig config, size_t index, const std::vector<int>& cpus) {
+    // 不沿用 supervisor 的信号处理函数 (只设置 supervisor 自己的标志)
+    std::signal(SIGTERM, SIG_DFL);
+    std::signal(SIGINT, SIG_DFL);
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            std::cerr << "Process " << index << ": failed to set CPU affinity" << std::endl;
+        }
+    }
+    config.reuse_port = true;
+    // 每个进程写自己的抓包文件、监听自己的共享内存接入套接字
+    if (!config.capture_path.empty()) config.capture_path += "." + std::to_string(index);
+    if (!config.shm_socket.empty()) config.shm_socket += "." + std::to_string(index);
+    // 共用归档目录，文件名带进程序号
+    config.archive_prefix = std::to_string(index) + "_";
+    try {
+        AudioServer::run_until_signal(config);
+    } catch (std::exception& e) {
+        std::cerr << "Process " << index << " exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+pid_t spawn(const ServerConfig& config, size_t index, const std::vector<int>& cpus) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int code = run_child(config, index, cpus);
+        std::cout.flush();
+        std::_Exit(code);
+    }
+    if (pid < 0) {
+        std::cerr << "fork failed for process " << index << std::endl;
+    } else {
+        std::cout << "Started process " << index << " (pid " << pid << ")" << std::endl;
+    }
+    return pid;
+}
+
+// 在临时子进程中加载一次模型，生成 ORT 格式缓存，之后各工作进程直接映射这份缓存。
+// supervisor 自己不创建 ORT 环境，fork 出的子进程不会继承 ORT 的线程与锁。
+bool prepare_model() {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int code = 0;
+        try {
+            VadModel::get();
+        } catch (std::exception& e) {
+            std::cerr << "Model load failed: " << e.what() << std::endl;
+            code = 1;
+        }
+        std::cout.flush();
+        std::_Exit(code);
+    }
+    if (pid < 0) return false;
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+bool parse_cpu_sets(const std::string& text, std::vector<std::vector<int>>& sets) {
+    sets.clear();
+    size_t group_start = 0;
+    while (group_start <= text.size()) {
+        size_t group_end = text.find(';', group_start);
+        if (group_end == std::string::npos) group_end = text.size();
+        std::vector<int> cpus;
+        size_t item_start = group_start;
+        while (item_start < group_end) {
+            size_t item_end = text.find(',', item_start);
+            if (item_end == std::string::npos || item_end > group_end) item_end = group_end;
+            std::string item = text.substr(item_start, item_end - item_start);
+            char* end = nullptr;
+            long first = std::strtol(item.c_str(), &end, 10);
+            long last = first;
+            if (*end == '-') last = std::strtol(end + 1, &end, 10);
+            if (end == item.c_str() || *end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+                return false;
+            }
+            for (long cpu = first; cpu <= last; ++cpu) cpus.push_back(static_cast<int>(cpu));
+            item_start = item_end + 1;
+        }
+        if (cpus.empty()) return false;
+        sets.push_back(std::move(cpus));
+        group_start = group_end + 1;
+    }
+    return !sets.empty();
+}
+
+int run_supervisor(const ServerConfig& server_config, const SupervisorConfig& config) {
+    size_t processes = config.processes;
+    std::vector<std::vector<int>> cpu_sets(processes);
+    if (!config.cpu_sets.empty()) {
+        for (size_t i = 0; i < processes; ++i) cpu_sets[i] = config.cpu_sets[i % config.cpu_sets.size()];
+    } else {
+        // 把可用 CPU 按编号连续切分 (相邻编号通常在同一个 NUMA 节点上)；CPU 不够分时不绑核
+        std::vector<int> cpus = available_cpus();
+        if (cpus.size() >= processes) {
+            for (size_t i = 0; i < processes; ++i) {
+                size_t begin = i * cpus.size() / processes;
+                size_t end = (i + 1) * cpus.size() / processes;
+                cpu_sets[i].assign(cpus.begin() + begin, cpus.begin() + end);
+            }
+        }
+    }
+
+    if (!prepare_model()) {
+        std::cerr << "Cannot load VAD model, not starting workers" << std::endl;
+        return 1;
+    }
+    if (!VadModel::cache_fresh(VadModel::options())) {
+        std::cerr << "ORT model cache " << VadModel::cache_path(VadModel::options())
+                  << " unavailable, each worker process loads a private copy of the model" << std::endl;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = on_stop_signal;
+    sigemptyset(&action.sa_mask);
+    // 不设 SA_RESTART: 信号到来时 waitpid 返回 EINTR
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+
+    std::vector<pid_t> pids(processes, -1);
+    for (size_t i = 0; i < processes; ++i) {
+        pids[i] = spawn(server_config, i, cpu_sets[i]);
+    }
+
+    while (!g_stop_signal) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (size_t i = 0; i < processes; ++i) {
+            if (pids[i] != pid) continue;
+            pids[i] = -1;
+            if (WIFSIGNALED(status)) {
+                std::cerr << "Process " << i << " (pid " << pid << ") killed by signal " << WTERMSIG(status)
+                          << std::endl;
+            } else {
+                std::cerr << "Process " << i << " (pid " << pid << ") exited with " << WEXITSTATUS(status)
+                          << std::endl;
+            }
+            if (g_stop_signal) break;
+            // 只有这个进程上的连接断开；稍等再拉起，避免崩溃循环占满 CPU
+            sleep(1);
+            if (!g_stop_signal) pids[i] = spawn(server_config, i, cpu_sets[i]);
+            break;
+        }
+    }
+
+    std::cout << "Stopping " << processes << " processes" << std::endl;
+    for (pid_t pid : pids) {
+        if (pid > 0) kill(pid, SIGTERM);
+    }
+    for (;;) {
+        pid_t pid = waitpid(-1, nullptr, 0);
+        if (pid > 0 || errno == EINTR) continue;
+        break;
+    }
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include "task_scheduler.h"
+
+size_t TaskScheduler::slice_bytes(const AudioTask& task) const {
+    if (task.bytes_per_sec == 0 || task.frame_bytes == 0 || config_.slice_ms == 0) return 0;
+    size_t bytes = static_cast<size_t>(task.bytes_per_sec) * config_.slice_ms / 1000;
+    return bytes / task.frame_bytes * task.frame_bytes;
+}
+
+TaskScheduler::time_point TaskScheduler::head_deadline(const SessionQueue& q) const {
+    const AudioTask& head = q.tasks.front();
+    if (q.head_offset == 0 || head.bytes_per_sec == 0) return head.deadline;
+    // 已派发部分对应的音频时长顺延截止时间
+    auto consumed_us = static_cast<int64_t>(q.head_offset) * 1000000 / head.bytes_per_sec;
+    return head.deadline + std::chrono::microseconds(consumed_us);
+}
+
+bool TaskScheduler::catching_up(const SessionQueue& q) const {
+    return config_.catchup_ms > 0 && q.tasks.size() > 1 &&
+           q.pending_us >= static_cast<uint64_t>(config_.catchup_ms) * 1000;
+}
+
+uint64_t TaskScheduler::queued_us(const SessionQueue& q, size_t index) const {
+    const AudioTask& task = q.tasks[index];
+    size_t bytes = task.payload_size() - (index == 0 ? q.head_offset : 0);
+    return static_cast<uint64_t>(bytes) * 1000000 / task.bytes_per_sec;
+}
+
+void TaskScheduler::extend_span(SessionQueue& q) const {
+    uint64_t limit_us = static_cast<uint64_t>(config_.catchup_max_ms) * 1000;
+    while (!q.span_closed && q.span_count < q.tasks.size()) {
+        const AudioTask& task = q.tasks[q.span_count];
+        if (q.span_count > 0) {
+            // 元数据会改变之后响应的内容，带元数据的任务另起一段
+            if (task.bytes_per_sec == 0 || !task.uid.empty() || !task.connect_session.empty() ||
+                !task.current_session.empty()) {
+                q.span_closed = true;
+                break;
+            }
+        }
+        uint64_t us = queued_us(q, q.span_count);
+        if (q.span_count > 0 && q.span_us + us > limit_us) {
+            q.span_closed = true;
+            break;
+        }
+        q.span_us += us;
+        ++q.span_count;
+    }
+}
+
+size_t TaskScheduler::catchup_span(SessionQueue& q, uint64_t& audio_us) const {
+    audio_us = 0;
+    if (!catching_up(q) || q.tasks.front().bytes_per_sec == 0) return 0;
+    if (!q.span_valid) {
+        q.span_count = 0;
+        q.span_us = 0;
+        q.span_closed = false;
+        q.span_valid = true;
+        extend_span(q);
+    }
+    audio_us = q.span_us;
+    return q.span_count;
+}
+
+size_t TaskScheduler::next_bytes(const SessionQueue& q) const {
+    const AudioTask& head = q.tasks.front();
+    size_t remaining = head.payload_size() - q.head_offset;
+    // 追赶模式不再切片
+    if (catching_up(q)) return remaining;
+    size_t slice = slice_bytes(head);
+    return slice > 0 && remaining > 2 * slice ? slice : remaining;
+}
+
+uint64_t TaskScheduler::next_cost_us(const SessionQueue& q) const {
+    // 追赶模式下是队首这一个原始任务的代价；额度有余时 take_next 再并入后续任务
+    const AudioTask& head = q.tasks.front();
+    if (head.bytes_per_sec == 0) return head.audio_us;
+    return static_cast<uint64_t>(next_bytes(q)) * 1000000 / head.bytes_per_sec;
+}
+
+void TaskScheduler::make_ready(uint64_t key, SessionQueue& q) {
+    if (!held_.empty() && held_.count(key)) return;
+    q.ready = true;
+    if (config_.policy == SchedulerConfig::Policy::DRR) {
+        active_.push_back(key);
+    } else {
+        ready_.push(ReadyEntry{head_deadline(q), seq_++, key});
+    }
+}
+
+void TaskScheduler::push(AudioTask task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t key = key_of(task.session_ref);
+        SessionQueue& q = sessions_[key];
+        q.pending_us += task.audio_us;
+        q.tasks.push_back(std::move(task));
+        if (q.span_valid) extend_span(q);
+        if (!q.ready) make_ready(key, q);
+    }
+    cond_.notify_one();
+}
+
+void TaskScheduler::take_merged(SessionQueue& q, size_t count, uint64_t audio_us, AudioTask& out) {
+    AudioTask& head = q.tasks.front();
+    out.session_ref = head.session_ref;
+    out.deadline = head_deadline(q);
+    out.bytes_per_sec = head.bytes_per_sec;
+    out.frame_bytes = head.frame_bytes;
+    if (q.head_offset == 0) {
+        out.uid = std::move(head.uid);
+        out.connect_session = std::move(head.connect_session);
+        out.current_session = std::move(head.current_session);
+    } else {
+        out.uid.clear();
+        out.connect_session.clear();
+        out.current_session.clear();
+    }
+    // 锁内只转移所有权 (引用计数)，不拷贝音频
+    merge_parts_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        AudioTask& task = q.tasks.front();
+        if (i == 0 && q.head_offset > 0) {
+            size_t remaining = task.payload_size() - q.head_offset;
+            task.offset += q.head_offset;
+            task.length = remaining;
+        }
+        merge_parts_.push_back(std::move(task));
+        q.tasks.pop_front();
+    }
+    q.head_offset = 0;
+
+    out.msg.reset();
+    out.external.reset();
+    out.external_size = 0;
+    out.data.reset();
+    out.offset = 0;
+    out.length = SIZE_MAX;
+    out.audio_us = audio_us;
+    out.catch_up = true;
+}
+
+void TaskScheduler::finish_merged(AudioTask& out) {
+    size_t total = 0;
+    for (const AudioTask& part : merge_parts_) total += part.payload_size();
+    auto merged = std::make_shared<std::vector<uint8_t>>();
+    merged->reserve(total);
+    for (const AudioTask& part : merge_parts_) {
+        merged->insert(merged->end(), part.payload(), part.payload() + part.payload_size());
+    }
+    out.data = std::move(merged);
+    // 原始消息与共享内存租约在这里释放
+    merge_parts_.clear();
+}
+
+bool TaskScheduler::take_next(SessionQueue& q, uint64_t budget_us, AudioTask& out) {
+    uint64_t merged_us = 0;
+    size_t merge = catchup_span(q, merged_us);
+    if (merge > 1 && merged_us > budget_us) {
+        // DRR: 只并入额度付得起的原始任务 (队首一个总是付得起)
+        size_t span = merge;
+        merge = 0;
+        merged_us = 0;
+        while (merge < span) {
+            uint64_t us = queued_us(q, merge);
+            if (merge > 0 && merged_us + us > budget_us) break;
+            merged_us += us;
+            ++merge;
+        }
+    }
+    // 队首即将变化，合并范围下次重新计算
+    q.span_valid = false;
+    bool catch_up = catching_up(q);
+    AudioTask& head = q.tasks.front();
+    size_t remaining = head.payload_size() - q.head_offset;
+    size_t bytes = next_bytes(q);
+    if (merge > 1) {
+        take_merged(q, merge, merged_us, out);
+    } else if (bytes < remaining) {
+        // 切出一片: 共享负载，只有第一片携带元数据
+        out.session_ref = head.session_ref;
+        out.msg = head.msg;
+        out.data = head.data;
+        out.external = head.external;
+        out.external_size = head.external_size;
+        out.offset = head.offset + q.head_offset;
+        out.length = bytes;
+        if (q.head_offset == 0) {
+            out.uid = head.uid;
+            out.connect_session = head.connect_session;
+            out.current_session = head.current_session;
+        } else {
+            out.uid.clear();
+            out.connect_session.clear();
+            out.current_session.clear();
+        }
+        out.deadline = head_deadline(q);
+        out.bytes_per_sec = head.bytes_per_sec;
+        out.frame_bytes = head.frame_bytes;
+        out.audio_us = static_cast<uint64_t>(bytes) * 1000000 / head.bytes_per_sec;
+        out.catch_up = false;
+        q.head_offset += bytes;
+    } else {
+        // 整个 (剩余的) 任务
+        out = std::move(head);
+        if (q.head_offset > 0) {
+            out.offset += q.head_offset;
+            out.length = remaining;
+            out.audio_us = static_cast<uint64_t>(remaining) * 1000000 / out.bytes_per_sec;
+            out.uid.clear();
+            out.connect_session.clear();
+            out.current_session.clear();
+        }
+        out.catch_up = catch_up;
+        q.tasks.pop_front();
+        q.head_offset = 0;
+    }
+    q.pending_us -= std::min(q.pending_us, out.audio_us);
+    return q.tasks.empty();
+}
+
+uint64_t TaskScheduler::pick_edf() {
+    uint64_t key = ready_.top().key;
+    ready_.pop();
+    return key;
+}
+
+uint64_t TaskScheduler::pick_drr() {
+    // 经典 DRR: 会话进入新一轮时领取一个额度，额度够付队首的代价就继续服务，不够则轮到下一个会话
+    // 额度在 pop() 中按实际派发的音频扣减
+    for (;;) {
+        uint64_t key = active_.front();
+        SessionQueue& q = sessions_[key];
+        if (!q.in_round) {
+            q.deficit_us += static_cast<uint64_t>(config_.quantum_ms) * 1000;
+            q.in_round = true;
+        }
+        if (next_cost_us(q) <= q.deficit_us) {
+            active_.pop_front();
+            return key;
+        }
+        q.in_round = false;
+        active_.pop_front();
+        active_.push_back(key);
+    }
+}
+
+bool TaskScheduler::pop(AudioTask& out) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool drr = config_.policy == SchedulerConfig::Policy::DRR;
+        cond_.wait(lock, [this, drr] { return stopped_ || (drr ? !active_.empty() : !ready_.empty()); });
+        if (drr ? active_.empty() : ready_.empty()) {
+            // 已停止且可派发的任务都已处理完: 剩下的只有暂扣中的会话 (迁移未完成)，计入丢弃
+            for (const auto& entry : sessions_) dropped_on_stop_ += entry.second.tasks.size();
+            sessions_.clear();
+            return false;
+        }
+
+        uint64_t key = drr ? pick_drr() : pick_edf();
+        auto it = sessions_.find(key);
+        SessionQueue& q = it->second;
+        q.ready = false;
+
+        bool empty = take_next(q, drr ? q.deficit_us : UINT64_MAX, out);
+        if (drr) q.deficit_us -= std::min(q.deficit_us, out.audio_us);
+        if (empty) {
+            // 队列清空的会话退出轮转，赤字清零 (DRR 不允许空闲会话囤积额度)
+            sessions_.erase(it);
+        } else if (drr && q.in_round) {
+            // 本轮额度未用完: 留在队首继续服务
+            q.ready = true;
+            active_.push_front(key);
+        } else {
+            make_ready(key, q);
+        }
+    }
+    if (!merge_parts_.empty()) finish_merged(out);
+    return true;
+}
+
+void TaskScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_.notify_all();
+}
+
+void TaskScheduler::hold(SessionRef ref) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    held_.insert(key_of(ref));
+}
+
+void TaskScheduler::release(SessionRef ref) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t key = key_of(ref);
+        if (held_.erase(key) == 0) return;
+        auto it = sessions_.find(key);
+        if (it == sessions_.end() || it->second.ready) return;
+        make_ready(key, it->second);
+    }
+    cond_.notify_one();
+}
+
+size_t TaskScheduler::dropped_on_stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_on_stop_;
+}
+
+size_t TaskScheduler::pending_sessions() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.size();
+}
@@ -0,0 +1,234 @@
+// 语音段归档单元测试: WAV 文件内容 (头与负载)、文件名清洗、目录中不残留临时文件、队列封顶时的丢弃计数，
+// 以及 stop() 写完排队的段。在临时目录中运行，由 ctest 运行
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "segment_archive.h"
+#include "test_check.h"
+#include "wav.h"
+
+namespace {
+
+bool wait_for(const std::function<bool()>& done, int timeout_ms = 5000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!done()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+std::vector<uint8_t> pattern(size_t size, uint32_t seed) {
+    std::vector<uint8_t> pcm(size);
+    for (size_t i = 0; i < size; ++i) pcm[i] = static_cast<uint8_t>((i * 131 + seed * 7) & 0xFF);
+    return pcm;
+}
+
+SpeechSegmentInfo info_for(const std::string& uid, const std::string& session, int sample_rate = 16000,
+                           int channels = 1) {
+    SpeechSegmentInfo info;
+    info.uid = uid;
+    info.new_session = session;
+    info.sample_rate = sample_rate;
+    info.channels = channels;
+    return info;
+}
+
+std::vector<std::string> list_dir(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return names;
+    while (dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") names.push_back(name);
+    }
+    closedir(d);
+    return names;
+}
+
+bool read_fd(int fd, std::string& out) {
+    char buf[4096];
+    for (;;) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0) return false;
+        if (n == 0) return true;
+        out.append(buf, static_cast<size_t>(n));
+    }
+}
+
+std::string read_file(const std::string& path) {
+    std::string out;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return out;
+    read_fd(fd, out);
+    ::close(fd);
+    return out;
+}
+
+// 文件应为 44 字节的 PCM 头加上按整帧截断的负载
+void check_wav(const std::string& bytes, const std::vector<uint8_t>& pcm, int sample_rate, int channels) {
+    size_t frame = 2 * static_cast<size_t>(channels);
+    size_t data_size = pcm.size() / frame * frame;
+    CHECK(bytes.size() == sizeof(wav::WavHeader) + data_size);
+    if (bytes.size() < sizeof(wav::WavHeader)) return;
+    wav::WavHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    CHECK(std::memcmp(header.riff, "RIFF", 4) == 0 && std::memcmp(header.wav, "WAVE", 4) == 0);
+    CHECK(std::memcmp(header.fmt, "fmt ", 4) == 0 && std::memcmp(header.data, "data", 4) == 0);
+    CHECK(header.size == 36 + data_size);
+    CHECK(header.fmt_size == 16 && header.format == 1 && header.bit == 16);
+    CHECK(header.channels == channels && static_cast<int>(header.sample_rate) == sample_rate);
+    CHECK(header.bytes_per_second == static_cast<unsigned int>(sample_rate) * frame);
+    CHECK(header.block_size == frame);
+    CHECK(header.data_size == data_size);
+    CHECK(std::memcmp(bytes.data() + sizeof(header), pcm.data(), std::min(data_size, bytes.size() - sizeof(header))) ==
+          0);
+}
+
+void check_no_temp_files(const std::string& dir) {
+    for (const std::string& name : list_dir(dir)) {
+        bool temp = name.size() >= 4 && name.compare(name.size() - 4, 4, ".tmp") == 0;
+        CHECK(!temp);
+        if (temp) std::cerr << "  leftover " << name << std::endl;
+    }
+}
+
+void test_contents(const std::string& dir) {
+    ArchiveOptions options;
+    options.directory = dir + "/"; // 末尾的斜杠被去掉
+    options.prefix = "7_";
+    SegmentArchive archive(options);
+    CHECK(archive.start());
+
+    // 单声道，末尾多出半个样本；双声道，末尾多出一个声道的样本: 都按整帧截断
+    std::vector<uint8_t> mono = pattern(3201, 1);
+    std::vector<uint8_t> stereo = pattern(6402, 2);
+    std::vector<uint8_t> mono_copy = mono, stereo_copy = stereo;
+    CHECK(archive.submit(info_for("alice", "s1"), mono));
+    CHECK(mono.empty()); // 缓冲区被取走
+    // uid 由客户端给出: 路径分隔符等字符替换为下划线
+    CHECK(archive.submit(info_for("../b o/b", "s2", 8000, 2), stereo));
+    CHECK(wait_for([&] { return archive.written_segments() == 2; }));
+    CHECK(archive.write_errors() == 0 && archive.dropped_segments() == 0);
+    CHECK(archive.written_bytes() == 2 * sizeof(wav::WavHeader) + 3200 + 6400);
+    CHECK(wait_for([&] { return archive.queue_segments() == 0 && archive.queue_bytes() == 0; }));
+
+    check_wav(read_file(dir + "/7_alice_s1.wav"), mono_copy, 16000, 1);
+    check_wav(read_file(dir + "/7____b_o_b_s2.wav"), stereo_copy, 8000, 2);
+    CHECK(list_dir(dir).size() == 2);
+    check_no_temp_files(dir);
+
+    // stop() 写完排队中的段再返回
+    std::vector<std::vector<uint8_t>> copies;
+    for (int i = 0; i < 5; ++i) {
+        std::vector<uint8_t> pcm = pattern(1600, 10 + i);
+        copies.push_back(pcm);
+        CHECK(archive.submit(info_for("queued", "q" + std::to_string(i)), pcm));
+    }
+    archive.stop();
+    CHECK(archive.written_segments() == 7);
+    for (int i = 0; i < 5; ++i) {
+        check_wav(read_file(dir + "/7_queued_q" + std::to_string(i) + ".wav"), copies[i], 16000, 1);
+    }
+    check_no_temp_files(dir);
+    // 停止后不再接受
+    std::vector<uint8_t> late = pattern(320, 99);
+    CHECK(!archive.submit(info_for("late", "x"), late));
+    CHECK(late.size() == 320);
+}
+
+void test_queue_limit(const std::string& dir) {
+    ArchiveOptions options;
+    options.directory = dir;
+    options.max_queue_segments = 3;
+    options.max_queue_bytes = 8000;
+    SegmentArchive archive(options);
+    CHECK(archive.start());
+
+    // 超过字节上限的单段直接丢弃，缓冲区留给调用方
+    std::vector<uint8_t> huge = pattern(8002, 3);
+    CHECK(!archive.submit(info_for("huge", "h"), huge));
+    CHECK(huge.size() == 8002);
+    CHECK(archive.dropped_segments() == 1);
+
+    // 用 FIFO 占住第一段的临时文件名: 归档线程阻塞在 open 上，模拟磁盘卡住
+    std::string stall_tmp = dir + "/stall_s0.wav.tmp";
+    CHECK(mkfifo(stall_tmp.c_str(), 0644) == 0);
+    std::vector<uint8_t> stalled = pattern(1000, 4);
+    std::vector<uint8_t> stalled_copy = stalled;
+    CHECK(archive.submit(info_for("stall", "s0"), stalled));
+    // 排队 (含正在写的一段) 达到 3 段后，新段被丢弃
+    for (int i = 1; i <= 4; ++i) {
+        std::vector<uint8_t> pcm = pattern(1000, 4 + i);
+        bool accepted = archive.submit(info_for("stall", "s" + std::to_string(i)), pcm);
+        CHECK(accepted == (i <= 2));
+        CHECK(pcm.empty() == accepted);
+    }
+    CHECK(archive.dropped_segments() == 3);
+    CHECK(archive.queue_segments() == 3 && archive.queue_bytes() == 3000);
+    CHECK(archive.peak_queue_segments() == 3 && archive.peak_queue_bytes() == 3000);
+    // 第一段还卡在 open 上，一个文件也没有写完
+    CHECK(archive.written_segments() == 0);
+
+    // 读出 FIFO，放行归档线程
+    int fd = ::open(stall_tmp.c_str(), O_RDONLY | O_CLOEXEC);
+    CHECK(fd >= 0);
+    std::string stalled_bytes;
+    if (fd >= 0) {
+        CHECK(read_fd(fd, stalled_bytes));
+        ::close(fd);
+    }
+    check_wav(stalled_bytes, stalled_copy, 16000, 1);
+    CHECK(wait_for([&] { return archive.written_segments() == 3 && archive.queue_segments() == 0; }));
+    CHECK(archive.queue_bytes() == 0);
+    CHECK(archive.peak_queue_segments() == 3);
+    archive.stop();
+    check_no_temp_files(dir);
+    // 丢弃的段没有文件
+    for (const std::string& name : list_dir(dir)) CHECK(name != "stall_s3.wav" && name != "stall_s4.wav");
+    CHECK(list_dir(dir).size() == 3);
+}
+
+void remove_dir(const std::string& dir) {
+    for (const std::string& name : list_dir(dir)) ::unlink((dir + "/" + name).c_str());
+    ::rmdir(dir.c_str());
+}
+
+} // namespace
+
+int main() {
+    char contents_dir[] = "/tmp/vad_archive_test.XXXXXX";
+    char limit_dir[] = "/tmp/vad_archive_test.XXXXXX";
+    if (!mkdtemp(contents_dir) || !mkdtemp(limit_dir)) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    test_contents(contents_dir);
+    test_queue_limit(limit_dir);
+    remove_dir(contents_dir);
+    remove_dir(limit_dir);
+
+    // 目录不存在时 start() 失败
+    ArchiveOptions missing;
+    missing.directory = std::string(contents_dir) + "/missing";
+    SegmentArchive archive(missing);
+    CHECK(!archive.start());
+
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "segment archive tests passed" << std::endl;
+    return 0;
+}
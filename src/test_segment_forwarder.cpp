@@ -0,0 +1,386 @@
+// 语音段转发单元测试: 进程内的 TCP 下游 (tcp:// 分帧与 ws:// 握手) 上检查段内顺序与连接独占、
+// 积压超限时放弃、握手应答校验失败，以及下游断开/重启后的重连。只用回环地址，由 ctest 运行
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "segment_forwarder.h"
+#include "test_check.h"
+#include "ws_protocol.h"
+
+namespace {
+
+enum MessageType : uint8_t { START = 1, AUDIO = 2, END = 3 };
+
+struct Received {
+    size_t conn;
+    uint8_t type;
+    std::string payload;
+};
+
+// 进程内下游: 一个线程 poll 监听套接字与全部连接，按协议拆出消息
+class TestSink {
+public:
+    struct Options {
+        bool websocket = false;
+        bool bad_accept = false;     // 握手应答给出错误的 Sec-WebSocket-Accept
+        bool close_after_end = false; // 收到 end 后关闭连接
+        bool accept = true;          // false: 只监听不 accept，也不读 (下游完全卡住)
+    };
+
+    explicit TestSink(const Options& options) : options_(options) {}
+    ~TestSink() { stop(); }
+
+    bool start(uint16_t port = 0) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (!options_.accept) {
+            // 接收缓冲区尽量小 (accept 出的连接继承)，发送方很快写满
+            int small = 4096;
+            setsockopt(listen_fd_, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        }
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, 64) < 0) {
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        stop_ = false;
+        thread_ = std::thread(&TestSink::run, this);
+        return true;
+    }
+
+    // 关闭监听与全部连接
+    void stop() {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+        for (Conn& conn : conns_) {
+            if (conn.fd >= 0) ::close(conn.fd);
+        }
+        conns_.clear();
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+    uint16_t port() const { return port_; }
+    size_t closed() const { return closed_.load(); }
+
+    std::vector<Received> messages() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return messages_;
+    }
+
+private:
+    struct Conn {
+        int fd = -1;
+        size_t index = 0;
+        bool upgraded = false;
+        std::string in;
+        ws::FrameParser parser;
+    };
+
+    void run() {
+        std::vector<uint8_t> buf(64 * 1024);
+        while (!stop_) {
+            std::vector<pollfd> fds;
+            if (options_.accept) fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+            for (Conn& conn : conns_) fds.push_back(pollfd{conn.fd, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), 20) <= 0) continue;
+            size_t first = 0;
+            if (options_.accept) {
+                first = 1;
+                if (fds[0].revents & POLLIN) {
+                    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd >= 0) {
+                        conns_.emplace_back();
+                        conns_.back().fd = fd;
+                        conns_.back().index = next_index_++;
+                    }
+                }
+            }
+            for (size_t i = first; i < fds.size(); ++i) {
+                if (!fds[i].revents) continue;
+                Conn& conn = conns_[i - first];
+                ssize_t n = ::recv(conn.fd, buf.data(), buf.size(), 0);
+                if (n <= 0 || !consume(conn, buf.data(), static_cast<size_t>(n))) close_conn(conn);
+            }
+            conns_.erase(std::remove_if(conns_.begin(), conns_.end(), [](const Conn& c) { return c.fd < 0; }),
+                         conns_.end());
+        }
+    }
+
+    void close_conn(Conn& conn) {
+        ::close(conn.fd);
+        conn.fd = -1;
+        closed_.fetch_add(1);
+    }
+
+    // 返回 false 时关闭连接
+    bool consume(Conn& conn, const uint8_t* data, size_t len) {
+        conn.in.append(reinterpret_cast<const char*>(data), len);
+        if (options_.websocket && !conn.upgraded) {
+            ws::HttpRequest request;
+            long header = ws::parse_http_request(conn.in.data(), conn.in.size(), request);
+            if (header == 0) return true;
+            if (header < 0 || !request.is_websocket()) return false;
+            std::string response = ws::handshake_response(options_.bad_accept ? request.key + "x" : request.key);
+            if (::send(conn.fd, response.data(), response.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(response.size())) {
+                return false;
+            }
+            conn.in.erase(0, static_cast<size_t>(header));
+            conn.upgraded = true;
+        }
+        size_t pos = 0;
+        bool ended = false;
+        for (;;) {
+            Received message{conn.index, 0, std::string()};
+            if (options_.websocket) {
+                size_t consumed = 0;
+                ws::FrameParser::Result r = conn.parser.next(reinterpret_cast<uint8_t*>(&conn.in[pos]),
+                                                             conn.in.size() - pos, consumed);
+                pos += consumed;
+                if (r == ws::FrameParser::NEED_MORE) break;
+                if (r != ws::FrameParser::MESSAGE) return false;
+                message.payload.assign(reinterpret_cast<const char*>(conn.parser.payload()), conn.parser.payload_size());
+                if (conn.parser.opcode() == ws::BINARY) {
+                    message.type = AUDIO;
+                } else {
+                    message.type = message.payload.find("\"type\":\"start\"") != std::string::npos ? START : END;
+                }
+            } else {
+                if (conn.in.size() - pos < 5) break;
+                const uint8_t* h = reinterpret_cast<const uint8_t*>(conn.in.data() + pos);
+                size_t size = (size_t(h[1]) << 24) | (size_t(h[2]) << 16) | (size_t(h[3]) << 8) | h[4];
+                if (conn.in.size() - pos - 5 < size) break;
+                message.type = h[0];
+                message.payload = conn.in.substr(pos + 5, size);
+                pos += 5 + size;
+            }
+            ended = ended || message.type == END;
+            std::lock_guard<std::mutex> lock(mutex_);
+            messages_.push_back(std::move(message));
+        }
+        conn.in.erase(0, pos);
+        return !(ended && options_.close_after_end);
+    }
+
+    Options options_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::vector<Conn> conns_;
+    size_t next_index_ = 0;
+    std::atomic<size_t> closed_{0};
+    std::mutex mutex_;
+    std::vector<Received> messages_;
+};
+
+bool wait_for(const std::function<bool()>& done, int timeout_ms = 5000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!done()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+std::string chunk(size_t segment, size_t index, size_t size) {
+    std::string s(size, 0);
+    for (size_t i = 0; i < size; ++i) s[i] = static_cast<char>((segment * 31 + index * 7 + i) & 0xFF);
+    return s;
+}
+
+SpeechSegmentInfo info_for(size_t segment) {
+    SpeechSegmentInfo info;
+    info.uid = "user";
+    info.new_session = "seg" + std::to_string(segment);
+    return info;
+}
+
+// 一段完整的语音: start、chunks 个音频帧、end
+void send_segment(SegmentForwarder& forwarder, size_t segment, size_t chunks, size_t chunk_bytes) {
+    uint64_t id = forwarder.begin_segment(info_for(segment));
+    for (size_t k = 0; k < chunks; ++k) {
+        std::string audio = chunk(segment, k, chunk_bytes);
+        forwarder.segment_audio(id, reinterpret_cast<const uint8_t*>(audio.data()), audio.size());
+    }
+    forwarder.end_segment(id, false);
+}
+
+std::string url(bool websocket, uint16_t port) {
+    return std::string(websocket ? "ws://" : "tcp://") + "127.0.0.1:" + std::to_string(port) + (websocket ? "/asr" : "");
+}
+
+// 每条连接上的消息流必须是完整的 start/audio.../end 序列 (段独占连接，不交错)，返回按段重组的音频
+std::map<std::string, std::string> segments_by_connection(const std::vector<Received>& messages) {
+    std::map<size_t, std::string> current; // 连接 -> 进行中的段
+    std::map<std::string, std::string> audio;
+    for (const Received& m : messages) {
+        if (m.type == START) {
+            CHECK(current[m.conn].empty());
+            size_t at = m.payload.find("\"new_session\":\"");
+            CHECK(at != std::string::npos);
+            if (at == std::string::npos) continue;
+            at += 15;
+            std::string name = m.payload.substr(at, m.payload.find('"', at) - at);
+            CHECK(audio.count(name) == 0); // 每段只转发一次
+            current[m.conn] = name;
+            audio[name];
+        } else if (m.type == AUDIO) {
+            CHECK(!current[m.conn].empty());
+            audio[current[m.conn]] += m.payload;
+        } else {
+            CHECK(m.type == END && !current[m.conn].empty());
+            CHECK(m.payload.find("\"aborted\":false") != std::string::npos);
+            current[m.conn].clear();
+        }
+    }
+    return audio;
+}
+
+void test_ordering(bool websocket) {
+    TestSink::Options sink_options;
+    sink_options.websocket = websocket;
+    TestSink sink(sink_options);
+    CHECK(sink.start());
+    ForwarderOptions options;
+    options.url = url(websocket, sink.port());
+    options.max_connections = 3;
+    SegmentForwarder forwarder(options);
+    CHECK(forwarder.start());
+
+    // 30 段同时进行 (远多于连接数)，各段的帧交错到达: 多出的段排队，连接空出后按顺序接上
+    const size_t kSegments = 30, kChunks = 12, kChunkBytes = 640;
+    std::vector<uint64_t> ids;
+    for (size_t s = 0; s < kSegments; ++s) ids.push_back(forwarder.begin_segment(info_for(s)));
+    for (size_t k = 0; k < kChunks; ++k) {
+        for (size_t s = 0; s < kSegments; ++s) {
+            std::string audio = chunk(s, k, kChunkBytes);
+            forwarder.segment_audio(ids[s], reinterpret_cast<const uint8_t*>(audio.data()), audio.size());
+        }
+    }
+    for (size_t s = 0; s < kSegments; ++s) forwarder.end_segment(ids[s], false);
+
+    CHECK(wait_for([&] { return forwarder.forwarded_segments() == kSegments; }));
+    CHECK(wait_for([&] { return sink.messages().size() == kSegments * (kChunks + 2); }));
+    CHECK(forwarder.dropped_segments() == 0);
+    CHECK(forwarder.forwarded_bytes() == kSegments * kChunks * kChunkBytes);
+    CHECK(forwarder.connections_opened() <= 3);
+    CHECK(forwarder.connect_failures() == 0);
+
+    std::map<std::string, std::string> audio = segments_by_connection(sink.messages());
+    CHECK(audio.size() == kSegments);
+    for (size_t s = 0; s < kSegments; ++s) {
+        std::string expected;
+        for (size_t k = 0; k < kChunks; ++k) expected += chunk(s, k, kChunkBytes);
+        CHECK(audio["seg" + std::to_string(s)] == expected);
+    }
+    forwarder.stop();
+}
+
+void test_bad_accept() {
+    TestSink::Options sink_options;
+    sink_options.websocket = true;
+    sink_options.bad_accept = true;
+    TestSink sink(sink_options);
+    CHECK(sink.start());
+    ForwarderOptions options;
+    options.url = url(true, sink.port());
+    SegmentForwarder forwarder(options);
+    CHECK(forwarder.start());
+    send_segment(forwarder, 0, 4, 640);
+    // 应答校验失败: 算作建连失败，段被放弃，不发出任何数据帧
+    CHECK(wait_for([&] { return forwarder.dropped_segments() == 1; }));
+    CHECK(forwarder.connect_failures() == 1);
+    CHECK(forwarder.forwarded_segments() == 0);
+    CHECK(sink.messages().empty());
+    forwarder.stop();
+}
+
+void test_backlog_drop() {
+    TestSink::Options sink_options;
+    sink_options.accept = false;
+    TestSink sink(sink_options);
+    CHECK(sink.start());
+    ForwarderOptions options;
+    options.url = url(false, sink.port());
+    options.max_backlog_bytes = 64 << 10;
+    SegmentForwarder forwarder(options);
+    CHECK(forwarder.start());
+    // 下游不读: 套接字缓冲区写满后在转发器里积压，超过 64 KiB 时放弃该段
+    send_segment(forwarder, 0, 512, 32 << 10);
+    CHECK(wait_for([&] { return forwarder.dropped_segments() == 1; }));
+    CHECK(forwarder.forwarded_segments() == 0);
+    forwarder.stop();
+}
+
+void test_reconnect() {
+    TestSink::Options sink_options;
+    sink_options.close_after_end = true;
+    TestSink sink(sink_options);
+    CHECK(sink.start());
+    uint16_t port = sink.port();
+    ForwarderOptions options;
+    options.url = url(false, port);
+    SegmentForwarder forwarder(options);
+    CHECK(forwarder.start());
+
+    // 下游在每段结束后关闭连接: 空闲连接被移出连接池，下一段新建连接
+    send_segment(forwarder, 0, 4, 640);
+    CHECK(wait_for([&] { return sink.closed() == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    send_segment(forwarder, 1, 4, 640);
+    CHECK(wait_for([&] { return forwarder.forwarded_segments() == 2 && sink.closed() == 2; }));
+    CHECK(forwarder.connections_opened() == 2);
+    CHECK(forwarder.dropped_segments() == 0);
+
+    // 下游不在时建连失败，段被放弃
+    sink.stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    send_segment(forwarder, 2, 4, 640);
+    CHECK(wait_for([&] { return forwarder.dropped_segments() == 1; }));
+    CHECK(forwarder.connect_failures() >= 1);
+
+    // 下游在同一端口恢复后，新段照常转发
+    TestSink restarted(sink_options);
+    CHECK(restarted.start(port));
+    send_segment(forwarder, 3, 4, 640);
+    CHECK(wait_for([&] { return forwarder.forwarded_segments() == 3; }));
+    CHECK(wait_for([&] { return restarted.messages().size() == 6; }));
+    std::map<std::string, std::string> audio = segments_by_connection(restarted.messages());
+    CHECK(audio.size() == 1 && audio.count("seg3") == 1);
+    forwarder.stop();
+}
+
+} // namespace
+
+int main() {
+    test_ordering(false);
+    test_ordering(true);
+    test_bad_accept();
+    test_backlog_drop();
+    test_reconnect();
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "segment forwarder tests passed" << std::endl;
+    return 0;
+}
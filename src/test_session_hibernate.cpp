@@ -0,0 +1,171 @@
+// 会话休眠/唤醒测试: 同一段音频分别喂给不休眠的参照会话和中途多次休眠的会话，
+// 两边每一帧的判决 (vad_state) 与语音段音频 (vad_audio) 必须逐字节一致。
+// 需要 Silero 模型；模型或 ONNX Runtime 不可用时返回 77，由 ctest 记为跳过
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "session.h"
+#include "test_check.h"
+#include "vad_model.h"
+
+namespace {
+
+const int kSkipped = 77;
+
+// 从响应中取出字符串字段 (响应由 Session 自己生成，格式固定)；new_session 是墙钟时间戳，不参与比较
+std::string extract_field(const std::string& response, const std::string& name) {
+    std::string key = "\"" + name + "\":\"";
+    size_t pos = response.find(key);
+    if (pos == std::string::npos) return "";
+    pos += key.size();
+    size_t end = response.find('"', pos);
+    return response.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+struct Decision {
+    bool has_event = false;
+    std::string state;
+    std::string audio;
+
+    bool operator==(const Decision& other) const {
+        return has_event == other.has_event && state == other.state && audio == other.audio;
+    }
+};
+
+Decision feed(Session& session, const uint8_t* data, size_t len) {
+    // 与接入线程一致: 每帧先 touch()，作废之前的休眠请求
+    session.touch();
+    std::string out;
+    Decision decision;
+    decision.has_event = session.process_audio(data, len, out);
+    decision.state = extract_field(out, "vad_state");
+    decision.audio = extract_field(out, "vad_audio");
+    return decision;
+}
+
+// 在 hibernate_every 帧的间隔上休眠 (0 表示不休眠)，返回每帧的判决
+std::vector<Decision> run_stream(const AudioFormat& format, const std::vector<uint8_t>& pcm, size_t hibernate_every,
+                                 int& hibernations) {
+    Session session("hibernate_test", websocketpp::connection_hdl(), format);
+    size_t frame_bytes = static_cast<size_t>(format.sample_rate / 50) * format.channels * 2; // 20ms
+    std::vector<Decision> decisions;
+    size_t index = 0;
+    for (size_t offset = 0; offset + frame_bytes <= pcm.size(); offset += frame_bytes, ++index) {
+        if (hibernate_every > 0 && index > 0 && index % hibernate_every == 0) {
+            size_t before = session.memory_bytes();
+            CHECK(session.request_hibernate());
+            CHECK(session.hibernate());
+            CHECK(session.hibernated() && !session.has_engine());
+            CHECK(session.memory_bytes() < before);
+            // 已在休眠中: 不重复休眠
+            CHECK(!session.hibernate());
+            ++hibernations;
+        }
+        decisions.push_back(feed(session, pcm.data() + offset, frame_bytes));
+        if (hibernate_every > 0) CHECK(!session.hibernated() && session.has_engine());
+    }
+    return decisions;
+}
+
+void test_round_trip(const AudioFormat& format, const std::vector<uint8_t>& pcm, const char* label) {
+    int unused = 0;
+    std::vector<Decision> reference = run_stream(format, pcm, 0, unused);
+    size_t begins = 0;
+    size_t ends = 0;
+    for (const Decision& d : reference) {
+        if (d.state == "VAD_BEGIN") ++begins;
+        if (d.state == "VAD_END") ++ends;
+    }
+    // 间隔取互质的几档，休眠点落在静音、语音段中途以及缓冲区里有半个窗口的各种位置上
+    for (size_t every : {1u, 7u, 23u, 61u}) {
+        int hibernations = 0;
+        std::vector<Decision> decisions = run_stream(format, pcm, every, hibernations);
+        CHECK(hibernations > 0);
+        CHECK(decisions.size() == reference.size());
+        size_t mismatches = 0;
+        for (size_t i = 0; i < decisions.size() && i < reference.size(); ++i) {
+            if (!(decisions[i] == reference[i])) {
+                if (mismatches == 0) {
+                    std::cerr << "  " << label << " every " << every << ": frame " << i << " got '"
+                              << decisions[i].state << "', expected '" << reference[i].state << "'" << std::endl;
+                }
+                ++mismatches;
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+    std::cout << label << ": " << reference.size() << " frames, " << begins << " begin / " << ends << " end"
+              << std::endl;
+}
+
+// 作废的休眠请求: 请求之后又收到了音频，控制任务执行时不再休眠
+void test_stale_request(const std::vector<uint8_t>& pcm) {
+    Session session("stale_test", websocketpp::connection_hdl(), AudioFormat());
+    CHECK(!session.hibernate()); // 没有请求
+    feed(session, pcm.data(), 640);
+    CHECK(session.request_hibernate());
+    CHECK(!session.request_hibernate()); // 同一空闲期只投递一次
+    session.touch();
+    CHECK(!session.hibernate());
+    CHECK(!session.hibernated() && session.has_engine());
+}
+
+std::vector<uint8_t> to_stereo(const std::vector<uint8_t>& mono) {
+    std::vector<uint8_t> stereo;
+    stereo.reserve(mono.size() * 2);
+    for (size_t i = 0; i + 1 < mono.size(); i += 2) {
+        stereo.insert(stereo.end(), {mono[i], mono[i + 1], mono[i], mono[i + 1]});
+    }
+    return stereo;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <silero_vad.onnx> <16k mono s16le pcm>" << std::endl;
+        return 1;
+    }
+    std::ifstream file(argv[2], std::ios::binary);
+    std::vector<uint8_t> pcm((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (pcm.size() < 640) {
+        std::cerr << "cannot read " << argv[2] << std::endl;
+        return 1;
+    }
+    // 连播两遍: 第二遍在第一遍留下的引擎状态上继续
+    pcm.insert(pcm.end(), pcm.begin(), pcm.end());
+
+    VadModelOptions options;
+    options.model_path = argv[1];
+    options.use_ort_cache = false;
+    VadModel::configure(options);
+    try {
+        VadModel::get();
+    } catch (const std::exception& e) {
+        std::cout << "model unavailable (" << e.what() << "), skipped" << std::endl;
+        return kSkipped;
+    }
+
+    AudioFormat mono16k;
+    test_round_trip(mono16k, pcm, "16k mono");
+    // 原生 8k 引擎
+    AudioFormat mono8k;
+    mono8k.sample_rate = 8000;
+    test_round_trip(mono8k, pcm, "8k mono");
+    // 重采样与下混: 休眠时 resampler 被 trim，唤醒后滤波器历史必须仍在
+    AudioFormat stereo48k;
+    stereo48k.sample_rate = 48000;
+    stereo48k.channels = 2;
+    test_round_trip(stereo48k, to_stereo(pcm), "48k stereo");
+    test_stale_request(pcm);
+
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "session hibernate tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,272 @@
+// 共享内存记录环单元测试: 回绕与填充记录、长消息拆分、损坏记录的拒绝、乱序归还
+// 环建在进程内的普通内存上 (与共享内存段里的布局相同)，不需要 memfd 与服务端，由 ctest 运行
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "shm_ring.h"
+#include "test_check.h"
+
+namespace {
+
+// 一个独立的环: 控制块 + 数据区
+struct TestRing {
+    explicit TestRing(size_t capacity) : control(new shm::RingControl()), data(capacity), capacity(capacity) {
+        writer = shm::RingWriter(control.get(), data.data(), capacity);
+        reader = shm::RingReader(control.get(), data.data(), capacity);
+    }
+
+    uint64_t head() const { return control->head.load(); }
+    uint64_t tail() const { return control->tail.load(); }
+
+    std::unique_ptr<shm::RingControl> control;
+    std::vector<uint8_t> data;
+    size_t capacity;
+    shm::RingWriter writer;
+    shm::RingReader reader;
+};
+
+std::string pattern(size_t size, uint32_t seed) {
+    std::string s(size, 0);
+    for (size_t i = 0; i < size; ++i) s[i] = static_cast<char>((i * 131 + seed * 7) & 0xFF);
+    return s;
+}
+
+bool publish(TestRing& ring, const std::string& payload) {
+    uint8_t* dst = ring.writer.reserve(payload.size());
+    if (!dst) return false;
+    std::memcpy(dst, payload.data(), payload.size());
+    ring.writer.commit();
+    return true;
+}
+
+void test_wraparound() {
+    TestRing ring(4096);
+    std::mt19937 rng(7);
+    uint64_t written = 0, read = 0;
+    std::vector<std::string> in_flight;
+    size_t pads_seen = 0;
+    for (int round = 0; round < 5000; ++round) {
+        // 随机长度 (包括 0 与不是 8 的倍数的长度)，连续写到环满
+        size_t size = std::uniform_int_distribution<size_t>(0, 700)(rng);
+        std::string payload = pattern(size, static_cast<uint32_t>(round));
+        uint64_t before = ring.head();
+        if (publish(ring, payload)) {
+            uint64_t offset = before & (ring.capacity - 1);
+            // 放不下时先写填充记录再回到开头: head 多走了到环尾的距离
+            if (shm::record_span(size) > ring.capacity - offset) {
+                ++pads_seen;
+                CHECK(ring.head() - before == ring.capacity - offset + shm::record_span(size));
+            } else {
+                CHECK(ring.head() - before == shm::record_span(size));
+            }
+            in_flight.push_back(payload);
+            ++written;
+            continue;
+        }
+        // 环满: 写入失败不能改变 head
+        CHECK(ring.head() == before);
+        const uint8_t* p;
+        uint32_t got;
+        uint64_t end;
+        while (ring.reader.next(p, got, end)) {
+            const std::string& expected = in_flight[read - (written - in_flight.size())];
+            // 负载总是一段连续内存，不跨越环尾
+            CHECK(p + got <= ring.data.data() + ring.capacity);
+            CHECK(got == expected.size() && std::memcmp(p, expected.data(), got) == 0);
+            ++read;
+            ring.reader.release(end);
+        }
+        CHECK(ring.tail() == ring.head());
+        in_flight.clear();
+    }
+    CHECK(!ring.reader.corrupted());
+    // 随机长度必须真正走过回绕
+    CHECK(pads_seen > 100);
+
+    // 单条记录最多占半个环
+    TestRing half(4096);
+    CHECK(half.writer.reserve(2048 - shm::kRecordHeader) != nullptr);
+    TestRing over(4096);
+    CHECK(over.writer.reserve(2048 - shm::kRecordHeader + 1) == nullptr);
+}
+
+// 在环的 shift 位置写一条消息并读回
+bool message_round_trip(size_t shift, size_t size, size_t* records) {
+    TestRing ring(4096);
+    const uint8_t* p;
+    uint32_t n;
+    uint64_t end = 0;
+    if (shift > 0) {
+        publish(ring, std::string(shift - shm::kRecordHeader, 's'));
+        while (ring.reader.next(p, n, end)) ring.reader.release(end);
+    }
+    std::string message = pattern(size, static_cast<uint32_t>(size));
+    bool notify = false;
+    uint64_t before = ring.head();
+    if (!ring.writer.write_message(message.data(), message.size(), notify)) {
+        CHECK(ring.head() == before); // 放不下时一条也不发布
+        CHECK(!ring.reader.next(p, n, end));
+        return false;
+    }
+    std::string got;
+    *records = 0;
+    while (ring.reader.next(p, n, end)) {
+        got.append(reinterpret_cast<const char*>(p), n);
+        ++*records;
+        if (!ring.reader.more()) break;
+    }
+    CHECK(!ring.reader.more());
+    CHECK(got == message);
+    ring.reader.release(end);
+    CHECK(ring.tail() == ring.head());
+    return true;
+}
+
+void test_messages() {
+    size_t records = 0;
+    // 单条记录上限为半个环 (2040 字节负载)，更长的拆开
+    CHECK(message_round_trip(0, 0, &records) && records == 1);
+    CHECK(message_round_trip(0, 2040, &records) && records == 1);
+    CHECK(message_round_trip(0, 2041, &records) && records == 2);
+    CHECK(message_round_trip(0, 4080, &records) && records == 2); // 恰好占满整个环
+    CHECK(!message_round_trip(0, 4081, &records));
+    CHECK(!message_round_trip(0, 5000, &records));
+    // 第二条记录放不下到环尾的距离: 两条之间插入填充记录
+    CHECK(message_round_trip(1536, 3000, &records) && records == 2);
+    // 加上填充就放不下
+    CHECK(!message_round_trip(1536, 4000, &records));
+}
+
+// 手工写一条记录头，模拟生产者写坏的控制字段
+void put_header(TestRing& ring, uint64_t position, uint32_t size, uint32_t flags) {
+    uint64_t offset = position & (ring.capacity - 1);
+    std::memcpy(ring.data.data() + offset, &size, 4);
+    std::memcpy(ring.data.data() + offset + 4, &flags, 4);
+}
+
+void test_corrupted() {
+    const uint8_t* p;
+    uint32_t size;
+    uint64_t end;
+
+    // 记录长度超过已发布的范围
+    TestRing beyond_head(4096);
+    publish(beyond_head, "abc");
+    put_header(beyond_head, 0, 64, 0);
+    CHECK(!beyond_head.reader.next(p, size, end));
+    CHECK(beyond_head.reader.corrupted());
+
+    // 记录跨越环尾
+    TestRing beyond_end(4096);
+    for (int i = 0; i < 3; ++i) publish(beyond_end, std::string(1000, 'x'));
+    while (beyond_end.reader.next(p, size, end)) beyond_end.reader.release(end);
+    uint64_t head = beyond_end.head();
+    publish(beyond_end, std::string(900, 'y'));
+    put_header(beyond_end, head, 2000, 0);
+    CHECK(!beyond_end.reader.next(p, size, end));
+    CHECK(beyond_end.reader.corrupted());
+
+    // 长度字段接近 2^32 (对齐计算不能回绕成小数)
+    TestRing huge(4096);
+    publish(huge, "abc");
+    put_header(huge, 0, 0xFFFFFFF9u, 0);
+    CHECK(!huge.reader.next(p, size, end));
+    CHECK(huge.reader.corrupted());
+
+    // 正常记录不触发
+    TestRing fine(4096);
+    publish(fine, "abc");
+    CHECK(fine.reader.next(p, size, end) && size == 3);
+    CHECK(!fine.reader.corrupted());
+}
+
+void test_release_order() {
+    TestRing ring(4096);
+    shm::ReleaseOrder order;
+    std::vector<uint64_t> ends;
+    for (const char* payload : {"first", "", "second", "third"}) publish(ring, payload);
+    const uint8_t* p;
+    uint32_t size;
+    uint64_t end;
+    while (ring.reader.next(p, size, end)) {
+        order.track(end);
+        ends.push_back(end);
+    }
+    CHECK(ends.size() == 4);
+    if (ends.size() != 4) return;
+
+    // 空记录立即完成、后面的租约先释放: 第一条仍被持有，tail 不动
+    CHECK(order.complete(ends[1]) == 0);
+    CHECK(order.complete(ends[3]) == 0);
+    CHECK(ring.tail() == 0);
+    // 第一条释放: 连续完成到第二条为止
+    uint64_t released = order.complete(ends[0]);
+    CHECK(released == ends[1]);
+    ring.reader.release(released);
+    CHECK(ring.tail() == ends[1]);
+    // 第三条释放: 一直归还到最后
+    released = order.complete(ends[2]);
+    CHECK(released == ends[3]);
+    ring.reader.release(released);
+    CHECK(ring.tail() == ring.head());
+    // 重复或未登记的位置不影响状态
+    CHECK(order.complete(ends[2]) == 0);
+    CHECK(order.complete(12345) == 0);
+
+    // 随机顺序释放: tail 永远不越过仍被持有的记录
+    TestRing big(1 << 16);
+    shm::ReleaseOrder shuffled;
+    std::vector<uint64_t> starts, record_ends;
+    for (int i = 0; i < 200; ++i) {
+        starts.push_back(big.head());
+        publish(big, pattern(static_cast<size_t>(i % 13) * 8, static_cast<uint32_t>(i)));
+    }
+    while (big.reader.next(p, size, end)) {
+        shuffled.track(end);
+        record_ends.push_back(end);
+    }
+    std::vector<size_t> perm(record_ends.size());
+    for (size_t i = 0; i < perm.size(); ++i) perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), std::mt19937(11));
+    std::vector<bool> held(perm.size(), true);
+    for (size_t k : perm) {
+        held[k] = false;
+        uint64_t to = shuffled.complete(record_ends[k]);
+        if (to != 0) big.reader.release(to);
+        size_t first_held = 0;
+        while (first_held < held.size() && !held[first_held]) ++first_held;
+        uint64_t limit = first_held < held.size() ? starts[first_held] : big.head();
+        CHECK(big.tail() == limit);
+    }
+}
+
+void test_wakeup() {
+    TestRing ring(4096);
+    // 消费者准备睡眠: 没有数据时可以睡；之后的第一次发布要求唤醒，再次发布不重复唤醒
+    CHECK(ring.reader.prepare_wait());
+    bool notify = false;
+    CHECK(ring.writer.write("a", 1, notify) && notify);
+    CHECK(ring.writer.write("b", 1, notify) && !notify);
+    // 有未读数据时不能睡
+    CHECK(!ring.reader.prepare_wait());
+}
+
+} // namespace
+
+int main() {
+    test_wraparound();
+    test_messages();
+    test_corrupted();
+    test_release_order();
+    test_wakeup();
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "shared-memory ring tests passed" << std::endl;
+    return 0;
+}
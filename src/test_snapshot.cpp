@@ -0,0 +1,205 @@
+// 快照往返测试: snapshot::Writer/Reader、VadEngineState、重采样器状态
+// 不依赖模型与 ORT，由 ctest 运行；失败时打印位置并返回非零
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "resampler.h"
+#include "session_snapshot.h"
+#include "test_check.h"
+
+namespace {
+
+const uint8_t* bytes_of(const std::string& s) {
+    return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+void test_primitives() {
+    std::string blob;
+    snapshot::Writer w(blob);
+    snapshot::write_header(w);
+    w.put<int32_t>(-7);
+    w.put<uint64_t>(0x0123456789abcdefULL);
+    w.put(0.25f);
+    w.put_string("session-1");
+    const uint8_t raw[3] = {1, 2, 255};
+    w.put_bytes(raw, sizeof(raw));
+    const float floats[4] = {0.5f, -1.0f, 1e-7f, 3.0f};
+    w.put_floats(floats, 4);
+    w.put_string("");
+
+    snapshot::Reader r(bytes_of(blob), blob.size());
+    CHECK(snapshot::read_header(r));
+    int32_t i32 = 0;
+    uint64_t u64 = 0;
+    float f = 0.0f;
+    std::string s, empty = "x";
+    std::vector<uint8_t> b;
+    std::vector<float> fs;
+    CHECK(r.get(i32) && i32 == -7);
+    CHECK(r.get(u64) && u64 == 0x0123456789abcdefULL);
+    CHECK(r.get(f) && f == 0.25f);
+    CHECK(r.get_string(s) && s == "session-1");
+    CHECK(r.get_bytes(b) && b == std::vector<uint8_t>(raw, raw + 3));
+    CHECK(r.get_floats(fs) && fs == std::vector<float>(floats, floats + 4));
+    CHECK(r.get_string(empty) && empty.empty());
+    CHECK(r.ok() && r.at_end());
+
+    // 读过头: ok() 变为 false 且保持
+    CHECK(!r.get(i32));
+    CHECK(!r.ok());
+
+    // 每一种截断都必须失败，而不是读出越界数据
+    for (size_t len = 0; len < blob.size(); ++len) {
+        snapshot::Reader t(bytes_of(blob), len);
+        bool ok = snapshot::read_header(t) && t.get(i32) && t.get(u64) && t.get(f) && t.get_string(s) &&
+                  t.get_bytes(b) && t.get_floats(fs) && t.get_string(empty);
+        CHECK(!ok);
+    }
+
+    // 长度字段声称的字节数超过剩余数据
+    std::string lying;
+    snapshot::Writer lw(lying);
+    lw.put<uint32_t>(1000);
+    lw.put<uint32_t>(0);
+    snapshot::Reader lr(bytes_of(lying), lying.size());
+    CHECK(!lr.get_string(s) && !lr.ok());
+
+    // 魔数或版本不符
+    std::string bad = blob;
+    bad[0] = 'X';
+    snapshot::Reader br(bytes_of(bad), bad.size());
+    CHECK(!snapshot::read_header(br));
+    bad = blob;
+    bad[4] = static_cast<char>(snapshot::kVersion + 1);
+    snapshot::Reader vr(bytes_of(bad), bad.size());
+    CHECK(!snapshot::read_header(vr));
+}
+
+VadEngineState sample_state() {
+    VadEngineState st;
+    st.sample_rate = 16000;
+    for (int i = 0; i < 64; ++i) st.context.push_back(std::sin(i * 0.1f));
+    for (int i = 0; i < 2 * 1 * 128; ++i) st.rnn_state.push_back(static_cast<float>(i) / 256.0f - 0.5f);
+    st.last_prob = 0.875f;
+    st.triggered = true;
+    st.temp_end = 4096;
+    st.current_sample = 123456;
+    st.prev_end = 1000;
+    st.next_start = 2000;
+    st.speech_start = 98000;
+    st.speech_end = -1;
+    st.last_start = 50000;
+    st.last_end = 60000;
+    st.pending.assign(300, 0.125f);
+    return st;
+}
+
+void test_engine_state() {
+    VadEngineState in = sample_state();
+    std::string blob;
+    snapshot::Writer w(blob);
+    in.write(w);
+
+    VadEngineState out;
+    snapshot::Reader r(bytes_of(blob), blob.size());
+    CHECK(out.read(r));
+    CHECK(r.at_end());
+    CHECK(out.sample_rate == in.sample_rate);
+    CHECK(out.context == in.context);
+    CHECK(out.rnn_state == in.rnn_state);
+    CHECK(out.last_prob == in.last_prob);
+    CHECK(out.triggered == in.triggered);
+    CHECK(out.temp_end == in.temp_end);
+    CHECK(out.current_sample == in.current_sample);
+    CHECK(out.prev_end == in.prev_end);
+    CHECK(out.next_start == in.next_start);
+    CHECK(out.speech_start == in.speech_start);
+    CHECK(out.speech_end == in.speech_end);
+    CHECK(out.last_start == in.last_start);
+    CHECK(out.last_end == in.last_end);
+    CHECK(out.pending == in.pending);
+
+    // 截断的状态与 RNN 状态尺寸不符都要拒绝
+    VadEngineState truncated;
+    snapshot::Reader tr(bytes_of(blob), blob.size() - 1);
+    CHECK(!truncated.read(tr));
+
+    VadEngineState wrong = sample_state();
+    wrong.rnn_state.resize(128);
+    std::string wrong_blob;
+    snapshot::Writer ww(wrong_blob);
+    wrong.write(ww);
+    VadEngineState rejected;
+    snapshot::Reader wr(bytes_of(wrong_blob), wrong_blob.size());
+    CHECK(!rejected.read(wr));
+}
+
+void test_resampler(int in_rate, int out_rate) {
+    // 非整包长度的正弦 + 扫频，保证相位与历史都不平凡
+    std::vector<float> signal(in_rate / 2);
+    for (size_t i = 0; i < signal.size(); ++i) {
+        double t = static_cast<double>(i) / in_rate;
+        signal[i] = static_cast<float>(0.5 * std::sin(2 * M_PI * 440 * t) +
+                                       0.3 * std::sin(2 * M_PI * 3000 * t * t));
+    }
+    const size_t split = 1237;
+
+    // 参照: 一个重采样器连续处理
+    PolyphaseResampler reference(in_rate, out_rate);
+    std::vector<float> expected;
+    reference.process(signal.data(), split, expected);
+    size_t head = expected.size();
+    reference.process(signal.data() + split, signal.size() - split, expected);
+
+    // 处理前半段后导出状态，由另一个实例接着处理后半段
+    PolyphaseResampler first(in_rate, out_rate);
+    std::vector<float> ignored;
+    first.process(signal.data(), split, ignored);
+    std::string blob;
+    snapshot::Writer w(blob);
+    first.save_state(w);
+
+    PolyphaseResampler second(in_rate, out_rate);
+    std::vector<float> warmup(97, 1.0f);
+    second.process(warmup.data(), warmup.size(), ignored); // 覆盖掉的旧状态不能影响结果
+    snapshot::Reader r(bytes_of(blob), blob.size());
+    CHECK(second.load_state(r));
+    std::vector<float> tail;
+    second.process(signal.data() + split, signal.size() - split, tail);
+    CHECK(tail.size() == expected.size() - head);
+    bool same = tail.size() == expected.size() - head;
+    for (size_t i = 0; same && i < tail.size(); ++i) same = tail[i] == expected[head + i];
+    CHECK(same);
+
+    // trim 后状态不变
+    second.trim();
+    std::string trimmed_blob;
+    snapshot::Writer tw(trimmed_blob);
+    second.save_state(tw);
+    std::string again_blob;
+    snapshot::Writer aw(again_blob);
+    reference.save_state(aw);
+    CHECK(trimmed_blob == again_blob);
+
+    // 采样率不同的实例拒绝恢复
+    PolyphaseResampler other(in_rate == 48000 ? 44100 : 48000, out_rate);
+    snapshot::Reader orr(bytes_of(blob), blob.size());
+    CHECK(!other.load_state(orr));
+}
+
+} // namespace
+
+int main() {
+    test_primitives();
+    test_engine_state();
+    test_resampler(48000, 16000);
+    test_resampler(44100, 16000);
+    test_resampler(8000, 16000);
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "snapshot round-trip tests passed" << std::endl;
+    return 0;
+}
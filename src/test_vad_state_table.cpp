@@ -0,0 +1,135 @@
+// 迟滞判决一致性测试: VadStateTable::update (SoA 批量、无分支) 与 SileroHysteresis (逐会话) 在随机概率流上
+// 逐窗口比较状态跳变与全部计数器。只调用 update，不做推理，不需要模型文件。
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "static_vad_engine.h"
+#include "test_check.h"
+#include "vad_state_table.h"
+
+namespace {
+
+// 概率流: 在语音/静音段之间随机切换，段长覆盖最短语音、最短静音的边界两侧，
+// 并混入恰好落在阈值与低阈值上 (以及相邻 float) 的取值
+class ProbabilityStream {
+public:
+    ProbabilityStream(uint32_t seed, float threshold) : rng_(seed), threshold_(threshold) {
+        double low = static_cast<double>(threshold) - 0.15;
+        low_ = static_cast<float>(low);
+        edges_ = {threshold_, std::nextafter(threshold_, 0.0f), std::nextafter(threshold_, 1.0f), low_,
+                  std::nextafter(low_, 0.0f), std::nextafter(low_, 1.0f), 0.0f, 1.0f};
+    }
+
+    float next() {
+        if (remaining_ == 0) {
+            // 段长 1..20 个窗口 (32ms): 250ms 最短语音约 8 个窗口，100ms 最短静音约 3 个窗口
+            speech_ = !speech_;
+            remaining_ = std::uniform_int_distribution<int>(1, 20)(rng_);
+        }
+        --remaining_;
+        int kind = std::uniform_int_distribution<int>(0, 9)(rng_);
+        if (kind == 0) return edges_[std::uniform_int_distribution<size_t>(0, edges_.size() - 1)(rng_)];
+        if (kind == 1) return std::uniform_real_distribution<float>(low_, threshold_)(rng_); // 中间带
+        return speech_ ? std::uniform_real_distribution<float>(threshold_, 1.0f)(rng_)
+                       : std::uniform_real_distribution<float>(0.0f, low_)(rng_);
+    }
+
+private:
+    std::mt19937 rng_;
+    float threshold_;
+    float low_;
+    std::vector<float> edges_;
+    bool speech_ = false;
+    int remaining_ = 0;
+};
+
+template <class Geometry>
+void compare_state(const VadStateTable<Geometry>& table, uint32_t row, const SileroHysteresis<Geometry>& ref,
+                   size_t step) {
+    VadEngineState a, b;
+    table.save_state(row, a);
+    ref.save_state(b);
+    bool same = a.triggered == b.triggered && a.temp_end == b.temp_end && a.current_sample == b.current_sample &&
+                a.prev_end == b.prev_end && a.next_start == b.next_start && a.speech_start == b.speech_start &&
+                a.speech_end == b.speech_end && a.last_start == b.last_start && a.last_end == b.last_end;
+    CHECK(same);
+    if (!same) std::cerr << "  row " << row << " diverged at step " << step << std::endl;
+}
+
+template <class Geometry>
+void run_parity(float threshold, uint32_t seed) {
+    const size_t kRows = 64;
+    const size_t kSteps = 5000;
+    // 只测迟滞判决，不需要模型
+    VadStateTable<Geometry> table(nullptr, kRows, threshold);
+    std::vector<uint32_t> rows;
+    for (size_t i = 0; i < kRows; ++i) rows.push_back(table.acquire());
+
+    // deque: 元素原地构造，不需要拷贝 (timestamp_t 的隐式拷贝构造已弃用)
+    std::deque<SileroHysteresis<Geometry>> refs;
+    for (size_t i = 0; i < kRows; ++i) refs.emplace_back(threshold);
+    std::vector<ProbabilityStream> streams;
+    for (size_t i = 0; i < kRows; ++i) streams.emplace_back(seed * 1000 + static_cast<uint32_t>(i), threshold);
+
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> batch;
+    std::vector<float> probs;
+    std::vector<uint8_t> transitions;
+    size_t starts = 0, ends = 0;
+    for (size_t step = 0; step < kSteps && test::failures == 0; ++step) {
+        // 每步随机一部分行参与 (打乱顺序)，覆盖收集/写回的任意下标
+        batch.clear();
+        for (size_t i = 0; i < kRows; ++i) {
+            if (std::uniform_int_distribution<int>(0, 3)(rng) != 0) batch.push_back(static_cast<uint32_t>(i));
+        }
+        std::shuffle(batch.begin(), batch.end(), rng);
+        probs.resize(batch.size());
+        transitions.assign(batch.size(), 0xff);
+        for (size_t k = 0; k < batch.size(); ++k) probs[k] = streams[batch[k]].next();
+
+        std::vector<uint32_t> table_rows;
+        for (uint32_t i : batch) table_rows.push_back(rows[i]);
+        table.update(table_rows.data(), probs.data(), batch.size(), transitions.data());
+
+        for (size_t k = 0; k < batch.size(); ++k) {
+            SileroHysteresis<Geometry>& ref = refs[batch[k]];
+            bool was = ref.triggered();
+            ref.update(probs[k]);
+            uint8_t expected = !was && ref.triggered()
+                                   ? VadStateTable<Geometry>::START
+                                   : (was && !ref.triggered() ? VadStateTable<Geometry>::END
+                                                              : VadStateTable<Geometry>::NONE);
+            CHECK(transitions[k] == expected);
+            CHECK(table.triggered(table_rows[k]) == ref.triggered());
+            starts += expected == VadStateTable<Geometry>::START;
+            ends += expected == VadStateTable<Geometry>::END;
+            compare_state(table, table_rows[k], ref, step);
+        }
+    }
+    // 随机流必须真正走过两种跳变，否则测试没有意义
+    CHECK(starts > 100 && ends > 100);
+    std::cout << Geometry::sample_rate << " Hz, threshold " << threshold << ": " << starts << " starts, " << ends
+              << " ends" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    for (uint32_t seed = 1; seed <= 3; ++seed) {
+        run_parity<VadGeometry<16000, 32>>(0.5f, seed);
+        run_parity<VadGeometry<8000, 32>>(0.5f, seed);
+        // 0.3 - 0.15 在 float 与 double 下舍入不同，检验低阈值的等价换算
+        run_parity<VadGeometry<16000, 32>>(0.3f, seed);
+        run_parity<VadGeometry<16000, 32>>(0.65f, seed);
+    }
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "hysteresis parity tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,279 @@
+// RFC 6455 协议单元测试: SHA-1、Sec-WebSocket-Accept、HTTP 升级请求解析、FrameParser (分片、控制帧、
+// 协议错误、UTF-8 校验)。不依赖网络与模型，由 ctest 运行
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "test_check.h"
+#include "ws_protocol.h"
+
+namespace {
+
+std::string sha1_hex(const std::string& input) {
+    uint8_t digest[20];
+    ws::sha1(reinterpret_cast<const uint8_t*>(input.data()), input.size(), digest);
+    std::string hex;
+    char buf[3];
+    for (uint8_t b : digest) {
+        std::snprintf(buf, sizeof(buf), "%02x", b);
+        hex += buf;
+    }
+    return hex;
+}
+
+void test_sha1() {
+    // FIPS 180 示例
+    CHECK(sha1_hex("") == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    CHECK(sha1_hex("abc") == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    CHECK(sha1_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    CHECK(sha1_hex(std::string(1000000, 'a')) == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+    // 补位边界: 55 字节恰好一块，56..64 需要第二块
+    CHECK(sha1_hex(std::string(55, 'a')) == "c1c8bbdc22796e28c0e15163d20899b65621d65a");
+    CHECK(sha1_hex(std::string(56, 'a')) == "c2db330f6083854c99d4b5bfb6e8f29f201be699");
+    CHECK(sha1_hex(std::string(63, 'a')) == "03f09f5b158a7a8cdad920bddc29b81c18a551f5");
+    CHECK(sha1_hex(std::string(64, 'a')) == "0098ba824b5c16427bd7a1122a5a442a25ec644d");
+    CHECK(sha1_hex(std::string(65, 'a')) == "11655326c708d70319be2610e8a57d9a5b959d3b");
+}
+
+void test_handshake() {
+    // RFC 6455 1.3 的示例
+    CHECK(ws::accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    std::string response = ws::handshake_response("dGhlIHNhbXBsZSBub25jZQ==");
+    CHECK(response.compare(0, 34, "HTTP/1.1 101 Switching Protocols\r\n") == 0);
+    CHECK(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    CHECK(response.size() >= 4 && response.compare(response.size() - 4, 4, "\r\n\r\n") == 0);
+}
+
+long parse(const std::string& text, ws::HttpRequest& request, size_t max_size = 8192) {
+    return ws::parse_http_request(text.data(), text.size(), request, max_size);
+}
+
+void test_http() {
+    const std::string upgrade = "GET /vad?uid=1 HTTP/1.1\r\n"
+                                "Host: localhost\r\n"
+                                "upgrade:  WebSocket \r\n"
+                                "CONNECTION: keep-alive, Upgrade\r\n"
+                                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                "Sec-WebSocket-Version: 13\r\n"
+                                "\r\n";
+    ws::HttpRequest request;
+    CHECK(parse(upgrade + "trailing frame bytes", request) == static_cast<long>(upgrade.size()));
+    CHECK(request.method == "GET");
+    CHECK(request.resource == "/vad?uid=1");
+    CHECK(request.upgrade == "websocket");
+    CHECK(request.connection == "keep-alive, upgrade");
+    CHECK(request.key == "dGhlIHNhbXBsZSBub25jZQ==");
+    CHECK(request.is_websocket());
+
+    // 逐字节到达: 头部结束前都是 0
+    for (size_t len = 0; len < upgrade.size(); ++len) {
+        ws::HttpRequest partial;
+        CHECK(parse(upgrade.substr(0, len), partial) == 0);
+    }
+
+    // 不完整且已超过上限、完整但超过上限
+    ws::HttpRequest r;
+    CHECK(parse(std::string(9000, 'x'), r) == -1);
+    CHECK(parse(upgrade, r, upgrade.size() - 1) == -1);
+    CHECK(parse(upgrade, r, upgrade.size()) == static_cast<long>(upgrade.size()));
+
+    // 请求行与头部格式错误
+    ws::HttpRequest bad;
+    CHECK(parse("GET\r\n\r\n", bad) == -1);
+    CHECK(parse("GET /\r\n\r\n", bad) == -1);
+    CHECK(parse("GET / FTP/1.0\r\n\r\n", bad) == -1);
+    CHECK(parse("\r\n\r\n", bad) == -1);
+    CHECK(parse("GET / HTTP/1.1\r\nno colon here\r\n\r\n", bad) == -1);
+
+    // 普通 HTTP 请求与缺字段的升级请求不是 WebSocket
+    ws::HttpRequest plain;
+    CHECK(parse("GET /ready HTTP/1.1\r\nHost: x\r\n\r\n", plain) > 0);
+    CHECK(plain.resource == "/ready" && !plain.is_websocket());
+    ws::HttpRequest old_version;
+    std::string v8 = upgrade;
+    v8.replace(v8.find("Version: 13"), 11, "Version: 8");
+    CHECK(parse(v8, old_version) > 0 && !old_version.is_websocket());
+    ws::HttpRequest post;
+    std::string p = upgrade;
+    p.replace(0, 3, "POST");
+    CHECK(parse(p, post) > 0 && !post.is_websocket());
+}
+
+const uint32_t kMask = 0x3c5a96e1;
+
+std::string client_frame(ws::Opcode opcode, const std::string& payload, bool fin = true) {
+    std::string out;
+    ws::append_client_frame(out, opcode, reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), kMask);
+    if (!fin) out[0] = static_cast<char>(out[0] & 0x7F);
+    return out;
+}
+
+std::string payload_of(const ws::FrameParser& parser) {
+    return std::string(reinterpret_cast<const char*>(parser.payload()), parser.payload_size());
+}
+
+struct Event {
+    ws::FrameParser::Result result;
+    ws::Opcode opcode;
+    std::string payload;
+    uint16_t close_code;
+};
+
+// 按 chunk 字节一块送入 (与 NativeLoop 相同: 未消耗的尾部留在缓冲区)，收集全部结果
+std::vector<Event> feed(ws::FrameParser& parser, const std::string& wire, size_t chunk) {
+    std::vector<Event> events;
+    std::string buffer;
+    for (size_t pos = 0; pos < wire.size(); pos += chunk) {
+        buffer.append(wire, pos, chunk);
+        for (;;) {
+            size_t consumed = 0;
+            ws::FrameParser::Result result =
+                parser.next(reinterpret_cast<uint8_t*>(&buffer[0]), buffer.size(), consumed);
+            if (result == ws::FrameParser::NEED_MORE) {
+                buffer.erase(0, consumed);
+                break;
+            }
+            events.push_back(Event{result, parser.opcode(), payload_of(parser), parser.close_code()});
+            if (result == ws::FrameParser::FAILED) return events;
+            buffer.erase(0, consumed);
+        }
+    }
+    return events;
+}
+
+ws::FrameParser::Result single(const std::string& wire, uint16_t* close_code = nullptr, size_t max = 1 << 20) {
+    ws::FrameParser parser(max);
+    std::vector<Event> events = feed(parser, wire, wire.size());
+    if (events.empty()) return ws::FrameParser::NEED_MORE;
+    if (close_code) *close_code = events.back().close_code;
+    return events.back().result;
+}
+
+void test_frames() {
+    // 三种长度编码，任意切块都得到同样的结果
+    for (size_t size : {0u, 5u, 125u, 126u, 65535u, 65536u, 70000u}) {
+        std::string payload(size, 0);
+        for (size_t i = 0; i < size; ++i) payload[i] = static_cast<char>(i * 7);
+        std::string wire = client_frame(ws::BINARY, payload);
+        for (size_t chunk : {size_t(1), size_t(3), size_t(1000), wire.size()}) {
+            if (chunk == 1 && size > 1000) continue;
+            ws::FrameParser parser;
+            std::vector<Event> events = feed(parser, wire, chunk);
+            CHECK(events.size() == 1 && events[0].result == ws::FrameParser::MESSAGE &&
+                  events[0].opcode == ws::BINARY && events[0].payload == payload);
+        }
+    }
+
+    // 分片消息中间穿插控制帧: 控制帧先单独返回，消息在最后一片到达时拼好
+    std::string wire = client_frame(ws::TEXT, "hel", false) + client_frame(ws::PING, "p1") +
+                       client_frame(ws::CONTINUATION, "lo ", false) + client_frame(ws::CONTINUATION, "world") +
+                       client_frame(ws::TEXT, "next");
+    for (size_t chunk : {size_t(1), size_t(2), size_t(7), wire.size()}) {
+        ws::FrameParser parser;
+        std::vector<Event> events = feed(parser, wire, chunk);
+        CHECK(events.size() == 3);
+        if (events.size() != 3) continue;
+        CHECK(events[0].result == ws::FrameParser::CONTROL && events[0].opcode == ws::PING &&
+              events[0].payload == "p1");
+        CHECK(events[1].result == ws::FrameParser::MESSAGE && events[1].opcode == ws::TEXT &&
+              events[1].payload == "hello world");
+        CHECK(events[2].result == ws::FrameParser::MESSAGE && events[2].payload == "next");
+    }
+
+    // 关闭帧: 带关闭码与原因、空负载
+    std::string close_payload = "\x03\xe9going";
+    ws::FrameParser parser;
+    std::vector<Event> events = feed(parser, client_frame(ws::CLOSE, close_payload), 64);
+    CHECK(events.size() == 1 && events[0].result == ws::FrameParser::CONTROL && events[0].opcode == ws::CLOSE &&
+          events[0].close_code == 1001 && events[0].payload == close_payload);
+    uint16_t code = 0;
+    CHECK(single(client_frame(ws::CLOSE, ""), &code) == ws::FrameParser::CONTROL && code == ws::NORMAL);
+    CHECK(single(client_frame(ws::PONG, "x")) == ws::FrameParser::CONTROL);
+
+    // 协议错误
+    std::string unmasked;
+    ws::append_frame_header(unmasked, ws::TEXT, 2);
+    unmasked += "hi";
+    CHECK(single(unmasked, &code) == ws::FrameParser::FAILED && code == ws::PROTOCOL_ERROR);
+    std::string rsv = client_frame(ws::TEXT, "hi");
+    rsv[0] = static_cast<char>(rsv[0] | 0x40);
+    CHECK(single(rsv, &code) == ws::FrameParser::FAILED && code == ws::PROTOCOL_ERROR);
+    CHECK(single(client_frame(ws::PING, std::string(126, 'x')), &code) == ws::FrameParser::FAILED &&
+          code == ws::PROTOCOL_ERROR);
+    CHECK(single(client_frame(ws::PING, "x", false), &code) == ws::FrameParser::FAILED && code == ws::PROTOCOL_ERROR);
+    CHECK(single(client_frame(static_cast<ws::Opcode>(0xB), ""), &code) == ws::FrameParser::FAILED);
+    CHECK(single(client_frame(static_cast<ws::Opcode>(0x3), ""), &code) == ws::FrameParser::FAILED);
+    CHECK(single(client_frame(ws::CONTINUATION, "x"), &code) == ws::FrameParser::FAILED &&
+          code == ws::PROTOCOL_ERROR);
+    CHECK(single(client_frame(ws::TEXT, "a", false) + client_frame(ws::TEXT, "b"), &code) ==
+              ws::FrameParser::FAILED &&
+          code == ws::PROTOCOL_ERROR);
+    CHECK(single(client_frame(ws::CLOSE, "\x03"), &code) == ws::FrameParser::FAILED && code == ws::PROTOCOL_ERROR);
+
+    // 消息上限: 单帧超过、分片累计超过
+    CHECK(single(client_frame(ws::BINARY, std::string(101, 'x')), &code, 100) == ws::FrameParser::FAILED &&
+          code == ws::MESSAGE_TOO_BIG);
+    CHECK(single(client_frame(ws::BINARY, std::string(100, 'x')), &code, 100) == ws::FrameParser::MESSAGE);
+    CHECK(single(client_frame(ws::BINARY, std::string(60, 'x'), false) +
+                     client_frame(ws::CONTINUATION, std::string(41, 'x')),
+                 &code, 100) == ws::FrameParser::FAILED &&
+          code == ws::MESSAGE_TOO_BIG);
+}
+
+bool utf8(const std::string& s) {
+    return ws::valid_utf8(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+}
+
+void test_utf8() {
+    CHECK(utf8(""));
+    CHECK(utf8("plain ascii"));
+    CHECK(utf8("\xe8\xaf\xad\xe9\x9f\xb3"));         // 语音
+    CHECK(utf8("\xc2\x80\xdf\xbf"));                 // U+0080, U+07FF
+    CHECK(utf8("\xe0\xa0\x80\xef\xbf\xbf"));         // U+0800, U+FFFF
+    CHECK(utf8("\xf0\x90\x80\x80\xf4\x8f\xbf\xbf")); // U+10000, U+10FFFF
+    CHECK(utf8("\xed\x9f\xbf\xee\x80\x80"));         // 代理区两侧
+    CHECK(!utf8("\x80"));                            // 单独的续字节
+    CHECK(!utf8("\xc0\xaf"));                        // 过长编码
+    CHECK(!utf8("\xc1\xbf"));
+    CHECK(!utf8("\xe0\x9f\xbf"));
+    CHECK(!utf8("\xf0\x8f\xbf\xbf"));
+    CHECK(!utf8("\xed\xa0\x80"));                    // U+D800
+    CHECK(!utf8("\xed\xbf\xbf"));                    // U+DFFF
+    CHECK(!utf8("\xf4\x90\x80\x80"));                // U+110000
+    CHECK(!utf8("\xf5\x80\x80\x80"));
+    CHECK(!utf8("\xff"));
+    CHECK(!utf8("\xe8\xaf"));                        // 截断
+    CHECK(!utf8("\xe8\x41\xad"));                    // 续字节不合法
+
+    // TEXT 消息: 非法 UTF-8 以 1007 关闭；多字节字符跨分片合法；BINARY 不校验
+    uint16_t code = 0;
+    CHECK(single(client_frame(ws::TEXT, "ok\xff"), &code) == ws::FrameParser::FAILED &&
+          code == ws::INVALID_PAYLOAD);
+    CHECK(single(client_frame(ws::TEXT, "\xe8\xaf", false) + client_frame(ws::CONTINUATION, "\xad"), &code) ==
+          ws::FrameParser::MESSAGE);
+    CHECK(single(client_frame(ws::TEXT, "\xe8\xaf", false) + client_frame(ws::CONTINUATION, "x"), &code) ==
+              ws::FrameParser::FAILED &&
+          code == ws::INVALID_PAYLOAD);
+    CHECK(single(client_frame(ws::BINARY, "\xff\xfe"), &code) == ws::FrameParser::MESSAGE);
+    // 关闭原因同样必须是 UTF-8
+    CHECK(single(client_frame(ws::CLOSE, std::string("\x03\xe8\xff", 3)), &code) == ws::FrameParser::FAILED &&
+          code == ws::INVALID_PAYLOAD);
+}
+
+} // namespace
+
+int main() {
+    test_sha1();
+    test_handshake();
+    test_http();
+    test_frames();
+    test_utf8();
+    if (test::failures > 0) {
+        std::cerr << test::failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "websocket protocol tests passed" << std::endl;
+    return 0;
+}
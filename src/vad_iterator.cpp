@@ -1,4 +1,5 @@
 #include "vad_iterator.h"
+#include "session_snapshot.h"
 #include <cstring>
 #include <iostream>
 #include <cmath>
@@ -56,6 +57,7 @@ VadIterator::VadIterator(const std::string ModelPath,
     : sample_rate(Sample_rate), threshold(Threshold), speech_pad_samples(speech_pad_ms), prev_end(0)
 {
     sr_per_ms = sample_rate / 1000;
+    context_samples = (sample_rate == 16000) ? 64 : 32;
     window_size_samples = windows_frame_size * sr_per_ms;
     effective_window_size = window_size_samples + context_samples;
     input_node_dims[0] = 1;
@@ -94,10 +96,15 @@ void VadIterator::reset_states() {
 }
 
 void VadIterator::predict(const std::vector<float>& data_chunk) {
-    std::vector<float> new_data(effective_window_size, 0.0f);
-    std::copy(_context.begin(), _context.end(), new_data.begin());
-    std::copy(data_chunk.begin(), data_chunk.end(), new_data.begin() + context_samples);
-    input = new_data;
+    predict(data_chunk.data());
+}
+
+void VadIterator::predict(const float* data) {
+    // 直接在复用的 input 缓冲区中拼接 [context | window]，避免每个窗口分配临时向量
+    input.resize(effective_window_size);
+    std::copy(_context.begin(), _context.end(), input.begin());
+    std::copy(data, data + window_size_samples, input.begin() + context_samples);
+    const std::vector<float>& new_data = input;
 
     Ort::Value input_ort = Ort::Value::CreateTensor<float>(
         memory_info, input.data(), input.size(), input_node_dims, 2);
@@ -195,8 +202,7 @@ void VadIterator::process(const std::vector<float>& input_wav) {
     for (size_t j = 0; j < static_cast<size_t>(audio_length_samples); j += static_cast<size_t>(window_size_samples)) {
         if (j + static_cast<size_t>(window_size_samples) > static_cast<size_t>(audio_length_samples))
             break;
-        std::vector<float> chunk(&input_wav[j], &input_wav[j] + window_size_samples);
-        predict(chunk);
+        predict(&input_wav[j]);
     }
     if (current_speech.start >= 0) {
         current_speech.end = audio_length_samples;
@@ -209,10 +215,59 @@ void VadIterator::process(const std::vector<float>& input_wav) {
     }
 }
 
-const std::vector<timestamp_t> VadIterator::get_speech_timestamps() const {
+const std::vector<timestamp_t>& VadIterator::get_speech_timestamps() const {
     return speeches;
 }
 
 void VadIterator::reset() {
     reset_states();
 }
+
+void VadIterator::save_state(VadEngineState& state) const {
+    state.sample_rate = sample_rate;
+    state.context = _context;
+    state.rnn_state = _state;
+    state.last_prob = last_prob;
+    state.triggered = triggered;
+    state.temp_end = temp_end;
+    state.current_sample = current_sample;
+    state.prev_end = prev_end;
+    state.next_start = next_start;
+    state.speech_start = current_speech.start;
+    state.speech_end = current_speech.end;
+    state.last_start = speeches.empty() ? -1 : speeches.back().start;
+    state.last_end = speeches.empty() ? -1 : speeches.back().end;
+}
+
+bool VadIterator::load_state(const VadEngineState& state) {
+    if (state.sample_rate != sample_rate || state.context.size() != _context.size() ||
+        state.rnn_state.size() != _state.size()) {
+        return false;
+    }
+    _context = state.context;
+    _state = state.rnn_state;
+    last_prob = state.last_prob;
+    triggered = state.triggered;
+    temp_end = state.temp_end;
+    current_sample = state.current_sample;
+    prev_end = state.prev_end;
+    next_start = state.next_start;
+    current_speech = timestamp_t(state.speech_start, state.speech_end);
+    // 历史语音段只保留最近一个
+    speeches.clear();
+    if (state.last_start >= 0) speeches.push_back(timestamp_t(state.last_start, state.last_end));
+    return true;
+}
+
+size_t VadIterator::memory_bytes() const {
+    return (_context.capacity() + input.capacity() + _state.capacity()) * sizeof(float) +
+           sr.capacity() * sizeof(int64_t) + speeches.capacity() * sizeof(timestamp_t) +
+           (ort_inputs.capacity() + ort_outputs.capacity()) * sizeof(Ort::Value);
+}
+
+void VadIterator::trim() {
+    if (speeches.size() <= 1 && speeches.capacity() <= 1) return;
+    std::vector<timestamp_t> last;
+    if (!speeches.empty()) last.push_back(speeches.back());
+    speeches.swap(last);
+}
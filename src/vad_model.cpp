@@ -0,0 +1,201 @@
+#include "vad_model.h"
+#include <array>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "onnxruntime_session_options_config_keys.h"
+
+namespace {
+
+// kOrtSessionOptionsConfigUseORTModelBytesForInitializers，随附的 ORT 头文件较旧，尚未定义该常量
+const char kUseOrtModelBytesForInitializers[] = "session.use_ort_model_bytes_for_initializers";
+
+std::mutex g_model_mutex;
+VadModelOptions g_options;
+std::shared_ptr<VadModel> g_model;
+
+bool file_mtime(const std::string& path, time_t& mtime) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    mtime = st.st_mtime;
+    return true;
+}
+
+} // namespace
+
+void VadModel::configure(const VadModelOptions& options) {
+    std::lock_guard<std::mutex> lock(g_model_mutex);
+    if (g_model) {
+        std::cerr << "VadModel already loaded, ignoring new options" << std::endl;
+        return;
+    }
+    g_options = options;
+}
+
+const VadModelOptions& VadModel::options() {
+    return g_options;
+}
+
+std::shared_ptr<VadModel> VadModel::get() {
+    std::lock_guard<std::mutex> lock(g_model_mutex);
+    if (!g_model) {
+        g_model.reset(new VadModel(g_options));
+    }
+    return g_model;
+}
+
+std::string VadModel::cache_path(const VadModelOptions& options) {
+    return options.ort_cache_path.empty() ? options.model_path + ".ort" : options.ort_cache_path;
+}
+
+bool VadModel::cache_fresh(const VadModelOptions& options) {
+    // 缓存不比原始模型旧时才使用，模型更新后自动重建
+    time_t model_mtime = 0, cache_mtime = 0;
+    return options.use_ort_cache && file_mtime(cache_path(options), cache_mtime) &&
+           (!file_mtime(options.model_path, model_mtime) || cache_mtime >= model_mtime);
+}
+
+VadModel::VadModel(const VadModelOptions& options) : env_(ORT_LOGGING_LEVEL_WARNING, "vad") {
+    std::string cache_path = VadModel::cache_path(options);
+
+    if (cache_fresh(options)) {
+        try {
+            load_from_cache(cache_path);
+        } catch (const Ort::Exception& e) {
+            // 缓存来自不兼容的 ORT 版本或已损坏: 退回原始模型并重写缓存
+            std::cerr << "Ignoring ORT model cache " << cache_path << ": " << e.what() << std::endl;
+            session_.reset();
+            unmap_file();
+        }
+    }
+    if (!session_) {
+        if (options.use_ort_cache) {
+            // 多进程模式下说明本进程没能共享缓存页，模型在进程内单独解析一份
+            std::cerr << "ORT model cache " << cache_path << " not usable, loading a private copy of "
+                      << options.model_path << std::endl;
+        }
+        load_from_model(options, cache_path);
+    }
+    std::cout << "VAD model loaded from " << loaded_from_ << " (" << mapped_size_ << " bytes mapped)" << std::endl;
+}
+
+VadModel::~VadModel() {
+    session_.reset();
+    unmap_file();
+}
+
+void VadModel::base_session_options(Ort::SessionOptions& options) {
+    // 与 VadIterator 相同: 单线程推理，并发度来自多个工作线程
+    options.SetIntraOpNumThreads(1);
+    options.SetInterOpNumThreads(1);
+    options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+}
+
+void VadModel::load_from_cache(const std::string& cache_path) {
+    if (!map_file(cache_path)) {
+        throw Ort::Exception("cannot map " + cache_path, ORT_NO_SUCHFILE);
+    }
+    Ort::SessionOptions options;
+    base_session_options(options);
+    options.AddConfigEntry(kOrtSessionOptionsConfigLoadModelFormat, "ORT");
+    // 直接引用映射的字节，不再拷贝一份模型；映射在 VadModel 生命周期内保持有效
+    options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+    // 权重也直接指向映射 (ORT 1.15+)，多个进程共享同一份页缓存；旧版本忽略未知的配置项
+    options.AddConfigEntry(kUseOrtModelBytesForInitializers, "1");
+    session_ = std::make_unique<Ort::Session>(env_, mapped_, mapped_size_, options);
+    loaded_from_ = cache_path;
+}
+
+void VadModel::load_from_model(const VadModelOptions& options, const std::string& cache_path) {
+    if (!map_file(options.model_path)) {
+        throw Ort::Exception("cannot map " + options.model_path, ORT_NO_SUCHFILE);
+    }
+    Ort::SessionOptions session_options;
+    base_session_options(session_options);
+
+    // 先写临时文件再改名，多个进程同时启动时不会读到写了一半的缓存
+    std::string tmp_path = cache_path + ".tmp." + std::to_string(::getpid());
+    if (options.use_ort_cache) {
+        session_options.AddConfigEntry(kOrtSessionOptionsConfigSaveModelFormat, "ORT");
+        session_options.SetOptimizedModelFilePath(tmp_path.c_str());
+    }
+    try {
+        session_ = std::make_unique<Ort::Session>(env_, mapped_, mapped_size_, session_options);
+    } catch (const Ort::Exception& e) {
+        if (!options.use_ort_cache) throw;
+        // 缓存目录不可写等情况: 不影响正常加载
+        std::cerr << "Cannot write ORT model cache " << cache_path << ": " << e.what() << std::endl;
+        std::remove(tmp_path.c_str());
+        Ort::SessionOptions plain;
+        base_session_options(plain);
+        session_ = std::make_unique<Ort::Session>(env_, mapped_, mapped_size_, plain);
+    }
+    if (options.use_ort_cache && std::rename(tmp_path.c_str(), cache_path.c_str()) == 0) {
+        std::cout << "Saved optimized ORT model to " << cache_path << std::endl;
+    }
+    loaded_from_ = options.model_path;
+
+    // 非 ORT 格式时 ORT 已经把模型解析进自己的结构，映射不再需要
+    unmap_file();
+}
+
+bool VadModel::map_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = false;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            mapped_ = p;
+            mapped_size_ = static_cast<size_t>(st.st_size);
+            ok = true;
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+void VadModel::unmap_file() {
+    if (mapped_) {
+        ::munmap(const_cast<void*>(mapped_), mapped_size_);
+        mapped_ = nullptr;
+        mapped_size_ = 0;
+    }
+}
+
+void VadModel::warmup(int iterations) {
+    static const char* const kInputNames[3] = {"input", "state", "sr"};
+    static const char* const kOutputNames[2] = {"output", "stateN"};
+    static const int64_t kStateDims[3] = {2, 1, 128};
+    static const int64_t kSrDims[1] = {1};
+
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+    std::mt19937 rng(12345);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+
+    // 与服务端实际使用的两种窗口一致: 16k 512+64、8k 256+32
+    for (int64_t rate : {int64_t(16000), int64_t(8000)}) {
+        std::vector<float> input(rate == 16000 ? 576 : 288);
+        std::array<float, 256> state{};
+        std::array<int64_t, 1> sr = {rate};
+        const int64_t input_dims[2] = {1, static_cast<int64_t>(input.size())};
+        for (int i = 0; i < iterations; ++i) {
+            for (float& x : input) x = noise(rng);
+            Ort::Value inputs[3] = {
+                Ort::Value::CreateTensor<float>(memory_info, input.data(), input.size(), input_dims, 2),
+                Ort::Value::CreateTensor<float>(memory_info, state.data(), state.size(), kStateDims, 3),
+                Ort::Value::CreateTensor<int64_t>(memory_info, sr.data(), sr.size(), kSrDims, 1)};
+            std::vector<Ort::Value> outputs =
+                session_->Run(Ort::RunOptions{nullptr}, kInputNames, inputs, 3, kOutputNames, 2);
+            const float* state_n = outputs[1].GetTensorMutableData<float>();
+            std::copy(state_n, state_n + state.size(), state.begin());
+        }
+    }
+}
@@ -0,0 +1,316 @@
+#include "vad_state_table.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+template <class Geometry>
+VadStateTable<Geometry>::VadStateTable(std::shared_ptr<VadModel> model, size_t capacity, float threshold)
+    : model_(std::move(model)),
+      threshold_(threshold),
+      rnn_state_(capacity * kStride),
+      context_(capacity * Geometry::context_samples),
+      last_prob_(capacity),
+      triggered_(capacity),
+      temp_end_(capacity),
+      current_sample_(capacity),
+      prev_end_(capacity),
+      next_start_(capacity),
+      speech_start_(capacity),
+      speech_end_(capacity),
+      last_start_(capacity),
+      last_end_(capacity) {
+    // VadIterator 以 double 比较 prob >= threshold - 0.15；换成等价的 float 比较，批循环里全部是 float
+    double low = static_cast<double>(threshold) - 0.15;
+    low_threshold_ = static_cast<float>(low);
+    if (static_cast<double>(low_threshold_) < low) low_threshold_ = std::nextafter(low_threshold_, 1.0f);
+
+    free_list_.reserve(capacity);
+    for (size_t i = capacity; i-- > 0;) {
+        free_list_.push_back(static_cast<uint32_t>(i));
+        reset_row(static_cast<uint32_t>(i));
+    }
+}
+
+template <class Geometry>
+uint32_t VadStateTable<Geometry>::acquire() {
+    uint32_t row;
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        if (free_list_.empty()) return kNoRow;
+        row = free_list_.back();
+        free_list_.pop_back();
+    }
+    reset_row(row);
+    return row;
+}
+
+template <class Geometry>
+void VadStateTable<Geometry>::release(uint32_t row) {
+    if (row >= capacity()) return;
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_list_.push_back(row);
+}
+
+template <class Geometry>
+void VadStateTable<Geometry>::reset_row(uint32_t row) {
+    std::fill_n(rnn_state_.begin() + row * kStride, kStride, 0.0f);
+    std::fill_n(context_.begin() + row * Geometry::context_samples, Geometry::context_samples, 0.0f);
+    last_prob_[row] = 0.0f;
+    triggered_[row] = 0;
+    temp_end_[row] = 0;
+    current_sample_[row] = 0;
+    prev_end_[row] = 0;
+    next_start_[row] = 0;
+    speech_start_[row] = -1;
+    speech_end_[row] = -1;
+    last_start_[row] = -1;
+    last_end_[row] = -1;
+}
+
+template <class Geometry>
+void VadStateTable<Geometry>::update(const uint32_t* rows, const float* probs, size_t n, uint8_t* transitions) {
+    const uint32_t window = static_cast<uint32_t>(Geometry::window_samples);
+    const uint32_t min_silence = Geometry::sr_per_ms * 100;
+    const uint32_t min_silence_at_max_speech = Geometry::sr_per_ms * 98;
+    const int32_t min_speech = Geometry::sr_per_ms * 250;
+
+    // 收集: 本批各行的计数器放进连续数组
+    thread_local std::vector<int32_t> trig, ss, se, pe, ns, ls, le;
+    thread_local std::vector<uint32_t> te, cs;
+    trig.resize(n), ss.resize(n), se.resize(n), pe.resize(n), ns.resize(n), ls.resize(n), le.resize(n);
+    te.resize(n), cs.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t r = rows[i];
+        trig[i] = triggered_[r];
+        te[i] = temp_end_[r];
+        cs[i] = current_sample_[r];
+        pe[i] = prev_end_[r];
+        ns[i] = next_start_[r];
+        ss[i] = speech_start_[r];
+        se[i] = speech_end_[r];
+        ls[i] = last_start_[r];
+        le[i] = last_end_[r];
+    }
+
+    // 判决: 与 SileroHysteresis::update 逐条对应，分支全部换成选择运算
+    const float th = threshold_;
+    const float low = low_threshold_;
+    for (size_t i = 0; i < n; ++i) {
+        const float p = probs[i];
+        const uint32_t now = cs[i] + window;
+        const uint32_t window_start = now - window;
+        const bool speech = p >= th;
+        const bool quiet = !speech && p < low;
+        const bool was_triggered = trig[i] != 0;
+
+        // 语音窗口: 取消暂定的结束点，未触发时开始新的语音段
+        const bool cancel_end = speech && te[i] != 0;
+        int32_t next_start = (cancel_end && ns[i] < pe[i]) ? static_cast<int32_t>(window_start) : ns[i];
+        uint32_t temp_end = cancel_end ? 0u : te[i];
+        const bool start = speech && !was_triggered;
+        int32_t speech_start = start ? static_cast<int32_t>(window_start) : ss[i];
+
+        // 静音窗口 (已触发): 记录暂定结束点，静音足够长后结束语音段
+        const bool silent = quiet && was_triggered;
+        temp_end = (silent && temp_end == 0) ? now : temp_end;
+        int32_t prev_end = (silent && now - temp_end > min_silence_at_max_speech) ? static_cast<int32_t>(temp_end)
+                                                                                   : pe[i];
+        const bool reached = silent && now - temp_end >= min_silence;
+        int32_t speech_end = reached ? static_cast<int32_t>(temp_end) : se[i];
+        const bool end = reached && speech_end - speech_start > min_speech;
+
+        ls[i] = end ? speech_start : ls[i];
+        le[i] = end ? speech_end : le[i];
+        ss[i] = end ? -1 : speech_start;
+        se[i] = end ? -1 : speech_end;
+        pe[i] = end ? 0 : prev_end;
+        ns[i] = end ? 0 : next_start;
+        te[i] = end ? 0u : temp_end;
+        trig[i] = end ? 0 : (was_triggered || speech ? 1 : 0);
+        cs[i] = now;
+        transitions[i] = static_cast<uint8_t>(start ? START : (end ? END : NONE));
+    }
+
+    // 写回
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t r = rows[i];
+        triggered_[r] = static_cast<uint8_t>(trig[i]);
+        temp_end_[r] = te[i];
+        current_sample_[r] = cs[i];
+        prev_end_[r] = pe[i];
+        next_start_[r] = ns[i];
+        speech_start_[r] = ss[i];
+        speech_end_[r] = se[i];
+        last_start_[r] = ls[i];
+        last_end_[r] = le[i];
+        last_prob_[r] = probs[i];
+    }
+}
+
+template <class Geometry>
+void VadStateTable<Geometry>::step(const uint32_t* rows, const float* const* windows, size_t n,
+                                   uint8_t* transitions) {
+    static const char* const kInputNames[3] = {"input", "state", "sr"};
+    static const char* const kOutputNames[2] = {"output", "stateN"};
+    const size_t ctx = Geometry::context_samples;
+    const size_t eff = Geometry::effective_window;
+    const size_t half = kStride / 2; // 每层 128
+
+    if (n == 0) return;
+    // 每个线程一份批缓冲区 (不同线程可以同时 step 不相交的行)
+    thread_local std::vector<float> input, state_in, state_out, probs;
+    thread_local std::array<int64_t, 1> sr;
+    input.resize(n * eff);
+    state_in.resize(n * kStride);
+    state_out.resize(n * kStride);
+    probs.resize(n);
+    sr[0] = Geometry::sample_rate;
+
+    // [context | window] 逐行拼接；状态从每行的 [2][128] 收集为 [2, n, 128]
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t r = rows[i];
+        float* in = input.data() + i * eff;
+        std::copy_n(context_.data() + r * ctx, ctx, in);
+        std::copy_n(windows[i], Geometry::window_samples, in + ctx);
+        const float* st = rnn_state_.data() + r * kStride;
+        std::copy_n(st, half, state_in.data() + i * half);
+        std::copy_n(st + half, half, state_in.data() + (n + i) * half);
+    }
+
+    const int64_t input_dims[2] = {static_cast<int64_t>(n), static_cast<int64_t>(eff)};
+    const int64_t state_dims[3] = {2, static_cast<int64_t>(n), static_cast<int64_t>(half)};
+    const int64_t sr_dims[1] = {1};
+    const int64_t prob_dims[2] = {static_cast<int64_t>(n), 1};
+    Ort::Value inputs[3] = {
+        Ort::Value::CreateTensor<float>(memory_info_, input.data(), input.size(), input_dims, 2),
+        Ort::Value::CreateTensor<float>(memory_info_, state_in.data(), state_in.size(), state_dims, 3),
+        Ort::Value::CreateTensor<int64_t>(memory_info_, sr.data(), sr.size(), sr_dims, 1)};
+    Ort::Value outputs[2] = {
+        Ort::Value::CreateTensor<float>(memory_info_, probs.data(), probs.size(), prob_dims, 2),
+        Ort::Value::CreateTensor<float>(memory_info_, state_out.data(), state_out.size(), state_dims, 3)};
+    model_->session().Run(Ort::RunOptions{nullptr}, kInputNames, inputs, 3, kOutputNames, outputs, 2);
+
+    // 状态写回各行，窗口尾部作为下一个窗口的上下文
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t r = rows[i];
+        float* st = rnn_state_.data() + r * kStride;
+        std::copy_n(state_out.data() + i * half, half, st);
+        std::copy_n(state_out.data() + (n + i) * half, half, st + half);
+        const float* in = input.data() + i * eff;
+        std::copy_n(in + eff - ctx, ctx, context_.data() + r * ctx);
+    }
+    update(rows, probs.data(), n, transitions);
+}
+
+template <class Geometry>
+void VadStateTable<Geometry>::save_state(uint32_t row, VadEngineState& state) const {
+    state.sample_rate = Geometry::sample_rate;
+    state.context.assign(context_.begin() + row * Geometry::context_samples,
+                         context_.begin() + (row + 1) * Geometry::context_samples);
+    state.rnn_state.assign(rnn_state_.begin() + row * kStride, rnn_state_.begin() + (row + 1) * kStride);
+    state.last_prob = last_prob_[row];
+    state.triggered = triggered_[row] != 0;
+    state.temp_end = temp_end_[row];
+    state.current_sample = current_sample_[row];
+    state.prev_end = prev_end_[row];
+    state.next_start = next_start_[row];
+    state.speech_start = speech_start_[row];
+    state.speech_end = speech_end_[row];
+    state.last_start = last_start_[row];
+    state.last_end = last_end_[row];
+}
+
+template <class Geometry>
+bool VadStateTable<Geometry>::load_state(uint32_t row, const VadEngineState& state) {
+    if (state.sample_rate != Geometry::sample_rate || state.context.size() != Geometry::context_samples ||
+        state.rnn_state.size() != kStride) {
+        return false;
+    }
+    std::copy(state.context.begin(), state.context.end(), context_.begin() + row * Geometry::context_samples);
+    std::copy(state.rnn_state.begin(), state.rnn_state.end(), rnn_state_.begin() + row * kStride);
+    last_prob_[row] = state.last_prob;
+    triggered_[row] = state.triggered ? 1 : 0;
+    temp_end_[row] = state.temp_end;
+    current_sample_[row] = state.current_sample;
+    prev_end_[row] = state.prev_end;
+    next_start_[row] = state.next_start;
+    speech_start_[row] = state.speech_start;
+    speech_end_[row] = state.speech_end;
+    last_start_[row] = state.last_start;
+    last_end_[row] = state.last_end;
+    return true;
+}
+
+// ==========================================
+// TableVadEngine
+// ==========================================
+
+template <class Geometry>
+TableVadEngine<Geometry>::TableVadEngine(std::shared_ptr<VadStateTable<Geometry>> table)
+    : table_(std::move(table)), row_(table_->acquire()) {
+    buffer_.reserve(Geometry::window_samples);
+}
+
+template <class Geometry>
+TableVadEngine<Geometry>::~TableVadEngine() {
+    if (valid()) table_->release(row_);
+}
+
+template <class Geometry>
+VadResult TableVadEngine<Geometry>::process_buffered() {
+    VadResult result;
+    result.state = VadState::SILENCE;
+    result.probability = table_->last_prob(row_);
+
+    size_t offset = 0;
+    while (buffer_.size() - offset >= Geometry::window_samples) {
+        const float* window = buffer_.data() + offset;
+        uint8_t transition = VadStateTable<Geometry>::NONE;
+        table_->step(&row_, &window, 1, &transition);
+        offset += Geometry::window_samples;
+        // 与 StaticVadEngine 相同的映射
+        if (transition == VadStateTable<Geometry>::START) {
+            result.state = VadState::START_SPEAKING;
+        } else if (transition == VadStateTable<Geometry>::END) {
+            result.state = VadState::END_SPEAKING;
+        } else if (table_->triggered(row_)) {
+            result.state = VadState::SPEAKING;
+        }
+    }
+    if (offset > 0) {
+        buffer_.erase(buffer_.begin(), buffer_.begin() + offset);
+        result.probability = table_->last_prob(row_);
+    }
+    if (result.state == VadState::SILENCE && table_->triggered(row_)) {
+        result.state = VadState::SPEAKING;
+    }
+    if (table_->last_start(row_) >= 0) {
+        result.timestamp = timestamp_t(table_->last_start(row_), table_->last_end(row_)).c_str();
+    }
+    return result;
+}
+
+template <class Geometry>
+void TableVadEngine<Geometry>::reset() {
+    table_->reset_row(row_);
+    buffer_.clear();
+}
+
+template <class Geometry>
+bool TableVadEngine<Geometry>::save_state(VadEngineState& state) const {
+    table_->save_state(row_, state);
+    state.pending = buffer_;
+    return true;
+}
+
+template <class Geometry>
+bool TableVadEngine<Geometry>::load_state(const VadEngineState& state) {
+    if (!table_->load_state(row_, state)) return false;
+    buffer_ = state.pending;
+    return true;
+}
+
+template class VadStateTable<VadGeometry<16000, 32>>;
+template class VadStateTable<VadGeometry<8000, 32>>;
+template class TableVadEngine<VadGeometry<16000, 32>>;
+template class TableVadEngine<VadGeometry<8000, 32>>;
@@ -0,0 +1,336 @@
+#include "ws_protocol.h"
+#include <cctype>
+#include <cstring>
+#include "base64.h"
+
+namespace ws {
+
+namespace {
+
+const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+std::string lower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+std::string trim(const char* begin, const char* end) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+    return std::string(begin, end);
+}
+
+// 就地去掩码: 按 8 字节一组异或
+void unmask(uint8_t* data, size_t len, const uint8_t mask[4]) {
+    uint64_t mask64;
+    uint8_t* m = reinterpret_cast<uint8_t*>(&mask64);
+    for (int i = 0; i < 8; ++i) m[i] = mask[i & 3];
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, data + i, 8);
+        v ^= mask64;
+        std::memcpy(data + i, &v, 8);
+    }
+    for (; i < len; ++i) data[i] ^= mask[i & 3];
+}
+
+} // namespace
+
+void sha1(const uint8_t* data, size_t len, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+
+    // 补位: 0x80、若干 0、64 位大端长度
+    std::vector<uint8_t> msg(data, data + len);
+    msg.push_back(0x80);
+    while (msg.size() % 64 != 56) msg.push_back(0);
+    uint64_t bits = static_cast<uint64_t>(len) * 8;
+    for (int i = 7; i >= 0; --i) msg.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+
+    for (size_t block = 0; block < msg.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const uint8_t* p = &msg[block + i * 4];
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+}
+
+bool valid_utf8(const uint8_t* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        uint8_t c = data[i];
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        // 按首字节确定长度与第二字节的合法范围 (RFC 3629 表 3-7)
+        size_t n;
+        uint8_t lo = 0x80, hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            n = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 3;
+            if (c == 0xE0) lo = 0xA0; // 过长编码
+            if (c == 0xED) hi = 0x9F; // 代理区
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 4;
+            if (c == 0xF0) lo = 0x90; // 过长编码
+            if (c == 0xF4) hi = 0x8F; // 超过 U+10FFFF
+        } else {
+            return false;
+        }
+        if (len - i < n) return false;
+        if (data[i + 1] < lo || data[i + 1] > hi) return false;
+        for (size_t k = 2; k < n; ++k) {
+            if ((data[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += n;
+    }
+    return true;
+}
+
+bool HttpRequest::is_websocket() const {
+    return method == "GET" && upgrade == "websocket" && connection.find("upgrade") != std::string::npos &&
+           !key.empty() && version == "13";
+}
+
+long parse_http_request(const char* data, size_t len, HttpRequest& request, size_t max_size) {
+    const char* end = nullptr;
+    for (size_t i = 3; i < len; ++i) {
+        if (data[i - 3] == '\r' && data[i - 2] == '\n' && data[i - 1] == '\r' && data[i] == '\n') {
+            end = data + i + 1;
+            break;
+        }
+    }
+    if (!end) return len > max_size ? -1 : 0;
+    if (static_cast<size_t>(end - data) > max_size) return -1;
+
+    // 请求行: METHOD SP resource SP HTTP/1.1
+    const char* line_end = static_cast<const char*>(std::memchr(data, '\r', end - data));
+    const char* sp1 = static_cast<const char*>(std::memchr(data, ' ', line_end - data));
+    if (!sp1) return -1;
+    const char* sp2 = static_cast<const char*>(std::memchr(sp1 + 1, ' ', line_end - sp1 - 1));
+    if (!sp2 || std::strncmp(sp2 + 1, "HTTP/1.", 7) != 0) return -1;
+    request.method.assign(data, sp1);
+    request.resource.assign(sp1 + 1, sp2);
+
+    const char* p = line_end + 2;
+    while (p < end - 2) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\r', end - p));
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', eol - p));
+        if (!colon) return -1;
+        std::string name = lower(std::string(p, colon));
+        if (name == "upgrade") {
+            request.upgrade = lower(trim(colon + 1, eol));
+        } else if (name == "connection") {
+            request.connection = lower(trim(colon + 1, eol));
+        } else if (name == "sec-websocket-key") {
+            request.key = trim(colon + 1, eol);
+        } else if (name == "sec-websocket-version") {
+            request.version = trim(colon + 1, eol);
+        }
+        p = eol + 2;
+    }
+    return static_cast<long>(end - data);
+}
+
+std::string accept_key(const std::string& key) {
+    std::string input = key + kGuid;
+    uint8_t digest[20];
+    sha1(reinterpret_cast<const uint8_t*>(input.data()), input.size(), digest);
+    std::string out;
+    base64::encode_append(out, digest, sizeof(digest));
+    return out;
+}
+
+std::string handshake_response(const std::string& key) {
+    return "HTTP/1.1 101 Switching Protocols\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: " + accept_key(key) + "\r\n\r\n";
+}
+
+std::string http_response(int status, const char* reason, const std::string& body) {
+    return "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+           "Content-Type: text/plain\r\n"
+           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+           "Connection: close\r\n\r\n" + body;
+}
+
+void append_frame_header(std::string& out, Opcode opcode, size_t payload_len) {
+    out.push_back(static_cast<char>(0x80 | opcode));
+    if (payload_len < 126) {
+        out.push_back(static_cast<char>(payload_len));
+    } else if (payload_len <= 0xFFFF) {
+        out.push_back(126);
+        out.push_back(static_cast<char>(payload_len >> 8));
+        out.push_back(static_cast<char>(payload_len & 0xFF));
+    } else {
+        out.push_back(127);
+        for (int i = 7; i >= 0; --i) out.push_back(static_cast<char>(static_cast<uint64_t>(payload_len) >> (i * 8)));
+    }
+}
+
+void append_close_frame(std::string& out, uint16_t code) {
+    append_frame_header(out, CLOSE, 2);
+    out.push_back(static_cast<char>(code >> 8));
+    out.push_back(static_cast<char>(code & 0xFF));
+}
+
+void append_client_frame(std::string& out, Opcode opcode, const uint8_t* payload, size_t len, uint32_t mask_key) {
+    size_t start = out.size();
+    append_frame_header(out, opcode, len);
+    out[start + 1] = static_cast<char>(out[start + 1] | 0x80);
+    uint8_t mask[4];
+    std::memcpy(mask, &mask_key, 4);
+    out.append(reinterpret_cast<const char*>(mask), 4);
+    size_t offset = out.size();
+    out.resize(offset + len);
+    for (size_t i = 0; i < len; ++i) out[offset + i] = static_cast<char>(payload[i] ^ mask[i & 3]);
+}
+
+FrameParser::FrameParser(size_t max_message) : max_message_(max_message) {}
+
+FrameParser::Result FrameParser::next(uint8_t* data, size_t len, size_t& consumed) {
+    consumed = 0;
+    for (;;) {
+        uint8_t* p = data + consumed;
+        size_t avail = len - consumed;
+        if (avail < 2) return NEED_MORE;
+
+        bool fin = (p[0] & 0x80) != 0;
+        Opcode opcode = static_cast<Opcode>(p[0] & 0x0F);
+        bool masked = (p[1] & 0x80) != 0;
+        uint64_t payload_len = p[1] & 0x7F;
+        size_t header = 2;
+        if ((p[0] & 0x70) != 0 || !masked) {
+            // 未协商扩展时 RSV 必须为 0；客户端帧必须带掩码
+            close_code_ = PROTOCOL_ERROR;
+            return FAILED;
+        }
+        if (payload_len == 126) {
+            if (avail < 4) return NEED_MORE;
+            payload_len = (uint64_t(p[2]) << 8) | p[3];
+            header = 4;
+        } else if (payload_len == 127) {
+            if (avail < 10) return NEED_MORE;
+            payload_len = 0;
+            for (int i = 0; i < 8; ++i) payload_len = (payload_len << 8) | p[2 + i];
+            header = 10;
+        }
+        bool control = (opcode & 0x08) != 0;
+        if (control && (!fin || payload_len > 125)) {
+            close_code_ = PROTOCOL_ERROR;
+            return FAILED;
+        }
+        if (payload_len > max_message_ || (fragmented_ && fragments_.size() + payload_len > max_message_)) {
+            close_code_ = MESSAGE_TOO_BIG;
+            return FAILED;
+        }
+        if (avail < header + 4 + payload_len) return NEED_MORE;
+
+        uint8_t* payload = p + header + 4;
+        unmask(payload, static_cast<size_t>(payload_len), p + header);
+        consumed += header + 4 + static_cast<size_t>(payload_len);
+
+        if (control) {
+            if (opcode != CLOSE && opcode != PING && opcode != PONG) {
+                close_code_ = PROTOCOL_ERROR;
+                return FAILED;
+            }
+            opcode_ = opcode;
+            payload_ = payload;
+            payload_size_ = static_cast<size_t>(payload_len);
+            close_code_ = NORMAL;
+            if (opcode == CLOSE && payload_len >= 2) close_code_ = static_cast<uint16_t>((payload[0] << 8) | payload[1]);
+            // 关闭帧负载要么为空，要么是 2 字节关闭码 + UTF-8 原因
+            if (opcode == CLOSE && payload_len == 1) {
+                close_code_ = PROTOCOL_ERROR;
+                return FAILED;
+            }
+            if (opcode == CLOSE && payload_len > 2 && !valid_utf8(payload + 2, payload_len - 2)) {
+                close_code_ = INVALID_PAYLOAD;
+                return FAILED;
+            }
+            return CONTROL;
+        }
+
+        if (opcode == CONTINUATION) {
+            if (!fragmented_) {
+                close_code_ = PROTOCOL_ERROR;
+                return FAILED;
+            }
+            fragments_.insert(fragments_.end(), payload, payload + payload_len);
+            if (!fin) continue;
+            fragmented_ = false;
+            opcode_ = fragment_opcode_;
+            payload_ = fragments_.data();
+            payload_size_ = fragments_.size();
+            return checked_message();
+        }
+        if ((opcode != TEXT && opcode != BINARY) || fragmented_) {
+            close_code_ = PROTOCOL_ERROR;
+            return FAILED;
+        }
+        if (!fin) {
+            // 分片消息的第一帧: 之后的分片拼接到内部缓冲
+            fragmented_ = true;
+            fragment_opcode_ = opcode;
+            fragments_.assign(payload, payload + payload_len);
+            continue;
+        }
+        opcode_ = opcode;
+        payload_ = payload;
+        payload_size_ = static_cast<size_t>(payload_len);
+        return checked_message();
+    }
+}
+
+// TEXT 在整条消息拼好后校验 (多字节字符可以跨分片)
+FrameParser::Result FrameParser::checked_message() {
+    if (opcode_ == TEXT && !valid_utf8(payload_, payload_size_)) {
+        close_code_ = INVALID_PAYLOAD;
+        return FAILED;
+    }
+    return MESSAGE;
+}
+
+} // namespace ws